@@ -759,6 +759,10 @@ bgp_adj_out_set (struct bgp_node *rn, struct bgp_peer *peer,
                  struct attr *attr, afi_t afi, safi_t safi,
                  struct bgp_info *binfo)
 {
+  u_int64_t start;
+
+  start = BGP_PERF_BEGIN ();
+
   if (!bgp_option_check (BGP_OPT_DISABLE_ADJ_OUT))
     bgp_rib_out_set (rn, peer, attr, afi, safi, binfo);
   else
@@ -766,6 +770,9 @@ bgp_adj_out_set (struct bgp_node *rn, struct bgp_peer *peer,
       if (peer != binfo->peer)
         bgp_adv_out_set (rn, peer, afi, safi, binfo, PAL_TRUE);
     }
+
+  bgp_perf_record (peer, BGP_PERF_ADJ_OUT, start);
+
   return;
 }
 
@@ -1768,6 +1768,69 @@ bgp_path_attr_lookup_addr_ipv4 (u_int32_t vr_id, struct prefix_ipv4 *addr,
   return NULL;
 }
 
+/* Position of the last row returned by a bgp4PathAttrTable walk.  The
+   node stays locked so that the next GETNEXT, whose index is the OID we
+   just returned, continues from here instead of searching the RIB. */
+static struct bgp_path_attr_cursor
+{
+  struct bgp *bgp;
+  struct bgp_node *rn;
+  struct prefix_ipv4 addr;
+  struct pal_in4_addr peer;
+} bgp_path_attr_cursor;
+
+/* Drop the cached walk position.  Must be called before the RIB of
+   'bgp' is freed; NULL drops it regardless of the instance.  */
+void
+bgp_path_attr_cursor_reset (struct bgp *bgp)
+{
+  struct bgp_path_attr_cursor *cur = &bgp_path_attr_cursor;
+
+  if (bgp && cur->bgp != bgp)
+    return;
+
+  if (cur->rn)
+    bgp_unlock_node (cur->rn);
+
+  pal_mem_set (cur, 0, sizeof (struct bgp_path_attr_cursor));
+}
+
+/* Take over the lock on 'rn' as the new walk position. */
+static void
+bgp_path_attr_cursor_set (struct bgp *bgp, struct bgp_node *rn,
+                          struct prefix_ipv4 *addr, union sockunion *su)
+{
+  struct bgp_path_attr_cursor *cur = &bgp_path_attr_cursor;
+
+  if (cur->rn)
+    bgp_unlock_node (cur->rn);
+
+  cur->bgp = bgp;
+  cur->rn = rn;
+  cur->addr = *addr;
+  cur->peer = su->sin.sin_addr;
+}
+
+/* Return the locked cursor node when the request continues the
+   cached walk, otherwise NULL. */
+static struct bgp_node *
+bgp_path_attr_cursor_match (struct bgp *bgp, struct prefix_ipv4 *addr,
+                            union sockunion *su)
+{
+  struct bgp_path_attr_cursor *cur = &bgp_path_attr_cursor;
+
+  if (cur->bgp != bgp || ! cur->rn
+      || cur->rn->tree != bgp->rib[BAAI_IP][BSAI_UNICAST])
+    return NULL;
+
+  if (cur->addr.prefixlen != addr->prefixlen
+      || cur->addr.prefix.s_addr != addr->prefix.s_addr
+      || cur->peer.s_addr != su->sin.sin_addr.s_addr)
+    return NULL;
+
+  return bgp_lock_node (cur->rn);
+}
+
 struct bgp_info *
 bgp_path_attr_lookup_addr_ipv4_next (u_int32_t vr_id, struct prefix_ipv4 *addr,
                                      union sockunion *su,
@@ -1785,16 +1848,32 @@ bgp_path_attr_lookup_addr_ipv4_next (u_int32_t vr_id, struct prefix_ipv4 *addr,
 
   offsetlen -= sizeof (struct pal_in4_addr);
 
+  rn = NULL;
   if (offsetlen < 0)
     rn = bgp_table_top (bgp->rib[BAAI_IP][BSAI_UNICAST]);
   else
-    rn = bgp_node_get (bgp->rib[BAAI_IP][BSAI_UNICAST],
-                       (struct prefix *) addr);
+    {
+      if (offsetlen >= (int) (1 + sizeof (struct pal_in4_addr)))
+        rn = bgp_path_attr_cursor_match (bgp, addr, su);
+      if (! rn)
+        rn = bgp_node_lookup_next (bgp->rib[BAAI_IP][BSAI_UNICAST],
+                                   (struct prefix *) addr);
+    }
   if (! rn)
     return NULL;
 
   offsetlen -= 1 + sizeof (struct pal_in4_addr);
 
+  /* The successor lookup may land past the requested prefix, in which
+     case every path of the first node follows the index.  */
+  if (offsetlen >= 0)
+    {
+      BGP_GET_PREFIX_FROM_NODE (rn);
+      if (rnp.prefixlen != addr->prefixlen
+          || rnp.u.prefix4.s_addr != addr->prefix.s_addr)
+        offsetlen = -1;
+    }
+
   do
     {
       min = NULL;
@@ -1827,7 +1906,7 @@ bgp_path_attr_lookup_addr_ipv4_next (u_int32_t vr_id, struct prefix_ipv4 *addr,
 
           pal_mem_cpy (&su->sin.sin_addr.s_addr, &min->peer->su.sin.sin_addr,
                   sizeof (struct pal_in4_addr));
-          bgp_unlock_node (rn);
+          bgp_path_attr_cursor_set (bgp, rn, addr, su);
           return min;
         }
 
@@ -336,6 +336,8 @@ bgp_path_attr_lookup_addr_ipv4 (u_int32_t, struct prefix_ipv4 *,
 struct bgp_info *
 bgp_path_attr_lookup_addr_ipv4_next (u_int32_t, struct prefix_ipv4 *,
                                      union sockunion *, int);
+void
+bgp_path_attr_cursor_reset (struct bgp *);
 
 /* BGP CLI API.  */
 
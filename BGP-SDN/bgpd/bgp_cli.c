@@ -11619,6 +11619,12 @@ bgp_cli_init (void)
   /* BGP Debug CLI Commands Initialization */
   bgp_debug_cli_init (BLG.ctree);
 
+  /* BGP RIB export CLI Commands Initialization */
+  bgp_export_cli_init (BLG.ctree);
+
+  /* BGP UPDATE pipeline latency CLI Commands Initialization */
+  bgp_perf_cli_init (BLG.ctree);
+
 #ifdef HAVE_MULTIPATH
   bgp_ecmp_cli_init(BLG.ctree);
 #endif
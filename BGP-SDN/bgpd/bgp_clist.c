@@ -57,7 +57,12 @@ community_entry_free (struct community_entry *entry)
       if (entry->config)
         XFREE (MTYPE_COMMUNITY_LIST_CONFIG, entry->config);
       if (entry->reg)
-        bgp_regex_free (entry->reg);
+        {
+          bgp_regex_free (entry->reg);
+
+          /* Invalidate verdicts cached against this expression.  */
+          bgp_comregex_gen++;
+        }
     default:
       break;
     }
@@ -325,20 +330,27 @@ static int
 community_regexp_match (struct community *com, pal_regex_t *reg)
 {
   u_int8_t *str;
+  s_int32_t match;
 
   /* When there is no communities attribute it is treated as empty
      string.  */
   if (com == NULL || com->size == 0)
-    str = "";
-  else
-    str = community_str (com);
+    return pal_regexec (reg, "", 0, NULL, 0) == 0;
+
+  /* The same interned community is usually matched against the same
+     expression many times, so reuse the previous verdict.  */
+  match = community_regex_cache_lookup (com, reg);
+  if (match >= 0)
+    return match;
+
+  str = community_str (com);
 
   /* Regular expression match.  */
-  if (pal_regexec (reg, str, 0, NULL, 0) == 0)
-    return 1;
+  match = (pal_regexec (reg, str, 0, NULL, 0) == 0);
 
-  /* No match.  */
-  return 0;
+  community_regex_cache_set (com, reg, match);
+
+  return match;
 }
 
 /* Do regular expression matching with single community val */
@@ -25,10 +25,20 @@ community_free (struct community *com)
   XFREE (MTYPE_COMMUNITY, com);
 }
 
+/* Forget cached expanded community-list verdicts.  Must be called
+   whenever the community value changes.  */
+static void
+community_regex_cache_flush (struct community *com)
+{
+  pal_mem_set (com->rcache, 0, sizeof (com->rcache));
+}
+
 /* Add one community value to the community. */
 void
 community_add_val (struct community *com, u_int32_t val)
 {
+  community_regex_cache_flush (com);
+
   com->size++;
   if (com->val)
     com->val = XREALLOC (MTYPE_COMMUNITY_VAL, com->val, com_length (com));
@@ -53,6 +63,8 @@ community_del_val (struct community *com, u_int32_t *val)
     {
       if (pal_mem_cmp (com->val + i, val, sizeof (u_int32_t)) == 0)
         {
+          community_regex_cache_flush (com);
+
           c = com->size -i -1;
 
           if (c > 0)
@@ -108,17 +120,32 @@ community_compare (const void *a1, const void *a2)
   return 0;
 }
 
+/* Communities values are sorted, so binary search the value.  */
 bool_t
 community_include (struct community *com, u_int32_t val)
 {
-  int i;
+  s_int32_t low;
+  s_int32_t high;
+  s_int32_t mid;
+  u_int32_t comval;
 
-  val = pal_hton32 (val);
+  low = 0;
+  high = com->size - 1;
 
-  for (i = 0; i < com->size; i++)
+  while (low <= high)
     {
-      if (pal_mem_cmp (&val, com_nthval (com, i), sizeof (u_int32_t)) == 0)
+      mid = (low + high) / 2;
+
+      pal_mem_cpy (&comval, com_nthval (com, mid), sizeof (u_int32_t));
+      comval = pal_ntoh32 (comval);
+
+      if (comval == val)
         return 1;
+
+      if (comval < val)
+        low = mid + 1;
+      else
+        high = mid - 1;
     }
   return 0;
 }
@@ -137,25 +164,64 @@ community_val_get (struct community *com, int i)
   return pal_ntoh32 (val);
 }
 
+/* Sort community values in place and remove duplicates.  */
+void
+community_sort (struct community *com)
+{
+  u_int32_t i;
+  u_int32_t j;
+
+  if (com->size < 2)
+    return;
+
+  /* Most communities arrive already sorted.  */
+  for (i = 1; i < com->size; i++)
+    if (community_compare (com_nthval (com, i - 1), com_nthval (com, i)) >= 0)
+      break;
+
+  if (i == com->size)
+    return;
+
+  community_regex_cache_flush (com);
+
+  /* String form follows value order.  */
+  if (com->str)
+    {
+      XFREE (MTYPE_COMMUNITY_STR, com->str);
+      com->str = NULL;
+    }
+
+  pal_qsort (com->val, com->size, sizeof (u_int32_t), community_compare);
+
+  for (i = 1, j = 1; i < com->size; i++)
+    if (com->val[i] != com->val[j - 1])
+      com->val[j++] = com->val[i];
+
+  if (j != com->size)
+    {
+      com->size = j;
+      com->val = XREALLOC (MTYPE_COMMUNITY_VAL, com->val, com_length (com));
+    }
+}
+
 /* Sort and uniq given community. */
 struct community *
 community_uniq_sort (struct community *com)
 {
-  int i;
   struct community *new;
-  u_int32_t val;
 
   new = community_new ();
 
-  for (i = 0; i < com->size; i++)
-    {
-      val = community_val_get (com, i);
+  if (com->size == 0)
+    return new;
 
-      if (! community_include (new, val))
-        community_add_val (new, val);
-    }
+  /* The source may point into a received packet, so copy it out
+     before sorting.  */
+  new->size = com->size;
+  new->val = XMALLOC (MTYPE_COMMUNITY_VAL, com_length (new));
+  pal_mem_cpy (new->val, com->val, com_length (new));
 
-  pal_qsort (new->val, new->size, sizeof (u_int32_t), community_compare);
+  community_sort (new);
 
   return new;
 }
@@ -274,6 +340,9 @@ community_intern (struct community *com)
   /* Assert this community structure is not interned. */
   pal_assert (com->refcnt == 0);
 
+  /* Interned communities are always sorted.  */
+  community_sort (com);
+
   /* Lookup community hash. */
   find = (struct community *) hash_get (bgp_comhash_tab, com, hash_alloc_intern);
 
@@ -379,11 +448,15 @@ community_hash_make (void *arg)
   return key;
 }
 
+/* Both communities are sorted, so a single merge pass tells whether
+   every value of com2 is present in com1.  */
 bool_t
 community_match (struct community *com1, struct community *com2)
 {
-  int i = 0;
-  int j = 0;
+  u_int32_t i = 0;
+  u_int32_t j = 0;
+  u_int32_t v1;
+  u_int32_t v2;
 
   if (com1 == NULL && com2 == NULL)
     return 1;
@@ -395,17 +468,23 @@ community_match (struct community *com1, struct community *com2)
     return 0;
 
   /* Every community on com2 needs to be on com1 for this to match */
-  while (i < com1->size && j < com2->size)
+  while (j < com2->size)
     {
-      if (pal_mem_cmp (com1->val + i, com2->val + j, sizeof (u_int32_t)) == 0)
+      /* Not enough values left in com1.  */
+      if (com1->size - i < com2->size - j)
+        return 0;
+
+      v1 = pal_ntoh32 (com1->val[i]);
+      v2 = pal_ntoh32 (com2->val[j]);
+
+      if (v1 == v2)
         j++;
+      else if (v1 > v2)
+        return 0;
       i++;
     }
 
-  if (j == com2->size)
-    return 1;
-  else
-    return 0;
+  return 1;
 }
 
 /* If two community have same value then return 1 else return 0. */ 
@@ -442,6 +521,8 @@ community_merge (struct community *com1, struct community *com2)
   pal_mem_cpy (com1->val + com1->size, com2->val, com2->size * 4);
   com1->size += com2->size;
 
+  community_regex_cache_flush (com1);
+
   return com1;
 }
 
@@ -607,6 +688,35 @@ community_str2com (u_int8_t *str)
   return com_sort;
 }
 
+/* Lookup cached expanded community-list verdict.  Return -1 when the
+   verdict for this regular expression is not cached.  */
+s_int32_t
+community_regex_cache_lookup (struct community *com, pal_regex_t *reg)
+{
+  struct community_regex_cache *rc;
+
+  rc = &com->rcache[((pal_size_t) reg >> 4) % COMMUNITY_REGEX_CACHE_SIZE];
+
+  if (rc->reg == reg && rc->gen == bgp_comregex_gen)
+    return rc->match;
+
+  return -1;
+}
+
+/* Store expanded community-list verdict.  */
+void
+community_regex_cache_set (struct community *com, pal_regex_t *reg,
+                           u_int8_t match)
+{
+  struct community_regex_cache *rc;
+
+  rc = &com->rcache[((pal_size_t) reg >> 4) % COMMUNITY_REGEX_CACHE_SIZE];
+
+  rc->reg = reg;
+  rc->gen = bgp_comregex_gen;
+  rc->match = match;
+}
+
 u_int32_t
 community_count (void)
 {
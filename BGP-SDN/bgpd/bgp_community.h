@@ -3,6 +3,23 @@
 #ifndef _BGPSDN_BGP_COMMUNITY_H
 #define _BGPSDN_BGP_COMMUNITY_H
 
+/* Number of expanded community-list verdicts cached per community.  */
+#define COMMUNITY_REGEX_CACHE_SIZE      4
+
+/* Cached result of one expanded community-list regular expression
+   against the string form of a community.  */
+struct community_regex_cache
+{
+  /* Compiled regular expression of the community-list entry.  */
+  pal_regex_t *reg;
+
+  /* Value of bgp_comregex_gen when the verdict was stored.  */
+  u_int32_t gen;
+
+  /* Match result.  */
+  u_int8_t match;
+};
+
 /* Communities attribute.  */
 struct community 
 {
@@ -18,6 +35,9 @@ struct community
   /* String of community attribute.  This string is used by vty output
      and expanded community-list for regular expression match.  */
   u_int8_t *str;
+
+  /* Expanded community-list verdict cache.  */
+  struct community_regex_cache rcache[COMMUNITY_REGEX_CACHE_SIZE];
 };
 
 /* Community pre-defined values definition. */
@@ -33,6 +53,10 @@ struct community
 #define com_lastval(X)   ((X)->val + (X)->size - 1)
 #define com_nthval(X,n)  ((X)->val + (n))
 
+/* Communities values are kept sorted in ascending order and without
+   duplicates by community_uniq_sort() and community_intern(), so that
+   matching can be done with a linear merge or a binary search.  */
+
 /* Prototypes of community attribute functions. */
 struct community *
 community_new (void);
@@ -42,6 +66,8 @@ void
 community_free (struct community *);
 struct community *
 community_uniq_sort (struct community *);
+void
+community_sort (struct community *);
 struct community *
 community_parse (u_char *, u_int16_t);
 struct community *
@@ -74,5 +100,9 @@ void
 community_del_val (struct community *, u_int32_t *);
 void
 community_add_val (struct community *com, u_int32_t val);
+s_int32_t
+community_regex_cache_lookup (struct community *, pal_regex_t *);
+void
+community_regex_cache_set (struct community *, pal_regex_t *, u_int8_t);
 
 #endif /* _BGPSDN_BGP_COMMUNITY_H */
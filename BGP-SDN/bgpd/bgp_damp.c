@@ -155,8 +155,10 @@ bgp_rfd_reuse_timer (struct thread *t_rfd_reuse)
 
 /*
  * Non-Reuse-list Timer handler:
- *  This is used to update Penalty values periodically and
- *  delete the History Info is (penalty < reuse/2)
+ *  Non-Reuse-list is a circular array of lists indexed by the tick at
+ *  which the penalty of a History Info decays below the penalty floor.
+ *  Only the list of the current tick is visited, and the History Info
+ *  is deleted if (penalty < reuse/2) or re-inserted otherwise.
  */
 s_int32_t
 bgp_rfd_non_reuse_timer (struct thread *t_rfd_non_reuse)
@@ -167,9 +169,18 @@ bgp_rfd_non_reuse_timer (struct thread *t_rfd_non_reuse)
 
   BGP_VR.t_rfd_non_reuse = NULL;
 
-  for (rfd_hinfo = BGP_VR.rfd_non_reuse_list;
-       rfd_hinfo;
-       rfd_hinfo = rfd_hinfo_next)
+  /* Detach the current list and rotate the circular queue */
+  rfd_hinfo = BGP_VR.rfd_non_reuse_list [BGP_VR.rfd_non_reuse_list_offset];
+  BGP_VR.rfd_non_reuse_list [BGP_VR.rfd_non_reuse_list_offset] = NULL;
+  BGP_VR.rfd_non_reuse_list_offset = (BGP_VR.rfd_non_reuse_list_offset + 1) %
+                                     BGP_RFD_NON_REUSE_LIST_SIZE;
+
+  for (rfd_hinfo_next = rfd_hinfo;
+       rfd_hinfo_next;
+       rfd_hinfo_next = rfd_hinfo_next->rfdh_reuse_next)
+    rfd_hinfo_next->rfdh_non_reuse_idx = BGP_RFD_NON_REUSE_LIST_INV_IDX;
+
+  for (; rfd_hinfo; rfd_hinfo = rfd_hinfo_next)
     {
       rfd_hinfo_next = rfd_hinfo->rfdh_reuse_next;
 
@@ -211,6 +222,9 @@ bgp_rfd_non_reuse_timer (struct thread *t_rfd_non_reuse)
 
           bgp_rfd_hinfo_delete (rfd_hinfo);
         }
+      else
+        /* Penalty was raised since insertion, wait for the new expiry */
+        bgp_rfd_non_reuse_list_insert (rfd_hinfo);
     }
 
   BGP_TIMER_ON (&BLG, BGP_VR.t_rfd_non_reuse, NULL,
@@ -235,6 +249,7 @@ bgp_rfd_hinfo_create (struct bgp_rfd_cb *rfd_cb,
     }
 
   (*rfd_hinfo)->rfdh_reuse_idx = BGP_RFD_REUSE_LIST_INV_IDX;
+  (*rfd_hinfo)->rfdh_non_reuse_idx = BGP_RFD_NON_REUSE_LIST_INV_IDX;
   (*rfd_hinfo)->rfdh_penalty = BGP_RFD_DEF_PENALTY;
   (*rfd_hinfo)->rfdh_rec_duration =
      (*rfd_hinfo)->rfdh_lupdate = pal_time_current (NULL);
@@ -308,6 +323,40 @@ bgp_rfd_hinfo_clear_flap_stats (struct bgp_rfd_hist_info *rfd_hinfo)
   return 0;
 }
 
+/* Compute the penalty decayed till now, without updating the record */
+u_int32_t
+bgp_rfd_hinfo_penalty (struct bgp_rfd_hist_info *rfd_hinfo)
+{
+  struct bgp_rfd_cb *rfd_cb;
+  u_int32_t ndecay;
+  float64_t *decay;
+  u_int32_t idx;
+
+  if (! rfd_hinfo || ! rfd_hinfo->rfdh_rfd_cb)
+    return 0;
+
+  rfd_cb = rfd_hinfo->rfdh_rfd_cb;
+
+  if (rfd_hinfo->rfdh_rec_event == BGP_RFD_RT_EVENT_REACH)
+    {
+      decay = rfd_cb->rfd_rdecay;
+      ndecay = rfd_cb->rfd_nrdecay;
+    }
+  else
+    {
+      decay = rfd_cb->rfd_udecay;
+      ndecay = rfd_cb->rfd_nudecay;
+    }
+
+  idx = (pal_time_current (NULL) - rfd_hinfo->rfdh_lupdate) /
+        BGP_RFD_DECAY_TICK;
+
+  if (idx >= ndecay)
+    return 0;
+
+  return rfd_hinfo->rfdh_penalty * decay [idx];
+}
+
 /* Insert BGP RFD history information into RFD-CB list */
 s_int32_t
 bgp_rfd_rfdcb_list_insert (struct bgp_rfd_cb *rfd_cb,
@@ -353,30 +402,33 @@ bgp_rfd_reuse_list_index (struct bgp_rfd_hist_info *rfd_hinfo)
   struct bgp_rfd_cb *rfd_cb;
   s_int32_t reuse_list_idx;
   u_int32_t *reuse_idx_ary;
+  u_int32_t reuse_span;
 
   rfd_cb = rfd_hinfo->rfdh_rfd_cb;
-  reuse_idx_ary = NULL;
 
   if (rfd_hinfo->rfdh_rec_event == BGP_RFD_RT_EVENT_REACH)
     {
       reuse_idx_ary = &rfd_cb->rfd_reach_reuse_idx_ary[0];
-
-      reuse_idx_ary_idx = ((((float64_t)rfd_hinfo->rfdh_penalty) /
-                            ((float64_t)rfd_cb->rfd_reuse)) - 1.0) *
-                           rfd_cb->rfd_rscale_factor;
+      reuse_span = rfd_cb->rfd_rreuse_span;
     }
   else
     {
       reuse_idx_ary = &rfd_cb->rfd_unreach_reuse_idx_ary[0];
-
-      reuse_idx_ary_idx = ((((float64_t)rfd_hinfo->rfdh_penalty) /
-                            ((float64_t)rfd_cb->rfd_reuse)) - 1.0) *
-                           rfd_cb->rfd_uscale_factor;
+      reuse_span = rfd_cb->rfd_ureuse_span;
     }
 
-  if (reuse_idx_ary_idx >= 0
-      && reuse_idx_ary_idx < BGP_RFD_REUSE_IDX_ARY_SIZE)
-    reuse_list_idx = reuse_idx_ary [reuse_idx_ary_idx];
+  /*
+   * Equivalent to ((penalty / reuse) - 1.0) * scale_factor, where
+   * reuse_span is (reuse / scale_factor) * BGP_RFD_REUSE_IDX_ARY_SIZE
+   */
+  if (rfd_hinfo->rfdh_penalty >= rfd_cb->rfd_reuse
+      && rfd_hinfo->rfdh_penalty - rfd_cb->rfd_reuse < reuse_span)
+    {
+      reuse_idx_ary_idx = ((u_int64_t) (rfd_hinfo->rfdh_penalty -
+                                        rfd_cb->rfd_reuse) *
+                           BGP_RFD_REUSE_IDX_ARY_SIZE) / reuse_span;
+      reuse_list_idx = reuse_idx_ary [reuse_idx_ary_idx];
+    }
   else
     reuse_list_idx = BGP_RFD_REUSE_LIST_SIZE - 1;
 
@@ -441,19 +493,86 @@ bgp_rfd_reuse_list_remove (struct bgp_rfd_hist_info *rfd_hinfo)
   return 0;
 }
 
+/* Calculate non-reuse list index */
+s_int32_t
+bgp_rfd_non_reuse_list_index (struct bgp_rfd_hist_info *rfd_hinfo)
+{
+  struct bgp_rfd_cb *rfd_cb;
+  float64_t *decay;
+  pal_time_t t_expiry;
+  pal_time_t t_now;
+  u_int32_t ndecay;
+  u_int32_t ticks;
+  u_int32_t low;
+  u_int32_t high;
+  u_int32_t mid;
+
+  rfd_cb = rfd_hinfo->rfdh_rfd_cb;
+
+  if (rfd_hinfo->rfdh_rec_event == BGP_RFD_RT_EVENT_REACH)
+    {
+      decay = rfd_cb->rfd_rdecay;
+      ndecay = rfd_cb->rfd_nrdecay;
+    }
+  else
+    {
+      decay = rfd_cb->rfd_udecay;
+      ndecay = rfd_cb->rfd_nudecay;
+    }
+
+  /* Find the first decay tick at which penalty reaches the floor */
+  low = 0;
+  high = ndecay;
+  while (low < high)
+    {
+      mid = (low + high) / 2;
+
+      if (rfd_hinfo->rfdh_penalty * decay [mid] <=
+          (float64_t) rfd_cb->rfd_penalty_floor)
+        high = mid;
+      else
+        low = mid + 1;
+    }
+
+  t_expiry = rfd_hinfo->rfdh_lupdate + low * BGP_RFD_DECAY_TICK;
+  t_now = pal_time_current (NULL);
+
+  if (t_expiry <= t_now)
+    ticks = 0;
+  else
+    ticks = (t_expiry - t_now + BGP_RFD_NON_REUSE_TICK - 1) /
+            BGP_RFD_NON_REUSE_TICK;
+
+  if (ticks >= BGP_RFD_NON_REUSE_LIST_SIZE)
+    ticks = BGP_RFD_NON_REUSE_LIST_SIZE - 1;
+
+  return (ticks + BGP_VR.rfd_non_reuse_list_offset) %
+         BGP_RFD_NON_REUSE_LIST_SIZE;
+}
+
 /* Insert BGP RFD history information into non-reuse list */
 s_int32_t
 bgp_rfd_non_reuse_list_insert (struct bgp_rfd_hist_info *rfd_hinfo)
 {
+  s_int32_t non_reuse_list_idx;
+
   if (! rfd_hinfo
       || rfd_hinfo->rfdh_reuse_idx != BGP_RFD_REUSE_LIST_INV_IDX)
     return -1;
 
+  /* If already on a Non-Reuse List, remove it */
+  bgp_rfd_non_reuse_list_remove (rfd_hinfo);
+
+  non_reuse_list_idx = bgp_rfd_non_reuse_list_index (rfd_hinfo);
+
+  rfd_hinfo->rfdh_non_reuse_idx = non_reuse_list_idx;
   rfd_hinfo->rfdh_reuse_prev = NULL;
-  rfd_hinfo->rfdh_reuse_next = BGP_VR.rfd_non_reuse_list;
-  if (BGP_VR.rfd_non_reuse_list)
-    BGP_VR.rfd_non_reuse_list->rfdh_reuse_prev = rfd_hinfo;
-  BGP_VR.rfd_non_reuse_list = rfd_hinfo;
+  rfd_hinfo->rfdh_reuse_next =
+    BGP_VR.rfd_non_reuse_list [non_reuse_list_idx];
+  if (BGP_VR.rfd_non_reuse_list [non_reuse_list_idx])
+    BGP_VR.rfd_non_reuse_list [non_reuse_list_idx]->rfdh_reuse_prev =
+                                                               rfd_hinfo;
+  BGP_VR.rfd_non_reuse_list [non_reuse_list_idx] = rfd_hinfo;
 
   return 0;
 }
@@ -465,7 +584,8 @@ bgp_rfd_non_reuse_list_remove (struct bgp_rfd_hist_info *rfd_hinfo)
   if (! rfd_hinfo)
     return -1;
 
-  if (rfd_hinfo->rfdh_reuse_idx != BGP_RFD_REUSE_LIST_INV_IDX)
+  if (rfd_hinfo->rfdh_reuse_idx != BGP_RFD_REUSE_LIST_INV_IDX
+      || rfd_hinfo->rfdh_non_reuse_idx == BGP_RFD_NON_REUSE_LIST_INV_IDX)
     return 0;
 
   if (rfd_hinfo->rfdh_reuse_next)
@@ -475,7 +595,10 @@ bgp_rfd_non_reuse_list_remove (struct bgp_rfd_hist_info *rfd_hinfo)
     rfd_hinfo->rfdh_reuse_prev->rfdh_reuse_next =
                                            rfd_hinfo->rfdh_reuse_next;
   else
-    BGP_VR.rfd_non_reuse_list = rfd_hinfo->rfdh_reuse_next;
+    BGP_VR.rfd_non_reuse_list [rfd_hinfo->rfdh_non_reuse_idx] =
+                                           rfd_hinfo->rfdh_reuse_next;
+
+  rfd_hinfo->rfdh_non_reuse_idx = BGP_RFD_NON_REUSE_LIST_INV_IDX;
 
   return 0;
 }
@@ -569,7 +692,8 @@ bgp_rfd_update_penalty (struct bgp_rfd_hist_info *rfd_hinfo,
             if (idx < rfd_cb->rfd_nudecay)
               rfd_hinfo->rfdh_penalty *= rfd_cb->rfd_udecay [idx];
             else
-              rfd_hinfo->rfdh_penalty = BGP_RFD_DEF_PENALTY;
+              /* Decay arrays span ceiling to floor, so it is gone */
+              rfd_hinfo->rfdh_penalty = 0;
           }
         break;
     }
@@ -675,6 +799,9 @@ bgp_rfd_rt_withdraw (struct bgp *bgp, struct bgp_peer *peer,
 
       *rt_state = BGP_RFD_RT_STATE_DAMPED;
     }
+  else
+    /* Penalty and decay rate changed, re-compute the expiry */
+    bgp_rfd_non_reuse_list_insert (rfd_hinfo);
 
 EXIT:
 
@@ -722,7 +849,12 @@ bgp_rfd_rt_update (struct bgp_info *binfo,
 
   if (! rfd_hinfo->rfdh_suppress_time
       && rfd_hinfo->rfdh_penalty < rfd_cb->rfd_suppress)
-    *rt_state = BGP_RFD_RT_STATE_USE;
+    {
+      /* Penalty and decay rate changed, re-compute the expiry */
+      bgp_rfd_non_reuse_list_insert (rfd_hinfo);
+
+      *rt_state = BGP_RFD_RT_STATE_USE;
+    }
   else if (rfd_hinfo->rfdh_suppress_time
            && rfd_hinfo->rfdh_penalty < rfd_cb->rfd_reuse)
     {
@@ -961,6 +1093,9 @@ bgp_rfd_cb_enable (struct bgp_rfd_cb *rfd_cb)
   /* Reuse scale-factor */
   rfd_cb->rfd_rscale_factor = ((float64_t)BGP_RFD_REUSE_IDX_ARY_SIZE /
                                (reuse_max_ratio - 1.0));
+  rfd_cb->rfd_rreuse_span = rfd_cb->rfd_reuse * (reuse_max_ratio - 1.0);
+  if (! rfd_cb->rfd_rreuse_span)
+    rfd_cb->rfd_rreuse_span = 1;
   /* Pre-compute values into reuse-index-array */
   for (idx = 0; idx < BGP_RFD_REUSE_IDX_ARY_SIZE; idx++)
     {
@@ -991,6 +1126,9 @@ bgp_rfd_cb_enable (struct bgp_rfd_cb *rfd_cb)
   /* Reuse scale-factor */
   rfd_cb->rfd_uscale_factor = BGP_RFD_REUSE_IDX_ARY_SIZE /
                               (reuse_max_ratio - 1);
+  rfd_cb->rfd_ureuse_span = rfd_cb->rfd_reuse * (reuse_max_ratio - 1.0);
+  if (! rfd_cb->rfd_ureuse_span)
+    rfd_cb->rfd_ureuse_span = 1;
   /* Pre-compute values into reuse-index-array */
   for (idx = 0; idx < BGP_RFD_REUSE_IDX_ARY_SIZE; idx++)
     {
@@ -1054,6 +1192,8 @@ bgp_rfd_cb_disable (struct bgp_rfd_cb *rfd_cb)
   pal_mem_set (rfd_cb->rfd_unreach_reuse_idx_ary, 0,
                sizeof (u_int32_t) * BGP_RFD_REUSE_IDX_ARY_SIZE);
   rfd_cb->rfd_uscale_factor = 0;
+  rfd_cb->rfd_rreuse_span = 0;
+  rfd_cb->rfd_ureuse_span = 0;
   rfd_cb->rfd_hinfo_list = NULL;
 
   return 0;
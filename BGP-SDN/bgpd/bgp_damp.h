@@ -53,6 +53,14 @@
 #define BGP_RFD_REUSE_TICK           (10)
 /* Non-Reuse Timer Interval in secs */
 #define BGP_RFD_NON_REUSE_TICK       (30)
+/* Non-Reuse-List-Array-Size:
+ * History records are kept until their penalty decays below the
+ * floor, which never takes longer than BGP_RFD_DECAY_ARY_MAX_TIME.
+ * Each slot holds the records expiring within one Non-Reuse tick.
+ */
+#define BGP_RFD_NON_REUSE_LIST_SIZE  (BGP_RFD_DECAY_ARY_MAX_TIME * \
+                                      ONE_MIN_SECOND /             \
+                                      BGP_RFD_NON_REUSE_TICK + 8)
 /* Reuse-Index-Array-Size */
 #define BGP_RFD_REUSE_IDX_ARY_SIZE   (1024)
 /* Reuse-List-Array-Size:
@@ -65,6 +73,9 @@
 /* Invalid Reuse-List-Array Index */
 #define BGP_RFD_REUSE_LIST_INV_IDX   (BGP_RFD_REUSE_LIST_SIZE + 1)
 
+/* Invalid Non-Reuse-List-Array Index */
+#define BGP_RFD_NON_REUSE_LIST_INV_IDX (BGP_RFD_NON_REUSE_LIST_SIZE + 1)
+
 /* BGP Route Flap Dampening route state */
 enum bgp_rfd_rt_event
 {
@@ -96,7 +107,10 @@ struct bgp_rfd_hist_info
   /* Index of Reuse-list if in one */
   u_int32_t rfdh_reuse_idx;
 
-  /* Figure-of-merit */
+  /* Index of Non-Reuse-list if in one */
+  u_int32_t rfdh_non_reuse_idx;
+
+  /* Figure-of-merit as of rfdh_lupdate, decayed lazily when touched */
   u_int32_t rfdh_penalty;
 
   /* Number of flaps */
@@ -186,6 +200,12 @@ struct bgp_rfd_cb
   /* Un-reachability reuse-index-array scale-factor */
   float64_t rfd_uscale_factor;
 
+  /* Penalty span above reuse covered by reuse-index-arrays, so that
+   * the array index is computed with integer arithmetic only
+   */
+  u_int32_t rfd_rreuse_span;
+  u_int32_t rfd_ureuse_span;
+
   /* List of RFD History Info elements assoc with this CB */
   struct bgp_rfd_hist_info *rfd_hinfo_list;
 };
@@ -241,10 +261,10 @@ struct bgp_rfd_cfg
 #define BGP_RFD_RT_HAS_RECORD(BGP_INFO)                              \
   ((BGP_INFO) && (BGP_INFO)->rfd_hinfo)
 
-/* Macro to obtain Penalty value */
+/* Macro to obtain (decayed) Penalty value */
 #define BGP_RFD_RT_GET_PENALTY(BGP_INFO)                             \
   (((BGP_INFO) && (BGP_INFO)->rfd_hinfo) ?                           \
-   (BGP_INFO)->rfd_hinfo->rfdh_penalty : 0)
+   bgp_rfd_hinfo_penalty ((BGP_INFO)->rfd_hinfo) : 0)
 
 /* Macro to obtain Flap Count */
 #define BGP_RFD_RT_GET_FLAP_COUNT(BGP_INFO)                          \
@@ -287,6 +307,8 @@ s_int32_t
 bgp_rfd_hinfo_free (struct bgp_rfd_hist_info *);
 s_int32_t
 bgp_rfd_hinfo_clear_flap_stats (struct bgp_rfd_hist_info *);
+u_int32_t
+bgp_rfd_hinfo_penalty (struct bgp_rfd_hist_info *);
 s_int32_t
 bgp_rfd_rfdcb_list_insert (struct bgp_rfd_cb *,
                            struct bgp_rfd_hist_info *);
@@ -299,6 +321,8 @@ bgp_rfd_reuse_list_insert (struct bgp_rfd_hist_info *);
 s_int32_t
 bgp_rfd_reuse_list_remove (struct bgp_rfd_hist_info *);
 s_int32_t
+bgp_rfd_non_reuse_list_index (struct bgp_rfd_hist_info *);
+s_int32_t
 bgp_rfd_non_reuse_list_insert (struct bgp_rfd_hist_info *);
 s_int32_t
 bgp_rfd_non_reuse_list_remove (struct bgp_rfd_hist_info *);
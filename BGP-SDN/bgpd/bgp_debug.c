@@ -616,6 +616,55 @@ ALI (no_debug_bgp_rfd,
      CLI_BGP_STR,
      "BGP Dampening");
 
+CLI (debug_bgp_policy_stats,
+     debug_bgp_policy_stats_cmd,
+     "debug bgp policy-statistics",
+     CLI_DEBUG_STR,
+     CLI_BGP_STR,
+     "Policy evaluation statistics")
+{
+  u_int32_t rate = PSTATS_SAMPLE_RATE_DEFAULT;
+
+  if (argc > 0)
+    CLI_GET_UINT32_RANGE ("sample rate", rate, argv[0], 1,
+                          PSTATS_SAMPLE_RATE_MAX);
+
+  pstats_enable (rate);
+  cli_out (cli, "BGP policy statistics are on, sampling 1 in %u\n", rate);
+
+  return CLI_SUCCESS;
+}
+
+ALI (debug_bgp_policy_stats,
+     debug_bgp_policy_stats_rate_cmd,
+     "debug bgp policy-statistics sample-rate <1-65535>",
+     CLI_DEBUG_STR,
+     CLI_BGP_STR,
+     "Policy evaluation statistics",
+     "Time one in every N evaluations of each policy",
+     "Sample rate");
+
+CLI (no_debug_bgp_policy_stats,
+     no_debug_bgp_policy_stats_cmd,
+     "no debug bgp policy-statistics",
+     CLI_NO_STR,
+     CLI_DEBUG_STR,
+     CLI_BGP_STR,
+     "Policy evaluation statistics")
+{
+  pstats_disable ();
+  cli_out (cli, "BGP policy statistics are off\n");
+
+  return CLI_SUCCESS;
+}
+
+ALI (no_debug_bgp_policy_stats,
+     undebug_bgp_policy_stats_cmd,
+     "undebug bgp policy-statistics",
+     CLI_UNDEBUG_STR,
+     CLI_BGP_STR,
+     "Policy evaluation statistics");
+
 CLI (debug_bgp_all,
      debug_bgp_all_cmd,
      "debug bgp (all|)",
@@ -712,6 +761,9 @@ CLI (show_debugging_bgp,
     cli_out (cli, "  BGP filter debugging is on\n");
   if (BGP_DEBUG (rfd, RFD))
     cli_out (cli, "  BGP Route Flap Dampening debugging is on\n");
+  if (PSTATS_ENABLED ())
+    cli_out (cli, "  BGP policy statistics are on, sampling 1 in %u\n",
+             pstats_sample_rate);
   cli_out (cli, "\n");
   return CLI_SUCCESS;
 }
@@ -785,6 +837,15 @@ bgp_debug_cli_init (struct cli_tree *ctree)
   cli_install_gen (ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
                    &show_debugging_bgp_cmd);
 
+  cli_install_gen (ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
+                   &debug_bgp_policy_stats_cmd);
+  cli_install_gen (ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
+                   &debug_bgp_policy_stats_rate_cmd);
+  cli_install_gen (ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
+                   &no_debug_bgp_policy_stats_cmd);
+  cli_install_gen (ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
+                   &undebug_bgp_policy_stats_cmd);
+
   cli_install_gen (ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
                    &debug_bgp_fsm_cmd);
   cli_install_gen (ctree, CONFIG_MODE, PRIVILEGE_NORMAL, 0,
@@ -548,6 +548,7 @@ bpd_msg_update (struct stream_sock_cb *ssock_cb,
   enum ssock_error ret;
   u_int32_t alloc_size;
   struct attr *attr;
+  u_int64_t start;
 
   bytes_to_read = 0;
   ret = SSOCK_ERR_NONE;
@@ -598,6 +599,8 @@ bpd_msg_update (struct stream_sock_cb *ssock_cb,
                "... Bytes To Read (%u), msg_size (%u)", peer->host,
                BGP_PEER_DIR_STR (peer), bytes_to_read, msg_size);
 
+  start = BGP_PERF_BEGIN ();
+
   /* Allocate the Attribute Structure */
   attr = XCALLOC (MTYPE_ATTR, sizeof (struct attr));
   if (! attr)
@@ -868,6 +871,7 @@ bpd_msg_update (struct stream_sock_cb *ssock_cb,
   CQUEUE_BUF_ENLIVEN_SNAPSHOT (cq_rbuf, &tmp_cqbss);
 
   /* Enqueue into Peer's 'bdui_fifo' */
+  bdui->ui_enq_nsec = pal_time_mono_nsec ();
   FIFO_ADD (&peer->bdui_fifo, &bdui->ui_fifo);
 
   /* Generate BGP Peer FSM Valid UPDATE Event */
@@ -878,6 +882,8 @@ bpd_msg_update (struct stream_sock_cb *ssock_cb,
 
 READ_NEXT_MSG:
 
+  bgp_perf_record (peer, BGP_PERF_DECODE, start);
+
   /* Reset argument for succeeding read_func, viz., Header Decoder */
   SSOCK_CB_SET_READ_FUNC_ARG (ssock_cb, BGP_HEADER_SIZE);
 
@@ -35,6 +35,8 @@ bgp_dump_open_file (struct bgp_dump *bgp_dump)
   if (bgp_dump->fp)
     pal_fclose (bgp_dump->fp);
 
+  /* A table dump into the old file is abandoned.  */
+  bgp_dump_routes_stop (bgp_dump);
 
   bgp_dump->fp = pal_fopen (realpath, "w");
 
@@ -346,45 +348,110 @@ bgp_dump_routes_entry (struct prefix *p,
   /* Set length. */
   bgp_dump_set_size (obuf, type);
 
+  /* Flushed once the table dump is complete.  */
   pal_fwrite (STREAM_DATA (obuf), stream_get_putp (obuf), 1,
               bgp_dump_routes->fp);
-  pal_fflush (bgp_dump_routes->fp);
 
   return;
 }
 
-/* Runs under child process. */
+/* Start a dump of the IPv4 and IPv6 unicast tables.  */
 void
-bgp_dump_routes_func (afi_t afi)
+bgp_dump_routes_start (struct bgp_dump *bgp_dump)
 {
+  bgp_dump_routes_stop (bgp_dump);
+
+  bgp_dump->routes_afi = AFI_IP;
+  bgp_dump->routes_seq = 0;
+  bgp_dump->t_routes = thread_add_event_low (&BLG, bgp_dump_routes_func,
+                                             bgp_dump, 0);
+}
+
+void
+bgp_dump_routes_stop (struct bgp_dump *bgp_dump)
+{
+  THREAD_OFF (bgp_dump->t_routes);
+
+  if (bgp_dump->routes_rn)
+    {
+      bgp_unlock_node (bgp_dump->routes_rn);
+      bgp_dump->routes_rn = NULL;
+    }
+}
+
+/* Dump one slice of the tables.  The walk is bounded like a "show"
+   slice and resumed from a low priority event, so that a full table
+   does not hold off keepalives and hold timers.  */
+s_int32_t
+bgp_dump_routes_func (struct thread *t)
+{
+  struct bgp_dump *bgp_dump;
   struct bgp_ptree *table;
   struct bgp_info *info;
-  struct stream *obuf;
   struct bgp_node *rn;
   struct bgp *bgp;
-  u_int32_t seq;
   struct prefix rnp;
+  u_int32_t visited;
+  u_int64_t start;
 
-  obuf = bgp_dump_obuf;
-  seq = 0;
+  bgp_dump = THREAD_ARG (t);
+  bgp_dump->t_routes = NULL;
 
-  bgp = bgp_lookup_default ();
-  if (!bgp)
-    return;
+  /* The walk resumes from the node it stopped at.  */
+  rn = bgp_dump->routes_rn;
+  bgp_dump->routes_rn = NULL;
 
-  if (bgp_dump_routes->fp == NULL)
-    return;
+  bgp = bgp_lookup_default ();
+  if (! bgp || bgp_dump->fp == NULL)
+    {
+      if (rn)
+        bgp_unlock_node (rn);
+      return 0;
+    }
 
-  /* Walk down each BGP route. */
-  table = bgp->rib[BGP_AFI2BAAI (afi)] [BGP_SAFI2BSAI (SAFI_UNICAST)];
+  start = pal_time_mono_nsec ();
+  visited = 0;
 
-  for (rn = bgp_table_top (table); rn; 
-       rn = bgp_route_next (rn))
-    for (info = rn->info; info; info = info->next)
+  while (1)
     {
-      BGP_GET_PREFIX_FROM_NODE (rn);	
-      bgp_dump_routes_entry (&rnp, info, afi, BGP_DUMP_TABLE, seq++);
+      if (! rn)
+        {
+          table = bgp->rib[BGP_AFI2BAAI (bgp_dump->routes_afi)]
+                          [BGP_SAFI2BSAI (SAFI_UNICAST)];
+          rn = bgp_table_top (table);
+        }
+
+      for (; rn; rn = bgp_route_next (rn))
+        {
+          if (visited >= BGP_SHOW_SLICE_NODES
+              || (visited && ! (visited & BGP_SHOW_SLICE_CLOCK_MASK)
+                  && pal_time_mono_nsec () - start >= BGP_SHOW_SLICE_NSEC))
+            {
+              bgp_dump->routes_rn = rn;
+              bgp_dump->t_routes = thread_add_event_low (&BLG,
+                                                         bgp_dump_routes_func,
+                                                         bgp_dump, 0);
+              return 0;
+            }
+          visited++;
+
+          for (info = rn->info; info; info = info->next)
+            {
+              BGP_GET_PREFIX_FROM_NODE (rn);
+              bgp_dump_routes_entry (&rnp, info, bgp_dump->routes_afi,
+                                     BGP_DUMP_TABLE, bgp_dump->routes_seq++);
+            }
+        }
+
+      if (bgp_dump->routes_afi == AFI_IP6)
+        break;
+
+      bgp_dump->routes_afi = AFI_IP6;
     }
+
+  pal_fflush (bgp_dump->fp);
+
+  return 0;
 }
 
 s_int32_t
@@ -400,10 +467,7 @@ bgp_dump_interval_func (struct thread *t)
 
   /* In case of bgp_dump_routes, we need special route dump function. */
   if (bgp_dump->type == BGP_DUMP_ROUTES)
-    {
-      bgp_dump_routes_func (AFI_IP);
-      bgp_dump_routes_func (AFI_IP6);
-    }
+    bgp_dump_routes_start (bgp_dump);
 
   bgp_dump_interval_add (bgp_dump, bgp_dump->interval);
 
@@ -627,6 +691,8 @@ bgp_dump_unset (struct cli *cli, struct bgp_dump *bgp_dump)
       bgp_dump->filename = NULL;
     }
 
+  bgp_dump_routes_stop (bgp_dump);
+
   /* This should be called when interval is expired. */
   if (bgp_dump->fp)
     {
@@ -32,6 +32,12 @@ struct bgp_dump
   u_int8_t *interval_str;
 
   struct thread *t_interval;
+
+  /* Table dump in progress, resumed from a low priority event.  */
+  struct thread *t_routes;
+  struct bgp_node *routes_rn;
+  afi_t routes_afi;
+  u_int32_t routes_seq;
 };
 
 /*
@@ -55,7 +61,11 @@ bgp_dump_routes_entry (struct prefix *,
                        u_int32_t,
                        u_int32_t);
 void
-bgp_dump_routes_func (afi_t);
+bgp_dump_routes_start (struct bgp_dump *);
+void
+bgp_dump_routes_stop (struct bgp_dump *);
+s_int32_t
+bgp_dump_routes_func (struct thread *);
 s_int32_t
 bgp_dump_interval_func (struct thread *);
 void
@@ -402,8 +402,8 @@ EXIT:
 
       /* Now restart the Keep-alive Timer */
       if (peer->v_holdtime && peer->v_keepalive)
-        BGP_TIMER_ON (&BLG, peer->t_keepalive, peer, bpf_timer_keepalive,
-                      bpf_timer_generate_jitter (peer->v_keepalive));
+        BGP_TIMER_HIGH_ON (&BLG, peer->t_keepalive, peer, bpf_timer_keepalive,
+                           bpf_timer_generate_jitter (peer->v_keepalive));
     }
 
   return;
@@ -517,8 +517,8 @@ EXIT:
 
       /* Now restart the Keep-alive Timer */
       if (peer->v_holdtime && peer->v_keepalive)
-        BGP_TIMER_ON (&BLG, peer->t_keepalive, peer, bpf_timer_keepalive,
-                      bpf_timer_generate_jitter (peer->v_keepalive));
+        BGP_TIMER_HIGH_ON (&BLG, peer->t_keepalive, peer, bpf_timer_keepalive,
+                           bpf_timer_generate_jitter (peer->v_keepalive));
     }
 
   return;
@@ -537,6 +537,7 @@ bgp_peer_send_update_adv_list (struct bgp_peer *peer,
   u_int32_t msg_count;
   u_int16_t msg_size;
   bool_t to_continue;
+  u_int64_t start;
 
   msg_count = 0;
 
@@ -568,8 +569,10 @@ bgp_peer_send_update_adv_list (struct bgp_peer *peer,
                  BGP_MAX_PACKET_SIZE);
 
     /* Encode one UPDATE Message */
+    start = BGP_PERF_BEGIN ();
     to_continue = bpe_msg_update (cq_wbuf, peer, adv_list,
                                   afi, safi, auto_summary_update);
+    bgp_perf_record (peer, BGP_PERF_ENCODE, start);
 
     /*
      * Obtain the Message Size and overwrite previous
@@ -0,0 +1,673 @@
+/* Copyright (C) 2003-2011 IP Infusion, Inc. All Rights Reserved. */
+
+#include <bgp_incl.h>
+
+/* Machine readable RIB export.  The table is walked in slices the
+   same way as "show ip bgp", but each route is encoded straight from
+   bgp_info and attr instead of being formatted as a table row.  */
+
+static const char bgp_export_b64[] =
+  "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static u_int32_t
+bgp_export_dict_key (struct bgp_export_dict *ent)
+{
+  return (u_int32_t) ((unsigned long) ent->obj >> 4) ^ ent->kind;
+}
+
+static bool_t
+bgp_export_dict_cmp (struct bgp_export_dict *a, struct bgp_export_dict *b)
+{
+  return a->obj == b->obj && a->kind == b->kind;
+}
+
+static void *
+bgp_export_dict_alloc (struct bgp_export_dict *tmp)
+{
+  struct bgp_export_dict *ent;
+
+  ent = XCALLOC (MTYPE_BGP_EXPORT, sizeof (struct bgp_export_dict));
+  if (! ent)
+    return NULL;
+
+  *ent = *tmp;
+
+  /* Keep the object alive until the export finishes.  */
+  switch (ent->kind)
+    {
+    case BGP_EXPORT_DICT_ASPATH:
+      ((struct aspath *) ent->obj)->refcnt++;
+      break;
+#ifdef HAVE_EXT_CAP_ASN
+    case BGP_EXPORT_DICT_AS4PATH:
+      ((struct as4path *) ent->obj)->refcnt++;
+      break;
+#endif /* HAVE_EXT_CAP_ASN */
+    case BGP_EXPORT_DICT_COMMUNITY:
+      ((struct community *) ent->obj)->refcnt++;
+      break;
+    }
+
+  return ent;
+}
+
+static void
+bgp_export_dict_free (struct bgp_export_dict *ent)
+{
+  switch (ent->kind)
+    {
+    case BGP_EXPORT_DICT_ASPATH:
+      aspath_unintern (ent->obj);
+      break;
+#ifdef HAVE_EXT_CAP_ASN
+    case BGP_EXPORT_DICT_AS4PATH:
+      aspath4B_unintern (ent->obj);
+      break;
+#endif /* HAVE_EXT_CAP_ASN */
+    case BGP_EXPORT_DICT_COMMUNITY:
+      community_unintern (ent->obj);
+      break;
+    }
+
+  XFREE (MTYPE_BGP_EXPORT, ent);
+}
+
+static struct bgp_export *
+bgp_export_new (u_int8_t format)
+{
+  struct bgp_export *ex;
+
+  ex = XCALLOC (MTYPE_BGP_EXPORT, sizeof (struct bgp_export));
+  if (! ex)
+    return NULL;
+
+  ex->format = format;
+  ex->dict = hash_create (bgp_export_dict_key, bgp_export_dict_cmp);
+  if (! ex->dict)
+    {
+      XFREE (MTYPE_BGP_EXPORT, ex);
+      return NULL;
+    }
+
+  return ex;
+}
+
+static void
+bgp_export_free (struct bgp_export *ex)
+{
+  hash_clean (ex->dict, (void (*) (void *)) bgp_export_dict_free);
+  hash_free (ex->dict);
+
+  if (ex->buf)
+    XFREE (MTYPE_BGP_EXPORT, ex->buf);
+  if (ex->line)
+    XFREE (MTYPE_BGP_EXPORT, ex->line);
+
+  XFREE (MTYPE_BGP_EXPORT, ex);
+}
+
+/* cli->cleanup for an export that ends or whose connection closes.  */
+static int
+bgp_export_clean (struct cli *cli)
+{
+  if (cli->arg)
+    bgp_export_free (cli->arg);
+  cli->arg = NULL;
+  return 0;
+}
+
+/* Start a record of at most SIZE bytes.  */
+static int
+bgp_export_begin (struct bgp_export *ex, u_int32_t size)
+{
+  u_int8_t *buf;
+
+  ex->len = 0;
+
+  if (size <= ex->size)
+    return 0;
+
+  size = (size + 1023) & ~1023;
+  buf = XREALLOC (MTYPE_BGP_EXPORT, ex->buf, size);
+  if (! buf)
+    return -1;
+
+  ex->buf = buf;
+  ex->size = size;
+
+  return 0;
+}
+
+static void
+bgp_export_put (struct bgp_export *ex, void *data, u_int32_t len)
+{
+  pal_mem_cpy (ex->buf + ex->len, data, len);
+  ex->len += len;
+}
+
+static void
+bgp_export_put_byte (struct bgp_export *ex, u_int8_t val)
+{
+  ex->buf[ex->len++] = val;
+}
+
+static void
+bgp_export_put_varint (struct bgp_export *ex, u_int32_t val)
+{
+  while (val >= 0x80)
+    {
+      ex->buf[ex->len++] = (val & 0x7f) | 0x80;
+      val >>= 7;
+    }
+  ex->buf[ex->len++] = val;
+}
+
+static void
+bgp_export_printf (struct bgp_export *ex, const char *format, ...)
+{
+  va_list args;
+  int len;
+
+  va_start (args, format);
+  len = pal_vsnprintf ((char *) ex->buf + ex->len, ex->size - ex->len,
+                       format, args);
+  va_end (args);
+
+  if (len > 0)
+    ex->len += MIN ((u_int32_t) len, ex->size - ex->len - 1);
+}
+
+/* Write the finished record as one output line.  Returns -1 if
+   it could not be written.  */
+static s_int32_t
+bgp_export_end (struct cli *cli, struct bgp_export *ex)
+{
+  u_int8_t *src = ex->buf;
+  u_int8_t *dst;
+  u_int32_t need;
+  u_int32_t i;
+
+  if (ex->format == BGP_EXPORT_JSONL)
+    {
+      ex->buf[ex->len] = '\0';
+      cli_out (cli, "%s\n", ex->buf);
+      return 0;
+    }
+
+  need = ((ex->len + 2) / 3) * 4 + 1;
+  if (need > ex->line_size)
+    {
+      dst = XREALLOC (MTYPE_BGP_EXPORT, ex->line, need);
+      if (! dst)
+        return -1;
+      ex->line = dst;
+      ex->line_size = need;
+    }
+
+  dst = ex->line;
+  for (i = 0; i + 2 < ex->len; i += 3)
+    {
+      *dst++ = bgp_export_b64[src[i] >> 2];
+      *dst++ = bgp_export_b64[((src[i] & 0x03) << 4) | (src[i + 1] >> 4)];
+      *dst++ = bgp_export_b64[((src[i + 1] & 0x0f) << 2) | (src[i + 2] >> 6)];
+      *dst++ = bgp_export_b64[src[i + 2] & 0x3f];
+    }
+  if (i < ex->len)
+    {
+      *dst++ = bgp_export_b64[src[i] >> 2];
+      if (i + 1 < ex->len)
+        {
+          *dst++ = bgp_export_b64[((src[i] & 0x03) << 4) | (src[i + 1] >> 4)];
+          *dst++ = bgp_export_b64[(src[i + 1] & 0x0f) << 2];
+        }
+      else
+        {
+          *dst++ = bgp_export_b64[(src[i] & 0x03) << 4];
+          *dst++ = '=';
+        }
+      *dst++ = '=';
+    }
+  *dst = '\0';
+
+  cli_out (cli, "%s\n", ex->line);
+
+  return 0;
+}
+
+static void
+bgp_export_header (struct cli *cli, struct bgp_export *ex)
+{
+  if (ex->format == BGP_EXPORT_JSONL)
+    {
+      if (bgp_export_begin (ex, 128) < 0)
+        return;
+      bgp_export_printf (ex, "{\"type\":\"header\",\"version\":%d,"
+                         "\"afi\":%d,\"safi\":%d}",
+                         BGP_EXPORT_VERSION, cli->afi, cli->safi);
+    }
+  else
+    {
+      if (bgp_export_begin (ex, 16) < 0)
+        return;
+      bgp_export_put_byte (ex, BGP_EXPORT_REC_HEADER);
+      bgp_export_put (ex, "BGPX", 4);
+      bgp_export_put_byte (ex, BGP_EXPORT_VERSION);
+      bgp_export_put_varint (ex, cli->afi);
+      bgp_export_put_varint (ex, cli->safi);
+    }
+
+  bgp_export_end (cli, ex);
+}
+
+/* Return the dictionary id of an interned AS path or community,
+   writing its dictionary record first if this is its first use.  */
+static u_int32_t
+bgp_export_dict_id (struct cli *cli, struct bgp_export *ex,
+                    void *obj, u_int8_t kind)
+{
+  struct bgp_export_dict tmp;
+  struct bgp_export_dict *ent;
+  u_int8_t *str = NULL;
+  u_int8_t *data = NULL;
+  u_int32_t len = 0;
+  u_int8_t width = 2;
+
+  if (! obj)
+    return 0;
+
+  tmp.obj = obj;
+  tmp.kind = kind;
+  tmp.id = 0;
+
+  ent = hash_lookup (ex->dict, &tmp);
+  if (ent)
+    return ent->id;
+
+  tmp.id = ++ex->next_id;
+  ent = hash_get (ex->dict, &tmp, bgp_export_dict_alloc);
+  if (! ent)
+    return 0;
+
+  switch (kind)
+    {
+    case BGP_EXPORT_DICT_ASPATH:
+      str = ((struct aspath *) obj)->str;
+      data = ((struct aspath *) obj)->data;
+      len = ((struct aspath *) obj)->length;
+      break;
+#ifdef HAVE_EXT_CAP_ASN
+    case BGP_EXPORT_DICT_AS4PATH:
+      str = ((struct as4path *) obj)->str;
+      data = ((struct as4path *) obj)->data;
+      len = ((struct as4path *) obj)->length;
+      width = 4;
+      break;
+#endif /* HAVE_EXT_CAP_ASN */
+    case BGP_EXPORT_DICT_COMMUNITY:
+      str = community_str (obj);
+      data = (u_int8_t *) ((struct community *) obj)->val;
+      len = com_length ((struct community *) obj);
+      break;
+    }
+
+  if (ex->format == BGP_EXPORT_JSONL)
+    {
+      /* AS path and community strings are digits, keywords and
+         punctuation only, so they need no escaping.  */
+      if (! str)
+        str = (u_int8_t *) "";
+      if (bgp_export_begin (ex, pal_strlen (str) + 64) < 0)
+        return ent->id;
+      if (kind == BGP_EXPORT_DICT_COMMUNITY)
+        bgp_export_printf (ex, "{\"type\":\"community\",\"id\":%u,"
+                           "\"value\":\"%s\"}", ent->id, str);
+      else
+        bgp_export_printf (ex, "{\"type\":\"aspath\",\"id\":%u,"
+                           "\"path\":\"%s\"}", ent->id, str);
+    }
+  else
+    {
+      if (bgp_export_begin (ex, len + 16) < 0)
+        return ent->id;
+      if (kind == BGP_EXPORT_DICT_COMMUNITY)
+        bgp_export_put_byte (ex, BGP_EXPORT_REC_COMMUNITY);
+      else
+        bgp_export_put_byte (ex, BGP_EXPORT_REC_ASPATH);
+      bgp_export_put_varint (ex, ent->id);
+      if (kind != BGP_EXPORT_DICT_COMMUNITY)
+        bgp_export_put_byte (ex, width);
+      bgp_export_put_varint (ex, len);
+      if (len)
+        bgp_export_put (ex, data, len);
+    }
+
+  bgp_export_end (cli, ex);
+
+  return ent->id;
+}
+
+static void
+bgp_export_put_addr (struct bgp_export *ex, u_int8_t family, void *addr)
+{
+  bgp_export_put_byte (ex, family == AF_INET ? 4 : 16);
+  bgp_export_put (ex, addr, family == AF_INET ? 4 : 16);
+}
+
+static char *
+bgp_export_ntop (u_int8_t family, void *addr, char *buf)
+{
+  if (! pal_inet_ntop (family, addr, buf, SU_ADDRSTRLEN))
+    buf[0] = '\0';
+  return buf;
+}
+
+/* Write one route.  */
+static void
+bgp_export_route (struct cli *cli, struct bgp_export *ex,
+                  struct prefix *p, struct bgp_info *ri)
+{
+  struct attr *attr = ri->attr;
+  union sockunion *su = &ri->peer->su;
+  char pbuf[SU_ADDRSTRLEN];
+  char peerbuf[SU_ADDRSTRLEN];
+  char nhbuf[SU_ADDRSTRLEN];
+  u_int8_t nhfamily = AF_INET;
+  u_int8_t peerfamily = su->sa.sa_family;
+  u_int8_t any[IPV6_MAX_BYTELEN];
+  void *nh = &attr->nexthop;
+  void *peer = &su->sin.sin_addr;
+  u_int32_t aspath_id;
+  u_int32_t community_id;
+  u_int32_t flags = 0;
+  u_int32_t med = 0;
+
+  /* Dictionary records go out ahead of the route using them.  */
+#ifdef HAVE_EXT_CAP_ASN
+  if (CHECK_FLAG (BGP_VR.bvr_options, BGP_OPT_EXTENDED_ASN_CAP))
+    aspath_id = bgp_export_dict_id (cli, ex, attr->aspath4B,
+                                    BGP_EXPORT_DICT_AS4PATH);
+  else
+#endif /* HAVE_EXT_CAP_ASN */
+    aspath_id = bgp_export_dict_id (cli, ex, attr->aspath,
+                                    BGP_EXPORT_DICT_ASPATH);
+  community_id = bgp_export_dict_id (cli, ex, attr->community,
+                                     BGP_EXPORT_DICT_COMMUNITY);
+
+  if (CHECK_FLAG (ri->flags, BGP_INFO_SELECTED))
+    flags |= BGP_EXPORT_ROUTE_BEST;
+  if (CHECK_FLAG (ri->flags, BGP_INFO_NHOP_VALID))
+    flags |= BGP_EXPORT_ROUTE_VALID;
+  if (ri->type == IPI_ROUTE_BGP && ri->sub_type == BGP_ROUTE_NORMAL)
+    {
+      flags |= BGP_EXPORT_ROUTE_MED;
+      med = bgp_med_value (attr, ri->peer->bgp);
+    }
+  else if (attr->flag & ATTR_FLAG_BIT (BGP_ATTR_MULTI_EXIT_DISC))
+    {
+      flags |= BGP_EXPORT_ROUTE_MED;
+      med = attr->med;
+    }
+  if (attr->flag & ATTR_FLAG_BIT (BGP_ATTR_LOCAL_PREF))
+    flags |= BGP_EXPORT_ROUTE_LOCAL_PREF;
+
+#ifdef HAVE_IPV6
+  if (p->family == AF_INET6 && attr->mp_nexthop_len != IPV4_MAX_BYTELEN)
+    {
+      nhfamily = AF_INET6;
+      nh = &attr->mp_nexthop_global;
+    }
+  else if (p->family == AF_INET6)
+    nh = &attr->mp_nexthop_global_in;
+  if (su->sa.sa_family == AF_INET6)
+    peer = &su->sin6.sin6_addr;
+#endif /* HAVE_IPV6 */
+
+  /* Local routes have no peer address, written as "0.0.0.0" or "::"
+     like "show ip bgp" does.  */
+  if (ri->peer == ri->peer->bgp->peer_self)
+    {
+      pal_mem_set (any, 0, sizeof (any));
+      peerfamily = p->family;
+      peer = any;
+    }
+
+  if (ex->format == BGP_EXPORT_JSONL)
+    {
+      if (bgp_export_begin (ex, 512) < 0)
+        return;
+
+      bgp_export_printf (ex, "{\"type\":\"route\",\"prefix\":\"%s/%d\","
+                         "\"peer\":\"%s\",\"nexthop\":\"%s\","
+                         "\"origin\":\"%s\"",
+                         bgp_export_ntop (p->family, &p->u.prefix, pbuf),
+                         p->prefixlen,
+                         bgp_export_ntop (peerfamily, peer, peerbuf),
+                         bgp_export_ntop (nhfamily, nh, nhbuf),
+                         BGP_ORIGIN_LONG_STR (attr->origin));
+      if (flags & BGP_EXPORT_ROUTE_MED)
+        bgp_export_printf (ex, ",\"med\":%u", med);
+      if (flags & BGP_EXPORT_ROUTE_LOCAL_PREF)
+        bgp_export_printf (ex, ",\"localpref\":%u", attr->local_pref);
+      bgp_export_printf (ex, ",\"weight\":%u", attr->weight);
+      if (aspath_id)
+        bgp_export_printf (ex, ",\"aspath\":%u", aspath_id);
+      if (community_id)
+        bgp_export_printf (ex, ",\"community\":%u", community_id);
+      bgp_export_printf (ex, ",\"best\":%s,\"valid\":%s}",
+                         (flags & BGP_EXPORT_ROUTE_BEST) ? "true" : "false",
+                         (flags & BGP_EXPORT_ROUTE_VALID) ? "true" : "false");
+    }
+  else
+    {
+      if (bgp_export_begin (ex, 96) < 0)
+        return;
+
+      bgp_export_put_byte (ex, BGP_EXPORT_REC_ROUTE);
+      bgp_export_put_varint (ex, flags);
+      bgp_export_put_byte (ex, p->family == AF_INET ? 4 : 16);
+      bgp_export_put_byte (ex, p->prefixlen);
+      bgp_export_put (ex, &p->u.prefix, (p->prefixlen + 7) / 8);
+      bgp_export_put_addr (ex, peerfamily, peer);
+      bgp_export_put_addr (ex, nhfamily, nh);
+      bgp_export_put_byte (ex, attr->origin);
+      bgp_export_put_varint (ex, med);
+      bgp_export_put_varint (ex, attr->local_pref);
+      bgp_export_put_varint (ex, attr->weight);
+      bgp_export_put_varint (ex, aspath_id);
+      bgp_export_put_varint (ex, community_id);
+    }
+
+  if (bgp_export_end (cli, ex) < 0)
+    return;
+
+  ex->routes++;
+}
+
+static void
+bgp_export_trailer (struct cli *cli, struct bgp_export *ex)
+{
+  if (ex->format == BGP_EXPORT_JSONL)
+    {
+      if (bgp_export_begin (ex, 64) < 0)
+        return;
+      bgp_export_printf (ex, "{\"type\":\"end\",\"routes\":%u}",
+                         ex->routes);
+    }
+  else
+    {
+      if (bgp_export_begin (ex, 8) < 0)
+        return;
+      bgp_export_put_byte (ex, BGP_EXPORT_REC_END);
+      bgp_export_put_varint (ex, ex->routes);
+    }
+
+  bgp_export_end (cli, ex);
+}
+
+/* Export callback.  Like bgp_show_callback() it registers itself as
+   cli->callback and is resumed by the event manager once the output
+   of the previous slice is written.  */
+static int
+bgp_export_callback (struct cli *cli)
+{
+  struct bgp_export *ex = cli->arg;
+  struct bgp_node *rn;
+  struct bgp_info *ri;
+  int count = 0;
+  int visited = 0;
+  u_int64_t start;
+  struct prefix rnp;
+
+  rn = cli->current;
+
+  if (cli->status == CLI_CLOSE)
+    goto cleanup;
+
+  if (cli->status == CLI_NORMAL)
+    bgp_export_header (cli, ex);
+
+  start = pal_time_mono_nsec ();
+
+  for (; rn; rn = bgp_route_next (rn))
+    {
+      if (count >= BGP_EXPORT_SLICE_ROUTES
+          || visited >= BGP_SHOW_SLICE_NODES
+          || (visited && ! (visited & BGP_SHOW_SLICE_CLOCK_MASK)
+              && pal_time_mono_nsec () - start >= BGP_SHOW_SLICE_NSEC))
+        {
+          cli->status = CLI_CONTINUE;
+          cli->current = rn;
+          cli->callback = bgp_export_callback;
+          return 0;
+        }
+      visited++;
+
+      if (rn->info == NULL)
+        continue;
+
+      BGP_GET_PREFIX_FROM_NODE (rn);
+
+      for (ri = rn->info; ri; ri = ri->next)
+        {
+          /* Same selection as "show ip bgp".  */
+          if (ri->type != IPI_ROUTE_BGP
+              && ! CHECK_FLAG (ri->flags, BGP_INFO_NHOP_VALID))
+            continue;
+
+          if (ri->type == IPI_ROUTE_BGP
+              && ri->sub_type == BGP_ROUTE_DEFAULT)
+            continue;
+
+          bgp_export_route (cli, ex, &rnp, ri);
+          count++;
+        }
+    }
+
+  bgp_export_trailer (cli, ex);
+
+ cleanup:
+
+  if (rn)
+    bgp_unlock_node (rn);
+
+  if (cli->cleanup)
+    {
+      (*cli->cleanup) (cli);
+      cli->cleanup = NULL;
+      cli->arg = NULL;
+    }
+
+  cli->status = CLI_CONTINUE;
+  cli->callback = NULL;
+
+  return 0;
+}
+
+static int
+bgp_export_cli (struct cli *cli, afi_t afi, safi_t safi, char *format)
+{
+  struct bgp_export *ex;
+  struct bgp *bgp;
+
+  bgp = bgp_lookup_default ();
+  if (! bgp)
+    return CLI_ERROR;
+
+  ex = bgp_export_new (pal_strcmp (format, "binary") == 0
+                       ? BGP_EXPORT_BINARY : BGP_EXPORT_JSONL);
+  if (! ex)
+    {
+      cli_out (cli, "%% Out of memory\n");
+      return CLI_ERROR;
+    }
+
+  cli->index = bgp;
+  cli->afi = afi;
+  cli->safi = safi;
+  cli->arg = ex;
+  cli->cleanup = bgp_export_clean;
+  cli->current = bgp_table_top (bgp->rib [BGP_AFI2BAAI (afi)]
+                                         [BGP_SAFI2BSAI (safi)]);
+
+  bgp_export_callback (cli);
+
+  return CLI_SUCCESS;
+}
+
+CLI (show_ip_bgp_format,
+     show_ip_bgp_format_cli,
+     "show ip bgp format (jsonl|binary)",
+     CLI_SHOW_STR,
+     CLI_IP_STR,
+     CLI_BGP_STR,
+     "Machine readable output",
+     "One JSON object per line",
+     "Base64 encoded binary records, one per line")
+{
+  return bgp_export_cli (cli, AFI_IP, SAFI_UNICAST, argv[0]);
+}
+
+CLI (show_ip_bgp_safi_format,
+     show_ip_bgp_safi_format_cli,
+     "show ip bgp ipv4 (unicast|multicast) format (jsonl|binary)",
+     CLI_SHOW_STR,
+     CLI_IP_STR,
+     CLI_BGP_STR,
+     CLI_AF_STR,
+     CLI_AFM_STR,
+     CLI_AFM_STR,
+     "Machine readable output",
+     "One JSON object per line",
+     "Base64 encoded binary records, one per line")
+{
+  return bgp_export_cli (cli, AFI_IP, bgp_cli_str2safi (argv[0]), argv[1]);
+}
+
+#ifdef HAVE_IPV6
+CLI (show_bgp_ipv6_format,
+     show_bgp_ipv6_format_cli,
+     "show bgp ipv6 format (jsonl|binary)",
+     CLI_SHOW_STR,
+     CLI_BGP_STR,
+     CLI_AF_STR,
+     "Machine readable output",
+     "One JSON object per line",
+     "Base64 encoded binary records, one per line")
+{
+  return bgp_export_cli (cli, AFI_IP6, SAFI_UNICAST, argv[0]);
+}
+#endif /* HAVE_IPV6 */
+
+void
+bgp_export_cli_init (struct cli_tree *ctree)
+{
+  cli_install_gen (ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
+                   &show_ip_bgp_format_cli);
+  cli_install_gen (ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
+                   &show_ip_bgp_safi_format_cli);
+#ifdef HAVE_IPV6
+  IF_BGP_CAP_HAVE_IPV6
+    cli_install_gen (ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
+                     &show_bgp_ipv6_format_cli);
+#endif /* HAVE_IPV6 */
+}
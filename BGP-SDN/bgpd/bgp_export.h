@@ -0,0 +1,86 @@
+/* Copyright (C) 2003-2011 IP Infusion, Inc. All Rights Reserved. */
+
+#ifndef _BGPSDN_BGP_EXPORT_H
+#define _BGPSDN_BGP_EXPORT_H
+
+/* Machine readable RIB export over the CLI channel.
+
+   "jsonl" writes one JSON object per line.  "binary" writes compact
+   varint encoded records, base64 encoded one record per line because
+   the vty channel carries text only.  Interned AS paths and
+   communities are written once as dictionary records ahead of the
+   first route that uses them and referenced by id afterwards.  Ids
+   start at 1; 0 means the attribute is absent.
+
+   Binary record layout (first byte is the record type, integers are
+   unsigned LEB128 varints unless noted):
+
+     HEADER     'B' 'G' 'P' 'X' version(1 byte) afi safi
+     ASPATH     id width(1 byte, 2 or 4) length data[length]
+     COMMUNITY  id length data[length]  (wire order)
+     ROUTE      flags family(1 byte) prefixlen(1 byte) prefix[(len+7)/8]
+                peer-family(1 byte) peer[4|16]
+                nexthop-family(1 byte) nexthop[4|16]
+                origin(1 byte) med local-pref weight aspath-id community-id
+     END        route-count  */
+
+#define BGP_EXPORT_JSONL                        (0)
+#define BGP_EXPORT_BINARY                       (1)
+
+#define BGP_EXPORT_VERSION                      (1)
+
+/* Binary record types.  */
+#define BGP_EXPORT_REC_HEADER                   (1)
+#define BGP_EXPORT_REC_ASPATH                   (2)
+#define BGP_EXPORT_REC_COMMUNITY                (3)
+#define BGP_EXPORT_REC_ROUTE                    (4)
+#define BGP_EXPORT_REC_END                      (5)
+
+/* ROUTE record flags.  */
+#define BGP_EXPORT_ROUTE_BEST                   (1 << 0)
+#define BGP_EXPORT_ROUTE_VALID                  (1 << 1)
+#define BGP_EXPORT_ROUTE_MED                    (1 << 2)
+#define BGP_EXPORT_ROUTE_LOCAL_PREF             (1 << 3)
+
+/* Routes written per CLI slice.  The node and time bounds of
+   "show ip bgp" apply as well.  */
+#define BGP_EXPORT_SLICE_ROUTES                 (256)
+
+/* Dictionary entry.  The entry holds a reference on the interned
+   object for the lifetime of the export.  */
+struct bgp_export_dict
+{
+  void *obj;
+#define BGP_EXPORT_DICT_ASPATH                  (0)
+#define BGP_EXPORT_DICT_AS4PATH                 (1)
+#define BGP_EXPORT_DICT_COMMUNITY               (2)
+  u_int8_t kind;
+  u_int32_t id;
+};
+
+/* State of one export, kept in cli->arg between slices.  */
+struct bgp_export
+{
+  u_int8_t format;
+
+  /* Interned attribute to dictionary id.  */
+  struct hash *dict;
+  u_int32_t next_id;
+
+  /* Number of routes written.  */
+  u_int32_t routes;
+
+  /* Record being encoded.  */
+  u_int8_t *buf;
+  u_int32_t size;
+  u_int32_t len;
+
+  /* Base64 line for the binary format.  */
+  u_int8_t *line;
+  u_int32_t line_size;
+};
+
+void
+bgp_export_cli_init (struct cli_tree *);
+
+#endif /* _BGPSDN_BGP_EXPORT_H */
@@ -324,8 +324,8 @@ as_4b_filter_match (struct as_filter *asfilter, struct as4path *aspath4B)
 #endif /* HAVE_EXT_CAP_ASN */
 
 /* Apply AS path filter to AS. */
-enum as_filter_type
-as_list_apply (struct as_list *aslist, void *object)
+static enum as_filter_type
+as_list_apply_entries (struct as_list *aslist, void *object)
 {
   struct as_filter *asfilter;
   struct aspath *aspath;
@@ -344,8 +344,6 @@ as_list_apply (struct as_list *aslist, void *object)
   else
     aspath = (struct aspath *) object;
 #endif /* HAVE_EXT_CAP_ASN */
-  if (! aslist)
-    return AS_FILTER_NO_MATCH;
 
   for (asfilter = aslist->head; asfilter; asfilter = asfilter->next)
     {
@@ -366,6 +364,25 @@ as_list_apply (struct as_list *aslist, void *object)
   return AS_FILTER_NO_MATCH;
 }
 
+enum as_filter_type
+as_list_apply (struct as_list *aslist, void *object)
+{
+  enum as_filter_type ret;
+  u_int64_t start;
+
+  if (! aslist)
+    return AS_FILTER_NO_MATCH;
+
+  if (! PSTATS_ENABLED ())
+    return as_list_apply_entries (aslist, object);
+
+  start = pstats_begin (&aslist->stats);
+  ret = as_list_apply_entries (aslist, object);
+  pstats_end (&aslist->stats, start, ret != AS_FILTER_NO_MATCH);
+
+  return ret;
+}
+
 /* Add hook function. */
 void
 as_list_add_hook (void (*func) ())
@@ -57,6 +57,9 @@ struct as_list
 
   struct as_filter *head;
   struct as_filter *tail;
+
+  /* Evaluation statistics, see pstats.h.  */
+  struct policy_stats stats;
 };
 
 struct bgp_as_list_master *
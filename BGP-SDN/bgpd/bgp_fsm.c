@@ -24,6 +24,21 @@ bpf_act_func_t bpf_action_func [BPF_STATE_MAX] =
   bpf_action_established
 };
 
+/* Run the Action-Func of the current State for the Event */
+static s_int32_t
+bpf_execute_event (struct bgp_peer *peer,
+                   u_int32_t bpf_event)
+{
+  BGP_SET_VR_CONTEXT (&BLG, peer->bgp->owning_bvr);
+
+  if (BGP_DEBUG (fsm, FSM))
+    zlog_info (&BLG, "%s-%s [FSM] State: %s Event: %d",
+               peer->host, BGP_PEER_DIR_STR (peer),
+               BGP_PEER_FSM_STATE_STR (peer->bpf_state), bpf_event);
+
+  return bpf_action_func [peer->bpf_state] (peer, bpf_event);
+}
+
 /* BGP Peer FSM Event Handler */
 s_int32_t
 bpf_process_event (struct thread *t_event)
@@ -59,15 +74,8 @@ bpf_process_event (struct thread *t_event)
   /* Obtain the Event value */
   bpf_event = THREAD_VAL (t_event);
 
-  BGP_SET_VR_CONTEXT (&BLG, peer->bgp->owning_bvr);
-
-  if (BGP_DEBUG (fsm, FSM))
-    zlog_info (&BLG, "%s-%s [FSM] State: %s Event: %d",
-               peer->host, BGP_PEER_DIR_STR (peer),
-               BGP_PEER_FSM_STATE_STR (peer->bpf_state), bpf_event);
-
   /* Invoke Action-Func defined for the current-state */
-  ret = bpf_action_func [peer->bpf_state] (peer, bpf_event);
+  ret = bpf_execute_event (peer, bpf_event);
 
 EXIT:
 
@@ -246,8 +254,8 @@ bpf_action_connect (struct bgp_peer *peer,
       else
         peer->v_holdtime = BGP_DEFAULT_HOLDTIME_LARGE;
       if(peer->v_holdtime)
-        BGP_TIMER_ON (&BLG, peer->t_holdtime, peer, bpf_timer_holdtime,
-                      peer->v_holdtime);
+        BGP_TIMER_HIGH_ON (&BLG, peer->t_holdtime, peer, bpf_timer_holdtime,
+                           peer->v_holdtime);
       bgp_peer_send_open (peer);
       bpf_change_state (peer, BPF_STATE_OPEN_SENT);
       break;
@@ -412,8 +420,8 @@ bpf_action_active (struct bgp_peer *peer,
         peer->v_holdtime = peer->bgp->default_holdtime;
       else
         peer->v_holdtime = BGP_DEFAULT_HOLDTIME_LARGE;
-      BGP_TIMER_ON (&BLG, peer->t_holdtime, peer, bpf_timer_holdtime,
-                    peer->v_holdtime);
+      BGP_TIMER_HIGH_ON (&BLG, peer->t_holdtime, peer, bpf_timer_holdtime,
+                         peer->v_holdtime);
       bgp_peer_send_open (peer);
       bpf_change_state (peer, BPF_STATE_OPEN_SENT);
       break;
@@ -628,11 +636,11 @@ bpf_action_open_sent (struct bgp_peer *peer,
           if (peer->v_holdtime && peer->v_keepalive)
             {
               BGP_TIMER_OFF (peer->t_keepalive);
-              BGP_TIMER_ON (&BLG, peer->t_keepalive, peer,
-                            bpf_timer_keepalive, peer->v_keepalive);
+              BGP_TIMER_HIGH_ON (&BLG, peer->t_keepalive, peer,
+                                 bpf_timer_keepalive, peer->v_keepalive);
               BGP_TIMER_OFF (peer->t_holdtime);
-              BGP_TIMER_ON (&BLG, peer->t_holdtime, peer,
-                            bpf_timer_holdtime, peer->v_holdtime);
+              BGP_TIMER_HIGH_ON (&BLG, peer->t_holdtime, peer,
+                                 bpf_timer_holdtime, peer->v_holdtime);
             }
           bpf_process_open (peer);
           bpf_change_state (peer, BPF_STATE_OPEN_CFM);
@@ -830,8 +838,8 @@ bpf_action_open_cfm (struct bgp_peer *peer,
     case BPF_EVENT_KEEPALIVE_EXP:
       bgp_peer_send_keepalive (peer);
       if (peer->v_holdtime && peer->v_keepalive)
-        BGP_TIMER_ON (&BLG, peer->t_keepalive, peer, bpf_timer_keepalive,
-                      peer->v_keepalive);
+        BGP_TIMER_HIGH_ON (&BLG, peer->t_keepalive, peer, bpf_timer_keepalive,
+                           peer->v_keepalive);
       break;
 
     case BPF_EVENT_TCP_CONN_CFM:
@@ -924,8 +932,8 @@ bpf_action_open_cfm (struct bgp_peer *peer,
     case BPF_EVENT_KEEPALIVE_VALID:
       BGP_TIMER_OFF (peer->t_holdtime);
       if (peer->v_holdtime)
-        BGP_TIMER_ON (&BLG, peer->t_holdtime, peer,
-                      bpf_timer_holdtime, peer->v_holdtime);
+        BGP_TIMER_HIGH_ON (&BLG, peer->t_holdtime, peer, bpf_timer_holdtime,
+                           peer->v_holdtime);
       peer->established++;
       peer->uptime = pal_time_current (NULL);
       bgp_log_neighbor_status_print (peer, PEER_LOG_STATUS_UP, "");
@@ -1072,8 +1080,8 @@ bpf_action_established (struct bgp_peer *peer,
     case BPF_EVENT_KEEPALIVE_EXP:
       bgp_peer_send_keepalive (peer);
       if (peer->v_holdtime && peer->v_keepalive)
-        BGP_TIMER_ON (&BLG, peer->t_keepalive, peer, bpf_timer_keepalive,
-                      peer->v_keepalive);
+        BGP_TIMER_HIGH_ON (&BLG, peer->t_keepalive, peer, bpf_timer_keepalive,
+                           peer->v_keepalive);
       break;
 
     case BPF_EVENT_TCP_CONN_CFM:
@@ -1170,8 +1178,8 @@ bpf_action_established (struct bgp_peer *peer,
     case BPF_EVENT_KEEPALIVE_VALID:
       BGP_TIMER_OFF (peer->t_holdtime);
       if (peer->v_holdtime)
-        BGP_TIMER_ON (&BLG, peer->t_holdtime, peer,
-                      bpf_timer_holdtime, peer->v_holdtime);
+        BGP_TIMER_HIGH_ON (&BLG, peer->t_holdtime, peer, bpf_timer_holdtime,
+                           peer->v_holdtime);
       
       if (peer->bgp->conv_complete != PAL_TRUE)
         if (!CHECK_FLAG (peer->sflags, PEER_STATUS_CONV_FOR_IGP)) 
@@ -1185,8 +1193,8 @@ bpf_action_established (struct bgp_peer *peer,
     case BPF_EVENT_UPDATE_VALID:
       BGP_TIMER_OFF (peer->t_holdtime);
       if (peer->v_holdtime)
-        BGP_TIMER_ON (&BLG, peer->t_holdtime, peer,
-                      bpf_timer_holdtime, peer->v_holdtime);
+        BGP_TIMER_HIGH_ON (&BLG, peer->t_holdtime, peer, bpf_timer_holdtime,
+                           peer->v_holdtime);
       bpf_process_update (peer);
       break;
 
@@ -1477,6 +1485,26 @@ EXIT:
   return ret;
 }
 
+/* Whether the Peer's socket has input we have not read yet */
+static bool_t
+bpf_peer_input_pending (struct bgp_peer *peer)
+{
+  struct pal_timeval timer_nowait;
+  pal_sock_set_t readfd;
+  pal_sock_handle_t fd;
+
+  fd = SSOCK_CB_GET_SSOCK_FD (peer->sock_cb);
+  if (fd < 0)
+    return PAL_FALSE;
+
+  pal_mem_set (&readfd, 0, sizeof (pal_sock_set_t));
+  PAL_SOCK_HANDLESET_SET (fd, &readfd);
+  timer_nowait.tv_sec = 0;
+  timer_nowait.tv_usec = 0;
+
+  return pal_sock_select (fd + 1, &readfd, NULL, NULL, &timer_nowait) > 0;
+}
+
 /* BGP Peer FSM Hold-time timer */
 s_int32_t
 bpf_timer_holdtime (struct thread *t_timer)
@@ -1516,8 +1544,26 @@ bpf_timer_holdtime (struct thread *t_timer)
 
   peer->t_holdtime = NULL;
 
-  /* Post the Timer Expiry FSM Event */
-  BGP_PEER_FSM_EVENT_ADD (&BLG, peer, BPF_EVENT_HOLD_EXP);
+  /*
+   * Input waiting on the socket means the Peer is alive and only
+   * our reading of it is behind, so restart the Hold-Timer.
+   */
+  if (bpf_peer_input_pending (peer))
+    {
+      if (BGP_DEBUG (fsm, FSM))
+        zlog_info (&BLG, "%s-%s [FSM] Hold-Timer: Input pending, restarted",
+                   peer->host, BGP_PEER_DIR_STR (peer));
+
+      BGP_TIMER_HIGH_ON (&BLG, peer->t_holdtime, peer, bpf_timer_holdtime,
+                         peer->v_holdtime);
+      goto EXIT;
+    }
+
+  /*
+   * Run the Timer Expiry FSM Event now.  A posted event would only
+   * be run once the ready queues have drained.
+   */
+  ret = bpf_execute_event (peer, BPF_EVENT_HOLD_EXP);
 
 EXIT:
 
@@ -1563,8 +1609,11 @@ bpf_timer_keepalive (struct thread *t_timer)
 
   peer->t_keepalive = NULL;
 
-  /* Post the Timer Expiry FSM Event */
-  BGP_PEER_FSM_EVENT_ADD (&BLG, peer, BPF_EVENT_KEEPALIVE_EXP);
+  /*
+   * Run the Timer Expiry FSM Event now.  A posted event would only
+   * be run once the ready queues have drained.
+   */
+  ret = bpf_execute_event (peer, BPF_EVENT_KEEPALIVE_EXP);
 
 EXIT:
 
@@ -1810,6 +1859,11 @@ bpf_process_update (struct bgp_peer *peer)
   bdui = (struct bgp_dec_update_info *) FIFO_HEAD (&peer->bdui_fifo);
   FIFO_DEL (&bdui->ui_fifo);
 
+  bgp_perf_record (peer, BGP_PERF_QUEUE, bdui->ui_enq_nsec);
+
+  /* Charge best-path selection to this peer */
+  bgp_perf_peer = peer;
+
   if (peer->afc [BAAI_IP][BSAI_UNICAST])
     {
       /* Process Withdrawn IPv4-Unicast NLRIs */
@@ -1886,6 +1940,8 @@ bpf_process_update (struct bgp_peer *peer)
       XFREE (MTYPE_TMP, bdui);
     }
 
+  bgp_perf_peer = NULL;
+
 EXIT:
 
   return ret;
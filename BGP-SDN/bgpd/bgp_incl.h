@@ -74,6 +74,8 @@
 #include "bgpd/bgp_as4path.h"
 #endif /* HAVE_EXT_CAP_ASN */
 #include "bgpd/bgp_filter.h"
+#include "bgpd/bgp_export.h"
+#include "bgpd/bgp_perf.h"
 #ifdef HAVE_SNMP
 #include "bgpd/bgp_snmp.h"
 #endif /* HAVE_SNMP */
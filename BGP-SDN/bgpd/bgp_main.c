@@ -123,6 +123,10 @@ bgp_start (u_int16_t daemon_mode, u_int8_t *config_file, u_int16_t vty_port,
   if (daemon_mode)
     pal_daemonize (0, 0);
 
+  /* Hand log output to the writer thread now the process is settled.  */
+  if (zlog_async_start (&BLG) < 0)
+    zlog_warn (&BLG, "Asynchronous logging unavailable");
+
 #ifdef HAVE_PID
   PID_REGISTER (PATH_BGPD_PID);
 #endif /* HAVE_PID */
@@ -0,0 +1,242 @@
+/* Copyright (C) 2013 IP Infusion, Inc. All Rights Reserved. */
+
+#include <bgp_incl.h>
+
+#ifdef HAVE_BGP_SDN
+#include <onion/onion.h>
+#include <onion/dict.h>
+#include <onion/shortcuts.h>
+#endif /* HAVE_BGP_SDN */
+
+/* Peer whose UPDATE is being processed, set around
+   bpf_process_update().  */
+struct bgp_peer *bgp_perf_peer;
+
+/* Every stage summed over all peers, including work that is not
+   done for any particular peer.  */
+static struct bgp_peer_perf bgp_perf_total;
+
+static char *bgp_perf_stage_str[BGP_PERF_STAGE_MAX] =
+{
+  "read", "decode", "queue", "process",
+  "adj-out", "encode", "write", "rest"
+};
+
+void
+bgp_perf_record_nsec (struct bgp_peer *peer, enum bgp_perf_stage stage,
+                      u_int64_t nsec)
+{
+  lathist_record (&bgp_perf_total.stage[stage], nsec);
+
+  if (! peer)
+    return;
+
+  if (! peer->perf)
+    {
+      peer->perf = XCALLOC (MTYPE_BGP_PERF, sizeof (struct bgp_peer_perf));
+      if (! peer->perf)
+        return;
+    }
+
+  lathist_record (&peer->perf->stage[stage], nsec);
+}
+
+/* Record a stage that began at START, as returned by BGP_PERF_BEGIN().  */
+void
+bgp_perf_record (struct bgp_peer *peer, enum bgp_perf_stage stage,
+                 u_int64_t start)
+{
+  bgp_perf_record_nsec (peer, stage, pal_time_mono_nsec () - start);
+}
+
+/* Socket-CB I/O timing function of the peer sockets.  The owner is
+   looked up on every call since an incoming connection's Socket-CB
+   moves to the configured peer once it is accepted.  */
+void
+bgp_perf_sock_time (struct stream_sock_cb *ssock_cb, u_int8_t dir,
+                    u_int64_t nsec)
+{
+  bgp_perf_record_nsec (SSOCK_CB_GET_OWNER (ssock_cb),
+                        dir == SSOCK_IO_READ ? BGP_PERF_READ : BGP_PERF_WRITE,
+                        nsec);
+}
+
+void
+bgp_perf_peer_free (struct bgp_peer *peer)
+{
+  if (bgp_perf_peer == peer)
+    bgp_perf_peer = NULL;
+
+  if (peer->perf)
+    {
+      XFREE (MTYPE_BGP_PERF, peer->perf);
+      peer->perf = NULL;
+    }
+}
+
+static void
+bgp_perf_show_one (struct cli *cli, struct bgp_peer_perf *perf)
+{
+  char mean[LATHIST_STR_LEN];
+  char p50[LATHIST_STR_LEN];
+  char p90[LATHIST_STR_LEN];
+  char p99[LATHIST_STR_LEN];
+  char max[LATHIST_STR_LEN];
+  char count[LATHIST_U64_STR_LEN];
+  struct lathist *lh;
+  int i;
+
+  for (i = 0; i < BGP_PERF_STAGE_MAX; i++)
+    {
+      lh = &perf->stage[i];
+      if (! lh->count)
+        continue;
+
+      cli_out (cli, "  %-9s %12s %9s %9s %9s %9s %9s\n",
+               bgp_perf_stage_str[i], lathist_u64_str (lh->count, count),
+               lathist_nsec_str (lathist_mean (lh), mean),
+               lathist_nsec_str (lathist_percentile (lh, 500), p50),
+               lathist_nsec_str (lathist_percentile (lh, 900), p90),
+               lathist_nsec_str (lathist_percentile (lh, 990), p99),
+               lathist_nsec_str (lh->max, max));
+    }
+}
+
+CLI (show_bgp_performance,
+     show_bgp_performance_cli,
+     "show bgp performance",
+     CLI_SHOW_STR,
+     CLI_BGP_STR,
+     "UPDATE pipeline latency per stage")
+{
+  struct bgp_peer *peer;
+  struct listnode *nn;
+  struct listnode *mm;
+  struct bgp *bgp;
+
+  cli_out (cli, "  %-9s %12s %9s %9s %9s %9s %9s\n",
+           "Stage", "Samples", "Mean", "p50", "p90", "p99", "Max");
+
+  cli_out (cli, "All peers\n");
+  bgp_perf_show_one (cli, &bgp_perf_total);
+
+  LIST_LOOP (BGP_VR.bgp_list, bgp, nn)
+    LIST_LOOP (bgp->peer_list, peer, mm)
+      {
+        if (! peer->perf)
+          continue;
+
+        cli_out (cli, "Neighbor %s\n", peer->host);
+        bgp_perf_show_one (cli, peer->perf);
+      }
+
+  return CLI_SUCCESS;
+}
+
+CLI (clear_bgp_performance,
+     clear_bgp_performance_cli,
+     "clear bgp performance",
+     CLI_CLEAR_STR,
+     CLI_BGP_STR,
+     "UPDATE pipeline latency per stage")
+{
+  struct bgp_peer *peer;
+  struct listnode *nn;
+  struct listnode *mm;
+  struct bgp *bgp;
+  int i;
+
+  for (i = 0; i < BGP_PERF_STAGE_MAX; i++)
+    lathist_reset (&bgp_perf_total.stage[i]);
+
+  LIST_LOOP (BGP_VR.bgp_list, bgp, nn)
+    LIST_LOOP (bgp->peer_list, peer, mm)
+      if (peer->perf)
+        for (i = 0; i < BGP_PERF_STAGE_MAX; i++)
+          lathist_reset (&peer->perf->stage[i]);
+
+  return CLI_SUCCESS;
+}
+
+void
+bgp_perf_cli_init (struct cli_tree *ctree)
+{
+  cli_install_gen (ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
+                   &show_bgp_performance_cli);
+  cli_install_gen (ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
+                   &clear_bgp_performance_cli);
+}
+
+#ifdef HAVE_BGP_SDN
+static void
+bgp_perf_dict_add_u64 (onion_dict *dict, char *key, u_int64_t val)
+{
+  char buf[LATHIST_U64_STR_LEN];
+
+  onion_dict_add (dict, key, lathist_u64_str (val, buf), OD_DUP_ALL);
+}
+
+static onion_dict *
+bgp_perf_dict (struct bgp_peer_perf *perf)
+{
+  struct lathist *lh;
+  onion_dict *dict;
+  onion_dict *d;
+  int i;
+
+  /* onion_dict_new: return check will not be done */
+  dict = onion_dict_new ();
+
+  for (i = 0; i < BGP_PERF_STAGE_MAX; i++)
+    {
+      lh = &perf->stage[i];
+      if (! lh->count)
+        continue;
+
+      d = onion_dict_new ();
+      bgp_perf_dict_add_u64 (d, "count", lh->count);
+      bgp_perf_dict_add_u64 (d, "mean_ns", lathist_mean (lh));
+      bgp_perf_dict_add_u64 (d, "p50_ns", lathist_percentile (lh, 500));
+      bgp_perf_dict_add_u64 (d, "p90_ns", lathist_percentile (lh, 900));
+      bgp_perf_dict_add_u64 (d, "p99_ns", lathist_percentile (lh, 990));
+      bgp_perf_dict_add_u64 (d, "max_ns", lh->max);
+
+      onion_dict_add (dict, bgp_perf_stage_str[i], d,
+                      OD_DICT|OD_DUP_KEY|OD_FREE_VALUE);
+    }
+
+  return dict;
+}
+
+/* GET wm/bgp/performance  */
+int
+bgp_perf_req_handler (void *p, onion_request *req, onion_response *res)
+{
+  struct bgp_peer *peer;
+  struct listnode *nn;
+  struct listnode *mm;
+  onion_dict *peers;
+  onion_dict *dict;
+  struct bgp *bgp;
+
+  if ((onion_request_get_flags (req) & OR_METHODS) != OR_GET)
+    return OCS_NOT_IMPLEMENTED;
+
+  /* onion_dict_new: return check will not be done */
+  dict = onion_dict_new ();
+  peers = onion_dict_new ();
+
+  onion_dict_add (dict, "total", bgp_perf_dict (&bgp_perf_total),
+                  OD_DICT|OD_DUP_KEY|OD_FREE_VALUE);
+
+  LIST_LOOP (BGP_VR.bgp_list, bgp, nn)
+    LIST_LOOP (bgp->peer_list, peer, mm)
+      if (peer->perf)
+        onion_dict_add (peers, (char *) peer->host, bgp_perf_dict (peer->perf),
+                        OD_DICT|OD_DUP_KEY|OD_FREE_VALUE);
+
+  onion_dict_add (dict, "peers", peers, OD_DICT|OD_DUP_KEY|OD_FREE_VALUE);
+
+  return onion_shortcut_response_json (dict, req, res);
+}
+#endif /* HAVE_BGP_SDN */
@@ -0,0 +1,56 @@
+/* Copyright (C) 2013 IP Infusion, Inc. All Rights Reserved. */
+
+#ifndef _BGPSDN_BGP_PERF_H
+#define _BGPSDN_BGP_PERF_H
+
+/* Per-peer latency of the UPDATE pipeline.
+
+   Each stage is timed with the monotonic clock and counted in a
+   latency histogram of the peer the work is done for, and in a
+   histogram summed over all peers.  Best-path selection is charged
+   to the peer whose UPDATE is being processed, if any.  */
+
+enum bgp_perf_stage
+{
+  BGP_PERF_READ,                /* Socket read system call */
+  BGP_PERF_DECODE,              /* UPDATE message decoding */
+  BGP_PERF_QUEUE,               /* Wait in the peer's bdui_fifo */
+  BGP_PERF_PROCESS,             /* bgp_process() best-path selection */
+  BGP_PERF_ADJ_OUT,             /* Adj-RIB-Out enqueue */
+  BGP_PERF_ENCODE,              /* UPDATE message encoding */
+  BGP_PERF_WRITE,               /* Socket write system call */
+  BGP_PERF_REST,                /* REST post to the SDN controller */
+  BGP_PERF_STAGE_MAX
+};
+
+struct bgp_peer_perf
+{
+  struct lathist stage[BGP_PERF_STAGE_MAX];
+};
+
+/* Peer whose UPDATE is being processed.  */
+extern struct bgp_peer *bgp_perf_peer;
+
+#define BGP_PERF_BEGIN()        pal_time_mono_nsec ()
+
+void
+bgp_perf_record (struct bgp_peer *, enum bgp_perf_stage, u_int64_t);
+void
+bgp_perf_record_nsec (struct bgp_peer *, enum bgp_perf_stage, u_int64_t);
+void
+bgp_perf_sock_time (struct stream_sock_cb *, u_int8_t, u_int64_t);
+void
+bgp_perf_peer_free (struct bgp_peer *);
+void
+bgp_perf_cli_init (struct cli_tree *);
+
+#ifdef HAVE_BGP_SDN
+struct onion_request_t;
+struct onion_response_t;
+
+int
+bgp_perf_req_handler (void *, struct onion_request_t *,
+                      struct onion_response_t *);
+#endif /* HAVE_BGP_SDN */
+
+#endif /* _BGPSDN_BGP_PERF_H */
@@ -380,6 +380,85 @@ bgp_ptree_node_sub_tree_lookup (struct bgp_ptree *tree,
   return NULL;
 }
 
+/* Return the first node which follows the subtree hanging off the
+   'dir' link of 'parent' in walk order, without locking it. */
+static struct bgp_node *
+bgp_ptree_subtree_next (struct bgp_node *parent, int dir)
+{
+  struct bgp_node *node;
+
+  if (dir == 0 && parent->p_right)
+    return parent->p_right;
+
+  node = parent;
+  while (node->parent)
+    {
+      if (node->parent->p_left == node && node->parent->p_right)
+        return node->parent->p_right;
+      node = node->parent;
+    }
+  return NULL;
+}
+
+/* Lookup the node for ptree_key, or the node that would follow it in
+   walk order had it been inserted.  Unlike bgp_ptree_node_get() the
+   tree is not modified.  Return the node locked, or NULL when ptree_key
+   sorts after every node in the tree. */
+struct bgp_node *
+bgp_ptree_node_lookup_next (struct bgp_ptree *tree, u_char *key,
+                            u_int16_t key_len)
+{
+  struct bgp_node *node;
+  struct bgp_node *match;
+  struct bgp_node *next;
+  u_int16_t len;
+  u_char *np;
+  int diff;
+
+  if (key_len > tree->max_key_len)
+    return NULL;
+
+  match = NULL;
+  node = tree->top;
+  while (node && node->key_len <= key_len
+         && bgp_ptree_key_match (BGP_PTREE_NODE_KEY (node),
+                                 node->key_len, key, key_len))
+    {
+      if (node->key_len == key_len)
+        return bgp_ptree_lock_node (node);
+
+      match = node;
+      node = node->link[bgp_ptree_check_bit (tree, key, node->key_len)];
+    }
+
+  if (node)
+    {
+      /* ptree_key would be a new parent of node, or a sibling of it
+         under a new branch.  Find the first bit in which they differ. */
+      np = BGP_PTREE_NODE_KEY (node);
+      len = MIN (node->key_len, key_len);
+      for (diff = 0; diff < len; diff++)
+        if (bgp_ptree_check_bit (tree, np, diff)
+            != bgp_ptree_check_bit (tree, key, diff))
+          break;
+
+      /* Parent of node or left sibling: node comes next. */
+      if (diff == len || bgp_ptree_check_bit (tree, key, diff) == 0)
+        return bgp_ptree_lock_node (node);
+    }
+
+  if (! match)
+    return NULL;
+
+  next = bgp_ptree_subtree_next (match,
+                                 bgp_ptree_check_bit (tree, key,
+                                                      match->key_len));
+  if (next)
+    bgp_ptree_lock_node (next);
+
+  return next;
+}
+
 /* Add node to routing tree. */
 struct bgp_node *
 bgp_ptree_node_get (struct bgp_ptree *tree, u_char *key, u_int16_t key_len)
@@ -784,6 +863,39 @@ bgp_node_lookup (struct bgp_ptree * tree, struct prefix * p)
   return node;
 }
 
+struct bgp_node *
+bgp_node_lookup_next (struct bgp_ptree * tree, struct prefix * p)
+{
+  u_char key[20];
+  u_int16_t key_len;
+  u_int16_t octect;
+  u_int8_t afi_len = 1;
+
+  pal_mem_set (key, 0, sizeof (key));
+
+  if (tree->family == BGP_IPV4_IPV6_ADDR_AFI)
+    {
+      octect = bgp_ptree_bit_to_octets (p->prefixlen + BGP_AFI_LENGTH_IN_BITS);
+      key [0] = p->family;
+      pal_mem_cpy ((key + afi_len), &p->u.prefix, (octect - afi_len));
+      key_len = p->prefixlen + BGP_AFI_LENGTH_IN_BITS;
+    }
+  else if ((tree->family == BGP_IPV4_ADDR_AFI)
+           || (tree->family == BGP_IPV6_ADDR_AFI))
+    {
+      octect = bgp_ptree_bit_to_octets (p->prefixlen);
+      pal_mem_cpy (key, &p->u.prefix, octect);
+      key_len = p->prefixlen;
+    }
+  else
+    {
+      /*Searching in a wrong tree */
+      return NULL;
+    }
+
+  return bgp_ptree_node_lookup_next (tree, key, key_len);
+}
+
 struct bgp_node *
 bgp_lock_node (struct bgp_node *node)
 {
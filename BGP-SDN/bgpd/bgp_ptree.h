@@ -73,6 +73,8 @@ struct bgp_node *bgp_ptree_node_get (struct bgp_ptree *tree, u_char *key,
 				   u_int16_t key_len);
 struct bgp_node *bgp_ptree_node_lookup (struct bgp_ptree *tree, u_char *key,
 				      u_int16_t key_len);
+struct bgp_node *bgp_ptree_node_lookup_next (struct bgp_ptree *tree,
+                                            u_char *key, u_int16_t key_len);
 struct bgp_node *bgp_ptree_lock_node (struct bgp_node *node);
 struct bgp_node *bgp_ptree_node_match (struct bgp_ptree *tree, u_char *key,
 				     u_int16_t key_len);
@@ -97,6 +99,7 @@ struct bgp_node *bgp_route_next (struct bgp_node *);
 struct bgp_node *bgp_route_next_until (struct bgp_node *, struct bgp_node *);
 struct bgp_node *bgp_node_get (struct bgp_ptree *, struct prefix *);
 struct bgp_node *bgp_node_lookup (struct bgp_ptree *, struct prefix *);
+struct bgp_node *bgp_node_lookup_next (struct bgp_ptree *, struct prefix *);
 struct bgp_node *bgp_lock_node (struct bgp_node *node);
 struct bgp_node *bgp_node_match (struct bgp_ptree *, struct prefix *);
 
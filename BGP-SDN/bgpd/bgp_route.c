@@ -27,51 +27,15 @@ bgp_curl_free (void *url)
   return 0;
 }
 
-int
-bgp_get_router_id (const char *path, struct pal_in4_addr *addr)
-{
-  char *str;
-  char *rid;
-  char *p;
-
-  str = XSTRDUP(MTYPE_TMP, path);
-  if (!str)
-    return -1;
-
-  rid = str;
-
-  /* skip the first */
-  rid++;
-
-  p = pal_strstr (rid, "/");
-  if (p)
-    *p = '\0';
- 
-  if (pal_inet_pton (AF_INET, rid, addr) != 1)
-    return -1;
-
-  XFREE(MTYPE_TMP, str);
-
-  return 0;
-}
-
+/* Router-id of the request, from the {rid:ipv4} element of the url.  */
 struct bgp *
 bgp_lookup_from_path (onion_request *req)
 {
-  const char *path;
   struct pal_in4_addr rid;
   struct bgp *bgp;
 
-  path = onion_request_get_path (req);
-  if (path)
-    {
-      if (bgp_get_router_id (path, &rid) < 0)
-	return NULL;
-    }
-  else
-    {
-      return NULL;
-    }    
+  if (onion_request_get_param_ipv4 (req, "rid", &rid) < 0)
+    return NULL;
 
   bgp = bgp_lookup_by_routerid (&rid);
   if (! bgp)
@@ -140,15 +104,19 @@ bgp_get_method(void *p, onion_request *req, onion_response *res)
             zlog_warn (&BLG, "[SDN] inet_ntop(%d)", errno);
 	  else
             {
+	      /* The RIB may be big, and the array keys are all the same,
+		 so use a hash dict, that keeps the table order.  */
 	      if (!a)
-  	        a = onion_dict_new ();
+		{
+		  a = onion_dict_new ();
+		  onion_dict_set_flags (a, OD_HASH);
+		}
 
 	      d = onion_dict_new ();
               onion_dict_add (d, "prefix", pfx, OD_DUP_ALL);
               onion_dict_add (d, "nexthop", nh, OD_DUP_ALL);
 
-  	      idx = strdup("");
-              onion_dict_add (a, idx, d, OD_DICT|OD_FREE_ALL);
+              onion_dict_add (a, "", d, OD_DICT|OD_FREE_VALUE);
             }
         }
     }
@@ -170,93 +138,26 @@ end:
   return ret;
 }
 
+/* Route of the request, from the {prefix:ipv4}/{len:int}/{nexthop:ipv4}
+   elements of the url, already checked by the url router.  */
 int
 bgp_get_rib_from_path (onion_request *req, struct prefix *pfx, struct pal_in4_addr *nh)
 {
-  int ret = 0;
-  const char *path = NULL;
-  char *str = NULL;
-  char *p, *tmp;
+  long len;
 
   pfx->family = AF_INET;
 
-  path = onion_request_get_path (req);
-  if (!path)
-    {
-      ret = -1;
-      goto end;
-    }
-
-  str = XSTRDUP(MTYPE_TMP, path);
-  if (!str)
-    {
-      ret = -1;
-      goto end;
-    }
-
-  p = str;
-
-  /* skip the first */
-  p++;
-  
-  /* skip router-id */
-  p = pal_strstr (p, "/");
-  if (!p)
-    {
-      ret = -1;
-      goto end;
-    }
-
-  /* prefix */
-  tmp = ++p;
-  p = pal_strstr (p, "/");
-  if (!p)
-    {
-      ret = -1;
-      goto end;
-    }
-
-  *p = '\0';
-  p++;
-
-  if (pal_inet_pton (AF_INET, tmp, &pfx->u.prefix4) != 1)
-    {
-      ret = -1;
-      goto end;
-    }
-
-  /* prefix length */
-  tmp = p;
-  p = pal_strstr (p, "/");
-  if (!p)
-    {
-      ret = -1;
-      goto end;
-    }
-
-  *p = '\0';
-  p++;
-
-  pfx->prefixlen = (u_int8_t)pal_strtou32 (tmp, (char **)NULL, 10);
-
-  /* nexthop */
-  tmp = p;
-  p = pal_strstr (p, "/");
-  if (p)
-    *p = '\0';
-
-  if (pal_inet_pton (AF_INET, tmp, nh) != 1)
-    {
-      ret = -1;
-      goto end;
-    }
+  if (onion_request_get_param_ipv4 (req, "prefix", &pfx->u.prefix4) < 0
+      || onion_request_get_param_int (req, "len", &len) < 0
+      || onion_request_get_param_ipv4 (req, "nexthop", nh) < 0)
+    return -1;
 
+  if (len < 0 || len > IPV4_MAX_BITLEN)
+    return -1;
 
-end:
-  if (str)
-    XFREE(MTYPE_TMP, str);
+  pfx->prefixlen = (u_int8_t) len;
 
-  return ret;
+  return 0;
 }
 
 int
@@ -375,11 +276,21 @@ bgp_onion_stop (void)
   return;
 }
 
+/* Url templates of bgp_req_handler.  */
+static const char *bgp_rest_urls[] =
+{
+  "wm/bgp/{rid:ipv4}",
+  "wm/bgp/{rid:ipv4}/",
+  "wm/bgp/{rid:ipv4}/{prefix:ipv4}/{len:int}/{nexthop:ipv4}",
+  "wm/bgp/{rid:ipv4}/{prefix:ipv4}/{len:int}/{nexthop:ipv4}/"
+};
+
 int
 bgp_onion_init (void)
 {
   int ret = 0;
   int api_ret;
+  u_int32_t i;
   onion_url *urls;
 
   /* onion_new: return check will not be done */
@@ -405,7 +316,9 @@ bgp_onion_init (void)
       goto end;
     }
 
-  api_ret = onion_url_add(urls, "^wm\/bgp", bgp_req_handler);
+  /* The url router checks and parses the parameters, so the handlers
+     get them with onion_request_get_param_*().  */
+  api_ret = onion_url_add(urls, "wm/bgp/performance", bgp_perf_req_handler);
   if (api_ret != 0)
     {
       zlog_warn (&BLG, "[SDN] onion_url_add failed");
@@ -413,6 +326,19 @@ bgp_onion_init (void)
       goto end;
     }
 
+  /* Also with a trailing "/", that the former "^wm/bgp" prefix
+     match accepted.  */
+  for (i = 0; i < sizeof (bgp_rest_urls) / sizeof (bgp_rest_urls[0]); i++)
+    {
+      api_ret = onion_url_add(urls, bgp_rest_urls[i], bgp_req_handler);
+      if (api_ret != 0)
+        {
+          zlog_warn (&BLG, "[SDN] onion_url_add failed");
+          ret = -1;
+          goto end;
+        }
+    }
+
   api_ret = onion_listen(bgp_onion);
   if (api_ret != 0) 
     {
@@ -665,8 +591,10 @@ void
 bgp_post_rib (struct bgp *bgp, struct prefix *p, struct bgp_info *bi)
 {
   char url[MAX_BGP_URL];
+  u_int64_t start;
   char *addr;
   u_int16_t port;
+  int ret;
   int i;
 
   if (CHECK_FLAG (bi->flags_misc, BGP_INFO_MULTI_POST))
@@ -686,7 +614,11 @@ bgp_post_rib (struct bgp *bgp, struct prefix *p, struct bgp_info *bi)
           continue;
         }
 
-      if (bgp_send_url (bgp, url, 1) < 0)
+      start = BGP_PERF_BEGIN ();
+      ret = bgp_send_url (bgp, url, 1);
+      bgp_perf_record (bi->peer, BGP_PERF_REST, start);
+
+      if (ret < 0)
         {
           zlog_warn (&BLG, "[SDN] failed to post url");
           continue;
@@ -702,8 +634,10 @@ void
 bgp_delete_rib (struct bgp *bgp, struct prefix *p, struct bgp_info *bi)
 {
   char url[MAX_BGP_URL];
+  u_int64_t start;
   char *addr;
   u_int16_t port;
+  int ret;
   int i;
 
   if (! CHECK_FLAG (bi->flags_misc, BGP_INFO_MULTI_POST))
@@ -723,7 +657,11 @@ bgp_delete_rib (struct bgp *bgp, struct prefix *p, struct bgp_info *bi)
           continue;
         }
 
-      if (bgp_send_url (bgp, url, 0) < 0)
+      start = BGP_PERF_BEGIN ();
+      ret = bgp_send_url (bgp, url, 0);
+      bgp_perf_record (bi->peer, BGP_PERF_REST, start);
+
+      if (ret < 0)
         {
           zlog_warn (&BLG, "[SDN] failed to delete url");
           continue;
@@ -1625,34 +1563,263 @@ bgp_input_modifier (struct bgp_peer *peer, struct prefix *p,
   return RMAP_PERMIT;
 }
 
+/* Apply the outbound filters, route-map and attribute transforms
+   that depend only on the outbound configuration of PEER.  ATTR holds
+   a copy of the route's attribute on entry and the result on return.
+   Return 0 when the route is denied.  */
+static s_int32_t
+bgp_announce_policy (struct bgp_info *ri,
+                     struct bgp_peer *peer,
+                     struct prefix *p,
+                     struct attr *attr,
+                     afi_t afi, safi_t safi,
+                     struct bgp_filter *filter,
+                     enum bgp_peer_type from_peer_type,
+                     enum bgp_peer_type to_peer_type,
+                     bool_t transparent,
+                     u_int8_t *flags_misc)
+{
+  struct bgp_rmap_info brmi;
+  struct attr dummy_attr;
+  struct bgp_info tmp_ri;
+  struct bgp *bgp;
+  u_int32_t baai;
+  u_int32_t bsai;
+  s_int32_t ret;
+
+  bsai = BGP_SAFI2BSAI (safi);
+  baai = BGP_AFI2BAAI (afi);
+  bgp = peer->bgp;
+
+  /* Output filter check. */
+  if (bgp_output_filter (peer, p, attr, afi, safi) == FILTER_DENY)
+    {
+      if (BGP_DEBUG (filter, FILTER))
+        zlog_info (&BLG, "%s-%s [RIB] Announce Check: %O "
+                   "is filtered",
+                   peer->host, BGP_PEER_DIR_STR (peer), p);
+      return 0;
+    }
+
+  /* If local-preference is not set. */
+  if ((to_peer_type == BGP_PEER_IBGP
+       || to_peer_type == BGP_PEER_CONFED)
+      && (! (attr->flag & ATTR_FLAG_BIT (BGP_ATTR_LOCAL_PREF))))
+    {
+      attr->flag |= ATTR_FLAG_BIT (BGP_ATTR_LOCAL_PREF);
+      attr->local_pref = bgp->default_local_pref;
+    }
+
+  /* Remove MED if its an EBGP peer - will get overwritten by route-maps */
+  if (to_peer_type == BGP_PEER_EBGP
+      && attr->flag & ATTR_FLAG_BIT (BGP_ATTR_MULTI_EXIT_DISC))
+    {
+      if (transparent == PAL_FALSE
+          && ri->peer != bgp->peer_self
+          && ! CHECK_FLAG (peer->af_flags [baai][bsai],
+                           PEER_FLAG_MED_UNCHANGED))
+        attr->flag &= ~(ATTR_FLAG_BIT (BGP_ATTR_MULTI_EXIT_DISC));
+    }
+
+  /* If this is EBGP peer and remove-private-AS is set.  */
+#ifdef HAVE_EXT_CAP_ASN
+     if (CHECK_FLAG (BGP_VR.bvr_options, BGP_OPT_EXTENDED_ASN_CAP))
+       { 
+         if (to_peer_type == BGP_PEER_EBGP
+             && peer_af_flag_check (peer, afi, safi, PEER_FLAG_REMOVE_PRIVATE_AS)
+             && as4path_private_as_check (attr->aspath4B))
+         attr->aspath4B = aspath4B_empty_get ();
+       }
+     /* Local Speaker is OBGP */
+     else
+       {
+#endif /* HAVE_EXT_CAP_ASN */
+         if (to_peer_type == BGP_PEER_EBGP
+             && peer_af_flag_check (peer, afi, safi, PEER_FLAG_REMOVE_PRIVATE_AS)
+             && aspath_private_as_check (attr->aspath))
+         attr->aspath = aspath_empty_get ();
+#ifdef HAVE_EXT_CAP_ASN
+       }        
+#endif /* HAVE_EXT_CAP_ASN */
+
+  /* Route map apply. */
+  if (ROUTE_MAP_OUT_NAME (filter)
+      || ri->suppress)
+    {
+      pal_mem_set (&tmp_ri, 0, sizeof (struct bgp_info));
+      tmp_ri.peer = peer;
+      tmp_ri.attr = attr;
+
+      /* If Route-reflector, do not modify attributes of reflected routes */
+      if (from_peer_type == BGP_PEER_IBGP
+          && to_peer_type == BGP_PEER_IBGP)
+        {
+          dummy_attr = *attr;
+          tmp_ri.attr = &dummy_attr;
+        }
+
+      pal_mem_set (&brmi, 0, sizeof (struct bgp_rmap_info));
+      brmi.brmi_type = BGP_RMAP_INFO_REGULAR;
+      brmi.brmi_bgp = bgp;
+      brmi.brmi_bri = &tmp_ri;
+
+      if (ri->suppress)
+        ret = route_map_apply (UNSUPPRESS_MAP (filter), p, &brmi);
+      else
+        ret = route_map_apply (ROUTE_MAP_OUT (filter), p, &brmi);
+
+      if (ret == RMAP_DENYMATCH)
+        {
+          bgp_attr_flush (attr);
+          return 0;
+        }
+
+      *flags_misc = tmp_ri.flags_misc;
+    }
+
+  return 1;
+}
+
+void
+bgp_announce_cache_init (struct bgp_announce_cache *cache,
+                         struct bgp_info *ri)
+{
+  cache->ri = ri;
+  cache->count = 0;
+  cache->next = 0;
+}
+
+void
+bgp_announce_cache_finish (struct bgp_announce_cache *cache)
+{
+  u_int32_t i;
+
+  for (i = 0; i < cache->count; i++)
+    if (cache->entry [i].attr)
+      bgp_attr_unintern (cache->entry [i].attr);
+
+  cache->count = 0;
+  cache->next = 0;
+}
+
+/* Outbound policy through the peer-group cache.  On a miss the policy
+   is evaluated for PEER and the resulting attribute is interned so that
+   later members copy an attribute whose components are all interned
+   already.  */
+static s_int32_t
+bgp_announce_policy_shared (struct bgp_announce_cache *cache,
+                            struct bgp_info *ri,
+                            struct bgp_peer *peer,
+                            struct prefix *p,
+                            struct attr *attr,
+                            afi_t afi, safi_t safi,
+                            struct bgp_filter *filter,
+                            enum bgp_peer_type from_peer_type,
+                            enum bgp_peer_type to_peer_type,
+                            bool_t transparent,
+                            bool_t reflect,
+                            u_int8_t *flags_misc)
+{
+  struct bgp_announce_cache_entry *entry;
+  u_int32_t af_flags;
+  u_int32_t i;
+
+  if (cache->ri != ri)
+    {
+      bgp_announce_cache_finish (cache);
+      cache->ri = ri;
+    }
+
+  af_flags = peer->af_flags [BGP_AFI2BAAI (afi)][BGP_SAFI2BSAI (safi)]
+             & (PEER_FLAG_MED_UNCHANGED | PEER_FLAG_REMOVE_PRIVATE_AS);
+
+  for (i = 0; i < cache->count; i++)
+    {
+      entry = &cache->entry [i];
+
+      if (entry->group == peer->group
+          && entry->to_peer_type == to_peer_type
+          && entry->af_flags == af_flags
+          && entry->transparent == transparent
+          && entry->reflect == reflect)
+        {
+          if (entry->per_peer)
+            return bgp_announce_policy (ri, peer, p, attr, afi, safi,
+                                        filter, from_peer_type, to_peer_type,
+                                        transparent, flags_misc);
+
+          if (! entry->attr)
+            return 0;
+
+          *attr = *entry->attr;
+          *flags_misc = entry->flags_misc;
+          return 1;
+        }
+    }
+
+  /* Miss.  Take a free slot or recycle the oldest one.  */
+  if (cache->count < BGP_ANNOUNCE_CACHE_SIZE)
+    entry = &cache->entry [cache->count++];
+  else
+    {
+      entry = &cache->entry [cache->next];
+      cache->next = (cache->next + 1) % BGP_ANNOUNCE_CACHE_SIZE;
+      if (entry->attr)
+        bgp_attr_unintern (entry->attr);
+    }
+
+  entry->group = peer->group;
+  entry->to_peer_type = to_peer_type;
+  entry->af_flags = af_flags;
+  entry->transparent = transparent;
+  entry->reflect = reflect;
+  entry->per_peer = PAL_FALSE;
+  entry->attr = NULL;
+  entry->flags_misc = 0;
+
+  if (ri->suppress)
+    entry->per_peer = bgp_route_map_peer_dependent (UNSUPPRESS_MAP (filter));
+  else
+    entry->per_peer = bgp_route_map_peer_dependent (ROUTE_MAP_OUT (filter));
+
+  if (! bgp_announce_policy (ri, peer, p, attr, afi, safi, filter,
+                             from_peer_type, to_peer_type, transparent,
+                             flags_misc))
+    return 0;
+
+  if (! entry->per_peer)
+    {
+      entry->attr = bgp_attr_intern (attr);
+      entry->flags_misc = *flags_misc;
+    }
+
+  return 1;
+}
+
 s_int32_t
-bgp_announce_check (struct bgp_info *ri,
-                    struct bgp_peer *peer,
-                    struct prefix *p,
-                    struct attr *attr,
-                    afi_t afi, safi_t safi)
+bgp_announce_check_shared (struct bgp_info *ri,
+                           struct bgp_peer *peer,
+                           struct prefix *p,
+                           struct attr *attr,
+                           afi_t afi, safi_t safi,
+                           struct bgp_announce_cache *cache)
 {
   enum bgp_peer_type from_peer_type;
   enum bgp_peer_type to_peer_type;
-  struct bgp_rmap_info brmi;
   struct bgp_filter *filter;
-  struct attr dummy_attr;
-  struct bgp_info tmp_ri;
   struct bgp_peer *from;
+  u_int8_t flags_misc;
   bool_t transparent;
   struct bgp *bgp;
   u_int32_t baai;
   u_int32_t bsai;
   bool_t reflect;
-  s_int32_t ret;
 
   bsai = BGP_SAFI2BSAI (safi);
   baai = BGP_AFI2BAAI (afi);
   transparent = PAL_FALSE;
   reflect = PAL_FALSE;
-  ret = 0;
-
-  pal_mem_set (&tmp_ri, 0, sizeof (struct bgp_info));
+  flags_misc = 0;
 
   if (peer->pbgp_node_inctx)
     filter = &peer->pbgp_node_inctx->filter[baai][bsai];
@@ -1733,16 +1900,6 @@ bgp_announce_check (struct bgp_info *ri,
         return 0;
     }
 
-  /* Output filter check. */
-  if (bgp_output_filter (peer, p, ri->attr, afi, safi) == FILTER_DENY)
-    {
-      if (BGP_DEBUG (filter, FILTER))
-        zlog_info (&BLG, "%s-%s [RIB] Announce Check: %O "
-                   "is filtered",
-                   peer->host, BGP_PEER_DIR_STR (peer), p);
-      return 0;
-    }
-
   /* If we're a CONFED we need to loop check the CONFED ID too */
   if (bgp_config_check (bgp, BGP_CFLAG_CONFEDERATION))
     {
@@ -1800,87 +1957,31 @@ bgp_announce_check (struct bgp_info *ri,
         }
       else
         {
-          /* A route from a Non-client peer. Reflect to all other
-             clients. */
-          if (! CHECK_FLAG (peer->af_flags [baai][bsai],
-                            PEER_FLAG_REFLECTOR_CLIENT))
-            return 0;
-        }
-    }
-
-  /* If local-preference is not set. */
-  if ((to_peer_type == BGP_PEER_IBGP
-       || to_peer_type == BGP_PEER_CONFED)
-      && (! (attr->flag & ATTR_FLAG_BIT (BGP_ATTR_LOCAL_PREF))))
-    {
-      attr->flag |= ATTR_FLAG_BIT (BGP_ATTR_LOCAL_PREF);
-      attr->local_pref = bgp->default_local_pref;
-    }
-
-  /* Remove MED if its an EBGP peer - will get overwritten by route-maps */
-  if (to_peer_type == BGP_PEER_EBGP
-      && attr->flag & ATTR_FLAG_BIT (BGP_ATTR_MULTI_EXIT_DISC))
-    {
-      if (transparent == PAL_FALSE
-          && ri->peer != bgp->peer_self
-          && ! CHECK_FLAG (peer->af_flags [baai][bsai],
-                           PEER_FLAG_MED_UNCHANGED))
-        attr->flag &= ~(ATTR_FLAG_BIT (BGP_ATTR_MULTI_EXIT_DISC));
-    }
-
-  /* If this is EBGP peer and remove-private-AS is set.  */
-#ifdef HAVE_EXT_CAP_ASN
-     if (CHECK_FLAG (BGP_VR.bvr_options, BGP_OPT_EXTENDED_ASN_CAP))
-       { 
-         if (to_peer_type == BGP_PEER_EBGP
-             && peer_af_flag_check (peer, afi, safi, PEER_FLAG_REMOVE_PRIVATE_AS)
-             && as4path_private_as_check (attr->aspath4B))
-         attr->aspath4B = aspath4B_empty_get ();
-       }
-     /* Local Speaker is OBGP */
-     else
-       {
-#endif /* HAVE_EXT_CAP_ASN */
-         if (to_peer_type == BGP_PEER_EBGP
-             && peer_af_flag_check (peer, afi, safi, PEER_FLAG_REMOVE_PRIVATE_AS)
-             && aspath_private_as_check (attr->aspath))
-         attr->aspath = aspath_empty_get ();
-#ifdef HAVE_EXT_CAP_ASN
-       }        
-#endif /* HAVE_EXT_CAP_ASN */
-
-  /* Route map apply. */
-  if (ROUTE_MAP_OUT_NAME (filter)
-      || ri->suppress)
-    {
-      tmp_ri.peer = peer;
-      tmp_ri.attr = attr;
-
-      /* If Route-reflector, do not modify attributes of reflected routes */
-      if (from_peer_type == BGP_PEER_IBGP
-          && to_peer_type == BGP_PEER_IBGP)
-        {
-          dummy_attr = *attr;
-          tmp_ri.attr = &dummy_attr;
-        }
-
-      pal_mem_set (&brmi, 0, sizeof (struct bgp_rmap_info));
-      brmi.brmi_type = BGP_RMAP_INFO_REGULAR;
-      brmi.brmi_bgp = bgp;
-      brmi.brmi_bri = &tmp_ri;
-
-      if (ri->suppress)
-        ret = route_map_apply (UNSUPPRESS_MAP (filter), p, &brmi);
-      else
-        ret = route_map_apply (ROUTE_MAP_OUT (filter), p, &brmi);
-
-      if (ret == RMAP_DENYMATCH)
-        {
-          bgp_attr_flush (attr);
-          return 0;
+          /* A route from a Non-client peer. Reflect to all other
+             clients. */
+          if (! CHECK_FLAG (peer->af_flags [baai][bsai],
+                            PEER_FLAG_REFLECTOR_CLIENT))
+            return 0;
         }
     }
 
+  /* Outbound policy.  Peer-group members share one evaluation.  */
+  if (cache
+      && peer->group
+      && peer->af_group [baai][bsai]
+      && ! peer->pbgp_node_inctx)
+    {
+      if (! bgp_announce_policy_shared (cache, ri, peer, p, attr, afi, safi,
+                                        filter, from_peer_type,
+                                        to_peer_type, transparent, reflect,
+                                        &flags_misc))
+        return 0;
+    }
+  else if (! bgp_announce_policy (ri, peer, p, attr, afi, safi, filter,
+                                  from_peer_type, to_peer_type,
+                                  transparent, &flags_misc))
+    return 0;
+
   /* NextHop Attribute setting */
 #ifdef HAVE_IPV6
   /* By default, do not transit Link-local address */
@@ -1916,10 +2017,9 @@ bgp_announce_check (struct bgp_info *ri,
                && (peer->ttl > BGP_PEER_TTL_EBGP_DEF)))
     {
       /* Set IPv4 nexthop. */
-      if (!CHECK_FLAG (tmp_ri.flags_misc, BGP_INFO_RMAP_NEXTHOP_APPLIED))
+      if (! CHECK_FLAG (flags_misc, BGP_INFO_RMAP_NEXTHOP_APPLIED))
         IPV4_ADDR_COPY (&attr->nexthop, &peer->nexthop.v4);
 
-      UNSET_FLAG (tmp_ri.flags_misc, BGP_INFO_RMAP_NEXTHOP_APPLIED);
 #ifdef HAVE_IPV6
       /* Set IPv6 nexthop. */
       if (BGP_CAP_HAVE_IPV6
@@ -2029,11 +2129,22 @@ bgp_announce_check (struct bgp_info *ri,
   return 1;
 }
 
-/* Process changed routing entry */
-void
-bgp_process (struct bgp *bgp, struct bgp_node *rn,
-             afi_t afi, safi_t safi, struct bgp_info *del)
+s_int32_t
+bgp_announce_check (struct bgp_info *ri,
+                    struct bgp_peer *peer,
+                    struct prefix *p,
+                    struct attr *attr,
+                    afi_t afi, safi_t safi)
+{
+  return bgp_announce_check_shared (ri, peer, p, attr, afi, safi, NULL);
+}
+
+/* Best-path selection for a changed routing entry */
+static void
+bgp_process_select (struct bgp *bgp, struct bgp_node *rn,
+                    afi_t afi, safi_t safi, struct bgp_info *del)
 {
+  struct bgp_announce_cache announce_cache;
   enum bgp_peer_type peer_type;
   struct bgp_info *new_select;
   struct bgp_info *old_select;
@@ -2269,6 +2380,8 @@ bgp_process (struct bgp *bgp, struct bgp_node *rn,
     }
 
   /* Announcement to all BGP peers included in this BGP instance. */
+  bgp_announce_cache_init (&announce_cache, new_select);
+
   LIST_LOOP (bgp->peer_list, peer, nn)
     {
       /* Announce route to Established peer. */
@@ -2303,12 +2416,15 @@ bgp_process (struct bgp *bgp, struct bgp_node *rn,
 
       /* Announcement/Withdrawal to the peer */
       if (new_select
-          && bgp_announce_check (new_select, peer, p, &attr, afi, safi))
+          && bgp_announce_check_shared (new_select, peer, p, &attr,
+                                        afi, safi, &announce_cache))
         bgp_adj_out_set (rn, peer, &attr, afi, safi, new_select);
       else
         bgp_adj_out_unset (rn, peer, del, afi, safi);
     }
 
+  bgp_announce_cache_finish (&announce_cache);
+
   /* Resetting the peer to NULL. */
   peer = NULL;
 
@@ -2342,6 +2458,20 @@ bgp_process (struct bgp *bgp, struct bgp_node *rn,
   return;
 }
 
+/* Process changed routing entry */
+void
+bgp_process (struct bgp *bgp, struct bgp_node *rn,
+             afi_t afi, safi_t safi, struct bgp_info *del)
+{
+  u_int64_t start;
+
+  start = BGP_PERF_BEGIN ();
+
+  bgp_process_select (bgp, rn, afi, safi, del);
+
+  bgp_perf_record (bgp_perf_peer, BGP_PERF_PROCESS, start);
+}
+
 bool_t
 bgp_peer_max_prefix_overflow (struct bgp_peer *peer,
                               afi_t afi, safi_t safi)
@@ -2435,60 +2565,33 @@ bgp_rib_withdraw (struct bgp_peer *peer, struct bgp_node *rn,
   return;
 }
 
-/* BGP RIB Update (Advertised) NLRI Processing */
-s_int32_t
-bgp_update_route (struct bgp_peer *peer,
-                  struct prefix *p,
-                  struct attr *attr,
-                  afi_t afi, safi_t safi,
-                  u_int32_t type, u_int32_t sub_type,
-                  struct bgp_rd_node *prn,
-                  u_int32_t soft_reconfig,
-                  bool_t pcount)
+/* Inbound policy for a route received from PEER: AS loop, originator
+   and cluster checks, input filters and route-map, nexthop validation
+   and distance.  NEW_ATTR receives the resulting attribute.  The RIB
+   is not modified.  Return PAL_FALSE with REASON set when the route is
+   filtered; RET carries the distance application result.  */
+static bool_t
+bgp_update_route_policy (struct bgp_peer *peer,
+                         struct prefix *p,
+                         struct attr *attr,
+                         afi_t afi, safi_t safi,
+                         struct attr *new_attr,
+                         u_int8_t **reason,
+                         s_int32_t *ret)
 {
-  enum bgp_rfd_rt_state rt_state;
   enum bgp_peer_type peer_type;
-  struct bgp_info *ri_tmp;
-  struct attr *attr_new;
   struct interface *ifp;
-  struct attr new_attr;
-  struct bgp *bgp_mvrf;
-  struct bgp_node *rn;
-  struct bgp_info *ri;
   struct prefix pnhop;
-  u_int8_t *reason;
-  struct bgp *bgp = NULL;
+  struct bgp *bgp;
   u_int32_t baai;
   u_int32_t bsai;
-  s_int32_t ret;
-  struct prefix rnp;
 
   bsai = BGP_SAFI2BSAI (safi);
   baai = BGP_AFI2BAAI (afi);
-  ret = 0;
-
   peer_type = peer_sort (peer);
+  bgp = peer->bgp;
+  *ret = 0;
 
-   bgp = peer->bgp;
-   bgp_mvrf = bgp;
-
-  rn = bgp_afi_node_get (bgp, afi, safi, p, prn);
-  if (rn == NULL)
-    goto EXIT;
-
-  /* Record attributes for inbound soft-reconfiguration */
-  if (CHECK_FLAG (peer->af_flags [baai][bsai],
-                  PEER_FLAG_SOFT_RECONFIG)
-      && ! soft_reconfig)
-    bgp_adj_in_set (rn, peer, attr);
-
-  /* Check previously received route */
-  for (ri = rn->info; ri; ri = ri->next)
-    if (ri->peer == peer
-        && ri->type == type
-        && ri->sub_type == sub_type)
-      break; 
-    
   /* Aspath loop check. */
 #ifdef HAVE_EXT_CAP_ASN
    if (CHECK_FLAG (BGP_VR.bvr_options, BGP_OPT_EXTENDED_ASN_CAP))
@@ -2502,8 +2605,8 @@ bgp_update_route (struct bgp_peer *peer,
 #endif /* BGP_STRICT_RFC3065 */
       )
          {
-            reason = "as-path contains our own AS";
-            goto FILTERED;
+            *reason = "as-path contains our own AS";
+            return PAL_FALSE;
          }
      }
    else
@@ -2519,8 +2622,8 @@ bgp_update_route (struct bgp_peer *peer,
 #endif /* BGP_STRICT_RFC3065 */
       )
     {
-      reason = "as-path contains our own AS";
-      goto FILTERED;
+      *reason = "as-path contains our own AS";
+      return PAL_FALSE;
     }
 #ifdef HAVE_EXT_CAP_ASN
      }
@@ -2530,32 +2633,32 @@ bgp_update_route (struct bgp_peer *peer,
   if (attr->flag & ATTR_FLAG_BIT (BGP_ATTR_ORIGINATOR_ID)
       && IPV4_ADDR_SAME (&bgp->router_id, &attr->originator_id))
     {
-      reason = "originator is us";
-      goto FILTERED;
+      *reason = "originator is us";
+      return PAL_FALSE;
     }
 
   /* Route reflector cluster ID check. */
   if (bgp_cluster_filter (peer, attr))
     {
-      reason = "reflected from the same cluster";
-      goto  FILTERED;
+      *reason = "reflected from the same cluster";
+      return PAL_FALSE;
     }
 
   /* Apply input filter and route-map.  Filter and route-map
      application logging is also done in the function. */
   if (bgp_input_filter (peer, p, attr, afi, safi) == FILTER_DENY)
     {
-      reason = "filter";
-      goto FILTERED;
+      *reason = "filter";
+      return PAL_FALSE;
     }
 
   /* Apply input route-map. */
-  new_attr = *attr;
+  *new_attr = *attr;
 
-  if (bgp_input_modifier (peer, p, &new_attr, afi, safi) == RMAP_DENY)
+  if (bgp_input_modifier (peer, p, new_attr, afi, safi) == RMAP_DENY)
     {
-      reason = "route-map";
-      goto FILTERED;
+      *reason = "route-map";
+      return PAL_FALSE;
     }
 
   /* Prepare a prefix structure for NHop */
@@ -2589,8 +2692,8 @@ bgp_update_route (struct bgp_peer *peer,
 			      &pnhop);
   if (ifp)
     {
-      reason = "Nexthop matched local interface address";
-      goto FILTERED;
+      *reason = "Nexthop matched local interface address";
+      return PAL_FALSE;
     }
 
   /* NextHop must be Connected Addr for EBGP-single-hop Peer */
@@ -2599,26 +2702,66 @@ bgp_update_route (struct bgp_peer *peer,
       && peer->ttl == BGP_PEER_TTL_EBGP_DEF
       && ! CHECK_FLAG (peer->flags, PEER_FLAG_ENFORCE_MULTIHOP))
     {
-      reason = "non-connected next-hop;";
-      goto FILTERED;
+      *reason = "non-connected next-hop;";
+      return PAL_FALSE;
     }
 
   /* Compute the new distance value */
-  ret = bgp_distance_apply (peer, p, &new_attr, afi, safi);
+  *ret = bgp_distance_apply (peer, p, new_attr, afi, safi);
 
-  if (ret < 0)
+  if (*ret < 0)
     {
-      reason = "distance apply failed";
-      goto FILTERED;
+      *reason = "distance apply failed";
+      return PAL_FALSE;
     }
 
+  return PAL_TRUE;
+}
+
+/* Install the outcome of bgp_update_route_policy () for P.  RN is
+   locked by the caller.  ATTR_NEW is the interned accepted attribute,
+   or NULL when the route was filtered for REASON.  */
+static void
+bgp_update_route_apply (struct bgp_peer *peer,
+                        struct bgp_node *rn,
+                        struct prefix *p,
+                        struct attr *attr_new,
+                        u_int8_t *reason,
+                        afi_t afi, safi_t safi,
+                        u_int32_t type, u_int32_t sub_type,
+                        bool_t pcount)
+{
+  enum bgp_rfd_rt_state rt_state;
+  enum bgp_peer_type peer_type;
+  struct bgp_info *ri_tmp;
+  struct bgp *bgp_mvrf;
+  struct bgp_info *ri;
+  struct bgp *bgp;
+  u_int32_t baai;
+  u_int32_t bsai;
+  struct prefix rnp;
+
+  bsai = BGP_SAFI2BSAI (safi);
+  baai = BGP_AFI2BAAI (afi);
+  peer_type = peer_sort (peer);
+  bgp = peer->bgp;
+  bgp_mvrf = bgp;
+
+  /* Check previously received route */
+  for (ri = rn->info; ri; ri = ri->next)
+    if (ri->peer == peer
+        && ri->type == type
+        && ri->sub_type == sub_type)
+      break;
+
+  if (! attr_new)
+    goto FILTERED;
+
   /* Received Logging. */
   if (BGP_DEBUG (update, UPDATE_IN))
     zlog_info (&BLG, "%s-%s [RIB] Update: Received Prefix %O",
                peer->host, BGP_PEER_DIR_STR (peer), p);
 
-  attr_new = bgp_attr_intern (&new_attr);
-
   /* If the update is implicit withdraw. */
   if (ri)
     {
@@ -2758,8 +2901,55 @@ FILTERED:
   bgp_unlock_node (rn);
 
 EXIT:
+  return;
+}
+
+/* BGP RIB Update (Advertised) NLRI Processing */
+s_int32_t
+bgp_update_route (struct bgp_peer *peer,
+                  struct prefix *p,
+                  struct attr *attr,
+                  afi_t afi, safi_t safi,
+                  u_int32_t type, u_int32_t sub_type,
+                  struct bgp_rd_node *prn,
+                  u_int32_t soft_reconfig,
+                  bool_t pcount)
+{
+  struct attr *attr_new;
+  struct attr new_attr;
+  struct bgp_node *rn;
+  u_int8_t *reason;
+  struct bgp *bgp;
+  u_int32_t baai;
+  u_int32_t bsai;
+  s_int32_t ret;
+
+  bsai = BGP_SAFI2BSAI (safi);
+  baai = BGP_AFI2BAAI (afi);
+  bgp = peer->bgp;
+  reason = NULL;
+  ret = 0;
+
+  rn = bgp_afi_node_get (bgp, afi, safi, p, prn);
+  if (rn == NULL)
+    return ret;
+
+  /* Record attributes for inbound soft-reconfiguration */
+  if (CHECK_FLAG (peer->af_flags [baai][bsai],
+                  PEER_FLAG_SOFT_RECONFIG)
+      && ! soft_reconfig)
+    bgp_adj_in_set (rn, peer, attr);
+
+  if (bgp_update_route_policy (peer, p, attr, afi, safi, &new_attr,
+                               &reason, &ret))
+    attr_new = bgp_attr_intern (&new_attr);
+  else
+    attr_new = NULL;
+
+  bgp_update_route_apply (peer, rn, p, attr_new, reason, afi, safi,
+                          type, sub_type, pcount);
+
   return ret;
-  
 }
 
 s_int32_t
@@ -3423,11 +3613,175 @@ EXIT:
   return;
 }
 
+/* Inbound soft-reconfiguration job.  The peer's Adj-RIB-In is walked
+   in slices of BGP_SOFT_RECONFIG_BATCH entries from the low priority
+   event queue.  Each slice first evaluates inbound policy for the batch
+   without touching the RIB, then applies the results.  */
+#define BGP_SOFT_RECONFIG_BATCH 256
+
+struct bgp_soft_reconfig_entry
+{
+  /* Locked RIB node.  */
+  struct bgp_node *rn;
+
+  /* Policy result, valid when accepted is set.  */
+  struct attr attr;
+  bool_t accepted;
+
+  u_int8_t *reason;
+  s_int32_t ret;
+};
+
+struct bgp_soft_reconfig
+{
+  struct bgp_peer *peer;
+  afi_t afi;
+  safi_t safi;
+
+  /* Next node to evaluate, locked.  */
+  struct bgp_node *rn;
+
+  struct thread *t_slice;
+
+  u_int32_t count;
+  struct bgp_soft_reconfig_entry batch [BGP_SOFT_RECONFIG_BATCH];
+};
+
+/* Inbound Soft Reconfiguration, evaluate stage.  Run inbound policy
+   over the next batch of the peer's Adj-RIB-In entries.  The RIB is
+   left untouched; every recorded node is locked for the apply stage.  */
+static void
+bgp_soft_reconfig_eval (struct bgp_soft_reconfig *job)
+{
+  struct bgp_soft_reconfig_entry *entry;
+  struct bgp_adj_in *bai;
+  struct prefix rnp;
+
+  job->count = 0;
+
+  while (job->rn && job->count < BGP_SOFT_RECONFIG_BATCH)
+    {
+      for (bai = job->rn->adj_in; bai; bai = bai->next)
+        if (bai->peer == job->peer)
+          {
+            BGP_GET_PREFIX_FROM_NODE (job->rn);
+
+            entry = &job->batch [job->count++];
+            entry->rn = bgp_lock_node (job->rn);
+            entry->reason = NULL;
+            entry->accepted = bgp_update_route_policy (job->peer, &rnp,
+                                                       bai->attr,
+                                                       job->afi, job->safi,
+                                                       &entry->attr,
+                                                       &entry->reason,
+                                                       &entry->ret);
+            break;
+          }
+
+      job->rn = bgp_route_next (job->rn);
+    }
+}
+
+/* Inbound Soft Reconfiguration, apply stage.  Intern the results of
+   the evaluate stage and run best-path selection.  Return PAL_FALSE if
+   the job has to be aborted.  */
+static bool_t
+bgp_soft_reconfig_apply (struct bgp_soft_reconfig *job)
+{
+  struct bgp_soft_reconfig_entry *entry;
+  struct attr *attr_new;
+  bool_t cont;
+  struct prefix rnp;
+  u_int32_t i;
+
+  cont = PAL_TRUE;
+
+  for (i = 0; i < job->count; i++)
+    {
+      entry = &job->batch [i];
+
+      /* Release what is left once the job is aborted.  */
+      if (cont == PAL_FALSE)
+        {
+          if (entry->accepted)
+            bgp_attr_flush (&entry->attr);
+          bgp_unlock_node (entry->rn);
+          continue;
+        }
+
+      BGP_GET_PREFIX_FROM_NODE (entry->rn);
+
+      attr_new = entry->accepted ? bgp_attr_intern (&entry->attr) : NULL;
+
+      bgp_update_route_apply (job->peer, entry->rn, &rnp, attr_new,
+                              entry->reason, job->afi, job->safi,
+                              IPI_ROUTE_BGP, BGP_ROUTE_NORMAL, PAL_TRUE);
+
+      if (entry->ret < 0)
+        cont = PAL_FALSE;
+    }
+
+  job->count = 0;
+
+  return cont;
+}
+
+static void
+bgp_soft_reconfig_free (struct bgp_soft_reconfig *job)
+{
+  job->peer->soft_reconfig [BGP_AFI2BAAI (job->afi)]
+                           [BGP_SAFI2BSAI (job->safi)] = NULL;
+
+  if (job->rn)
+    bgp_unlock_node (job->rn);
+
+  XFREE (MTYPE_BGP_SOFT_RECONFIG, job);
+}
+
+static s_int32_t
+bgp_soft_reconfig_slice (struct thread *t)
+{
+  struct bgp_soft_reconfig *job;
+
+  job = THREAD_ARG (t);
+  job->t_slice = NULL;
+
+  bgp_soft_reconfig_eval (job);
+
+  if (! bgp_soft_reconfig_apply (job) || ! job->rn)
+    {
+      bgp_soft_reconfig_free (job);
+      return 0;
+    }
+
+  job->t_slice = thread_add_event_low (&BLG, bgp_soft_reconfig_slice,
+                                       job, 0);
+  return 0;
+}
+
+/* Stop an inbound soft-reconfiguration job in progress */
+void
+bgp_soft_reconfig_in_cancel (struct bgp_peer *peer,
+                             afi_t afi, safi_t safi)
+{
+  struct bgp_soft_reconfig *job;
+
+  job = peer->soft_reconfig [BGP_AFI2BAAI (afi)][BGP_SAFI2BSAI (safi)];
+  if (! job)
+    return;
+
+  if (job->t_slice)
+    thread_cancel (job->t_slice);
+
+  bgp_soft_reconfig_free (job);
+}
+
 /* Inbound Soft Reconfiguration */
 void
 bgp_soft_reconfig_in (struct bgp_peer *peer,
                       afi_t afi, safi_t safi)
 {
+  struct bgp_soft_reconfig *job;
   struct bgp_adj_in *bai;
   struct bgp_node *rn;
   struct bgp *bgp;
@@ -3435,31 +3789,54 @@ bgp_soft_reconfig_in (struct bgp_peer *peer,
   struct prefix rnp;
 
   bgp = peer->bgp;
-  if (! bgp)
+  if (! bgp || ! bgp->rib [BGP_AFI2BAAI (afi)][BGP_SAFI2BSAI (safi)])
     return;
 
-  for (rn = bgp_table_top (bgp->rib [BGP_AFI2BAAI (afi)]
-                                    [BGP_SAFI2BSAI (safi)]);
-       rn; rn = bgp_route_next (rn))
-    for (bai = rn->adj_in; bai; bai = bai->next)
-      if (bai->peer == peer)
-        {
-	  BGP_GET_PREFIX_FROM_NODE (rn);
-          ret = bgp_update (peer, &rnp, bai->attr, afi, safi,
-                            IPI_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, 1);
+  /* Restart a job already in progress from the top.  */
+  bgp_soft_reconfig_in_cancel (peer, afi, safi);
 
-          /* Address family configuration mismatch or maximum-prefix count
-             overflow. */
-          if (ret < 0)
+  /* Routes shared by several instances are re-run in one go.  */
+  if (bgp_option_check (BGP_OPT_MULTI_INS_ALLOW_SAME_PEER))
+    {
+      for (rn = bgp_table_top (bgp->rib [BGP_AFI2BAAI (afi)]
+                                        [BGP_SAFI2BSAI (safi)]);
+           rn; rn = bgp_route_next (rn))
+        for (bai = rn->adj_in; bai; bai = bai->next)
+          if (bai->peer == peer)
             {
-              bgp_unlock_node (rn);
-              return;
+              BGP_GET_PREFIX_FROM_NODE (rn);
+              ret = bgp_update (peer, &rnp, bai->attr, afi, safi,
+                                IPI_ROUTE_BGP, BGP_ROUTE_NORMAL, NULL, 1);
+
+              /* Address family configuration mismatch or maximum-prefix
+                 count overflow. */
+              if (ret < 0)
+                {
+                  bgp_unlock_node (rn);
+                  return;
+                }
             }
-        }
 
+      return;
+    }
+
+  job = XCALLOC (MTYPE_BGP_SOFT_RECONFIG, sizeof (struct bgp_soft_reconfig));
+  if (! job)
+    return;
+
+  job->peer = peer;
+  job->afi = afi;
+  job->safi = safi;
+  job->rn = bgp_table_top (bgp->rib [BGP_AFI2BAAI (afi)]
+                                    [BGP_SAFI2BSAI (safi)]);
+
+  peer->soft_reconfig [BGP_AFI2BAAI (afi)][BGP_SAFI2BSAI (safi)] = job;
+
+  job->t_slice = thread_add_event_low (&BLG, bgp_soft_reconfig_slice,
+                                       job, 0);
   return;
 }
-
+
 /* BGP Peer Route-Table Announcement */
 void
 bgp_peer_initial_announce (struct bgp_peer *peer)
@@ -3772,6 +4149,8 @@ bgp_clear_route (struct bgp_peer *peer, afi_t afi, safi_t safi)
 {
  struct list *list  = NULL;
 
+ bgp_soft_reconfig_in_cancel (peer, afi, safi);
+
  if (!bgp_option_check (BGP_OPT_MULTI_INS_ALLOW_SAME_PEER))
     bgp_clear_all_routes (peer, afi, safi, list);
  else 
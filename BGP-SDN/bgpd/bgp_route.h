@@ -73,6 +73,38 @@ struct bgp_distance
 #define UNSUPPRESS_MAP_NAME(F)  ((F)->usmap.name)
 #define UNSUPPRESS_MAP(F)       ((F)->usmap.map)
 
+/* Outbound policy results for one route, shared by the members of a
+   peer-group while bgp_process () walks the peer list.  Members of a
+   peer-group cannot override outbound filters, so only the few
+   attributes that can still differ between members form the key.
+   Per-peer checks (split horizon, ORF, reflection, nexthop) are still
+   done for every member.  */
+#define BGP_ANNOUNCE_CACHE_SIZE 8
+
+struct bgp_announce_cache_entry
+{
+  struct bgp_peer_group *group;
+  enum bgp_peer_type to_peer_type;
+  u_int32_t af_flags;
+  bool_t transparent;
+  bool_t reflect;
+
+  /* Outbound route-map refers to the peer, evaluate per member.  */
+  bool_t per_peer;
+
+  /* Interned result, NULL when the route is denied.  */
+  struct attr *attr;
+  u_int8_t flags_misc;
+};
+
+struct bgp_announce_cache
+{
+  struct bgp_info *ri;
+  u_int32_t count;
+  u_int32_t next;
+  struct bgp_announce_cache_entry entry [BGP_ANNOUNCE_CACHE_SIZE];
+};
+
 
 
 /*
@@ -113,6 +145,14 @@ s_int32_t
 bgp_announce_check (struct bgp_info *, struct bgp_peer *,
                     struct prefix *, struct attr *,
                     afi_t, safi_t);
+s_int32_t
+bgp_announce_check_shared (struct bgp_info *, struct bgp_peer *,
+                           struct prefix *, struct attr *,
+                           afi_t, safi_t, struct bgp_announce_cache *);
+void
+bgp_announce_cache_init (struct bgp_announce_cache *, struct bgp_info *);
+void
+bgp_announce_cache_finish (struct bgp_announce_cache *);
 
 void
 bgp_process (struct bgp *, struct bgp_node *,
@@ -154,6 +194,8 @@ bgp_peer_process_nlri (struct bgp_peer *,
 
 void
 bgp_soft_reconfig_in (struct bgp_peer *, afi_t, safi_t);
+void
+bgp_soft_reconfig_in_cancel (struct bgp_peer *, afi_t, safi_t);
 
 void
 bgp_peer_initial_announce (struct bgp_peer *);
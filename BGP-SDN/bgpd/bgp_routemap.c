@@ -2647,6 +2647,40 @@ brm_route_map_event (struct ipi_vr *vr, route_map_event_t event,
      } /* LIST_LOOP */
 }
 
+/* Return PAL_TRUE when MAP has a rule whose result depends on the
+   peer the route is evaluated for (`match/set ip peer').  The outcome
+   of such a route-map cannot be shared between peer-group members.  */
+bool_t
+bgp_route_map_peer_dependent (struct route_map *map)
+{
+  struct route_map_index *index;
+  struct route_map_rule *rule;
+
+  if (! map)
+    return PAL_FALSE;
+
+  for (index = map->head; index; index = index->next)
+    {
+      for (rule = index->match_list.head; rule; rule = rule->next)
+        if (rule->cmd == &brm_match_ip_peer_cmd
+#ifdef HAVE_IPV6
+            || rule->cmd == &brm_match_ipv6_peer_cmd
+#endif /* HAVE_IPV6 */
+            )
+          return PAL_TRUE;
+
+      for (rule = index->set_list.head; rule; rule = rule->next)
+        if (rule->cmd == &brm_set_ip_peer_cmd
+#ifdef HAVE_IPV6
+            || rule->cmd == &brm_set_ipv6_peer_cmd
+#endif /* HAVE_IPV6 */
+            )
+          return PAL_TRUE;
+    }
+
+  return PAL_FALSE;
+}
+
 
 s_int32_t
 bgp_route_map_init (struct ipi_vr *ivr)
@@ -533,7 +533,9 @@ bgp_show_callback (struct cli *cli)
   struct bgp_info *ri;
   int header = 0;
   int count = 0;
+  int visited = 0;
   int displayed;
+  u_int64_t start;
   void *val;
   struct prefix rnp;
 
@@ -546,10 +548,13 @@ bgp_show_callback (struct cli *cli)
 
   /* This is first time.  */
   if (cli->status == CLI_NORMAL)
-    {
-      header = 1;
-      cli->count = 0;
-    }
+    cli->count = 0;
+
+  /* Earlier slices may not have displayed anything yet.  */
+  if (cli->count == 0)
+    header = 1;
+
+  start = pal_time_mono_nsec ();
 
   /* Look up argument.  Between callback access-list, community-list
      and route-map may be changed.  So we just keep the value in
@@ -559,6 +564,22 @@ bgp_show_callback (struct cli *cli)
   /* Walk BGP table.  */
   for (; rn; rn = bgp_route_next (rn))
    {
+      /* Bound the work of this slice so that a long or heavily
+         filtered walk cannot hold off keepalives and hold timers.
+         The locked node is kept as the resume point; vty_flush()
+         calls back only once the output is written to the socket.  */
+      if (count >= BGP_SHOW_SLICE_PREFIXES
+          || visited >= BGP_SHOW_SLICE_NODES
+          || (visited && ! (visited & BGP_SHOW_SLICE_CLOCK_MASK)
+              && pal_time_mono_nsec () - start >= BGP_SHOW_SLICE_NSEC))
+        {
+          cli->status = CLI_CONTINUE;
+          cli->current = rn;
+          cli->callback = bgp_show_callback;
+          return 0;
+        }
+      visited++;
+
       if (rn->info != NULL)
       {
         /* When more than two BGP routes exists for on prefix, only
@@ -669,15 +690,6 @@ bgp_show_callback (struct cli *cli)
             cli->count++;
             count++;
           }
-
-        /* Remember current pointer then suspend output. */
-        if (count >= 25)
-          {
-            cli->status = CLI_CONTINUE;
-            cli->current = bgp_route_next (rn);
-            cli->callback = bgp_show_callback;
-            return 0;
-          }
       } 
    } /* End of Wk BGP */
   /* Total count display. */
@@ -4825,6 +4837,161 @@ CLI (show_ip_bgp_community_info,
   return CLI_SUCCESS;
 }
 
+/* Policy evaluation statistics.  */
+static void
+bgp_pstats_show_one (struct cli *cli, char *type, char *name, s_int32_t seq,
+                     struct policy_stats *ps)
+{
+  char eval[LATHIST_U64_STR_LEN];
+  char match[LATHIST_U64_STR_LEN];
+  char total[LATHIST_U64_STR_LEN];
+  u_int32_t avg;
+  int i;
+
+  if (! ps->eval)
+    return;
+
+  avg = ps->sampled ? (u_int32_t) (ps->nsec / ps->sampled) : 0;
+
+  if (seq >= 0)
+    cli_out (cli, "%-10s %-20s %5d", type, name, seq);
+  else
+    cli_out (cli, "%-10s %-20s %5s", type, name, "");
+
+  cli_out (cli, " %12s %12s %9u %12s\n",
+           lathist_u64_str (ps->eval, eval),
+           lathist_u64_str (ps->match, match),
+           avg,
+           lathist_u64_str (PSTATS_EST_NSEC (ps) / 1000, total));
+
+  if (! ps->sampled)
+    return;
+
+  cli_out (cli, "%38s", "");
+  for (i = 0; i < PSTATS_HIST_MAX; i++)
+    if (ps->hist[i])
+      cli_out (cli, " %s:%u", pstats_hist_str (i), ps->hist[i]);
+  cli_out (cli, "\n");
+}
+
+static void
+bgp_pstats_show_plist (struct cli *cli, char *type,
+                       struct prefix_list_list *list)
+{
+  struct prefix_list *plist;
+
+  for (plist = list->head; plist; plist = plist->next)
+    bgp_pstats_show_one (cli, type, plist->name, -1, &plist->stats);
+}
+
+static void
+bgp_pstats_show_aslist (struct cli *cli, struct as_list_list *list)
+{
+  struct as_list *aslist;
+
+  for (aslist = list->head; aslist; aslist = aslist->next)
+    bgp_pstats_show_one (cli, "as-path", aslist->name, -1, &aslist->stats);
+}
+
+static void
+bgp_pstats_clear_plist (struct prefix_list_list *list)
+{
+  struct prefix_list *plist;
+
+  for (plist = list->head; plist; plist = plist->next)
+    pstats_reset (&plist->stats);
+}
+
+static void
+bgp_pstats_clear_aslist (struct as_list_list *list)
+{
+  struct as_list *aslist;
+
+  for (aslist = list->head; aslist; aslist = aslist->next)
+    pstats_reset (&aslist->stats);
+}
+
+CLI (show_ip_bgp_policy_stats,
+     show_ip_bgp_policy_stats_cli,
+     "show ip bgp policy-statistics",
+     CLI_SHOW_STR,
+     CLI_IP_STR,
+     CLI_BGP_STR,
+     "Policy evaluation statistics")
+{
+  struct ipi_vr *vr = BGP_VR.owning_ivr;
+  struct route_map *map;
+  struct route_map_index *index;
+
+  if (PSTATS_ENABLED ())
+    cli_out (cli, "Policy statistics are enabled, sampling 1 in %u"
+             " evaluations\n", pstats_sample_rate);
+  else
+    cli_out (cli, "Policy statistics are disabled\n");
+
+  cli_out (cli, "%-10s %-20s %5s %12s %12s %9s %12s\n",
+           "Type", "Name", "Seq", "Evaluations", "Matches",
+           "Avg(ns)", "Est.total(us)");
+
+  if (vr)
+    {
+      bgp_pstats_show_plist (cli, "prefix", &vr->prefix_master_ipv4.num);
+      bgp_pstats_show_plist (cli, "prefix", &vr->prefix_master_ipv4.str);
+#ifdef HAVE_IPV6
+      bgp_pstats_show_plist (cli, "prefix6", &vr->prefix_master_ipv6.num);
+      bgp_pstats_show_plist (cli, "prefix6", &vr->prefix_master_ipv6.str);
+#endif /* HAVE_IPV6 */
+
+      for (map = vr->route_map_master.head; map; map = map->next)
+        for (index = map->head; index; index = index->next)
+          bgp_pstats_show_one (cli, "route-map", map->name, index->pref,
+                               &index->stats);
+    }
+
+  if (bgp_aslist_master)
+    {
+      bgp_pstats_show_aslist (cli, &bgp_aslist_master->num);
+      bgp_pstats_show_aslist (cli, &bgp_aslist_master->str);
+    }
+
+  return CLI_SUCCESS;
+}
+
+CLI (clear_ip_bgp_policy_stats,
+     clear_ip_bgp_policy_stats_cli,
+     "clear ip bgp policy-statistics",
+     CLI_CLEAR_STR,
+     CLI_IP_STR,
+     CLI_BGP_STR,
+     "Policy evaluation statistics")
+{
+  struct ipi_vr *vr = BGP_VR.owning_ivr;
+  struct route_map *map;
+  struct route_map_index *index;
+
+  if (vr)
+    {
+      bgp_pstats_clear_plist (&vr->prefix_master_ipv4.num);
+      bgp_pstats_clear_plist (&vr->prefix_master_ipv4.str);
+#ifdef HAVE_IPV6
+      bgp_pstats_clear_plist (&vr->prefix_master_ipv6.num);
+      bgp_pstats_clear_plist (&vr->prefix_master_ipv6.str);
+#endif /* HAVE_IPV6 */
+
+      for (map = vr->route_map_master.head; map; map = map->next)
+        for (index = map->head; index; index = index->next)
+          pstats_reset (&index->stats);
+    }
+
+  if (bgp_aslist_master)
+    {
+      bgp_pstats_clear_aslist (&bgp_aslist_master->num);
+      bgp_pstats_clear_aslist (&bgp_aslist_master->str);
+    }
+
+  return CLI_SUCCESS;
+}
+
 static void
 attr_show_iterator (struct hash_backet *backet, struct cli *cli)
 {
@@ -6320,6 +6487,12 @@ bgp_show_init (void)
   cli_install_gen (BLG.ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
                    &show_ip_bgp_community_info_cli);
 
+  /* "show ip bgp policy-statistics" commands. */
+  cli_install_gen (BLG.ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
+                   &show_ip_bgp_policy_stats_cli);
+  cli_install_gen (BLG.ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
+                   &clear_ip_bgp_policy_stats_cli);
+
   /* "show ip bgp attribute-info" commands. */
   cli_install_gen (BLG.ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
                    &show_ip_bgp_attr_info_cli);
@@ -20,6 +20,7 @@ static u_char *bgpPeerTable ();
 static u_char *bgpRcvdPathAttrTable ();
 static u_char *bgpIdentifier ();
 static u_char *bgp4PathAttrTable ();
+static s_int32_t bgp4PathAttrBulk ();
 
 struct variable bgp_variables[] =
 {
@@ -96,33 +97,33 @@ struct variable bgp_variables[] =
    3, {5, 1, 6}},
   /* BGP-4 received path attribute table. */
   {BGP4PATHATTRPEER, IPADDRESS, RONLY, bgp4PathAttrTable,
-   3, {6, 1, 1}},
+   3, {6, 1, 1}, NULL, bgp4PathAttrBulk},
   {BGP4PATHATTRIPADDRPREFIXLEN, INTEGER32, RONLY, bgp4PathAttrTable,
-   3, {6, 1, 2}},
+   3, {6, 1, 2}, NULL, bgp4PathAttrBulk},
   {BGP4PATHATTRIPADDRPREFIX,  IPADDRESS, RONLY, bgp4PathAttrTable,
-   3, {6, 1, 3}},
+   3, {6, 1, 3}, NULL, bgp4PathAttrBulk},
   {BGP4PATHATTRORIGIN,        INTEGER32, RONLY, bgp4PathAttrTable,
-   3, {6, 1, 4}},
+   3, {6, 1, 4}, NULL, bgp4PathAttrBulk},
   {BGP4PATHATTRASPATHSEGMENT, OCTET_STRING, RONLY, bgp4PathAttrTable,
-   3, {6, 1, 5}},
+   3, {6, 1, 5}, NULL, bgp4PathAttrBulk},
   {BGP4PATHATTRNEXTHOP,       IPADDRESS, RONLY, bgp4PathAttrTable,
-   3, {6, 1, 6}},
+   3, {6, 1, 6}, NULL, bgp4PathAttrBulk},
   {BGP4PATHATTRMULTIEXITDISC, INTEGER32, RONLY, bgp4PathAttrTable,
-   3, {6, 1, 7}},
+   3, {6, 1, 7}, NULL, bgp4PathAttrBulk},
   {BGP4PATHATTRLOCALPREF,     INTEGER32, RONLY, bgp4PathAttrTable,
-   3, {6, 1, 8}},
+   3, {6, 1, 8}, NULL, bgp4PathAttrBulk},
   {BGP4PATHATTRATOMICAGGREGATE, INTEGER, RONLY, bgp4PathAttrTable,
-   3, {6, 1, 9}},
+   3, {6, 1, 9}, NULL, bgp4PathAttrBulk},
   {BGP4PATHATTRAGGREGATORAS,  INTEGER32, RONLY, bgp4PathAttrTable,
-   3, {6, 1, 10}},
+   3, {6, 1, 10}, NULL, bgp4PathAttrBulk},
   {BGP4PATHATTRAGGREGATORADDR, IPADDRESS, RONLY, bgp4PathAttrTable,
-   3, {6, 1, 11}},
+   3, {6, 1, 11}, NULL, bgp4PathAttrBulk},
   {BGP4PATHATTRCALCLOCALPREF, INTEGER32, RONLY, bgp4PathAttrTable,
-   3, {6, 1, 12}},
+   3, {6, 1, 12}, NULL, bgp4PathAttrBulk},
   {BGP4PATHATTRBEST,          INTEGER, RONLY, bgp4PathAttrTable,
-   3, {6, 1, 13}},
+   3, {6, 1, 13}, NULL, bgp4PathAttrBulk},
   {BGP4PATHATTRUNKNOWN,       OCTET_STRING, RONLY, bgp4PathAttrTable,
-   3, {6, 1, 14}},
+   3, {6, 1, 14}, NULL, bgp4PathAttrBulk},
 };
 
 /* BGP SMUX SNMP Notification function */
@@ -641,187 +642,177 @@ bgp_snmp_path_index_set (struct variable *v, oid *name, size_t *length,
   *length = v->namelen + BGP_PATHATTR_ENTRY_OFFSET;
 }
 
-/* Entry function for bgp4PathAttrTable object.  */
-u_char *
-bgp4PathAttrTable (struct variable *v, oid *name, size_t *length,
-                   int exact, size_t *var_len, WriteMethod **write_method,
-                   u_int32_t vr_id)
+/* Return the bgp4PathAttrTable column 'v' of the path at or, when not
+   exact, following the index in addr and su.  The index of the path
+   found is left in addr and su.  */
+static u_char *
+bgp4PathAttrValue (struct variable *v, struct prefix_ipv4 *addr,
+                   union sockunion *su, int offsetlen, int exact,
+                   size_t *var_len, u_int32_t vr_id)
 {
-  int ret = 0;
-  struct prefix_ipv4 addr;
   struct pal_in4_addr outaddr;
   static u_char *pnt;
   int  out;
-  int offsetlen;
   int proc_id = BGP_PROCESS_ID_ANY;
-  union sockunion su;
-
-  pal_mem_set (&addr, 0, sizeof (struct prefix_ipv4));
-  pal_mem_set (&su, 0, sizeof (union sockunion));
-
-  ret = bgp_snmp_path_index_get (v, name, length, &addr, &su, exact);
-  if (ret < 0)
-    return NULL;
-
-  offsetlen = *length - v->namelen;
 
   switch (v->magic)
     {
     case BGP4PATHATTRPEER:        /* 1 */
-      if (BGP_SNMP_GET2NEXT (path_attr_peer, &addr, &su, offsetlen, &outaddr,
+      if (BGP_SNMP_GET2NEXT (path_attr_peer, addr, su, offsetlen, &outaddr,
                              vr_id))
-        {
-          if (! exact)
-            bgp_snmp_path_index_set (v, name, length, &addr, &su);
-
-          BGP_SNMP_RETURN_IPADDRESS (outaddr);
-        }
+        BGP_SNMP_RETURN_IPADDRESS (outaddr);
       break;
     case BGP4PATHATTRIPADDRPREFIXLEN: /* 2 */
       if (BGP_SNMP_GET2NEXT (path_attr_ip_addr_prefix_len,
-                             &addr, &su, offsetlen, &out,
+                             addr, su, offsetlen, &out,
                              vr_id))
-        {
-          if (! exact)
-            bgp_snmp_path_index_set (v, name, length, &addr, &su);
-
-          BGP_SNMP_RETURN_INTEGER (out);
-        }
+        BGP_SNMP_RETURN_INTEGER (out);
       break;
     case BGP4PATHATTRIPADDRPREFIX: /* 3 */
       if (BGP_SNMP_GET2NEXT (path_attr_ip_addr_prefix,
-                             &addr, &su, offsetlen, &outaddr,
+                             addr, su, offsetlen, &outaddr,
                              vr_id))
-        {
-          if (! exact)
-            bgp_snmp_path_index_set (v, name, length, &addr, &su);
-
-          BGP_SNMP_RETURN_IPADDRESS (outaddr);
-        }
+        BGP_SNMP_RETURN_IPADDRESS (outaddr);
       break;
     case BGP4PATHATTRORIGIN:        /* 4 */
       if (BGP_SNMP_GET2NEXT (path_attr_origin,
-                             &addr, &su, offsetlen, &out,
+                             addr, su, offsetlen, &out,
                              vr_id))
-        {
-          if (! exact)
-            bgp_snmp_path_index_set (v, name, length, &addr, &su);
-
-          BGP_SNMP_RETURN_INTEGER (out);
-        }
+        BGP_SNMP_RETURN_INTEGER (out);
       break;
     case BGP4PATHATTRASPATHSEGMENT: /* 5 */
       if (BGP_SNMP_GET3NEXT (path_attr_as_path_segment,
-                             &addr, &su, offsetlen, &pnt, var_len,
+                             addr, su, offsetlen, &pnt, var_len,
                              vr_id))
-        {
-          if (! exact)
-            bgp_snmp_path_index_set (v, name, length, &addr, &su);
-
-          BGP_SNMP_RETURN_OCTETSTRING (pnt);
-        }
+        BGP_SNMP_RETURN_OCTETSTRING (pnt);
       break;
     case BGP4PATHATTRNEXTHOP:        /* 6 */
       if (BGP_SNMP_GET2NEXT (path_attr_next_hop,
-                             &addr, &su, offsetlen, &outaddr,
+                             addr, su, offsetlen, &outaddr,
                              vr_id))
-        {
-          if (! exact)
-            bgp_snmp_path_index_set (v, name, length, &addr, &su);
-
-          BGP_SNMP_RETURN_IPADDRESS (outaddr);
-        }
+        BGP_SNMP_RETURN_IPADDRESS (outaddr);
       break;
     case BGP4PATHATTRMULTIEXITDISC: /* 7 */
       if (BGP_SNMP_GET2NEXT (path_attr_multi_exit_disc,
-                             &addr, &su, offsetlen, &out,
+                             addr, su, offsetlen, &out,
                              vr_id))
-        {
-          if (! exact)
-            bgp_snmp_path_index_set (v, name, length, &addr, &su);
-
-          BGP_SNMP_RETURN_INTEGER (out);
-        }
+        BGP_SNMP_RETURN_INTEGER (out);
       break;
     case BGP4PATHATTRLOCALPREF:        /* 8 */
       if (BGP_SNMP_GET2NEXT (path_attr_local_pref,
-                             &addr, &su, offsetlen, &out,
+                             addr, su, offsetlen, &out,
                              vr_id))
-        {
-          if (! exact)
-            bgp_snmp_path_index_set (v, name, length, &addr, &su);
-
-          BGP_SNMP_RETURN_INTEGER (out);
-        }
+        BGP_SNMP_RETURN_INTEGER (out);
       break;
     case BGP4PATHATTRATOMICAGGREGATE: /* 9 */
       if (BGP_SNMP_GET2NEXT (path_attr_atomic_aggregate,
-                             &addr, &su, offsetlen, &out,
+                             addr, su, offsetlen, &out,
                              vr_id))
-        {
-          if (! exact)
-            bgp_snmp_path_index_set (v, name, length, &addr, &su);
-
-          BGP_SNMP_RETURN_INTEGER (out);
-        }
+        BGP_SNMP_RETURN_INTEGER (out);
       break;
     case BGP4PATHATTRAGGREGATORAS: /* 10 */
       if (BGP_SNMP_GET2NEXT (path_attr_aggregator_as,
-                             &addr, &su, offsetlen, &out,
+                             addr, su, offsetlen, &out,
                              vr_id))
-        {
-          if (! exact)
-            bgp_snmp_path_index_set (v, name, length, &addr, &su);
-
-          BGP_SNMP_RETURN_INTEGER (out);
-        }
+        BGP_SNMP_RETURN_INTEGER (out);
       break;
     case BGP4PATHATTRAGGREGATORADDR: /* 11 */
       if (BGP_SNMP_GET2NEXT (path_attr_aggregator_addr,
-                             &addr, &su, offsetlen, &outaddr,
+                             addr, su, offsetlen, &outaddr,
                              vr_id))
-        {
-          if (! exact)
-            bgp_snmp_path_index_set (v, name, length, &addr, &su);
-
-          BGP_SNMP_RETURN_IPADDRESS (outaddr);
-        }
+        BGP_SNMP_RETURN_IPADDRESS (outaddr);
       break;
     case BGP4PATHATTRCALCLOCALPREF: /* 12 */
       if (BGP_SNMP_GET2NEXT (path_attr_calc_local_pref,
-                             &addr, &su, offsetlen, &out,
+                             addr, su, offsetlen, &out,
                              vr_id))
-        {
-          if (! exact)
-            bgp_snmp_path_index_set (v, name, length, &addr, &su);
-
-          BGP_SNMP_RETURN_INTEGER (out);
-        }
+        BGP_SNMP_RETURN_INTEGER (out);
       break;
     case BGP4PATHATTRBEST:        /* 13 */
-      if (BGP_SNMP_GET2NEXT (path_attr_best, &addr, &su, offsetlen, &out,
+      if (BGP_SNMP_GET2NEXT (path_attr_best, addr, su, offsetlen, &out,
                              vr_id))
-        {
-          if (! exact)
-            bgp_snmp_path_index_set (v, name, length, &addr, &su);
-
-          BGP_SNMP_RETURN_INTEGER (out);
-        }
+        BGP_SNMP_RETURN_INTEGER (out);
       break;
     case BGP4PATHATTRUNKNOWN:        /* 14 */
       if (BGP_SNMP_GET3NEXT (path_attr_unknown,
-                             &addr, &su, offsetlen, &pnt, var_len, vr_id))
-        {
-          if (! exact)
-            bgp_snmp_path_index_set (v, name, length, &addr, &su);
-
-          BGP_SNMP_RETURN_OCTETSTRING (pnt);
-        }
+                             addr, su, offsetlen, &pnt, var_len, vr_id))
+        BGP_SNMP_RETURN_OCTETSTRING (pnt);
       break;
     }
   return NULL;
 }
-
+
+/* Entry function for bgp4PathAttrTable object.  */
+u_char *
+bgp4PathAttrTable (struct variable *v, oid *name, size_t *length,
+                   int exact, size_t *var_len, WriteMethod **write_method,
+                   u_int32_t vr_id)
+{
+  int ret = 0;
+  struct prefix_ipv4 addr;
+  int offsetlen;
+  union sockunion su;
+  u_char *val;
+
+  pal_mem_set (&addr, 0, sizeof (struct prefix_ipv4));
+  pal_mem_set (&su, 0, sizeof (union sockunion));
+
+  ret = bgp_snmp_path_index_get (v, name, length, &addr, &su, exact);
+  if (ret < 0)
+    return NULL;
+
+  offsetlen = *length - v->namelen;
+
+  val = bgp4PathAttrValue (v, &addr, &su, offsetlen, exact, var_len, vr_id);
+  if (val && ! exact)
+    bgp_snmp_path_index_set (v, name, length, &addr, &su);
+
+  return val;
+}
+
+/* Bulk iterator for bgp4PathAttrTable.  The index is decoded once and
+   every following row continues from the RIB walk position cached by
+   bgp_path_attr_lookup_addr_ipv4_next(), so a GetBulk costs a single
+   walk instead of one lookup per repetition.  */
+static s_int32_t
+bgp4PathAttrBulk (struct variable *v, oid *name, size_t *length,
+                  s_int32_t max_rows, BulkAddMethod *add, void *arg,
+                  u_int32_t vr_id)
+{
+  struct prefix_ipv4 addr;
+  union sockunion su;
+  size_t var_len;
+  int offsetlen;
+  u_char *val;
+  s_int32_t rows;
+
+  pal_mem_set (&addr, 0, sizeof (struct prefix_ipv4));
+  pal_mem_set (&su, 0, sizeof (union sockunion));
+
+  if (bgp_snmp_path_index_get (v, name, length, &addr, &su, 0) < 0)
+    return 0;
+
+  offsetlen = *length - v->namelen;
+
+  for (rows = 0; rows < max_rows; rows++)
+    {
+      val = bgp4PathAttrValue (v, &addr, &su, offsetlen, 0, &var_len, vr_id);
+      if (! val)
+        break;
+
+      bgp_snmp_path_index_set (v, name, length, &addr, &su);
+      if ((*add) (arg, name, *length, v->type, val, var_len))
+        {
+          rows++;
+          break;
+        }
+
+      offsetlen = BGP_PATHATTR_ENTRY_OFFSET;
+    }
+
+  return rows;
+}
+
 /* BGP Traps. */
 struct trap_object bgpSnmpNotifyList[] =
 {
@@ -1277,6 +1277,8 @@ bgp_peer_new (bool_t config_only)
           return NULL;
         }
 
+      SSOCK_CB_SET_TIME_FUNC (peer->sock_cb, bgp_perf_sock_time);
+
       bgp_peer_adv_list_init (peer);
     }
 
@@ -2279,6 +2281,9 @@ bgp_peer_delete (struct bgp_peer *peer)
   if (peer->password)
     XFREE (MTYPE_TMP, peer->password);
 
+  /* Free UPDATE pipeline latency statistics */
+  bgp_perf_peer_free (peer);
+
   /* Free peer structure. */
   XFREE (MTYPE_BGP_PEER, peer);
 
@@ -3677,6 +3682,11 @@ bgp_free (struct bgp *bgp)
       goto EXIT;
     }
 
+#ifdef HAVE_SNMP
+  /* Release the SNMP walk position before the RIB goes away */
+  bgp_path_attr_cursor_reset (bgp);
+#endif /* HAVE_SNMP */
+
   /* Delete the Self-peer */
   if (bgp->peer_self)
     bgp_peer_delete (bgp->peer_self);
@@ -7155,7 +7165,10 @@ bgp_global_delete (void)
   if (bgp_dump_updates)
     XFREE (MTYPE_BGP_DUMP, bgp_dump_updates);
   if (bgp_dump_routes)
-    XFREE (MTYPE_BGP_DUMP, bgp_dump_routes);
+    {
+      bgp_dump_routes_stop (bgp_dump_routes);
+      XFREE (MTYPE_BGP_DUMP, bgp_dump_routes);
+    }
 #endif /* HAVE_BGP_DUMP */
 
   /* Community list delete */
@@ -7245,6 +7258,21 @@ bgp_vr_create (struct ipi_vr *ivr)
       goto EXIT;
     }
 
+  BGP_VR.rfd_non_reuse_list_offset = 0;
+  BGP_VR.rfd_non_reuse_list = XCALLOC (MTYPE_BGP_RFD_REUSE_LIST_ARRAY,
+                                       sizeof (struct bgp_rfd_hist_info *) *
+                                       BGP_RFD_NON_REUSE_LIST_SIZE);
+  if (! BGP_VR.rfd_non_reuse_list)
+    {
+      zlog_err (&BLG, "[INIT] VR Init:"
+                " Cannot allocate memory (%d) @ %s:%d",
+                sizeof (struct bgp_rfd_hist_info),
+                __FILE__, __LINE__);
+
+      ret = -1;
+      goto EXIT;
+    }
+
   /* Initializing the NHT delay timer to 5 seconds. */
   BGP_VR.nh_tracking_delay_interval = BGP_NH_TRACKING_DELAY_INTERVAL_DEFAULT; 
 
@@ -472,6 +472,14 @@ enum bgp_show_type
   bgp_show_type_inconsistent_as
 };
 
+/* Work done by one "show ip bgp" slice before it returns to the event
+   loop: displayed prefixes, visited nodes and elapsed time.  The clock
+   is only read every (BGP_SHOW_SLICE_CLOCK_MASK + 1) nodes.  */
+#define BGP_SHOW_SLICE_PREFIXES         25
+#define BGP_SHOW_SLICE_NODES            512
+#define BGP_SHOW_SLICE_NSEC             (2 * 1000 * 1000)
+#define BGP_SHOW_SLICE_CLOCK_MASK       31
+
 /* BGP route-map information type */
 enum bgp_rmap_info_type
 {
@@ -548,6 +556,12 @@ struct bgp_global
   struct hash *comhash_tab;
 #define bgp_comhash_tab                  (BGP_GLOBAL.comhash_tab)
 
+  /* Generation of expanded community-list regular expressions.  It is
+     bumped whenever a compiled expression is freed so that verdicts
+     cached in communities never refer to a reused pointer.  */
+  u_int32_t comregex_gen;
+#define bgp_comregex_gen                 (BGP_GLOBAL.comregex_gen)
+
   /* Hash Table for Extended-Community attribute. */
   struct hash *ecomhash_tab;
 #define bgp_ecomhash_tab                 (BGP_GLOBAL.ecomhash_tab)
@@ -679,11 +693,14 @@ struct bgp_vr
   struct bgp_rfd_hist_info **rfd_reuse_list;
 
   /* BGP Route Flap Dampening Non-Reuse List Array */
-  struct bgp_rfd_hist_info *rfd_non_reuse_list;
+  struct bgp_rfd_hist_info **rfd_non_reuse_list;
 
   /* BGP Route Flap Dampening Reuse List Array offset */
   u_int32_t rfd_reuse_list_offset;
 
+  /* BGP Route Flap Dampening Non-Reuse List Array offset */
+  u_int32_t rfd_non_reuse_list_offset;
+
   /* BGP Route Flap Dampening Reuse Timer thread */
   struct thread *t_rfd_reuse;
 
@@ -1250,6 +1267,9 @@ u_int32_t dyn_cap_flags;
   struct thread *t_routeadv;
   struct thread *t_gshut_timer;
 
+  /* Inbound soft-reconfiguration jobs in progress */
+  struct bgp_soft_reconfig *soft_reconfig [BAAI_MAX][BSAI_MAX];
+
   /* Statistics fields */
   u_int32_t open_in;            /* Open message input count */
   u_int32_t open_out;           /* Open message output count */
@@ -1323,6 +1343,9 @@ u_int32_t dyn_cap_flags;
   /* FIFO of Decoded UPDATE Messges Info. */
   struct fifo bdui_fifo;
 
+  /* UPDATE pipeline latency, allocated on first sample.  */
+  struct bgp_peer_perf *perf;
+
   /* FIFO of Incoming Connection Requests */
   struct fifo bicr_fifo;
 
@@ -1453,6 +1476,9 @@ struct bgp_dec_update_info
   /* Decoded MP Reach NLRI */
   struct bgp_nlri mp_reach;
 
+  /* Time of enqueue into the Peer's 'bdui_fifo' */
+  u_int64_t ui_enq_nsec;
+
   /* Decoded NLRI byte buffer */
   u_int8_t ui_nlri [1];
 };
@@ -1713,6 +1739,14 @@ do {                                                                  \
                                  (ARG), (TIME_VAL));                  \
 } while (0)
 
+/* Macro for high priority timer turn on */
+#define BGP_TIMER_HIGH_ON(LIB_GLOB, THREAD, ARG, THREAD_FUNC, TIME_VAL)\
+do {                                                                  \
+  if (!(THREAD))                                                      \
+    (THREAD) = thread_add_timer_high ((LIB_GLOB), (THREAD_FUNC),      \
+                                      (ARG), (TIME_VAL));             \
+} while (0)
+
 /* Macro for timer turn off */
 #define BGP_TIMER_OFF(THREAD)                                         \
 do {                                                                  \
@@ -1841,6 +1875,8 @@ bgp_ecmp_cli_init(struct cli_tree *);
  */
 s_int32_t
 bgp_route_map_init (struct ipi_vr *);
+bool_t
+bgp_route_map_peer_dependent (struct route_map *);
 
 /*
  * Function Prototype Declarations
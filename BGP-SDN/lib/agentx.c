@@ -478,17 +478,16 @@ agentx_send (struct lib_globals *zg,
       return 0;
     }
 
-  if ((pktbuf = XMALLOC (MTYPE_TMP, 2048)) == NULL)
+  /* Size the buffer for the whole PDU up front so that building a large
+     GetBulk response does not reallocate it varbind by varbind. */
+  pktbuf_len = MAX (agentx_build_size (pdu), AGENTX_PKTBUF_MIN);
+  if ((pktbuf = XMALLOC (MTYPE_TMP, pktbuf_len)) == NULL)
     {
       if (IS_SUBAG_DEBUG_SEND)
         zlog_err (zg, "AgentX: send, couldn't malloc initial packet buffer");
       sess->lib_errno = SNMPERR_MALLOC;
       return 0;
     }
-  else
-    {
-      pktbuf_len = 2048;
-    }
 
   sess->lib_errno = 0;
   sess->sys_errno = 0;
@@ -1270,6 +1269,154 @@ agentx_handle_getnext (struct lib_globals *zg,
   return SNMP_ERR_NOERROR;
 }
 
+/* GetBulk state shared with a table's bulk iterator. */
+struct agentx_bulk_state
+{
+  struct lib_globals *zg;
+
+  /* Subtree of the column being walked. */
+  struct subtree *subtree;
+
+  /* Where the next varbind is linked in. */
+  struct agentx_variable_list **tail;
+
+  /* OID of the last varbind, the next repetition starts from here. */
+  oid *name;
+  size_t *namelen;
+
+  /* Scope requested by the master agent, scope_len is 0 if none. */
+  oid *scope;
+  size_t scope_len;
+
+  /* Varbinds added by the iterator. */
+  s_int32_t added;
+
+  /* Set when the scope was reached or on failure. */
+  u_char done;
+  u_char error;
+};
+
+/* Find the registered column that 'name' is an instance of, provided the
+   table handler supplies a bulk iterator for it. */
+static struct variable *
+agentx_bulk_lookup (struct lib_globals *zg, oid *name, size_t namelen,
+                    struct subtree **subtreep)
+{
+  struct listnode *node;
+  struct subtree *subtree;
+  struct variable *v;
+  s_int32_t j;
+
+  for (node = zg->snmp.treelist->head; node; node = node->next)
+    {
+      subtree = node->data;
+      if (namelen <= subtree->name_len
+          || oid_compare_part (name, subtree->name_len,
+                               subtree->name, subtree->name_len) != 0)
+        continue;
+
+      for (j = 0; j < subtree->variables_num; j++)
+        {
+          v = &subtree->variables[j];
+          if (v->findBulk == NULL || v->acl == NOACCESS)
+            continue;
+
+          if (namelen >= subtree->name_len + v->namelen
+              && oid_compare_part (name + subtree->name_len, v->namelen,
+                                   v->name, v->namelen) == 0)
+            {
+              *subtreep = subtree;
+              return v;
+            }
+        }
+    }
+  return NULL;
+}
+
+/* Append one row produced by a bulk iterator to the response. */
+static s_int32_t
+agentx_bulk_add (void *arg, oid *suffix, size_t suffix_len,
+                 u_int8_t val_type, void *val, size_t val_len)
+{
+  struct agentx_bulk_state *bs = arg;
+  struct lib_globals *zg = bs->zg;
+  struct agentx_variable_list *v;
+  oid name[MAX_OID_LEN];
+  size_t namelen;
+
+  namelen = bs->subtree->name_len + suffix_len;
+  if (namelen > MAX_OID_LEN)
+    {
+      bs->error = 1;
+      return 1;
+    }
+  oid_copy (name, bs->subtree->name, bs->subtree->name_len);
+  oid_copy (name + bs->subtree->name_len, suffix, suffix_len);
+
+  /* Scope check, see agentx_handle_getbulk(). */
+  if (bs->scope_len
+      && oid_compare (name, namelen, bs->scope, bs->scope_len) >= 0)
+    {
+      v = agentx_varlist_add_variable (zg, bs->tail, bs->name, *bs->namelen,
+                                       SNMP_ENDOFMIBVIEW, 0, 0);
+      if (v == NULL)
+        bs->error = 1;
+      else
+        {
+          bs->tail = &v->next_variable;
+          bs->added++;
+        }
+      bs->done = 1;
+      return 1;
+    }
+
+  v = agentx_varlist_add_variable (zg, bs->tail, name, namelen,
+                                   val_type, val, val_len);
+  if (v == NULL)
+    {
+      bs->error = 1;
+      return 1;
+    }
+  bs->tail = &v->next_variable;
+  bs->added++;
+
+  oid_copy (bs->name, name, namelen);
+  *bs->namelen = namelen;
+
+  return 0;
+}
+
+/* Let the table handler of the column 'name' falls in produce up to
+   'max_rows' repetitions in one walk.  Returns the number of varbinds
+   added; 0 means the caller has to fall back to agentx_getnext(). */
+static s_int32_t
+agentx_getbulk_rows (struct agentx_bulk_state *bs, s_int32_t max_rows,
+                     u_int32_t vr_id)
+{
+  struct lib_globals *zg = bs->zg;
+  struct variable *v;
+  oid suffix[MAX_OID_LEN];
+  size_t suffix_len;
+  s_int32_t rows;
+
+  bs->added = 0;
+  v = agentx_bulk_lookup (zg, bs->name, *bs->namelen, &bs->subtree);
+  if (v == NULL)
+    return 0;
+
+  suffix_len = *bs->namelen - bs->subtree->name_len;
+  oid_copy (suffix, bs->name + bs->subtree->name_len, suffix_len);
+
+  rows = (*v->findBulk) (v, suffix, &suffix_len, max_rows,
+                         agentx_bulk_add, bs, vr_id);
+
+  if (IS_SUBAG_DEBUG_PROCESS)
+    zlog_info (zg, "AgentX: bulk handler %d returned %d of %d rows",
+               v->magic, rows, max_rows);
+
+  return bs->added;
+}
+
 int
 agentx_handle_getbulk (struct lib_globals *zg, 
                        struct agentx_session *sess, s_int32_t exact,
@@ -1277,7 +1424,12 @@ agentx_handle_getbulk (struct lib_globals *zg,
 {
   struct agentx_magic *smagic = (struct agentx_magic *) magic;
   struct agentx_variable_list *u = NULL, *v = NULL;
-  struct variable tvar;
+  struct agentx_variable_list **tail = &pdu->variables;
+  oid name[MAX_OID_LEN];
+  size_t namelen;
+  struct agentx_bulk_state bs;
+  s_int32_t rows;
+  u_char nobulk;
   u_int32_t non_repeaters = pdu->errstat; /* non_repeaters in GetBulk */
   u_int32_t max_repetitions = pdu->errindex; /* max_repetitions in GetBulk */
   u_int32_t i = 0; /* for each iteration */
@@ -1295,9 +1447,9 @@ agentx_handle_getbulk (struct lib_globals *zg,
 
   for (u = smagic->ovars; u != NULL; u = u->next_variable) {
     index++;
+    namelen = MIN (u->name_length, MAX_OID_LEN);
     if (u->name)
-      pal_mem_cpy (&tvar.name, u->name, u->name_length);
-    tvar.namelen = u->name_length;
+      oid_copy (name, u->name, namelen);
 
     /*
      RFC 2741, chap. 7.2.3.3. Subagent Processing of the agentx-GetBulk-PDU
@@ -1310,7 +1462,7 @@ agentx_handle_getbulk (struct lib_globals *zg,
          (ASN_PRIV_INCL_RANGE or ASN_PRIV_EXCL_RANGE)
          Currently, it seems to be operated as ASN_PRIV_INCL_RANGE
        */
-      ret = agentx_getnext (zg, tvar.name, (size_t *)&tvar.namelen, exact,
+      ret = agentx_getnext (zg, name, &namelen, exact,
                             &val_type, &val, &val_len, vr_id);
       if (ret != 0) {
         /*
@@ -1319,12 +1471,12 @@ agentx_handle_getbulk (struct lib_globals *zg,
         if (ret == SNMP_ENDOFMIBVIEW) {
           if (IS_SUBAG_DEBUG_PROCESS) {
             snmp_oid_dump (zg, "AgentX: cannot handle OID",
-                               v->name, v->name_length);
+                               name, namelen);
             zlog_info (zg, "AgentX: cannot locate an appropriate variable"
                            " -- endOfMibView (%d)", ret);
           }
-          v = agentx_pdu_add_variable (zg, pdu, u->name, u->name_length,
-                                       ret, 0, 0);
+          v = agentx_varlist_add_variable (zg, tail, u->name, u->name_length,
+                                           ret, 0, 0);
         } else {
           /*
            RFC 2741, p.65. chapter 7.2.3.
@@ -1341,9 +1493,17 @@ agentx_handle_getbulk (struct lib_globals *zg,
         }
       } else {
         /* save the variable bindings separately */
-        v = agentx_pdu_add_variable (zg, pdu, tvar.name, tvar.namelen,
-                                     val_type, val, val_len);
+        v = agentx_varlist_add_variable (zg, tail, name, namelen,
+                                         val_type, val, val_len);
+      }
+
+      if (v == NULL) {
+        pdu->errstat = SNMP_ERR_GENERR;
+        pdu->errindex = index;
+        agentx_free_varbind (pdu->variables);
+        return pdu->errstat;
       }
+      tail = &v->next_variable;
 
       /*
        * scope check
@@ -1391,13 +1551,54 @@ agentx_handle_getbulk (struct lib_globals *zg,
      */
     /* handling iteration */
     } else {
+      bs.zg = zg;
+      bs.name = name;
+      bs.namelen = &namelen;
+      bs.done = bs.error = 0;
+      if (oid_compare
+          (u->val.objid, u->val_len / sizeof(oid), nullOid,
+           nullOidLen) != 0) {
+        bs.scope = u->val.objid;
+        bs.scope_len = u->val_len / sizeof(oid);
+      } else {
+        bs.scope = NULL;
+        bs.scope_len = 0;
+      }
+      nobulk = 0;
+
       for (i = 0; i < max_repetitions; i++) {
+        /*
+         * Let a column with a bulk iterator produce the remaining
+         * repetitions of this SearchRange in one table walk.  Once it
+         * runs short the column is exhausted and we continue with the
+         * generic getnext into whatever follows it.
+         */
+        if (! nobulk) {
+          bs.tail = tail;
+          rows = agentx_getbulk_rows (&bs, max_repetitions - i, vr_id);
+          tail = bs.tail;
+          if (bs.error) {
+            pdu->errstat = SNMP_ERR_GENERR;
+            pdu->errindex = index;
+            agentx_free_varbind (pdu->variables);
+            return pdu->errstat;
+          }
+          if (bs.done)
+            break;
+          if (rows < (s_int32_t) (max_repetitions - i))
+            nobulk = 1;
+          if (rows > 0) {
+            i += rows - 1;
+            continue;
+          }
+        }
+
         /*
            It need to handle this based on include flag (v->type)
            (ASN_PRIV_INCL_RANGE or ASN_PRIV_EXCL_RANGE)
            Currently, it seems to be operated as ASN_PRIV_INCL_RANGE
          */
-        ret = agentx_getnext (zg, tvar.name, (size_t *)&tvar.namelen, exact,
+        ret = agentx_getnext (zg, name, &namelen, exact,
                               &val_type, &val, &val_len, vr_id);
         if (ret != 0) {
           /*
@@ -1406,12 +1607,14 @@ agentx_handle_getbulk (struct lib_globals *zg,
           if (ret == SNMP_ENDOFMIBVIEW) {
             if (IS_SUBAG_DEBUG_PROCESS) {
               snmp_oid_dump (zg, "AgentX: cannot handle OID",
-                                 v->name, v->name_length);
+                                 name, namelen);
               zlog_info (zg, "AgentX: cannot locate an appropriate variable"
                              " -- endOfMibView (%d)", ret);
             }
-            v = agentx_pdu_add_variable (zg, pdu, tvar.name, tvar.namelen,
-                                         ret, 0, 0);
+            v = agentx_varlist_add_variable (zg, tail, name, namelen,
+                                             ret, 0, 0);
+            if (v != NULL)
+              tail = &v->next_variable;
             break;
           } else {
             /* 
@@ -1424,9 +1627,18 @@ agentx_handle_getbulk (struct lib_globals *zg,
           }
         } else {
           /* save the variable bindings separately */
-          v = agentx_pdu_add_variable (zg, pdu, tvar.name, tvar.namelen,
-                                       val_type, val, val_len);
+          v = agentx_varlist_add_variable (zg, tail, name, namelen,
+                                           val_type, val, val_len);
+          nobulk = 0;
+        }
+
+        if (v == NULL) {
+          pdu->errstat = SNMP_ERR_GENERR;
+          pdu->errindex = index;
+          agentx_free_varbind (pdu->variables);
+          return pdu->errstat;
         }
+        tail = &v->next_variable;
   
         /*
          * scope check
@@ -1458,7 +1670,7 @@ agentx_handle_getbulk (struct lib_globals *zg,
              *    SearchRange.
              */
               /* The varbind is out of scope. */
-              agentx_set_var_objid (v, tvar.name, tvar.namelen);
+              agentx_set_var_objid (v, name, namelen);
               agentx_set_var_typed_value (v, SNMP_ENDOFMIBVIEW, 0, 0);
               if (IS_SUBAG_DEBUG_PROCESS)
                 zlog_info (zg, "AgentX: scope violation -- return endOfMibView");
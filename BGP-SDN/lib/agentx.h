@@ -26,6 +26,9 @@ struct snmp_master;
 
 #define MAX_PACKET_LENGTH       (0x7fffffff)
 
+/* Smallest packet buffer allocated by agentx_send(). */
+#define AGENTX_PKTBUF_MIN       2048
+
 #define AGENTX_VERSION_1        1
 #define IS_AGENTX_VERSION(v)    ((v) == AGENTX_VERSION_1)
 #define AGENTX_DEFAULT_VERSION  AGENTX_VERSION_1
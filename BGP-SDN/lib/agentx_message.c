@@ -824,6 +824,44 @@ _agentx_build (struct lib_globals *zg,
   return 1;
 }
 
+/* Upper bound of the encoded length of a PDU, used to size the packet
+   buffer once instead of growing it while the varbinds are built. */
+size_t
+agentx_build_size (struct agentx_pdu *pdu)
+{
+  struct agentx_variable_list *vp;
+  size_t len;
+
+  /* Header, context, and the largest fixed payload (Response). */
+  len = 20 + 4 + ((pdu->community_len + 3) & ~3) + 8;
+
+  for (vp = pdu->variables; vp; vp = vp->next_variable)
+    {
+      /* Type, reserved and the name. */
+      len += 4 + 4 + 4 * vp->name_length;
+
+      switch (vp->type)
+        {
+        case ASN_OCTET_STR:
+        case ASN_IPADDRESS:
+        case ASN_OPAQUE:
+          len += 4 + ((vp->val_len + 3) & ~3);
+          break;
+        case ASN_OBJECT_ID:
+        case ASN_PRIV_EXCL_RANGE:
+        case ASN_PRIV_INCL_RANGE:
+          len += 4 + 4 * (vp->val_len / sizeof (oid));
+          break;
+        default:
+          len += 8;
+          break;
+        }
+    }
+
+  /* The builders want one spare byte past the end. */
+  return len + 4;
+}
+
 int
 agentx_build (struct lib_globals *zg,
               struct agentx_session *session, struct agentx_pdu *pdu,
@@ -86,6 +86,7 @@ const char *agentx_cmd (u_char code);
 int agentx_build (struct lib_globals *zg, 
                   struct agentx_session *session, struct agentx_pdu *pdu,
                   u_char **buf, size_t *buf_len, size_t *out_len);
+size_t agentx_build_size (struct agentx_pdu *);
 u_char *agentx_parse_oid (struct lib_globals *zg, 
                           u_char *data, size_t *length, int *inc,
                           oid *oid_buf, size_t *oid_len,
@@ -1904,6 +1904,9 @@ host_cli_init (struct lib_globals *zg, struct cli_tree *ctree)
   /* Install logging CLIs. */
   if (zg->protocol != IPI_PROTO_IMI)
     zlog_cli_init (ctree);
+
+  /* Install thread scheduler CLIs. */
+  thread_cli_init (ctree);
 }
 
 void
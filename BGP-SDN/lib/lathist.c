@@ -0,0 +1,143 @@
+/* Copyright (C) 2013 IP Infusion, Inc. All Rights Reserved. */
+
+#include "pal.h"
+#include "lib.h"
+
+/* Bucket index of a value in nanoseconds.  */
+static u_int32_t
+lathist_index (u_int64_t nsec)
+{
+  u_int64_t val = nsec >> LATHIST_UNIT_SHIFT;
+  u_int32_t msb = LATHIST_SUB_BITS;
+  u_int32_t index;
+
+  if (val < LATHIST_SUB)
+    return (u_int32_t) val;
+
+  while (val >> (msb + 1))
+    msb++;
+
+  index = (msb - LATHIST_SUB_BITS + 1) * LATHIST_SUB
+          + (u_int32_t) (val >> (msb - LATHIST_SUB_BITS)) - LATHIST_SUB;
+
+  return index < LATHIST_BUCKETS ? index : LATHIST_BUCKETS - 1;
+}
+
+/* Largest value in nanoseconds that falls into a bucket.  */
+static u_int64_t
+lathist_bucket_max (u_int32_t index)
+{
+  u_int32_t major = index / LATHIST_SUB;
+  u_int32_t sub = index % LATHIST_SUB;
+  u_int64_t upper;
+
+  if (major == 0)
+    upper = sub + 1;
+  else
+    upper = (u_int64_t) (LATHIST_SUB + sub + 1) << (major - 1);
+
+  return (upper << LATHIST_UNIT_SHIFT) - 1;
+}
+
+void
+lathist_record (struct lathist *lh, u_int64_t nsec)
+{
+  lh->count++;
+  lh->sum += nsec;
+  if (nsec > lh->max)
+    lh->max = nsec;
+
+  lh->bucket[lathist_index (nsec)]++;
+}
+
+/* Add the samples of SRC to DST.  */
+void
+lathist_merge (struct lathist *dst, struct lathist *src)
+{
+  u_int32_t i;
+
+  dst->count += src->count;
+  dst->sum += src->sum;
+  if (src->max > dst->max)
+    dst->max = src->max;
+
+  for (i = 0; i < LATHIST_BUCKETS; i++)
+    dst->bucket[i] += src->bucket[i];
+}
+
+void
+lathist_reset (struct lathist *lh)
+{
+  pal_mem_set (lh, 0, sizeof (struct lathist));
+}
+
+u_int64_t
+lathist_mean (struct lathist *lh)
+{
+  return lh->count ? lh->sum / lh->count : 0;
+}
+
+/* Value at or below which PERMILLE thousandths of the samples fall.  */
+u_int64_t
+lathist_percentile (struct lathist *lh, u_int32_t permille)
+{
+  u_int64_t rank;
+  u_int64_t seen;
+  u_int64_t val;
+  u_int32_t i;
+
+  if (! lh->count)
+    return 0;
+
+  rank = (lh->count * permille + 999) / 1000;
+  if (rank == 0)
+    rank = 1;
+
+  for (i = 0, seen = 0; i < LATHIST_BUCKETS; i++)
+    {
+      seen += lh->bucket[i];
+      if (seen >= rank)
+        break;
+    }
+
+  val = lathist_bucket_max (i < LATHIST_BUCKETS ? i : LATHIST_BUCKETS - 1);
+
+  return val < lh->max ? val : lh->max;
+}
+
+/* Format a duration with a unit, e.g. "850ns", "12.5us", "3.2s".
+   BUF must hold LATHIST_STR_LEN bytes.  */
+char *
+lathist_nsec_str (u_int64_t nsec, char *buf)
+{
+  if (nsec < 1000)
+    pal_snprintf (buf, LATHIST_STR_LEN, "%uns", (u_int32_t) nsec);
+  else if (nsec < 1000000)
+    pal_snprintf (buf, LATHIST_STR_LEN, "%u.%uus",
+                  (u_int32_t) (nsec / 1000), (u_int32_t) (nsec % 1000 / 100));
+  else if (nsec < 1000000000)
+    pal_snprintf (buf, LATHIST_STR_LEN, "%u.%ums",
+                  (u_int32_t) (nsec / 1000000),
+                  (u_int32_t) (nsec % 1000000 / 100000));
+  else
+    pal_snprintf (buf, LATHIST_STR_LEN, "%u.%us",
+                  (u_int32_t) (nsec / 1000000000),
+                  (u_int32_t) (nsec % 1000000000 / 100000000));
+
+  return buf;
+}
+
+/* Format a plain counter, as two 10^9 halves so no long long is needed.
+   BUF must hold LATHIST_U64_STR_LEN bytes.  */
+char *
+lathist_u64_str (u_int64_t val, char *buf)
+{
+  if (val < 1000000000)
+    pal_snprintf (buf, LATHIST_U64_STR_LEN, "%u", (u_int32_t) val);
+  else
+    pal_snprintf (buf, LATHIST_U64_STR_LEN, "%u%09u",
+                  (u_int32_t) (val / 1000000000),
+                  (u_int32_t) (val % 1000000000));
+
+  return buf;
+}
@@ -0,0 +1,45 @@
+/* Copyright (C) 2013 IP Infusion, Inc. All Rights Reserved. */
+
+#ifndef _BGPSDN_LATHIST_H
+#define _BGPSDN_LATHIST_H
+
+/* Latency histograms.
+
+   Samples are counted in log-linear buckets in the style of HDR
+   histograms: every power of two range of the value is split into
+   LATHIST_SUB linear sub-buckets, so any recorded value, and any
+   percentile read back, is within 1/LATHIST_SUB of the true value.
+   The unit is 2^LATHIST_UNIT_SHIFT nanoseconds and the top bucket
+   absorbs anything above roughly nine minutes.  */
+
+#define LATHIST_UNIT_SHIFT              7
+#define LATHIST_SUB_BITS                2
+#define LATHIST_SUB                     (1 << LATHIST_SUB_BITS)
+#define LATHIST_MAJOR                   31
+#define LATHIST_BUCKETS                 (LATHIST_MAJOR * LATHIST_SUB)
+
+/* Length of the string written by lathist_nsec_str().  */
+#define LATHIST_STR_LEN                 16
+
+/* Length of the string written by lathist_u64_str().  */
+#define LATHIST_U64_STR_LEN             24
+
+struct lathist
+{
+  /* Number of samples, their sum and the largest one, in ns.  */
+  u_int64_t count;
+  u_int64_t sum;
+  u_int64_t max;
+
+  u_int32_t bucket[LATHIST_BUCKETS];
+};
+
+void lathist_record (struct lathist *, u_int64_t);
+void lathist_merge (struct lathist *, struct lathist *);
+void lathist_reset (struct lathist *);
+u_int64_t lathist_mean (struct lathist *);
+u_int64_t lathist_percentile (struct lathist *, u_int32_t);
+char *lathist_nsec_str (u_int64_t, char *);
+char *lathist_u64_str (u_int64_t, char *);
+
+#endif /* _BGPSDN_LATHIST_H */
@@ -615,6 +615,8 @@ lib_clean (struct lib_globals *zg)
     ipi_vr_finish (zg);
 
   /* Close the logger. */
+  zlog_async_stop (zg);
+
   if (zg->log)
     closezlog (zg, zg->log);
 
@@ -31,6 +31,8 @@
 
 #include "if.h"
 #include "filter.h"
+#include "pstats.h"
+#include "lathist.h"
 #include "plist.h"
 #include "routemap.h"
 #include "entity.h"
@@ -70,6 +70,190 @@ zlog_unset_flag (struct lib_globals *zg, struct zlog *zl, u_char flags)
   zl->flags &= ~flags;
 }
 
+/* Asynchronous log ring.  Producers format into a reserved slot without
+   taking a lock; the writer thread drains committed slots in order and
+   hands them to pal_log_output () in batches.  */
+struct zlog_ring_slot
+{
+  /* Equals the ring position while free, position + 1 once committed.  */
+  u_int32_t seq;
+
+  u_int32_t priority;
+  struct lib_globals *zg;
+  struct zlog *zl;
+  char buf[ZLOG_BUF_MAXLEN];
+};
+
+static struct zlog_ring
+{
+  /* Next position to drain and next position to reserve.  */
+  u_int32_t head;
+  u_int32_t tail;
+
+  /* Writer thread is running.  */
+  bool_t active;
+
+  /* Statistics.  */
+  u_int32_t written;
+  u_int32_t batches;
+  u_int32_t dropped;
+  u_int32_t dropped_reported;
+
+  struct lib_globals *zg;
+  struct zlog_ring_slot slot[ZLOG_RING_SIZE];
+} zlog_ring;
+
+#define ZLOG_LOAD(P)         __atomic_load_n ((P), __ATOMIC_ACQUIRE)
+#define ZLOG_STORE(P,V)      __atomic_store_n ((P), (V), __ATOMIC_RELEASE)
+#define ZLOG_CAS(P,E,V)                                                 \
+  __atomic_compare_exchange_n ((P), (E), (V), 1,                        \
+                               __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)
+#define ZLOG_INC(P)          __atomic_fetch_add ((P), 1, __ATOMIC_RELAXED)
+
+/* Reserve the next free slot.  Returns NULL and counts a drop when the
+   ring is full.  */
+static struct zlog_ring_slot *
+zlog_ring_reserve (u_int32_t *posp)
+{
+  struct zlog_ring_slot *slot;
+  u_int32_t pos;
+  s_int32_t diff;
+
+  pos = __atomic_load_n (&zlog_ring.tail, __ATOMIC_RELAXED);
+  for (;;)
+    {
+      slot = &zlog_ring.slot[pos & ZLOG_RING_MASK];
+      diff = (s_int32_t) (ZLOG_LOAD (&slot->seq) - pos);
+      if (diff == 0)
+        {
+          /* On failure POS is reloaded with the current tail.  */
+          if (ZLOG_CAS (&zlog_ring.tail, &pos, pos + 1))
+            break;
+        }
+      else if (diff < 0)
+        {
+          ZLOG_INC (&zlog_ring.dropped);
+          return NULL;
+        }
+      else
+        pos = __atomic_load_n (&zlog_ring.tail, __ATOMIC_RELAXED);
+    }
+
+  *posp = pos;
+  return slot;
+}
+
+/* Publish a reserved slot to the writer.  */
+static void
+zlog_ring_commit (struct zlog_ring_slot *slot, u_int32_t pos)
+{
+  u_int32_t priority = slot->priority;
+
+  /* The slot belongs to the writer from here on.  */
+  ZLOG_STORE (&slot->seq, pos + 1);
+
+  /* The writer polls; only wake it for urgent messages or when the ring
+     is filling up.  */
+  if (priority <= ZLOG_CRITICAL
+      || pos + 1 - ZLOG_LOAD (&zlog_ring.head) >= ZLOG_RING_KICK)
+    pal_log_writer_kick ();
+}
+
+/* Write out every committed slot.  Called with the writer lock held.  */
+static void
+zlog_ring_drain (void *arg)
+{
+  struct zlog_ring_slot *slot;
+  struct zlog *last = NULL;
+  struct lib_globals *zg;
+  struct zlog *zl;
+  u_int32_t dropped;
+  u_int32_t pos;
+  char buf[ZLOG_BUF_MAXLEN];
+
+  pos = zlog_ring.head;
+  for (;;)
+    {
+      slot = &zlog_ring.slot[pos & ZLOG_RING_MASK];
+      if (ZLOG_LOAD (&slot->seq) != pos + 1)
+        break;
+
+      if (slot->zl != last)
+        {
+          if (last)
+            pal_log_batch (last, PAL_FALSE);
+          pal_log_batch (slot->zl, PAL_TRUE);
+          last = slot->zl;
+        }
+
+      pal_log_output (slot->zg, slot->zl, zlog_priority[slot->priority],
+                      modname_strl (slot->zg->protocol), slot->buf);
+
+      ZLOG_STORE (&slot->seq, pos + ZLOG_RING_SIZE);
+      ZLOG_STORE (&zlog_ring.head, ++pos);
+      zlog_ring.written++;
+    }
+
+  if (last)
+    {
+      pal_log_batch (last, PAL_FALSE);
+      zlog_ring.batches++;
+    }
+
+  /* Account for messages lost since the last report.  */
+  dropped = ZLOG_LOAD (&zlog_ring.dropped);
+  zg = zlog_ring.zg;
+  if (dropped != zlog_ring.dropped_reported && zg != NULL)
+    {
+      zl = zg->log ? zg->log : zg->log_default;
+      if (zl != NULL)
+        {
+          pal_snprintf (buf, sizeof (buf), "%u log messages dropped",
+                        dropped - zlog_ring.dropped_reported);
+          pal_log_output (zg, zl, zlog_priority[ZLOG_WARN],
+                          modname_strl (zg->protocol), buf);
+        }
+      zlog_ring.dropped_reported = dropped;
+    }
+}
+
+/* Move log output to the writer thread.  Must be called from the main
+   thread, after any fork.  */
+int
+zlog_async_start (struct lib_globals *zg)
+{
+  u_int32_t i;
+  int ret;
+
+  if (zlog_ring.active)
+    return 0;
+
+  pal_mem_set (&zlog_ring, 0, sizeof (struct zlog_ring));
+  for (i = 0; i < ZLOG_RING_SIZE; i++)
+    zlog_ring.slot[i].seq = i;
+  zlog_ring.zg = zg;
+
+  ret = pal_log_writer_start (zlog_ring_drain, NULL);
+  if (ret < 0)
+    return ret;
+
+  zlog_ring.active = PAL_TRUE;
+
+  return 0;
+}
+
+/* Flush the ring and return to synchronous output.  */
+void
+zlog_async_stop (struct lib_globals *zg)
+{
+  if (! zlog_ring.active)
+    return;
+
+  zlog_ring.active = PAL_FALSE;
+  pal_log_writer_stop ();
+  zlog_ring.zg = NULL;
+}
+
 /* Open a particular log. */
 struct zlog *
 openzlog (struct lib_globals *zg, u_int32_t instance, module_id_t protocol,
@@ -111,6 +295,11 @@ closezlog (struct lib_globals *zg, struct zlog *zl)
 
   if (zl)
     {
+      /* Write out anything still queued for this log.  */
+      pal_log_writer_lock ();
+      if (zlog_ring.active)
+        zlog_ring_drain (NULL);
+
       pal_log_close (zg, zl);
 
       if(zl->logfile)
@@ -120,6 +309,7 @@ closezlog (struct lib_globals *zg, struct zlog *zl)
       }
 
       zlog_free (&zl);
+      pal_log_writer_unlock ();
     }
 
   return;
@@ -129,17 +319,20 @@ static void
 vzlog (struct lib_globals *zg, struct zlog *zl, u_int32_t priority,
        const char *format, va_list args)
 {
+  struct zlog_ring_slot *slot;
   char buf[ZLOG_BUF_MAXLEN];
   char *protostr;
+  char *msg;
+  bool_t on_main;
+  u_int32_t pos;
 
   if (! zl)
     zl = zg->log_default;
-  /* First prepare output string. */
-  (void) zvsnprintf (buf, sizeof(buf), format, args);
   if (zl == NULL)
     {
       struct zlog tzl;
 
+      (void) zvsnprintf (buf, sizeof(buf), format, args);
       pal_mem_set (&tzl, 0, sizeof(struct zlog));
 
       /* Use stderr. */
@@ -149,13 +342,48 @@ vzlog (struct lib_globals *zg, struct zlog *zl, u_int32_t priority,
       return;
     }
 
-  /* Log this information only if it has not been masked out. */
+  /* Log this information only if it has not been masked out.  Nothing is
+     formatted for filtered messages.  */
   if (priority > zl->maskpri)
     return;
 
   /* Protocol string. */
   protostr = modname_strl (zg->protocol);
 
+  if (zlog_ring.active)
+    {
+      /* Terminal monitors are only served from the main thread.  */
+      on_main = pal_log_thread_is_main ();
+
+      slot = zlog_ring_reserve (&pos);
+      if (slot != NULL)
+        {
+          slot->priority = priority;
+          slot->zg = zg;
+          slot->zl = zl;
+          (void) zvsnprintf (slot->buf, sizeof (slot->buf), format, args);
+          msg = slot->buf;
+        }
+      else if (on_main)
+        {
+          (void) zvsnprintf (buf, sizeof (buf), format, args);
+          msg = buf;
+        }
+      else
+        return;
+
+      if (on_main)
+        vty_log (zg, zl->record_priority ? zlog_priority[priority] : "",
+                 protostr, msg);
+
+      if (slot != NULL)
+        zlog_ring_commit (slot, pos);
+      return;
+    }
+
+  /* First prepare output string. */
+  (void) zvsnprintf (buf, sizeof(buf), format, args);
+
   /* Always try to send syslog, stderr, stdout. */
   pal_log_output (zg, zl, zlog_priority[priority], protostr, buf);
 
@@ -281,7 +509,9 @@ zlog_rotate (struct lib_globals *zg, struct zlog *zl)
   if (zl == NULL)
     return;
 
+  pal_log_writer_lock ();
   pal_log_rotate (zl);
+  pal_log_writer_unlock ();
 }
 
 #ifdef PAL_LOG_STDOUT
@@ -329,6 +559,7 @@ zlog_set_file (struct lib_globals *zg, struct zlog *zl,
   if (zl == NULL)
     return -1;
 
+  pal_log_writer_lock ();
   zlog_set_flag (zg, zl, ZLOG_FILE);
 
   ret = pal_log_set_file (zl, filename, size);
@@ -337,6 +568,7 @@ zlog_set_file (struct lib_globals *zg, struct zlog *zl,
     {
       zlog_unset_flag (zg,zl,ZLOG_FILE);
     }
+  pal_log_writer_unlock ();
 
   return ret;
 }
@@ -357,10 +589,12 @@ zlog_unset_file (struct lib_globals *zg, struct zlog *zl,
   if (! (zl->flags & ZLOG_FILE))
     return -1;
 
+  pal_log_writer_lock ();
   ret = pal_log_unset_file (zl, filename);
   if (ret < 0)
     {
       /* Filename not matched. */
+      pal_log_writer_unlock ();
       return -1;
     }
 
@@ -368,6 +602,7 @@ zlog_unset_file (struct lib_globals *zg, struct zlog *zl,
   zl->log_maxsize = 0;
 
   zlog_unset_flag (zg, zl, ZLOG_FILE);
+  pal_log_writer_unlock ();
 
   return 0;
 }
@@ -572,9 +807,53 @@ mes_lookup (struct message *meslist, s_int32_t max, s_int32_t index)
   return meslist[index].str;
 }
 
+CLI (show_logging,
+     show_logging_cli,
+     "show logging",
+     CLI_SHOW_STR,
+     "Logging configuration and statistics")
+{
+  struct lib_globals *zg = cli->zg;
+  struct zlog *zl;
+  u_int32_t head;
+  u_int32_t tail;
+
+  if (! zg->log)
+    zl = zg->log_default;
+  else
+    zl = zg->log;
+
+  if (zl != NULL)
+    {
+      cli_out (cli, "Trap level: %s\n", zlog_priority[zl->maskpri]);
+      cli_out (cli, "Record priority: %s\n",
+               zl->record_priority ? "enabled" : "disabled");
+    }
+
+  if (! zlog_ring.active)
+    {
+      cli_out (cli, "Writer: synchronous\n");
+      return CLI_SUCCESS;
+    }
+
+  head = ZLOG_LOAD (&zlog_ring.head);
+  tail = ZLOG_LOAD (&zlog_ring.tail);
+
+  cli_out (cli, "Writer: asynchronous\n");
+  cli_out (cli, "  Ring: %u/%u queued\n", tail - head, ZLOG_RING_SIZE);
+  cli_out (cli, "  Written: %u in %u batches\n",
+           zlog_ring.written, zlog_ring.batches);
+  cli_out (cli, "  Dropped: %u\n", ZLOG_LOAD (&zlog_ring.dropped));
+
+  return CLI_SUCCESS;
+}
+
 void
 zlog_cli_init (struct cli_tree *ctree)
 {
+  cli_install_gen (ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
+                   &show_logging_cli);
+
 #ifdef PAL_LOG_STDOUT
   cli_install_gen (ctree, CONFIG_MODE, PRIVILEGE_MAX, 0,
                    &config_log_stdout_cli);
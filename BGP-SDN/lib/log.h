@@ -25,6 +25,13 @@ struct cli_tree;
 #define ZLOG_BUF_MAXLEN              1024
 #define ZLOG_PRIORITY_STR_MAXLEN       17
 
+/* Asynchronous log ring.  Must be a power of two.  */
+#define ZLOG_RING_SIZE                256
+#define ZLOG_RING_MASK               (ZLOG_RING_SIZE - 1)
+
+/* Queue depth at which producers wake the writer early.  */
+#define ZLOG_RING_KICK               (ZLOG_RING_SIZE / 4)
+
 enum log_severity
 {
   ZLOG_EMERGENCY,     /* Emergency. */
@@ -97,6 +104,8 @@ void zlog_debug (struct lib_globals *, const char *, ...);
 void plog_err (struct lib_globals *, struct zlog *, const char *, ...);
 void plog_info (struct lib_globals *, struct zlog *, const char *, ...);
 void zlog_rotate (struct lib_globals *, struct zlog *);
+int zlog_async_start (struct lib_globals *);
+void zlog_async_stop (struct lib_globals *);
 int zlog_config_write (struct cli *);
 char * zlog_get_priority_str(s_int8_t prio);
 
@@ -4,10 +4,15 @@
 
 #include "log.h"
 #include "cli.h"
+#include "thread.h"
 #include "memory.h"
 #include "memmgr.h"
 #include "memmgr_config.h"
 
+#ifdef MEMMGR_TCACHE
+#include <pthread.h>
+#endif /* MEMMGR_TCACHE */
+
 /*
  *  Global declaration
  */
@@ -16,6 +21,64 @@ static struct ipi_mem_table  free_table[BUKT_COUNT];
 static struct ipi_mem_info   mem_stats;
 static struct ipi_mem_global mem_global;
 
+/*
+ *  On-demand arenas of each bucket.  Active arenas hold blocks on the
+ *  free table or in use; dormant arenas have had their pages released.
+ */
+struct memmgr_arena_bucket
+     {
+        struct ipi_mem_arena *list;
+        struct ipi_mem_arena *dormant;
+        unsigned int  dormant_count;
+        unsigned int  released;
+        unsigned int  unmapped;
+     };
+
+static struct memmgr_arena_bucket arena_table[BUKT_COUNT];
+
+/* Compaction event and the bucket it works on next */
+static struct thread *memmgr_t_compact;
+static int memmgr_compact_next;
+
+#define MEMMGR_ARENA_OF(H)                                                \
+  ((struct ipi_mem_arena *)                                               \
+   ((unsigned long) (H) & ~((unsigned long) MEMMGR_ARENA_SIZE - 1)))
+
+#ifdef MEMMGR_TCACHE
+/*
+ *  Per-thread mtype statistics.  A block may be freed by another thread
+ *  than the one that allocated it, so a single thread's counters can go
+ *  negative; only the sum over all threads (plus the totals folded into
+ *  mtype_table by exited threads) is meaningful.
+ */
+struct memmgr_mtype_stat
+     {
+        int  size;
+        int  req_size;
+        int  count;
+     };
+
+/*  Free blocks of one bucket cached by a thread.  */
+struct memmgr_magazine
+     {
+        int  count;
+        struct ipi_memblock_header *blk[2 * MEMMGR_MAG_SIZE];
+     };
+
+struct memmgr_tcache
+     {
+        struct memmgr_tcache     *next;
+        struct memmgr_magazine   mag[MEMMGR_MAG_BUKT_COUNT];
+        struct memmgr_mtype_stat stat[MTYPE_MAX];
+     };
+
+static __thread struct memmgr_tcache *memmgr_tcache_self;
+static struct memmgr_tcache *memmgr_tcache_list;
+static pthread_key_t   memmgr_tcache_key;
+static pthread_mutex_t memmgr_mutex;
+static pthread_once_t  memmgr_once = PTHREAD_ONCE_INIT;
+#endif /* MEMMGR_TCACHE */
+
 #define MEMMGR_LG mem_global.lg
 
 #ifdef HAVE_ISO_MACRO_VARARGS
@@ -71,13 +134,26 @@ void   memmgr_remove_from_mtype_table (int, void *);
 void   memmgr_add_to_free_table (void *);
 struct ipi_memblock_header * memmgr_get_from_free_table (int);
 struct ipi_memblock_header * memmgr_get_from_system_heap (int);
+struct ipi_memblock_header * memmgr_get_from_depot (int, int *);
 int    memmgr_get_ipi_overhead_size ();
 int    memmgr_get_ipi_header_size ();
 struct ipi_memblock_trailer * memmgr_get_ipi_trailer_offset ();
 int    memmgr_get_bucket_index (int);
 int    memmgr_get_bucket_count (int);
 void   memmgr_set_pa_stats (int, int, void *);
-void   memmgr_set_rt_stats (int);
+void   memmgr_set_rt_stats (int, int);
+struct ipi_mem_arena * memmgr_arena_add (int);
+void   memmgr_arena_release (int, struct ipi_mem_arena *);
+int    memmgr_compact_bucket (int);
+static void memmgr_account_mtype (int, int, int, int);
+static int  memmgr_compact_timer (struct thread *);
+static int  memmgr_compact_event (struct thread *);
+static void memmgr_sum_mtype (int, struct ipi_mem_table *);
+#ifdef MEMMGR_TCACHE
+static struct ipi_memblock_header * memmgr_tcache_alloc (int);
+static int  memmgr_tcache_free (struct ipi_memblock_header *);
+static void memmgr_tcache_flush (struct memmgr_tcache *);
+#endif /* MEMMGR_TCACHE */
 
 /****************************************************************
  * The following are the API's to access memory manager data    *
@@ -90,7 +166,14 @@ void
 memmgr_set_lg (void *lg)
 {
   if (MEMMGR_LG == NULL)
-    MEMMGR_LG = (struct lib_globals *)lg;
+    {
+      MEMMGR_LG = (struct lib_globals *)lg;
+
+      /* start periodic arena compaction */
+      if (MEMMGR_LG->master != NULL && memmgr_t_compact == NULL)
+        memmgr_t_compact = thread_add_timer (MEMMGR_LG, memmgr_compact_timer,
+                                             NULL, MEMMGR_COMPACT_INTERVAL);
+    }
   return;
 }
 
@@ -101,7 +184,11 @@ void
 memmgr_unset_lg (void *lg)
 {
   if (MEMMGR_LG == (struct lib_globals *)lg)
-    MEMMGR_LG = NULL;
+    {
+      /* the thread master, and the compaction thread with it, is gone */
+      memmgr_t_compact = NULL;
+      MEMMGR_LG = NULL;
+    }
   return;
 }
 /*
@@ -113,11 +200,18 @@ memmgr_init_memtable (void)
     int  i;
     int  sts;
 
+#ifdef MEMMGR_TCACHE
+    if (memmgr_sem_create () < 0)
+      return -1;
+#endif /* MEMMGR_TCACHE */
+
     MEMMGR_MUTEX_START;
 
     /* init memory table */
     pal_mem_set (mtype_table,  0,  sizeof (struct ipi_mem_table) * MTYPE_MAX);
     pal_mem_set (free_table,   0,  sizeof (struct ipi_mem_table) * BUKT_COUNT);
+    pal_mem_set (arena_table,  0,
+                 sizeof (struct memmgr_arena_bucket) * BUKT_COUNT);
 
     mem_stats.pa_mem_size      = 0;
     mem_stats.pa_mem_blocks    = 0;
@@ -193,14 +287,22 @@ memmgr_free_memtable ()
     int    index;
     int    count;
     int    rt_count;
-    struct ipi_memblock_trailer *p;
     struct ipi_memblock_header  *hdr;
-    struct ipi_memblock_header  *temp;
+    struct ipi_mem_arena        *arena;
+#ifdef MEMMGR_TCACHE
+    struct memmgr_tcache *tc;
+#endif /* MEMMGR_TCACHE */
 
     MEMMGR_MUTEX_START;
 
     rt_count = 0;
 
+#ifdef MEMMGR_TCACHE
+    /* return blocks cached by threads to the free table */
+    for (tc = memmgr_tcache_list; tc != NULL; tc = tc->next)
+      memmgr_tcache_flush (tc);
+#endif /* MEMMGR_TCACHE */
+
     /* free memory blocks from free_table */
     for (index = 0; index < BUKT_COUNT; index++)
       {
@@ -208,13 +310,7 @@ memmgr_free_memtable ()
         count = free_table[index].count;
         while (count > 0 && hdr != NULL)
           {
-            temp = hdr;
             hdr = hdr->next;
-            if (CHECK_FLAG (temp->flags, MEM_BLK_MALLOC))
-              {
-                rt_count++;
-                free (temp);
-              }
             count--;
           }
       }
@@ -223,28 +319,26 @@ memmgr_free_memtable ()
     if (count != 0)
       MEMMGR_LOG_ERR ("Mismatch of count and # of elements in free list\n");
 
-    /* free memory blocks from mtype_table */
-    for (index = 0; index < MTYPE_MAX; index++)
+    /* unmap on-demand arenas */
+    for (index = 0; index < BUKT_COUNT; index++)
       {
-        hdr = (struct ipi_memblock_header *) mtype_table[index].list;
-        count = mtype_table[index].count;
-
-        while (count > 0 && hdr != NULL)
+        while ((arena = arena_table[index].list) != NULL)
           {
-            temp = hdr;
-            p =  memmgr_get_ipi_trailer_offset (hdr);
-            hdr = hdr->next;
-            if (CHECK_FLAG (temp->flags, MEM_BLK_MALLOC))
-              {
-                rt_count++;
-                free (temp);
-              }
-            count--;
+            arena_table[index].list = arena->next;
+            rt_count += arena->total;
+            pal_mem_page_unmap (arena, MEMMGR_ARENA_SIZE);
+          }
+        while ((arena = arena_table[index].dormant) != NULL)
+          {
+            arena_table[index].dormant = arena->next;
+            pal_mem_page_unmap (arena, MEMMGR_ARENA_SIZE);
           }
       }
 
-    if (count != 0)
-      MEMMGR_LOG_ERR ("Mismatch of count and # of elements in mtype list\n");
+    /*
+     * Allocated blocks are not linked per mtype; anything still in use
+     * at this point goes back to the system with the process.
+     */
 
     MEMMGR_LOG_INFO ("  %d vs %d \n", rt_count, mem_stats.rt_mem_blocks);
 
@@ -291,12 +385,9 @@ memmgr_malloc (int size, int mtype, char *filename, int line)
          return NULL;
        }
 
-     MEMMGR_MUTEX_START;
-
+     /* takes the free table lock only when the depot is needed */
      bufptr = memmgr_get_user_membuf (size, mtype, filename, line);
 
-     MEMMGR_MUTEX_END;
-
      return (void *) bufptr;
 }
 
@@ -363,8 +454,9 @@ memmgr_realloc (void *ptr,  int new_size, int mtype, char *filename, int line)
  *   memmgr_free()
  *
  *   remove a memory block from mtype table and add it to free table for
- *   subsequent use. In this implementation none of the allocated memory is ever
- *   returned to the system heap
+ *   subsequent use. Small blocks go to the calling thread's magazine first.
+ *   The pre-allocated memory is kept, but arenas whose blocks are all free
+ *   are later returned to the system by memmgr_compact ().
  */
 void
 memmgr_free (int mtype, void *ptr, char *file, int line)
@@ -372,14 +464,20 @@ memmgr_free (int mtype, void *ptr, char *file, int line)
      if (ptr == NULL)
        return;
 
-     MEMMGR_MUTEX_START;
-
 #ifdef MEMMGR_RUNTIME_CHECK
      memmgr_buffer_check (ptr);
 #endif
 
      memmgr_remove_from_mtype_table (mtype, ptr);
 
+#ifdef MEMMGR_TCACHE
+     if (memmgr_tcache_free ((struct ipi_memblock_header *)
+                             ((char *) ptr - memmgr_get_ipi_header_size ())))
+       return;
+#endif /* MEMMGR_TCACHE */
+
+     MEMMGR_MUTEX_START;
+
      memmgr_add_to_free_table (ptr);
 
      MEMMGR_MUTEX_END;
@@ -610,41 +708,23 @@ memmgr_partition_memory (int count,  int block_size, struct ipi_mem_table *tbl)
 void
 memmgr_add_to_mtype_table (int mtype, struct ipi_memblock_header *nmhdr, int req_size)
 {
-    struct ipi_memblock_header *mhdr;
-
     if (nmhdr->cookie != 0)
         MEMMGR_LOG_WARN ("Mem block already exists in allocated table\n");
 
-    if (mtype_table[mtype].list == NULL)
-      {
-        mtype_table[mtype].list = (void *) nmhdr;
-      }
-    else
-      {
-        mhdr = (struct ipi_memblock_header *) mtype_table[mtype].list;
-
-        /* add to the list */
-        nmhdr->prev = mhdr->prev;
-        nmhdr->next = mhdr;
-      }
-
     /* update memory header fields */
     nmhdr->cookie = MAGIC_COOKIE;
     SET_FLAG (nmhdr->flags, MEM_BLK_ALLOC);
     UNSET_FLAG (nmhdr->flags, MEM_BLK_FREE);
     nmhdr->req_size = req_size;
     nmhdr->mid = mtype;
-
-    /* update linked list pointers */
-    nmhdr->next->prev = nmhdr;
-    nmhdr->prev->next = nmhdr;
+    nmhdr->prev = nmhdr;
+    nmhdr->next = nmhdr;
 
     /* update mtype stats */
-    mtype_table[mtype].size += memmgr_decode_header_size (nmhdr->size) +
-                               memmgr_get_ipi_overhead_size ();
-
-    mtype_table[mtype].req_size += req_size;
-    mtype_table[mtype].count++;
+    memmgr_account_mtype (mtype,
+                          memmgr_decode_header_size (nmhdr->size) +
+                          memmgr_get_ipi_overhead_size (),
+                          req_size, 1);
 }
 
 
@@ -658,15 +738,6 @@ void
 memmgr_remove_from_mtype_table (int mtype, void *ptr)
 {
     struct ipi_memblock_header *mhdr;
-    int    index;
-    int    size;
-
-    if (mtype_table[mtype].list == NULL)
-      {
-        MEMMGR_LOG_ERR ("Can't delete - mtype list is empty. mtype(%d, %s)\n",
-                        mtype, memmgr_get_mtype_str (mtype));
-        return;
-      }
 
     /* get to the beginning of header */
     mhdr = (struct ipi_memblock_header *)
@@ -694,26 +765,11 @@ memmgr_remove_from_mtype_table (int mtype, void *ptr)
         return;
       }
 
-    /* decode header size */
-    size = memmgr_decode_header_size (mhdr->size);
-    index = memmgr_get_bucket_index (size);
-
-    /* in case of list having only one memory block */
-    if (mhdr->next == mhdr && mhdr->prev == mhdr)
-      mtype_table[mtype].list = NULL;
-    /* memory block happens to be the first element in the list */
-    else if (mhdr == (struct ipi_memblock_header *) mtype_table[mtype].list)
-      mtype_table[mtype].list = mhdr->next;
-
-    /* remove block from mtype list and update pointers */
-    mhdr->prev->next = mhdr->next;
-    mhdr->next->prev = mhdr->prev;
-
     /* update mtype stats */
-    mtype_table[mtype].size -= memmgr_decode_header_size (mhdr->size) +
-                               memmgr_get_ipi_overhead_size ();
-    mtype_table[mtype].req_size -= mhdr->req_size;
-    mtype_table[mtype].count--;
+    memmgr_account_mtype (mtype,
+                          - (memmgr_decode_header_size (mhdr->size) +
+                             memmgr_get_ipi_overhead_size ()),
+                          - mhdr->req_size, -1);
 }
 
 
@@ -752,6 +808,10 @@ memmgr_add_to_free_table (void *ptr)
                               memmgr_get_ipi_overhead_size ();
     free_table[index].count++;
 
+    /* arena occupancy */
+    if (CHECK_FLAG (hdr->flags, MEM_BLK_MALLOC))
+      MEMMGR_ARENA_OF (hdr)->used--;
+
     if (free_table[index].list == NULL)
       {
         free_table[index].list = (void *) hdr;
@@ -806,6 +866,10 @@ memmgr_get_from_free_table (int index)
     free_table[index].count--;
     free_table[index].size -= ipi_size;
 
+    /* arena occupancy */
+    if (CHECK_FLAG (mhdr->flags, MEM_BLK_MALLOC))
+      MEMMGR_ARENA_OF (mhdr)->used++;
+
     /* init link pointers */
     mhdr->prev = mhdr;
     mhdr->next = mhdr;
@@ -817,39 +881,323 @@ memmgr_get_from_free_table (int index)
 /*
  *   memmgr_get_from_system_heap ()
  *
- *   get memory from system heap and initialize header fields.
+ *   Add an on-demand arena for the best fit bucket and return one of its
+ *   blocks.
  */
 struct ipi_memblock_header *
 memmgr_get_from_system_heap (int req_size)
 {
-     struct ipi_memblock_header *mhdr;
-     int    ipi_size;
-     int    block_size;
      int    index;
 
      /* map the req size to a best fit bucket size */
      index = memmgr_get_bucket_index (req_size);
 
-     block_size = memmgr_get_bucket_block_size (index);
+     if (memmgr_arena_add (index) == NULL)
+       return NULL;
+
+     return memmgr_get_from_free_table (index);
+}
+
 
-     /* get bucket fixed size in bytes & add the overhead */
+/*
+ *   memmgr_arena_add ()
+ *
+ *   Revive a dormant arena, or map a new one, for a given bucket and put
+ *   all of its blocks on the free table.
+ */
+struct ipi_mem_arena *
+memmgr_arena_add (int index)
+{
+     struct memmgr_arena_bucket *ab = &arena_table[index];
+     struct ipi_memblock_header *mhdr;
+     struct ipi_mem_arena *arena;
+     int    block_size;
+     int    ipi_size;
+     int    hdr_size;
+     unsigned int i;
+     char   *ptr;
+
+     block_size = memmgr_get_bucket_block_size (index);
      ipi_size = block_size + memmgr_get_ipi_overhead_size ();
+     hdr_size = memmgr_get_ipi_header_size ();
+
+     arena = ab->dormant;
+     if (arena != NULL)
+       {
+         ab->dormant = arena->next;
+         ab->dormant_count--;
+         UNSET_FLAG (arena->flags, MEM_ARENA_DORMANT);
+       }
+     else
+       {
+         arena = pal_mem_page_map (MEMMGR_ARENA_SIZE, MEMMGR_ARENA_SIZE);
+         if (arena == NULL)
+           return NULL;
+
+         arena->bucket = index;
+         arena->flags = 0;
+       }
+
+     arena->total = (MEMMGR_ARENA_SIZE - MEMMGR_ARENA_HDR_SIZE) / ipi_size;
+
+     /* every block is handed to the free table below */
+     arena->used = arena->total;
 
-     mhdr = (struct ipi_memblock_header *) malloc (ipi_size);
-     if (mhdr == NULL)
-       return mhdr;
+     arena->prev = NULL;
+     arena->next = ab->list;
+     if (ab->list)
+       ab->list->prev = arena;
+     ab->list = arena;
+
+     ptr = (char *) arena + MEMMGR_ARENA_HDR_SIZE;
+     for (i = 0; i < arena->total; i++, ptr += ipi_size)
+       {
+         mhdr = (struct ipi_memblock_header *) ptr;
+         pal_mem_set (mhdr, 0, hdr_size);
+         mhdr->size = memmgr_encode_header_size (block_size);
+         SET_FLAG (mhdr->flags, MEM_BLK_MALLOC);
+
+         memmgr_add_to_free_table (ptr + hdr_size);
+       }
 
      /* update rt stats */
-     memmgr_set_rt_stats (block_size);
+     memmgr_set_rt_stats (block_size, arena->total);
+
+     return arena;
+}
 
-     pal_mem_set (mhdr, 0, sizeof (struct ipi_memblock_header));
 
-     SET_FLAG (mhdr->flags, MEM_BLK_MALLOC);
-     mhdr->prev = mhdr;
-     mhdr->next = mhdr;
-     mhdr->size = memmgr_encode_header_size (block_size);
+/*
+ *   memmgr_arena_release ()
+ *
+ *   Take the blocks of an empty arena off the free table and give its pages
+ *   back to the system. The arena is kept dormant for reuse, or unmapped
+ *   when enough arenas are dormant already.
+ */
+void
+memmgr_arena_release (int index, struct ipi_mem_arena *arena)
+{
+     struct memmgr_arena_bucket *ab = &arena_table[index];
+     struct ipi_memblock_header *mhdr;
+     struct ipi_mem_arena *last;
+     int    block_size;
+     int    ipi_size;
+     unsigned int i;
+     char   *ptr;
+
+     block_size = memmgr_get_bucket_block_size (index);
+     ipi_size = block_size + memmgr_get_ipi_overhead_size ();
 
-     return mhdr;
+     /* unlink every block from the free list */
+     ptr = (char *) arena + MEMMGR_ARENA_HDR_SIZE;
+     for (i = 0; i < arena->total; i++, ptr += ipi_size)
+       {
+         mhdr = (struct ipi_memblock_header *) ptr;
+
+         if (mhdr->next == mhdr)
+           free_table[index].list = NULL;
+         else if (mhdr == (struct ipi_memblock_header *) free_table[index].list)
+           free_table[index].list = mhdr->next;
+
+         mhdr->prev->next = mhdr->next;
+         mhdr->next->prev = mhdr->prev;
+
+         free_table[index].count--;
+         free_table[index].size -= ipi_size;
+       }
+
+     /* unlink arena */
+     if (arena->prev)
+       arena->prev->next = arena->next;
+     else
+       ab->list = arena->next;
+     if (arena->next)
+       arena->next->prev = arena->prev;
+
+     memmgr_set_rt_stats (block_size, - (int) arena->total);
+
+     /* drop the block pages; the header page keeps the dormant link */
+     pal_mem_page_release ((char *) arena + MEMMGR_ARENA_HDR_SIZE,
+                           MEMMGR_ARENA_SIZE - MEMMGR_ARENA_HDR_SIZE);
+
+     SET_FLAG (arena->flags, MEM_ARENA_DORMANT);
+     arena->total = 0;
+     arena->used = 0;
+     arena->prev = NULL;
+     arena->next = ab->dormant;
+     ab->dormant = arena;
+     ab->dormant_count++;
+     ab->released++;
+
+     if (ab->dormant_count <= MEMMGR_ARENA_DORMANT_MAX)
+       return;
+
+     /* unmap the oldest dormant arena */
+     for (last = ab->dormant; last->next->next != NULL; last = last->next)
+       ;
+     arena = last->next;
+     last->next = NULL;
+     ab->dormant_count--;
+     ab->unmapped++;
+
+     pal_mem_page_unmap (arena, MEMMGR_ARENA_SIZE);
+}
+
+
+/*
+ *   memmgr_compact_bucket ()
+ *
+ *   Release the empty arenas of a bucket beyond MEMMGR_ARENA_KEEP. Return
+ *   the number of arenas released. Called with the free table lock held.
+ */
+int
+memmgr_compact_bucket (int index)
+{
+     struct ipi_mem_arena *arena;
+     struct ipi_mem_arena *next;
+     int    empty = 0;
+     int    released = 0;
+
+     for (arena = arena_table[index].list; arena != NULL; arena = next)
+       {
+         next = arena->next;
+
+         if (arena->used != 0)
+           continue;
+
+         if (empty < MEMMGR_ARENA_KEEP)
+           {
+             empty++;
+             continue;
+           }
+
+         memmgr_arena_release (index, arena);
+         released++;
+       }
+
+     return released;
+}
+
+
+/*
+ *   memmgr_compact ()
+ *
+ *   Release empty arenas of all buckets. Blocks cached by the calling
+ *   thread are returned first. Return the number of arenas released.
+ */
+int
+memmgr_compact (void)
+{
+     int    released = 0;
+     int    index;
+
+     MEMMGR_MUTEX_START;
+
+#ifdef MEMMGR_TCACHE
+     if (memmgr_tcache_self != NULL)
+       memmgr_tcache_flush (memmgr_tcache_self);
+#endif /* MEMMGR_TCACHE */
+
+     for (index = 0; index < BUKT_COUNT; index++)
+       released += memmgr_compact_bucket (index);
+
+     MEMMGR_MUTEX_END;
+
+     return released;
+}
+
+
+/*
+ *   memmgr_compact_event ()
+ *
+ *   Low priority background compaction, one bucket per event.
+ */
+static int
+memmgr_compact_event (struct thread *t)
+{
+     memmgr_t_compact = NULL;
+
+     MEMMGR_MUTEX_START;
+
+#ifdef MEMMGR_TCACHE
+     /* blocks cached by this thread would keep arenas occupied */
+     if (memmgr_compact_next == 0 && memmgr_tcache_self != NULL)
+       memmgr_tcache_flush (memmgr_tcache_self);
+#endif /* MEMMGR_TCACHE */
+
+     memmgr_compact_bucket (memmgr_compact_next);
+
+     MEMMGR_MUTEX_END;
+
+     if (MEMMGR_LG == NULL)
+       return 0;
+
+     if (++memmgr_compact_next < BUKT_COUNT)
+       memmgr_t_compact = thread_add_event_low (MEMMGR_LG, memmgr_compact_event,
+                                                NULL, 0);
+     else
+       {
+         memmgr_compact_next = 0;
+         memmgr_t_compact = thread_add_timer (MEMMGR_LG, memmgr_compact_timer,
+                                              NULL, MEMMGR_COMPACT_INTERVAL);
+       }
+
+     return 0;
+}
+
+
+/*
+ *   memmgr_compact_timer ()
+ *
+ *   Periodic compaction kick.
+ */
+static int
+memmgr_compact_timer (struct thread *t)
+{
+     memmgr_t_compact = NULL;
+     memmgr_compact_next = 0;
+
+     if (MEMMGR_LG != NULL)
+       memmgr_t_compact = thread_add_event_low (MEMMGR_LG, memmgr_compact_event,
+                                                NULL, 0);
+
+     return 0;
+}
+
+
+/*
+ *   memmgr_get_arena_stats ()
+ *
+ *   Return arena occupancy of a given bucket.
+ */
+void
+memmgr_get_arena_stats (int index, struct ipi_mem_arena_stats *st)
+{
+     struct ipi_mem_arena *arena;
+
+     pal_mem_set (st, 0, sizeof (struct ipi_mem_arena_stats));
+
+     MEMMGR_MUTEX_START;
+
+     for (arena = arena_table[index].list; arena != NULL; arena = arena->next)
+       {
+         st->arenas++;
+         st->blocks += arena->total;
+         st->used += arena->used;
+
+         if (arena->used == arena->total)
+           st->full++;
+         else if (arena->used == 0)
+           st->empty++;
+         else
+           st->partial++;
+       }
+
+     st->dormant = arena_table[index].dormant_count;
+     st->released = arena_table[index].released;
+     st->unmapped = arena_table[index].unmapped;
+
+     MEMMGR_MUTEX_END;
 }
 
 
@@ -903,11 +1251,66 @@ memmgr_set_memblock_trailer (struct ipi_memblock_header *hdr, int index,
 }
 
 
+/*
+ *   memmgr_get_from_depot ()
+ *
+ *   Take a block for a given bucket from the shared free table, falling
+ *   back to the system heap and then to the next higher free pool. The
+ *   bucket index is updated if a larger block is returned. Called with the
+ *   free table lock held.
+ */
+struct ipi_memblock_header *
+memmgr_get_from_depot (int req_size, int *index)
+{
+    struct    ipi_memblock_header  *mhdr;
+    unsigned  int allocated_size;
+    int       i;
+
+    /* if no free blocks, allocate memory from system */
+    mhdr = memmgr_get_from_free_table (*index);
+    if (mhdr != NULL)
+      return mhdr;
+
+    /* check here if we have exceeded max process memory before accessing
+     * system heap. If so, return an error. Check for maximum allowed
+     * memory only if it is not set to infinite
+     */
+    if (mem_global.max_mem_size != PM_MEM_SIZE_INF)
+      {
+        allocated_size = memmgr_get_total_mtype_req_size () + req_size;
+        if (allocated_size > mem_global.max_mem_size)
+          {
+            MEMMGR_LOG_WARN ("Maximum memory threshold %u KB reached\n",
+                (mem_global.max_mem_size / 1000));
+            return NULL;
+          }
+      }
+
+    if ((mhdr = memmgr_get_from_system_heap (req_size)) != NULL)
+      return mhdr;
+
+    /* see if the requested memory could be allocated from the next
+     * higher free pool
+     */
+    for (i = *index + 1; i < BUKT_COUNT; i++)
+      {
+        mhdr = memmgr_get_from_free_table (i);
+        if (mhdr != NULL)
+          {
+            *index = i;
+            return mhdr;
+          }
+      }
+
+    return NULL;
+}
+
+
 /*
  *   memmgr_get_user_membuf ()
  *
  *   Based on the request size, allocate an appropriate memory block (best fit)
- *   from one of the buckets in free memory table.
+ *   from the thread's magazine or one of the buckets in free memory table.
  *   For now, return an error if the requested block size is more than 64k
  */
 char *
@@ -916,7 +1319,6 @@ memmgr_get_user_membuf (int req_size, int mtype, char *filename, int line)
     char      *ptr;
     struct    ipi_memblock_header  *mhdr;
     int       index;
-    unsigned  int allocated_size;
 
     /* get bucket index */
     index = memmgr_get_bucket_index (req_size);
@@ -927,39 +1329,22 @@ memmgr_get_user_membuf (int req_size, int mtype, char *filename, int line)
         return NULL;
       }
 
-    /* if no free blocks, allocate memory from system */
-    mhdr = memmgr_get_from_free_table (index);
+    mhdr = NULL;
+
+#ifdef MEMMGR_TCACHE
+    /* small blocks come from this thread's magazine without locking */
+    if (index < MEMMGR_MAG_BUKT_COUNT)
+      mhdr = memmgr_tcache_alloc (index);
+#endif /* MEMMGR_TCACHE */
 
     if (mhdr == NULL)
       {
-        /* check here if we have exceeded max process memory before accessing
-         * system heap. If so, return an error
-         */
-        allocated_size = memmgr_get_total_mtype_req_size () + req_size;
-        /* Check for maximum allowed memory only if it is not set to
-         * infinite
-         */
-        if ((mem_global.max_mem_size != PM_MEM_SIZE_INF) &&
-            (allocated_size > mem_global.max_mem_size))
-          {
-            MEMMGR_LOG_WARN ("Maximum memory threshold %u KB reached\n",
-                (mem_global.max_mem_size / 1000));
-            return NULL;
-          }
+        MEMMGR_MUTEX_START;
+        mhdr = memmgr_get_from_depot (req_size, &index);
+        MEMMGR_MUTEX_END;
 
-        if ((mhdr = memmgr_get_from_system_heap (req_size)) == NULL)
-          {
-            /* see if the requested memory could be allocated from the next
-             * higher free pool
-             */
-            for (index = index+1; index < BUKT_COUNT; index++)
-              {
-                mhdr = memmgr_get_from_free_table (index);
-                if (mhdr != NULL) break;
-              }
-            if (index == BUKT_COUNT)
-              return NULL;
-          }
+        if (mhdr == NULL)
+          return NULL;
       }
 
     /* init gaurd area and copy file and line information */
@@ -974,6 +1359,236 @@ memmgr_get_user_membuf (int req_size, int mtype, char *filename, int line)
 }
 
 
+/*
+ *  memmgr_account_mtype ()
+ *
+ *  Apply a size/count delta to the stats of a given mtype.  With thread
+ *  caches the delta lands in the calling thread's counters.
+ */
+static void
+memmgr_account_mtype (int mtype, int size, int req_size, int count)
+{
+#ifdef MEMMGR_TCACHE
+    struct memmgr_tcache *tc;
+
+    tc = memmgr_tcache_self;
+    if (tc != NULL)
+      {
+        tc->stat[mtype].size += size;
+        tc->stat[mtype].req_size += req_size;
+        tc->stat[mtype].count += count;
+        return;
+      }
+#endif /* MEMMGR_TCACHE */
+
+    MEMMGR_MUTEX_START;
+    mtype_table[mtype].size += size;
+    mtype_table[mtype].req_size += req_size;
+    mtype_table[mtype].count += count;
+    MEMMGR_MUTEX_END;
+}
+
+
+/*
+ *  memmgr_sum_mtype ()
+ *
+ *  Merge the stats of a given mtype across all threads.  Called with the
+ *  free table lock held.
+ */
+static void
+memmgr_sum_mtype (int mtype, struct ipi_mem_table *sum)
+{
+#ifdef MEMMGR_TCACHE
+    struct memmgr_tcache *tc;
+#endif /* MEMMGR_TCACHE */
+
+    sum->size = mtype_table[mtype].size;
+    sum->req_size = mtype_table[mtype].req_size;
+    sum->count = mtype_table[mtype].count;
+
+#ifdef MEMMGR_TCACHE
+    for (tc = memmgr_tcache_list; tc != NULL; tc = tc->next)
+      {
+        sum->size += tc->stat[mtype].size;
+        sum->req_size += tc->stat[mtype].req_size;
+        sum->count += tc->stat[mtype].count;
+      }
+#endif /* MEMMGR_TCACHE */
+}
+
+
+#ifdef MEMMGR_TCACHE
+/*
+ *  memmgr_tcache_release ()
+ *
+ *  Thread exit destructor: hand cached blocks back to the free table and
+ *  fold the thread's mtype stats into the global table.
+ */
+static void
+memmgr_tcache_release (void *arg)
+{
+    struct memmgr_tcache *tc = arg;
+    struct memmgr_tcache **pp;
+    int    i;
+
+    MEMMGR_MUTEX_START;
+
+    memmgr_tcache_flush (tc);
+
+    for (i = 0; i < MTYPE_MAX; i++)
+      {
+        mtype_table[i].size += tc->stat[i].size;
+        mtype_table[i].req_size += tc->stat[i].req_size;
+        mtype_table[i].count += tc->stat[i].count;
+      }
+
+    for (pp = &memmgr_tcache_list; *pp != NULL; pp = &(*pp)->next)
+      if (*pp == tc)
+        {
+          *pp = tc->next;
+          break;
+        }
+
+    MEMMGR_MUTEX_END;
+
+    memmgr_tcache_self = NULL;
+    free (tc);
+}
+
+/*
+ *  memmgr_tcache_get ()
+ *
+ *  Return the calling thread's cache, creating it on first use.
+ */
+static struct memmgr_tcache *
+memmgr_tcache_get (void)
+{
+    struct memmgr_tcache *tc;
+
+    tc = memmgr_tcache_self;
+    if (tc != NULL)
+      return tc;
+
+    tc = (struct memmgr_tcache *) calloc (1, sizeof (struct memmgr_tcache));
+    if (tc == NULL)
+      return NULL;
+
+    pthread_setspecific (memmgr_tcache_key, tc);
+
+    MEMMGR_MUTEX_START;
+    tc->next = memmgr_tcache_list;
+    memmgr_tcache_list = tc;
+    MEMMGR_MUTEX_END;
+
+    memmgr_tcache_self = tc;
+
+    return tc;
+}
+
+/*
+ *  memmgr_tcache_flush ()
+ *
+ *  Return every block in a thread cache to the free table.  Called with
+ *  the free table lock held.
+ */
+static void
+memmgr_tcache_flush (struct memmgr_tcache *tc)
+{
+    struct memmgr_magazine *mag;
+    int    i;
+
+    for (i = 0; i < MEMMGR_MAG_BUKT_COUNT; i++)
+      {
+        mag = &tc->mag[i];
+        while (mag->count > 0)
+          memmgr_add_to_free_table ((char *) mag->blk[--mag->count] +
+                                    memmgr_get_ipi_header_size ());
+      }
+}
+
+/*
+ *  memmgr_tcache_alloc ()
+ *
+ *  Pop a block of a given bucket from the thread's magazine, refilling it
+ *  with up to MEMMGR_MAG_SIZE blocks from the free table when empty.
+ */
+static struct ipi_memblock_header *
+memmgr_tcache_alloc (int index)
+{
+    struct memmgr_tcache *tc;
+    struct memmgr_magazine *mag;
+    struct ipi_memblock_header *mhdr;
+
+    tc = memmgr_tcache_get ();
+    if (tc == NULL)
+      return NULL;
+
+    mag = &tc->mag[index];
+    if (mag->count == 0)
+      {
+        MEMMGR_MUTEX_START;
+        while (mag->count < MEMMGR_MAG_SIZE
+               && (mhdr = memmgr_get_from_free_table (index)) != NULL)
+          mag->blk[mag->count++] = mhdr;
+        MEMMGR_MUTEX_END;
+
+        /* depot is empty; the caller goes to the system heap */
+        if (mag->count == 0)
+          return NULL;
+      }
+
+    return mag->blk[--mag->count];
+}
+
+/*
+ *  memmgr_tcache_free ()
+ *
+ *  Push a freed block onto the thread's magazine.  A full magazine first
+ *  returns MEMMGR_MAG_SIZE blocks to the free table.  Return 0 if the
+ *  block is not cacheable.
+ */
+static int
+memmgr_tcache_free (struct ipi_memblock_header *hdr)
+{
+    struct memmgr_tcache *tc;
+    struct memmgr_magazine *mag;
+    int    index;
+    int    i;
+
+    index = memmgr_get_bucket_index (memmgr_decode_header_size (hdr->size));
+    if (index < 0 || index >= MEMMGR_MAG_BUKT_COUNT)
+      return 0;
+
+    tc = memmgr_tcache_get ();
+    if (tc == NULL)
+      return 0;
+
+    /* same header state as a block on the free table */
+    hdr->prev = hdr;
+    hdr->next = hdr;
+    hdr->cookie = 0;
+    hdr->req_size = 0;
+    hdr->mid = 0;
+    UNSET_FLAG (hdr->flags, MEM_BLK_ALLOC);
+    SET_FLAG (hdr->flags, MEM_BLK_FREE);
+
+    mag = &tc->mag[index];
+    if (mag->count == 2 * MEMMGR_MAG_SIZE)
+      {
+        MEMMGR_MUTEX_START;
+        for (i = 0; i < MEMMGR_MAG_SIZE; i++)
+          memmgr_add_to_free_table ((char *) mag->blk[--mag->count] +
+                                    memmgr_get_ipi_header_size ());
+        MEMMGR_MUTEX_END;
+      }
+
+    mag->blk[mag->count++] = hdr;
+
+    return 1;
+}
+#endif /* MEMMGR_TCACHE */
+
+
 /*
  *  memmgr_get_bucket_index ()
  *
@@ -1167,14 +1782,15 @@ memmgr_set_pa_stats (int count, int block_size, void * ptr)
  *  memmgr_set_rt_stats ()
  *
  *  Maintain information of the total memory allocated on top of pre-allocated
- *  memory size and the associated overhead.
+ *  memory size and the associated overhead. COUNT is negative when arena
+ *  blocks are released.
  */
 void
-memmgr_set_rt_stats (int block_size)
+memmgr_set_rt_stats (int block_size, int count)
 {
-    mem_stats.rt_mem_size += block_size;
-    mem_stats.rt_mem_blocks += 1;
-    mem_stats.rt_mem_overhead += memmgr_get_ipi_overhead_size ();
+    mem_stats.rt_mem_size += block_size * count;
+    mem_stats.rt_mem_blocks += count;
+    mem_stats.rt_mem_overhead += memmgr_get_ipi_overhead_size () * count;
 }
 
 
@@ -1301,7 +1917,13 @@ memmgr_get_ipi_trailer_offset (struct ipi_memblock_header *hdr)
 unsigned int
 memmgr_get_mtype_size (int mtype)
 {
-    return mtype_table[mtype].size;
+    struct ipi_mem_table sum;
+
+    MEMMGR_MUTEX_START;
+    memmgr_sum_mtype (mtype, &sum);
+    MEMMGR_MUTEX_END;
+
+    return sum.size;
 }
 
 /*
@@ -1312,7 +1934,13 @@ memmgr_get_mtype_size (int mtype)
 unsigned int
 memmgr_get_bucket_size (int bucket)
 {
-    return free_table[bucket].size;
+    unsigned int size;
+
+    size = memmgr_get_bucket_count (bucket) - free_table[bucket].count;
+    size *= memmgr_get_bucket_block_size (bucket) +
+            memmgr_get_ipi_overhead_size ();
+
+    return free_table[bucket].size + size;
 }
 
 /*
@@ -1323,7 +1951,13 @@ memmgr_get_bucket_size (int bucket)
 int
 memmgr_get_mtype_count (int mtype)
 {
-    return mtype_table[mtype].count;
+    struct ipi_mem_table sum;
+
+    MEMMGR_MUTEX_START;
+    memmgr_sum_mtype (mtype, &sum);
+    MEMMGR_MUTEX_END;
+
+    return sum.count;
 }
 
 /*
@@ -1334,7 +1968,25 @@ memmgr_get_mtype_count (int mtype)
 int
 memmgr_get_bucket_count (int bucket)
 {
-    return free_table[bucket].count;
+    int  count;
+#ifdef MEMMGR_TCACHE
+    struct memmgr_tcache *tc;
+#endif /* MEMMGR_TCACHE */
+
+    MEMMGR_MUTEX_START;
+
+    count = free_table[bucket].count;
+
+#ifdef MEMMGR_TCACHE
+    /* blocks cached in thread magazines are free as well */
+    if (bucket < MEMMGR_MAG_BUKT_COUNT)
+      for (tc = memmgr_tcache_list; tc != NULL; tc = tc->next)
+        count += tc->mag[bucket].count;
+#endif /* MEMMGR_TCACHE */
+
+    MEMMGR_MUTEX_END;
+
+    return count;
 }
 
 /*
@@ -1345,13 +1997,19 @@ memmgr_get_bucket_count (int bucket)
 unsigned int
 memmgr_get_total_mtype_size ()
 {
+    struct ipi_mem_table sum;
     unsigned int size;
     int      i;
 
     size = 0;
 
+    MEMMGR_MUTEX_START;
     for (i = 0; i < MTYPE_MAX; i++)
-       size += mtype_table[i].size;
+      {
+        memmgr_sum_mtype (i, &sum);
+        size += sum.size;
+      }
+    MEMMGR_MUTEX_END;
 
     return size;
 }
@@ -1364,13 +2022,19 @@ memmgr_get_total_mtype_size ()
 unsigned int
 memmgr_get_total_mtype_req_size ()
 {
+    struct ipi_mem_table sum;
     unsigned int size;
     int          i;
 
     size = 0;
 
+    MEMMGR_MUTEX_START;
     for (i = 0; i < MTYPE_MAX; i++)
-       size += mtype_table[i].req_size;
+      {
+        memmgr_sum_mtype (i, &sum);
+        size += sum.req_size;
+      }
+    MEMMGR_MUTEX_END;
 
     return size;
 }
@@ -1384,13 +2048,19 @@ memmgr_get_total_mtype_req_size ()
 int
 memmgr_get_total_mtype_count ()
 {
+    struct ipi_mem_table sum;
     int  count;
     int  i;
 
     count = 0;
 
+    MEMMGR_MUTEX_START;
     for (i = 0; i < MTYPE_MAX; i++)
-       count += mtype_table[i].count;
+      {
+        memmgr_sum_mtype (i, &sum);
+        count += sum.count;
+      }
+    MEMMGR_MUTEX_END;
 
     return count;
 }
@@ -1468,6 +2138,51 @@ memmgr_sem_delete (void)
 
     return ret;
 }
+
+#else
+
+/*
+ *  memmgr_sem_init ()
+ *
+ *  One-time creation of the recursive free table lock (memory manager log
+ *  messages may allocate while it is held) and the thread cache key.
+ */
+static void
+memmgr_sem_init (void)
+{
+    pthread_mutexattr_t attr;
+
+    pthread_mutexattr_init (&attr);
+    pthread_mutexattr_settype (&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init (&memmgr_mutex, &attr);
+    pthread_mutexattr_destroy (&attr);
+
+    pthread_key_create (&memmgr_tcache_key, memmgr_tcache_release);
+}
+
+int
+memmgr_sem_create (void)
+{
+    return pthread_once (&memmgr_once, memmgr_sem_init) == 0 ? 0 : -1;
+}
+
+int
+memmgr_sem_take (void)
+{
+    return pthread_mutex_lock (&memmgr_mutex);
+}
+
+int
+memmgr_sem_give (void)
+{
+    return pthread_mutex_unlock (&memmgr_mutex);
+}
+
+int
+memmgr_sem_delete (void)
+{
+    return 0;
+}
 #endif
 
 
@@ -13,8 +13,9 @@
 /*
  *  For each enabled protocol module, the memory manager pre-allocates 5 MB
  *  of memory at the start-up. When any given free bucket memory is used up,
- *  the mem manager obtains requested memory from system heap. At no point,
- *  any of the allocated memory is returned to the system pool.
+ *  the mem manager maps page-granular arenas of that bucket's block size.
+ *  The pre-allocated memory is never returned to the system pool; arenas
+ *  whose blocks are all free are released by a background compaction event.
  *
  *  Note that the memory manager gets more than 5 MB of memory to accommodate
  *  the overhead involved in maintaining the memory.
@@ -126,12 +127,36 @@
 
 #define BUKT_COUNT      13
 
+/*
+ *  Per-thread magazine caches.  Buckets up to BLK_1K are served from a
+ *  thread-local magazine; the magazine is refilled from, and returned to,
+ *  the shared free table MEMMGR_MAG_SIZE blocks at a time.
+ */
+#define MEMMGR_MAG_SIZE         32
+#define MEMMGR_MAG_BUKT_COUNT   (BUKT5 + 1)
+
+/*
+ *  On-demand arenas.  Each arena is MEMMGR_ARENA_SIZE bytes, aligned to its
+ *  size, and holds blocks of a single bucket.  Compaction keeps up to
+ *  MEMMGR_ARENA_KEEP empty arenas per bucket in use, parks further empty
+ *  arenas as dormant with their pages released, and unmaps dormant arenas
+ *  beyond MEMMGR_ARENA_DORMANT_MAX.
+ */
+#define MEMMGR_ARENA_SIZE         (256 * 1024)
+#define MEMMGR_ARENA_HDR_SIZE     64
+#define MEMMGR_ARENA_KEEP         1
+#define MEMMGR_ARENA_DORMANT_MAX  2
+#define MEMMGR_COMPACT_INTERVAL   30        /* seconds */
+
 /* Header bit fields */
 #define MEM_BLK_PALLOC   1   /* pre-allocated memory at the startup */
 #define MEM_BLK_MALLOC   2   /* memory obtained from system pool */
 #define MEM_BLK_FREE     4   /* in free pool */
 #define MEM_BLK_ALLOC    8   /* in allocated pool */
 
+/* Arena flags */
+#define MEM_ARENA_DORMANT  1   /* pages released, blocks not on free list */
+
 /* Global memory manager structure */
 struct ipi_mem_global
 {
@@ -169,6 +194,36 @@ struct ipi_mem_table
         unsigned int    count;      /* number of blocks allocated or free */
      };
 
+/*
+ *  On-demand arena header, at the start of each arena.  Blocks start at
+ *  MEMMGR_ARENA_HDR_SIZE.
+ */
+struct ipi_mem_arena
+     {
+        struct ipi_mem_arena *next;
+        struct ipi_mem_arena *prev;
+        unsigned short  bucket;
+        unsigned short  flags;
+        unsigned int    total;      /* blocks carved from this arena */
+        unsigned int    used;       /* blocks not on the free table */
+     };
+
+/*
+ *  Per bucket arena statistics for fragmentation display.
+ */
+struct ipi_mem_arena_stats
+     {
+        unsigned int  arenas;       /* mapped arenas holding blocks */
+        unsigned int  full;         /* no free block */
+        unsigned int  partial;      /* some blocks free */
+        unsigned int  empty;        /* all blocks free */
+        unsigned int  dormant;      /* mapped, pages released */
+        unsigned int  blocks;       /* blocks in mapped arenas */
+        unsigned int  used;         /* of which in use */
+        unsigned int  released;     /* arenas released so far */
+        unsigned int  unmapped;     /* arenas unmapped so far */
+     };
+
 /*
  *  This header precedes each user buffer.  This header size must be multiple of
  *  16 bytes to avoid alignment exceptions.
@@ -203,13 +258,11 @@ struct ipi_memblock_trailer
 /*
  *  Mutex semaphore support functions for any RTOS
  */
-#ifdef CPU  
+#ifndef CPU
+#define MEMMGR_TCACHE
+#endif
 #define MEMMGR_MUTEX_START      memmgr_sem_take()
 #define MEMMGR_MUTEX_END        memmgr_sem_give()
-#else
-#define MEMMGR_MUTEX_START
-#define MEMMGR_MUTEX_END
-#endif
 int         memmgr_sem_create (void);
 int         memmgr_sem_take (void);
 int         memmgr_sem_give (void);
@@ -246,4 +299,7 @@ unsigned int memmgr_get_rt_mem_size ();
 unsigned int memmgr_get_rt_mem_overhead ();
 unsigned int memmgr_get_rt_mem_blocks ();
 
+void         memmgr_get_arena_stats (int, struct ipi_mem_arena_stats *);
+int          memmgr_compact (void);
+
 #endif /* _MEMMGR_H */
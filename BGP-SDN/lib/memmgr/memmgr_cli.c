@@ -413,6 +413,59 @@ CLI (show_memory_free,
      return CLI_SUCCESS;
 }
 
+/*
+ *  memmgr_show_memory_fragmentation ()
+ *
+ *  Display on-demand arena occupancy per bucket.
+ */
+int
+memmgr_show_memory_fragmentation (struct cli *cli)
+{
+     struct ipi_mem_arena_stats st;
+     int  i;
+     int  occupancy;
+
+     cli_out (cli, "Block size  Arenas  Full Partial Empty Dormant   Blocks   In use  Occ%%  Released Unmapped\n");
+     cli_out (cli, "==========  ======  ==== ======= ===== =======  ======= ======== =====  ======== ========\n");
+
+     for (i = 0; i < BUKT_COUNT; i++)
+       {
+         memmgr_get_arena_stats (i, &st);
+
+         /* Divide first when the product would not fit an unsigned int.  */
+         if (! st.blocks)
+           occupancy = 0;
+         else if (st.used <= UINT32_MAX / 100)
+           occupancy = (int) (st.used * 100 / st.blocks);
+         else
+           occupancy = (int) (st.used / (st.blocks / 100));
+
+         cli_out (cli, "%-10d  %6u  %4u %7u %5u %7u  %7u %8u %4d%%  %8u %8u\n",
+                  memmgr_get_bucket_block_size (i), st.arenas, st.full,
+                  st.partial, st.empty, st.dormant, st.blocks, st.used,
+                  occupancy, st.released, st.unmapped);
+       }
+
+     return CLI_SUCCESS;
+}
+
+/*
+ *   show_memory_fragmentation()
+ *
+ *    Display arena occupancy of on-demand memory.
+ */
+CLI (show_memory_fragmentation,
+     show_memory_fragmentation_cli,
+     "show memory fragmentation",
+     CLI_SHOW_STR,
+     CLI_SHOW_MEMORY_STR,
+     "Occupancy of on-demand memory arenas")
+{
+     memmgr_show_memory_fragmentation (cli);
+
+     return CLI_SUCCESS;
+}
+
 /*
  *   memmgr_cli_init()
  *
@@ -431,6 +484,7 @@ memmgr_cli_init (struct lib_globals * lib_node)
 
     cli_install (ctree, EXEC_MODE, &show_memory_summary_cli);
     cli_install (ctree, EXEC_MODE, &show_memory_free_cli);
+    cli_install (ctree, EXEC_MODE, &show_memory_fragmentation_cli);
 
     return RESULT_OK;
 }
@@ -6,6 +6,7 @@
 int memmgr_cli_init (struct lib_globals * lib_node);
 int memmgr_show_memory_summary (struct cli *);
 int memmgr_show_memory_free (struct cli *);
+int memmgr_show_memory_fragmentation (struct cli *);
 int memmgr_show_memory_module (struct cli *, int);
 
 #endif /* _MEMMGR_CLI_H */
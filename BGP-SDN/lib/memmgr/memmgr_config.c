@@ -25,6 +25,7 @@ static struct mtype_info mtypes[] = {
    /* Thread */
    {MTYPE_THREAD_MASTER,             IPI_PROTO_MAX,     THREAD_MASTER_STR},
    {MTYPE_THREAD,                    IPI_PROTO_MAX,     THREAD_STR},
+   {MTYPE_THREAD_CPU,                IPI_PROTO_MAX,     THREAD_CPU_STR},
 
    /* Linklist */
    {MTYPE_LINK_LIST,                 IPI_PROTO_MAX,     LINK_LIST_STR},
@@ -301,10 +302,13 @@ static struct mtype_info mtypes[] = {
    {MTYPE_BGP_TABLE,                 IPI_PROTO_BGP,    BGP_TABLE_STR},
    {MTYPE_BGP_NODE,                  IPI_PROTO_BGP,    BGP_NODE_STR},
    {MTYPE_BGP_WALKER,                IPI_PROTO_BGP,    BGP_WALKER_STR},
+   {MTYPE_BGP_SOFT_RECONFIG,         IPI_PROTO_BGP,    BGP_SOFT_RECONFIG_STR},
    {MTYPE_PEER_UPDATE_SOURCE,        IPI_PROTO_BGP,    PEER_UPDATE_SOURCE_STR},
    {MTYPE_PEER_DESC,                 IPI_PROTO_BGP,    PEER_DESC_STR},
    {MTYPE_BGP_VRF,                   IPI_PROTO_BGP,    BGP_VRF_STR},
    {MTYPE_BGP_DUMP,                  IPI_PROTO_BGP,    BGP_DUMP_STR},
+   {MTYPE_BGP_EXPORT,                IPI_PROTO_BGP,    BGP_EXPORT_STR},
+   {MTYPE_BGP_PERF,                  IPI_PROTO_BGP,    BGP_PERF_STR},
    {MTYPE_BGP_MPLS_LABEL_REQ,        IPI_PROTO_BGP,    BGP_MPLS_LABEL_REQ_STR},
 #ifdef HAVE_EXT_CAP_ASN
    {MTYPE_AS4_PATH,                  IPI_PROTO_BGP,    AS4_PATH_STR},
@@ -22,6 +22,7 @@ struct mtype_info
 #define  HASH_BUCKET_STR        "Hash bucket"
 #define  THREAD_MASTER_STR      "Thread master"
 #define  THREAD_STR             "Thread"
+#define  THREAD_CPU_STR         "Thread CPU statistics"
 #define  LINK_LIST_STR          "Link list"
 #define  LIST_NODE_STR          "Link list node"
 #define  BUFFER_STR             "Buffer"
@@ -269,10 +270,13 @@ struct mtype_info
 #define  BGP_TABLE_STR                  "BGP table"
 #define  BGP_NODE_STR                   "BGP node"
 #define  BGP_WALKER_STR                 "BGP walker"
+#define  BGP_SOFT_RECONFIG_STR          "BGP Soft Reconfig Job"
 #define  PEER_UPDATE_SOURCE_STR         "BGP Peer Update Source"
 #define  PEER_DESC_STR                  "BGP Peer Description"
 #define  BGP_VRF_STR                    "BGP VRF list"
 #define  BGP_DUMP_STR                   "BGP dump"
+#define  BGP_EXPORT_STR                 "BGP RIB export"
+#define  BGP_PERF_STR                   "BGP peer latency statistics"
 #define  BGP_MPLS_LABEL_REQ_STR         "BGP MPLS label req"
 #ifdef HAVE_EXT_CAP_ASN
 #define  AS4_PATH_STR                    "BGP as4path"
@@ -18,6 +18,7 @@ enum memory_type
   /* Thread */
   MTYPE_THREAD_MASTER,
   MTYPE_THREAD,
+  MTYPE_THREAD_CPU,
 
   /* Linklist */
   MTYPE_LINK_LIST,
@@ -188,10 +189,13 @@ enum memory_type
   MTYPE_BGP_TABLE,
   MTYPE_BGP_NODE,
   MTYPE_BGP_WALKER,
+  MTYPE_BGP_SOFT_RECONFIG,
   MTYPE_PEER_UPDATE_SOURCE,
   MTYPE_PEER_DESC,
   MTYPE_BGP_VRF,
   MTYPE_BGP_DUMP,
+  MTYPE_BGP_EXPORT,
+  MTYPE_BGP_PERF,
 #ifdef HAVE_EXT_CAP_ASN
   MTYPE_AS4_PATH,
   MTYPE_AS4_SEG,
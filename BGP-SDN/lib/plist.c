@@ -467,26 +467,47 @@ prefix_list_entry_match_custom (struct prefix_list_entry *pentry,
   return ret;
 }
 
-enum prefix_list_type
-prefix_list_apply (struct prefix_list *plist, void *object)
+/* Walk the entries of PLIST.  Per-entry counters are only touched
+   when COUNT is set so that the common case does not dirty shared
+   entries on every lookup.  */
+static enum prefix_list_type
+prefix_list_apply_entries (struct prefix_list *plist, struct prefix *p,
+                           bool_t count)
 {
   struct prefix_list_entry *pentry;
-  struct prefix *p;
 
-  p = (struct prefix *) object;
+  for (pentry = plist->head; pentry; pentry = pentry->next)
+    {
+      if (count)
+        pentry->refcnt++;
 
-  if (! plist)
-    return PREFIX_NO_MATCH;
+      if (prefix_list_entry_match (pentry, p))
+        {
+          if (count)
+            pentry->hitcnt++;
+          return pentry->type;
+        }
+    }
 
-  if (plist->count == 0)
-    return PREFIX_PERMIT;
+  return PREFIX_NO_MATCH;
+}
+
+static enum prefix_list_type
+prefix_list_custom_apply_entries (struct prefix_list *plist,
+                                  result_t (* cust_func) (void *, void *),
+                                  void *object, bool_t count)
+{
+  struct prefix_list_entry *pentry;
 
   for (pentry = plist->head; pentry; pentry = pentry->next)
     {
-      pentry->refcnt++;
-      if (prefix_list_entry_match (pentry, p))
+      if (count)
+        pentry->refcnt++;
+
+      if (prefix_list_entry_match_custom (pentry, cust_func, object))
         {
-          pentry->hitcnt++;
+          if (count)
+            pentry->hitcnt++;
           return pentry->type;
         }
     }
@@ -494,12 +515,37 @@ prefix_list_apply (struct prefix_list *plist, void *object)
   return PREFIX_NO_MATCH;
 }
 
+enum prefix_list_type
+prefix_list_apply (struct prefix_list *plist, void *object)
+{
+  enum prefix_list_type ret;
+  u_int64_t start;
+
+  if (! plist)
+    return PREFIX_NO_MATCH;
+
+  if (plist->count == 0)
+    return PREFIX_PERMIT;
+
+  if (! PSTATS_ENABLED ())
+    return prefix_list_apply_entries (plist, (struct prefix *) object,
+                                      PAL_FALSE);
+
+  start = pstats_begin (&plist->stats);
+  ret = prefix_list_apply_entries (plist, (struct prefix *) object,
+                                   PAL_TRUE);
+  pstats_end (&plist->stats, start, ret != PREFIX_NO_MATCH);
+
+  return ret;
+}
+
 enum prefix_list_type
 prefix_list_custom_apply (struct prefix_list *plist,
                           result_t (* cust_func) (void *, void *),
                           void *object)
 {
-  struct prefix_list_entry *pentry;
+  enum prefix_list_type ret;
+  u_int64_t start;
 
   if (! plist)
     return PREFIX_NO_MATCH;
@@ -507,20 +553,18 @@ prefix_list_custom_apply (struct prefix_list *plist,
   if (plist->count == 0)
     return PREFIX_PERMIT;
 
-  for (pentry = plist->head; pentry; pentry = pentry->next)
-    {
-      pentry->refcnt++;
+  if (! PSTATS_ENABLED ())
+    return prefix_list_custom_apply_entries (plist, cust_func, object,
+                                             PAL_FALSE);
 
-      if (prefix_list_entry_match_custom (pentry, cust_func, object))
-        {
-          pentry->hitcnt++;
-          return pentry->type;
-        }
-    }
+  start = pstats_begin (&plist->stats);
+  ret = prefix_list_custom_apply_entries (plist, cust_func, object,
+                                          PAL_TRUE);
+  pstats_end (&plist->stats, start, ret != PREFIX_NO_MATCH);
 
-  return PREFIX_NO_MATCH;
+  return ret;
 }
-
+
 /* Retrun 1 when plist already include pentry policy. */
 struct prefix_list_entry *
 prefix_entry_dup_check (struct prefix_list *plist,
@@ -40,6 +40,9 @@ struct prefix_list
 
   struct prefix_list *next;
   struct prefix_list *prev;
+
+  /* Evaluation statistics, see pstats.h.  */
+  struct policy_stats stats;
 };
 
 struct orf_prefix
@@ -64,6 +67,8 @@ struct prefix_list_entry
   int any;
   struct prefix prefix;
 
+  /* Per-entry visit and hit counts.  Only maintained while policy
+     statistics are enabled.  */
   u_int32_t refcnt;
   u_int32_t hitcnt;
 
@@ -0,0 +1,79 @@
+/* Copyright (C) 2013 IP Infusion, Inc. All Rights Reserved. */
+
+#include "pal.h"
+#include "lib.h"
+
+/* Sampling interval, zero when policy statistics are disabled.  */
+u_int32_t pstats_sample_rate;
+
+static char *pstats_hist_label[PSTATS_HIST_MAX] =
+{
+  "<1us", "<10us", "<100us", "<1ms", "<10ms", ">=10ms"
+};
+
+/* Count an evaluation.  Return the start timestamp if this evaluation
+   is to be timed, otherwise 0.  */
+u_int64_t
+pstats_begin (struct policy_stats *ps)
+{
+  if (ps->eval++ % pstats_sample_rate)
+    return 0;
+
+  return pal_time_mono_nsec ();
+}
+
+void
+pstats_end (struct policy_stats *ps, u_int64_t start, bool_t matched)
+{
+  u_int64_t nsec;
+  u_int32_t bucket;
+  u_int64_t limit;
+
+  if (matched)
+    ps->match++;
+
+  if (! start)
+    return;
+
+  nsec = pal_time_mono_nsec () - start;
+
+  ps->sampled++;
+  ps->nsec += nsec;
+
+  for (bucket = 0, limit = 1000;
+       bucket < PSTATS_HIST_MAX - 1 && nsec >= limit;
+       bucket++, limit *= 10)
+    ;
+
+  ps->hist[bucket]++;
+}
+
+void
+pstats_reset (struct policy_stats *ps)
+{
+  pal_mem_set (ps, 0, sizeof (struct policy_stats));
+}
+
+void
+pstats_enable (u_int32_t rate)
+{
+  if (rate == 0 || rate > PSTATS_SAMPLE_RATE_MAX)
+    rate = PSTATS_SAMPLE_RATE_DEFAULT;
+
+  pstats_sample_rate = rate;
+}
+
+void
+pstats_disable (void)
+{
+  pstats_sample_rate = 0;
+}
+
+char *
+pstats_hist_str (u_int32_t bucket)
+{
+  if (bucket >= PSTATS_HIST_MAX)
+    return "";
+
+  return pstats_hist_label[bucket];
+}
@@ -0,0 +1,53 @@
+/* Copyright (C) 2013 IP Infusion, Inc. All Rights Reserved. */
+
+#ifndef _BGPSDN_PSTATS_H
+#define _BGPSDN_PSTATS_H
+
+/* Policy evaluation statistics.
+
+   Prefix-lists, route-map indexes and AS-path lists each carry a
+   struct policy_stats.  Collection is off by default; when it is
+   off the apply functions do not touch the counters at all.  When it
+   is on, every evaluation is counted and one in every
+   `pstats_sample_rate' evaluations of a given policy is timed with
+   the monotonic clock.  */
+
+/* Sampled latency buckets: <1us, <10us, <100us, <1ms, <10ms, >=10ms.  */
+#define PSTATS_HIST_MAX                 6
+
+#define PSTATS_SAMPLE_RATE_DEFAULT      64
+#define PSTATS_SAMPLE_RATE_MAX          65535
+
+struct policy_stats
+{
+  /* Number of evaluations.  */
+  u_int64_t eval;
+
+  /* Number of evaluations that matched an entry.  */
+  u_int64_t match;
+
+  /* Number of timed evaluations and their cumulative duration.  */
+  u_int64_t sampled;
+  u_int64_t nsec;
+
+  /* Distribution of the timed evaluations.  */
+  u_int32_t hist[PSTATS_HIST_MAX];
+};
+
+/* Zero while collection is disabled.  */
+extern u_int32_t pstats_sample_rate;
+
+#define PSTATS_ENABLED()        (pstats_sample_rate != 0)
+
+/* Estimated total time spent in a policy, extrapolated from samples.  */
+#define PSTATS_EST_NSEC(S)                                                    \
+    ((S)->sampled ? (S)->nsec / (S)->sampled * (S)->eval : 0)
+
+u_int64_t pstats_begin (struct policy_stats *);
+void pstats_end (struct policy_stats *, u_int64_t, bool_t);
+void pstats_reset (struct policy_stats *);
+void pstats_enable (u_int32_t);
+void pstats_disable (void);
+char *pstats_hist_str (u_int32_t);
+
+#endif /* _BGPSDN_PSTATS_H */
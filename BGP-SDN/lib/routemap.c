@@ -837,6 +837,7 @@ route_map_apply (struct route_map *map, struct prefix *prefix, void *object)
 {
   struct route_map_index *index;
   route_map_result_t ret;
+  u_int64_t start;
 
   ret = RMAP_NOMATCH;
 
@@ -846,7 +847,14 @@ route_map_apply (struct route_map *map, struct prefix *prefix, void *object)
   for (index = map->head; index; index = index->next)
     {
       /* Apply this index, until we get the end of route-map case. */
-      ret = route_map_apply_index (index, prefix, object);
+      if (! PSTATS_ENABLED ())
+        ret = route_map_apply_index (index, prefix, object);
+      else
+        {
+          start = pstats_begin (&index->stats);
+          ret = route_map_apply_index (index, prefix, object);
+          pstats_end (&index->stats, start, ret != RMAP_NOMATCH);
+        }
 
       if (ret == RMAP_MATCH || ret == RMAP_DENYMATCH)
         return ret;
@@ -114,6 +114,8 @@ struct route_map_index
   /* Make linked list. */
   struct route_map_index *next;
   struct route_map_index *prev;
+  /* Evaluation statistics, see pstats.h.  */
+  struct policy_stats stats;
 };
 
 /* Route map list structure. */
@@ -107,6 +107,23 @@ typedef u_int8_t *(FindVarMethod)(struct variable *v,
                                   WriteMethod **write_method,
                                   u_int32_t vr_id);
 
+/* Called by a bulk iterator for every row it produces.  Returns
+   non-zero when the caller wants no more rows. */
+typedef s_int32_t (BulkAddMethod)(void *arg, oid *name, size_t length,
+                                  u_int8_t val_type, void *val,
+                                  size_t val_len);
+
+/* Bulk iterator of a table column.  Walks up to max_rows instances
+   following 'name' in a single pass and hands each one to 'add'.
+   Returns the number of rows produced. */
+typedef s_int32_t (FindBulkMethod)(struct variable *v,
+                                   oid *name,
+                                   size_t *length,
+                                   s_int32_t max_rows,
+                                   BulkAddMethod *add,
+                                   void *arg,
+                                   u_int32_t vr_id);
+
 /* SNMP variable */
 struct variable
 {
@@ -128,6 +145,9 @@ struct variable
 
   /* Lib globals */
   struct lib_globals *lg;
+
+  /* Optional bulk iterator for GetBulk, NULL if none. */
+  FindBulkMethod *findBulk;
 };
 
 /* SNMP tree. */
@@ -873,6 +873,7 @@ stream_sock_cb_read (struct thread *t_ssock_read)
   enum ssock_error ret;
   s_int32_t sock_read;
   s_int32_t ret_val;
+  u_int64_t start;
 
   sock_errno = RESULT_OK;
   ret = SSOCK_ERR_NONE;
@@ -916,10 +917,18 @@ READ_AGAIN:
 
   /* Socket 'read' System Call */
   if (sock_readsize)
-    sock_read = pal_sock_read (ssock_cb->ssock_fd,
-                               (ssock_cb->ssock_ibuf->data +
-                                ssock_cb->ssock_ibuf->putp),
-                               sock_readsize);
+    {
+      start = ssock_cb->ssock_time_func ? pal_time_mono_nsec () : 0;
+
+      sock_read = pal_sock_read (ssock_cb->ssock_fd,
+                                 (ssock_cb->ssock_ibuf->data +
+                                  ssock_cb->ssock_ibuf->putp),
+                                 sock_readsize);
+
+      if (start && sock_read > 0)
+        ssock_cb->ssock_time_func (ssock_cb, SSOCK_IO_READ,
+                                   pal_time_mono_nsec () - start);
+    }
 
   /* Process the return value */
   if (sock_read < 0)
@@ -1046,6 +1055,7 @@ stream_sock_cb_write (struct thread *t_ssock_write)
   s_int32_t sock_errno;
   enum ssock_error ret;
   s_int32_t ret_val;
+  u_int64_t start;
 
   sock_errno = RESULT_OK;
   ret = SSOCK_ERR_NONE;
@@ -1096,9 +1106,17 @@ WRITE_AGAIN:
 
   /* Socket 'write' System Call */
   if (sock_writesize)
-    sock_written = pal_sock_write (ssock_cb->ssock_fd,
-                                   (cq_wbuf->data + cq_wbuf->getp),
-                                   sock_writesize);
+    {
+      start = ssock_cb->ssock_time_func ? pal_time_mono_nsec () : 0;
+
+      sock_written = pal_sock_write (ssock_cb->ssock_fd,
+                                     (cq_wbuf->data + cq_wbuf->getp),
+                                     sock_writesize);
+
+      if (start && sock_written > 0)
+        ssock_cb->ssock_time_func (ssock_cb, SSOCK_IO_WRITE,
+                                   pal_time_mono_nsec () - start);
+    }
 
   /* Process the return value */
   if (sock_written < 0)
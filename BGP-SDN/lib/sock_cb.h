@@ -69,8 +69,15 @@ struct stream_sock_cb
 
   /* Stream Socket CB Read Function Argument */
   u_int32_t ssock_read_func_arg;
+
+  /* Stream Socket CB I/O Timing Function Pointer */
+  void (*ssock_time_func) (struct stream_sock_cb *, u_int8_t, u_int64_t);
 };
 
+/* Directions reported to the I/O Timing Function */
+#define SSOCK_IO_READ                       (0)
+#define SSOCK_IO_WRITE                      (1)
+
 /* Socket-CB Status Function Type */
 typedef void (*ssock_cb_status_func_t) (struct stream_sock_cb *,
                                         s_int32_t,
@@ -81,6 +88,10 @@ typedef enum ssock_error (*ssock_cb_read_func_t) (struct stream_sock_cb *,
                                                   u_int32_t,
                                                   struct lib_globals *);
 
+/* Socket-CB I/O Timing Function Type */
+typedef void (*ssock_cb_time_func_t) (struct stream_sock_cb *,
+                                      u_int8_t, u_int64_t);
+
 /* Macro for Starting Steam Socket Read Thread */
 #define SSOCK_CB_READ_ON(LIB_GLOB, THREAD, THREAD_ARG,                \
                          THREAD_FUNC, SOCK_FD)                        \
@@ -169,6 +180,11 @@ do {                                                                  \
 #define SSOCK_CB_SET_READ_FUNC_ARG(SSOCK_CB, READ_FUNC_ARG)           \
   (((SSOCK_CB)->ssock_read_func_arg) = (READ_FUNC_ARG))
 
+/* Macro to set SOCK-CB I/O timing-func, called with the duration of
+   every socket read and write system call */
+#define SSOCK_CB_SET_TIME_FUNC(SSOCK_CB, TIME_FUNC)                   \
+  (((SSOCK_CB)->ssock_time_func) = (TIME_FUNC))
+
 /* Macro to get SOCK-CB ssock_fd */
 #define SSOCK_CB_GET_SSOCK_FD(SSOCK_CB)                               \
   ((SSOCK_CB) ? ((SSOCK_CB)->ssock_fd) : -1)
@@ -5,6 +5,8 @@
 #include "lib.h"
 #include "thread.h"
 #include "timeutil.h"
+#include "cli.h"
+#include "log.h"
 
 /*
    Thread.c maintains a list of all the "callbacks" waiting to run.
@@ -41,8 +43,13 @@
 struct thread_master *
 thread_master_create ()
 {
-  return (struct thread_master *) XCALLOC (MTYPE_THREAD_MASTER,
-                                           sizeof (struct thread_master));
+  struct thread_master *m;
+
+  m = XCALLOC (MTYPE_THREAD_MASTER, sizeof (struct thread_master));
+  if (m)
+    thread_cpu_warn_set (m, THREAD_CPU_WARN_MSEC);
+
+  return m;
 }
 
 /* Add a new thread to the list.  */
@@ -166,6 +173,25 @@ thread_list_clear (struct lib_globals *zg, struct thread_list *list)
     }
 }
 
+/* Free the callback runtime statistics.  */
+static void
+thread_cpu_free (struct thread_master *m)
+{
+  struct thread_cpu *tc;
+  struct thread_cpu *next;
+  int i;
+
+  for (i = 0; i < THREAD_CPU_HASH_SIZE; i++)
+    {
+      for (tc = m->cpu[i]; tc; tc = next)
+        {
+          next = tc->next;
+          XFREE (MTYPE_THREAD_CPU, tc);
+        }
+      m->cpu[i] = NULL;
+    }
+}
+
 /* Stop thread scheduler. */
 void
 thread_master_finish (struct thread_master *m)
@@ -180,9 +206,11 @@ thread_master_finish (struct thread_master *m)
   thread_list_free (m, &m->write);
   for (i = 0; i < THREAD_TIMER_SLOT; i++)
     thread_list_free (m, &m->timer[i]);
+  thread_list_free (m, &m->timer_high);
   thread_list_free (m, &m->event);
   thread_list_free (m, &m->event_low);
   thread_list_free (m, &m->unuse);
+  thread_cpu_free (m);
 
   XFREE (MTYPE_THREAD_MASTER, m);
 }
@@ -412,6 +440,38 @@ thread_add_timer_timeval (struct lib_globals *zg,
   return thread;
 }
 
+/* Add high priority timer thread.  It is run by thread_fetch() as
+   soon as it expires, so its delay does not grow with the number of
+   ready threads.  The callback must be short.  */
+struct thread *
+thread_add_timer_high (struct lib_globals *zg,
+                       int (*func) (struct thread *),
+                       void *arg, long timer)
+{
+  struct thread_master *m = zg->master;
+  struct pal_timeval timer_now;
+  struct thread *thread;
+  struct thread *tt;
+
+  pal_assert (m != NULL);
+  thread = thread_get (zg, THREAD_TIMER_HIGH, func, arg);
+  if (thread == NULL)
+    return NULL;
+
+  pal_time_tzcurrent (&timer_now, NULL);
+  timer_now.tv_sec += timer;
+  thread->u.sands = timer_now;
+
+  /* Sort by timeval. */
+  for (tt = m->timer_high.tail; tt; tt = tt->prev)
+    if (timeval_cmp (thread->u.sands, tt->u.sands) >= 0)
+      break;
+
+  thread_list_add_after (&m->timer_high, tt, thread);
+
+  return thread;
+}
+
 /* Add simple event thread. */
 struct thread *
 thread_add_event (struct lib_globals *zg,
@@ -494,6 +554,9 @@ thread_cancel (struct thread *thread)
     case THREAD_TIMER:
       thread_list_delete (&thread->master->timer[(int)thread->index], thread);
       break;
+    case THREAD_TIMER_HIGH:
+      thread_list_delete (&thread->master->timer_high, thread);
+      break;
     case THREAD_EVENT:
       thread_list_delete (&thread->master->event, thread);
       break;
@@ -679,6 +742,22 @@ thread_cancel_timer (struct lib_globals *zg, void *arg)
             }
         }
     }
+
+  thread = m->timer_high.head;
+  while (thread)
+    {
+      struct thread *t;
+
+      t = thread;
+      thread = t->next;
+
+      if (t->arg == arg)
+        {
+          thread_list_delete (&m->timer_high, t);
+          t->type = THREAD_UNUSED;
+          thread_add_unuse (m, t);
+        }
+    }
 }
 
 struct pal_timeval *
@@ -727,6 +806,14 @@ thread_timer_wait (struct thread_master *m, struct pal_timeval *timer_val)
           timer_wait = &thread->u.sands;
       }
 
+  if ((thread = m->timer_high.head) != NULL)
+    {
+      if (! timer_wait)
+        timer_wait = &thread->u.sands;
+      else if (timeval_cmp (thread->u.sands, *timer_wait) < 0)
+        timer_wait = &thread->u.sands;
+    }
+
   if (timer_wait)
     {
       timer_min = *timer_wait;
@@ -767,6 +854,14 @@ thread_timer_wait (struct thread_master *m, struct pal_timeval *timer_val)
           timer_wait = &thread->u.sands;
       }
 
+  if ((thread = m->timer_high.head) != NULL)
+    {
+      if (! timer_wait)
+        timer_wait = &thread->u.sands;
+      else if (timeval_cmp (thread->u.sands, *timer_wait) < 0)
+        timer_wait = &thread->u.sands;
+    }
+
   if (timer_wait)
     {
       timer_min = *timer_wait;
@@ -794,6 +889,10 @@ struct thread *
 thread_run (struct thread_master *m, struct thread *thread,
             struct thread *fetch)
 {
+  if (thread->type == THREAD_QUEUE && thread->ready_nsec)
+    lathist_record (&m->queue_wait[(int) thread->priority],
+                    pal_time_mono_nsec () - thread->ready_nsec);
+
   *fetch = *thread;
   thread->type = THREAD_UNUSED;
   thread_add_unuse (m, thread);
@@ -803,24 +902,30 @@ thread_run (struct thread_master *m, struct thread *thread,
 void
 thread_enqueue_high (struct thread_master *m, struct thread *thread)
 {
+  thread->ready_type = thread->type;
   thread->type = THREAD_QUEUE;
   thread->priority = THREAD_PRIORITY_HIGH;
+  thread->ready_nsec = pal_time_mono_nsec ();
   thread_list_add (&m->queue_high, thread);
 }
 
 void
 thread_enqueue_middle (struct thread_master *m, struct thread *thread)
 {
+  thread->ready_type = thread->type;
   thread->type = THREAD_QUEUE;
   thread->priority = THREAD_PRIORITY_MIDDLE;
+  thread->ready_nsec = pal_time_mono_nsec ();
   thread_list_add (&m->queue_middle, thread);
 }
 
 void
 thread_enqueue_low (struct thread_master *m, struct thread *thread)
 {
+  thread->ready_type = thread->type;
   thread->type = THREAD_QUEUE;
   thread->priority = THREAD_PRIORITY_LOW;
+  thread->ready_nsec = pal_time_mono_nsec ();
   thread_list_add (&m->queue_low, thread);
 }
 
@@ -883,6 +988,17 @@ thread_fetch (struct lib_globals *zg, struct thread *fetch)
       if ((thread = thread_trim_head (&m->read_pend)) != NULL)
         return thread_run (m, thread, fetch);
 
+      /* Expired high priority timers go before the ready queues.  */
+      if ((thread = m->timer_high.head) != NULL)
+        {
+          pal_time_tzcurrent (&timer_now, NULL);
+          if (timeval_cmp (timer_now, thread->u.sands) >= 0)
+            {
+              thread_list_delete (&m->timer_high, thread);
+              return thread_run (m, thread, fetch);
+            }
+        }
+
       /* Check ready queue.  */
       if ((thread = thread_trim_head (&m->queue_high)) != NULL)
         return thread_run (m, thread, fetch);
@@ -959,11 +1075,84 @@ thread_fetch (struct lib_globals *zg, struct thread *fetch)
     }
 }
 
+/* Callbacks longer than MSEC are logged, 0 turns the warning off.  */
+void
+thread_cpu_warn_set (struct thread_master *m, u_int32_t msec)
+{
+  m->cpu_warn_nsec = (u_int64_t) msec * 1000000;
+}
+
+static struct thread_cpu *
+thread_cpu_get (struct thread_master *m, int (*func) (struct thread *))
+{
+  struct thread_cpu *tc;
+  u_int32_t key;
+
+  key = (u_int32_t) ((pal_size_t) func >> 4) % THREAD_CPU_HASH_SIZE;
+
+  for (tc = m->cpu[key]; tc; tc = tc->next)
+    if (tc->func == func)
+      return tc;
+
+  tc = XCALLOC (MTYPE_THREAD_CPU, sizeof (struct thread_cpu));
+  if (tc == NULL)
+    return NULL;
+
+  tc->func = func;
+  tc->next = m->cpu[key];
+  m->cpu[key] = tc;
+
+  return tc;
+}
+
+/* Account a callback that ran for NSEC.  */
+static void
+thread_cpu_account (struct thread_master *m, struct thread *thread,
+                    u_int64_t nsec)
+{
+  struct thread_cpu *tc;
+  char name[64];
+  char run[LATHIST_STR_LEN];
+  int type;
+
+  tc = thread_cpu_get (m, thread->func);
+  if (tc == NULL)
+    return;
+
+  lathist_record (&tc->run, nsec);
+
+  type = thread->type == THREAD_QUEUE ? thread->ready_type : thread->type;
+  if (type < 16)
+    tc->types |= (1 << type);
+
+  if (m->cpu_warn_nsec && nsec > m->cpu_warn_nsec)
+    {
+      tc->slow++;
+      if (thread->zg)
+        zlog_warn (thread->zg, "Thread %s ran for %s",
+                   pal_addr_symbol ((void *) thread->func, name, sizeof (name)),
+                   lathist_nsec_str (nsec, run));
+    }
+}
+
 /* Call the thread.  */
 void
 thread_call (struct thread *thread)
 {
+  struct thread_master *m = thread->master;
+  u_int64_t start;
+
+  /* Threads faked by thread_execute() have no master and are
+     accounted to the callback they run in.  */
+  if (m == NULL)
+    {
+      (*thread->func) (thread);
+      return;
+    }
+
+  start = pal_time_mono_nsec ();
   (*thread->func) (thread);
+  thread_cpu_account (m, thread, pal_time_mono_nsec () - start);
 }
 
 /* Fake execution of the thread with given arguemment.  */
@@ -991,6 +1180,147 @@ thread_execute (struct lib_globals *zg,
   return NULL;
 }
 
+static char *thread_queue_str[THREAD_PRIORITY_MAX] =
+{
+  "high", "middle", "low"
+};
+
+/* Thread type letters, indexed by THREAD_xxx.  */
+static char thread_type_char[] = "RWTE??HPLX";
+
+/* Sort by total runtime, largest first.  */
+static int
+thread_cpu_cmp (const void *a, const void *b)
+{
+  struct thread_cpu *ta = *(struct thread_cpu **) a;
+  struct thread_cpu *tb = *(struct thread_cpu **) b;
+
+  if (ta->run.sum > tb->run.sum)
+    return -1;
+  if (ta->run.sum < tb->run.sum)
+    return 1;
+  return 0;
+}
+
+static void
+thread_lathist_show (struct cli *cli, char *name, struct lathist *lh)
+{
+  char mean[LATHIST_STR_LEN];
+  char p50[LATHIST_STR_LEN];
+  char p99[LATHIST_STR_LEN];
+  char max[LATHIST_STR_LEN];
+  char total[LATHIST_STR_LEN];
+  char count[LATHIST_U64_STR_LEN];
+
+  cli_out (cli, "  %-32s %10s %9s %9s %9s %9s %9s",
+           name, lathist_u64_str (lh->count, count),
+           lathist_nsec_str (lh->sum, total),
+           lathist_nsec_str (lathist_mean (lh), mean),
+           lathist_nsec_str (lathist_percentile (lh, 500), p50),
+           lathist_nsec_str (lathist_percentile (lh, 990), p99),
+           lathist_nsec_str (lh->max, max));
+}
+
+CLI (show_thread_cpu,
+     show_thread_cpu_cli,
+     "show thread cpu",
+     CLI_SHOW_STR,
+     "Thread scheduler",
+     "Callback runtime and ready queue wait")
+{
+  struct thread_master *m = cli->zg->master;
+  struct thread_cpu **sorted;
+  struct thread_cpu *tc;
+  char warn[LATHIST_STR_LEN];
+  char name[64];
+  char types[16];
+  u_int32_t count;
+  u_int32_t i;
+  u_int32_t j;
+  u_int32_t n;
+
+  cli_out (cli, "Ready queue wait:\n");
+  cli_out (cli, "  %-32s %10s %9s %9s %9s %9s %9s\n",
+           "Queue", "Threads", "Total", "Mean", "p50", "p99", "Max");
+  for (i = 0; i < THREAD_PRIORITY_MAX; i++)
+    {
+      thread_lathist_show (cli, thread_queue_str[i], &m->queue_wait[i]);
+      cli_out (cli, "\n");
+    }
+
+  for (i = 0, count = 0; i < THREAD_CPU_HASH_SIZE; i++)
+    for (tc = m->cpu[i]; tc; tc = tc->next)
+      count++;
+
+  if (m->cpu_warn_nsec)
+    cli_out (cli, "\nCallback runtime, warning above %s:\n",
+             lathist_nsec_str (m->cpu_warn_nsec, warn));
+  else
+    cli_out (cli, "\nCallback runtime:\n");
+
+  if (count == 0)
+    return CLI_SUCCESS;
+
+  sorted = XMALLOC (MTYPE_TMP, count * sizeof (struct thread_cpu *));
+  if (sorted == NULL)
+    return CLI_ERROR;
+
+  for (i = 0, count = 0; i < THREAD_CPU_HASH_SIZE; i++)
+    for (tc = m->cpu[i]; tc; tc = tc->next)
+      sorted[count++] = tc;
+
+  pal_qsort (sorted, count, sizeof (struct thread_cpu *), thread_cpu_cmp);
+
+  cli_out (cli, "  %-32s %10s %9s %9s %9s %9s %9s %6s %s\n",
+           "Function", "Calls", "Total", "Mean", "p50", "p99", "Max",
+           "Slow", "Type");
+  for (i = 0; i < count; i++)
+    {
+      tc = sorted[i];
+
+      for (j = 0, n = 0; thread_type_char[j]; j++)
+        if (tc->types & (1 << j))
+          types[n++] = thread_type_char[j];
+      types[n] = '\0';
+
+      thread_lathist_show (cli,
+                           pal_addr_symbol ((void *) tc->func,
+                                            name, sizeof (name)),
+                           &tc->run);
+      cli_out (cli, " %6u %s\n", tc->slow, types);
+    }
+
+  XFREE (MTYPE_TMP, sorted);
+
+  return CLI_SUCCESS;
+}
+
+CLI (clear_thread_cpu,
+     clear_thread_cpu_cli,
+     "clear thread cpu",
+     CLI_CLEAR_STR,
+     "Thread scheduler",
+     "Callback runtime and ready queue wait")
+{
+  struct thread_master *m = cli->zg->master;
+  int i;
+
+  thread_cpu_free (m);
+  for (i = 0; i < THREAD_PRIORITY_MAX; i++)
+    lathist_reset (&m->queue_wait[i]);
+
+  return CLI_SUCCESS;
+}
+
+void
+thread_cli_init (struct cli_tree *ctree)
+{
+  cli_install_gen (ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
+                   &show_thread_cpu_cli);
+  cli_install_gen (ctree, EXEC_MODE, PRIVILEGE_NORMAL, 0,
+                   &clear_thread_cpu_cli);
+}
+
 /* Real time OS support routine.  */
 #ifdef HAVE_RTOS_TIC
 #ifdef RTOS_EXECUTE_ONE_THREAD
@@ -4,6 +4,9 @@
 #define _BGPSDN_THREAD_H
 
 #include "pal.h"
+#include "lathist.h"
+
+struct cli_tree;
 
 /* Linked list of thread. */
 struct thread_list
@@ -13,6 +16,12 @@ struct thread_list
   u_int32_t count;
 };
 
+/* Ready queue priorities.  */
+#define THREAD_PRIORITY_HIGH         0
+#define THREAD_PRIORITY_MIDDLE       1
+#define THREAD_PRIORITY_LOW          2
+#define THREAD_PRIORITY_MAX          3
+
 /* Master of the theads. */
 struct thread_master
 {
@@ -26,6 +35,10 @@ struct thread_master
   int index;
   struct thread_list timer[THREAD_TIMER_SLOT];
 
+  /* Timers that are run as soon as they expire, ahead of the ready
+     queues, for the work that must not wait behind a backlog.  */
+  struct thread_list timer_high;
+
   /* Thread to be executed.  */
   struct thread_list read_pend;
   struct thread_list read_high;
@@ -39,6 +52,34 @@ struct thread_master
   pal_sock_set_t exceptfd;
   int max_fd;
   u_int32_t alloc;
+
+  /* Runtime per callback function.  */
+#define THREAD_CPU_HASH_SIZE        256
+  struct thread_cpu *cpu[THREAD_CPU_HASH_SIZE];
+
+  /* Time ready threads wait in queue_high, queue_middle and
+     queue_low, indexed by priority.  */
+  struct lathist queue_wait[THREAD_PRIORITY_MAX];
+
+  /* Callbacks running longer than this are logged.  */
+#define THREAD_CPU_WARN_MSEC        100
+  u_int64_t cpu_warn_nsec;
+};
+
+/* Runtime of the callbacks of one function.  */
+struct thread_cpu
+{
+  struct thread_cpu *next;
+
+  int (*func) (struct thread *);
+
+  /* Thread types it was scheduled as, bitmask of 1 << THREAD_xxx.  */
+  u_int16_t types;
+
+  /* Runs longer than the warning threshold.  */
+  u_int32_t slow;
+
+  struct lathist run;
 };
 
 /* Thread structure. */
@@ -65,13 +106,13 @@ struct thread
 
   /* Priority.  */
   char priority;
-#define THREAD_PRIORITY_HIGH         0
-#define THREAD_PRIORITY_MIDDLE       1
-#define THREAD_PRIORITY_LOW          2
 
   /* Thread timer index.  */
   char index;
 
+  /* Thread type before it was put on a ready queue.  */
+  char ready_type;
+
   /* Arguments.  */
   union 
   {
@@ -84,6 +125,9 @@ struct thread
     /* Rest of time sands value.  */
     struct pal_timeval sands;
   } u;
+
+  /* Monotonic time it was put on a ready queue, in ns.  */
+  u_int64_t ready_nsec;
 };
 
 /* Thread types.  */
@@ -96,6 +140,7 @@ struct thread
 #define THREAD_READ_HIGH        6
 #define THREAD_READ_PEND        7
 #define THREAD_EVENT_LOW        8
+#define THREAD_TIMER_HIGH       9
 
 /* Macros.  */
 #define THREAD_ARG(X)           ((X)->arg)
@@ -160,6 +205,8 @@ struct thread *thread_add_timer (struct lib_globals *,
 struct thread *thread_add_timer_timeval (struct lib_globals *,
                                          int (*)(struct thread *),
                                          void *, struct pal_timeval);
+struct thread *thread_add_timer_high (struct lib_globals *,
+                                      int (*)(struct thread *), void *, long);
 struct thread *thread_add_event (struct lib_globals *,
                                  int (*)(struct thread *), void *,
                                  int);
@@ -180,6 +227,8 @@ struct thread *thread_execute (struct lib_globals *,
                                int (*)(struct thread *), void *,
                                int);
 void thread_call (struct thread *);
+void thread_cpu_warn_set (struct thread_master *, u_int32_t);
+void thread_cli_init (struct cli_tree *);
 u_int32_t thread_timer_remain_second (struct thread *);
 
 #endif /* _BGPSDN_THREAD_H */
@@ -126,7 +126,7 @@ vty_out (struct vty *vty, const char *format, ...)
       mem_allocation = 1;
 
       va_start (args, format);
-      len = zvsnprintf (p, len, format, args);
+      len = zvsnprintf (p, len + 1, format, args);
       va_end (args);
     }
   else
@@ -2,6 +2,7 @@
 
 #include "pal.h"
 #include "sys/syslog.h"
+#include <pthread.h>
 
 #include "pal_log.h"
 #include "memory.h"
@@ -10,6 +11,20 @@
 #define ZLOG_PATH_SPLAT "/var/opt/OPSEC/ipinfusion/BGP-SDN-SRS/log"
 #endif /* HAVE_SPLAT */
 
+/* Asynchronous writer state.  The writer mutex is held by whoever drains
+   the log ring, so the drain callback never runs concurrently and log
+   configuration changes can exclude it.  */
+static pthread_mutex_t log_writer_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t log_writer_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t log_writer_thread;
+static pthread_t log_main_thread;
+static void (*log_writer_drain) (void *);
+static void *log_writer_arg;
+static bool_t log_writer_running;
+
+/* Set while a batch is being written; per-line flushes are deferred.  */
+static bool_t log_batch;
+
 static void
 log_print (FILE *fp, char *pristr, const char *protostr, char *msgstr)
 {
@@ -28,7 +43,8 @@ log_print (FILE *fp, char *pristr, const char *protostr, char *msgstr)
   else
     fprintf (fp, "%s %s: %s: %s\n", ret ? buf : "(incomplete)",
              pristr, protostr, msgstr);
-  fflush (fp);
+  if (! log_batch)
+    fflush (fp);
 }
 
 void *
@@ -361,6 +377,125 @@ pal_log_unset_file (struct zlog *zl, char *logfile)
   return 0;
 }
 
+/* Begin or end a batch of output to ZL.  Ending the batch flushes the
+   streams that were written.  */
+void
+pal_log_batch (struct zlog *zl, bool_t on)
+{
+  struct pal_log_data *plog;
+
+  log_batch = on;
+  if (on || zl == NULL)
+    return;
+
+  if (zl->flags & ZLOG_STDOUT)
+    fflush (stdout);
+
+  if (zl->flags & ZLOG_STDERR)
+    fflush (stderr);
+
+  plog = (struct pal_log_data *)zl->pal_log_data;
+  if ((zl->flags & ZLOG_FILE) && plog && plog->fp)
+    fflush (plog->fp);
+}
+
+static void *
+pal_log_writer_main (void *arg)
+{
+  struct timespec ts;
+
+  pthread_mutex_lock (&log_writer_mutex);
+  while (log_writer_running)
+    {
+      log_writer_drain (log_writer_arg);
+
+      /* Sleep until kicked, or at most PAL_LOG_WRITER_MSEC.  */
+      clock_gettime (CLOCK_REALTIME, &ts);
+      ts.tv_nsec += PAL_LOG_WRITER_MSEC * 1000000L;
+      if (ts.tv_nsec >= 1000000000L)
+        {
+          ts.tv_sec++;
+          ts.tv_nsec -= 1000000000L;
+        }
+      pthread_cond_timedwait (&log_writer_cond, &log_writer_mutex, &ts);
+    }
+
+  /* Final drain so nothing queued before stop is lost.  */
+  log_writer_drain (log_writer_arg);
+  pthread_mutex_unlock (&log_writer_mutex);
+
+  return NULL;
+}
+
+/* Start the log writer thread calling DRAIN (ARG) for every batch.  The
+   calling thread is recorded as the main thread.  */
+int
+pal_log_writer_start (void (*drain) (void *), void *arg)
+{
+  int ret;
+
+  if (log_writer_running)
+    return 0;
+
+  log_main_thread = pthread_self ();
+  log_writer_drain = drain;
+  log_writer_arg = arg;
+  log_writer_running = PAL_TRUE;
+
+  ret = pthread_create (&log_writer_thread, NULL, pal_log_writer_main, NULL);
+  if (ret != 0)
+    {
+      log_writer_running = PAL_FALSE;
+      return -1;
+    }
+
+  return 0;
+}
+
+/* Stop the log writer thread after a final drain.  */
+void
+pal_log_writer_stop (void)
+{
+  if (! log_writer_running)
+    return;
+
+  pthread_mutex_lock (&log_writer_mutex);
+  log_writer_running = PAL_FALSE;
+  pthread_cond_signal (&log_writer_cond);
+  pthread_mutex_unlock (&log_writer_mutex);
+
+  pthread_join (log_writer_thread, NULL);
+}
+
+/* Wake the log writer.  Does not take the writer mutex.  */
+void
+pal_log_writer_kick (void)
+{
+  pthread_cond_signal (&log_writer_cond);
+}
+
+/* Exclude the log writer.  */
+void
+pal_log_writer_lock (void)
+{
+  pthread_mutex_lock (&log_writer_mutex);
+}
+
+void
+pal_log_writer_unlock (void)
+{
+  pthread_mutex_unlock (&log_writer_mutex);
+}
+
+/* Return PAL_TRUE when the log writer is running and the caller is the
+   thread that started it.  */
+bool_t
+pal_log_thread_is_main (void)
+{
+  return log_writer_running
+         && pthread_equal (pthread_self (), log_main_thread);
+}
+
 /* Start log system. */
 int
 pal_log_start (struct lib_globals *zg)
@@ -16,6 +16,9 @@
 #define TIME_BUF            27
 #define PATHNAME_BUF        1024
 
+/* Maximum time the log writer sleeps between batches (msec). */
+#define PAL_LOG_WRITER_MSEC 10
+
 struct pal_log_data
 {
   FILE *fp;
@@ -2,6 +2,7 @@
 
 #include "pal.h"
 #include "memory.h"  
+#include <sys/mman.h>
 
 /* Preallocate memory. */
 void *
@@ -84,3 +85,52 @@ pal_strdup (enum memory_type type, const char *s)
 {
   return strdup(s);
 }
+
+/* Map SIZE bytes of zeroed pages aligned to ALIGN.  Over-map by ALIGN and
+   trim the unaligned head and tail.  */
+void *
+pal_mem_page_map (size_t size, size_t align)
+{
+  char *mem;
+  char *aligned;
+  size_t head;
+  size_t tail;
+
+  mem = mmap (NULL, size + align, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED)
+    return NULL;
+
+  aligned = (char *) (((unsigned long) mem + align - 1) & ~(align - 1));
+  head = aligned - mem;
+  tail = align - head;
+
+  if (head)
+    munmap (mem, head);
+  if (tail)
+    munmap (aligned + size, tail);
+
+  return aligned;
+}
+
+/* Give the pages backing a range back to the kernel.  */
+void
+pal_mem_page_release (void *ptr, size_t size)
+{
+  unsigned long page = getpagesize ();
+  unsigned long start;
+  unsigned long end;
+
+  start = ((unsigned long) ptr + page - 1) & ~(page - 1);
+  end = ((unsigned long) ptr + size) & ~(page - 1);
+
+  if (end > start)
+    madvise ((void *) start, end - start, MADV_DONTNEED);
+}
+
+/* Unmap a range.  */
+void
+pal_mem_page_unmap (void *ptr, size_t size)
+{
+  munmap (ptr, size);
+}
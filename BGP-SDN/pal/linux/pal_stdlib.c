@@ -10,6 +10,7 @@
 #include "pal_stdlib.h"
 #include "snprintf.h"
 #include <crypt.h>
+#include <dlfcn.h>
 
 pal_handle_t
 pal_stdlib_start (struct lib_globals *lib_node)
@@ -121,3 +122,35 @@ char *pal_get_sys_name ()
 
 }
 
+
+/*
+** Name the function at a code address.  The daemon is linked with
+** -rdynamic (platform/linux/Rules.platform) so its own functions are
+** known to dladdr(); for anything else the object file and offset are
+** given, which addr2line can resolve.
+**
+** Parameters
+**   IN  void *addr
+**   OUT char *buf
+**   IN  size_t size
+**
+** Results
+**   Writes the name into buf and returns buf.
+*/
+char *
+pal_addr_symbol (void *addr, char *buf, size_t size)
+{
+  Dl_info info;
+
+  if (! dladdr (addr, &info))
+    snprintf (buf, size, "%p", addr);
+  else if (info.dli_sname)
+    snprintf (buf, size, "%s", info.dli_sname);
+  else if (info.dli_fname && info.dli_fbase)
+    snprintf (buf, size, "%s+0x%lx", info.dli_fname,
+              (unsigned long) ((char *) addr - (char *) info.dli_fbase));
+  else
+    snprintf (buf, size, "%p", addr);
+
+  return buf;
+}
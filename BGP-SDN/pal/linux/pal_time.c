@@ -158,6 +158,26 @@ pal_time_tzcurrent (struct pal_timeval *tv,
   return;
 }
 
+/*!
+** Return a monotonic timestamp in nanoseconds for interval measurement.
+**
+** Parameters
+**   None
+**
+** Results
+**   Nanoseconds since an arbitrary point, 0 on error.
+*/
+u_int64_t
+pal_time_mono_nsec (void)
+{
+  struct timespec ts;
+
+  if (clock_gettime (CLOCK_MONOTONIC, &ts) < 0)
+    return 0;
+
+  return (u_int64_t) ts.tv_sec * 1000000000 + (u_int64_t) ts.tv_nsec;
+}
+
 /*!
 ** Take a local time and convert it to GMT (UTC), in expanded form.
 **
@@ -144,6 +144,8 @@ int onion_block_add_data(onion_block *bl, const char *data, size_t l){
 	char *manualrealloc=NULL;
 	if (bl->size+l>bl->maxsize){
 		int grow=l;
+		if (grow<bl->size) // Grows at least ^2, so many small appends do not copy all the data each time.
+			grow=bl->size;
 		if (grow<ONION_BLOCK_GROW_MIN_BLOCK)
 			grow=ONION_BLOCK_GROW_MIN_BLOCK;
 		bl->maxsize=bl->size+grow;
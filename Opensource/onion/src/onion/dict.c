@@ -17,10 +17,12 @@
 	*/
 
 #include <malloc.h>
+#include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <ctype.h>
 
 #include "log.h"
 #include "dict.h"
@@ -52,6 +54,62 @@ static void onion_dict_node_data_free(onion_dict_node_data *dict);
 static void onion_dict_set_node_data(onion_dict_node_data *data, const char *key, const void *value, int flags);
 static onion_dict_node *onion_dict_node_new(const char *key, const void *value, int flags);
 
+/// Initial size of the index of hash dicts. Always a power of 2.
+#define ONION_DICT_HASH_MIN_SIZE 16
+/// Size of the first arena block. Next ones double it, up to ONION_DICT_ARENA_MAX_BLOCK.
+#define ONION_DICT_ARENA_BLOCK 4096
+#define ONION_DICT_ARENA_MAX_BLOCK (1024*1024)
+
+#define HASH_EMPTY -1
+#define HASH_REMOVED -2
+
+/**
+ * @short Arena block, where hash dicts keep their dupped keys and values.
+ * @private
+ */
+typedef struct onion_dict_arena_t{
+	struct onion_dict_arena_t *next;
+	size_t size;
+	size_t pos;
+	char data[];
+}onion_dict_arena;
+
+/**
+ * @short Element at a hash dict
+ * @private
+ */
+typedef struct onion_dict_entry_t{
+	onion_dict_node_data data; /// If key is NULL, its removed.
+	unsigned int hash;
+	int next;                  /// Next entry with the same key, or -1.
+	int last;                  /// At the first entry of a key, last one with that key, so repeated keys are added in order.
+}onion_dict_entry;
+
+/**
+ * @short Hash table for OD_HASH dicts.
+ * @private
+ * 
+ * Entries are at an array in insertion order. The index is an open addressing table, with linear
+ * probing, with the position at entries of the first entry of each key; repeated keys are chained
+ * from it. All dupped keys and values are at the arena, and freed at once.
+ */
+typedef struct onion_dict_hash_t{
+	onion_dict_entry *entries;
+	int nentries;           /// Used entries, including removed ones. At most index_size/2.
+	int count;              /// Entries not removed
+	int *index;             /// Position at entries, HASH_EMPTY or HASH_REMOVED.
+	int index_size;
+	char sorted;            /// Preorder is sorted by key.
+	onion_dict_arena *arena;
+}onion_dict_hash;
+
+static void onion_dict_hash_resize(onion_dict *dict, int rehash);
+static void onion_dict_hash_add(onion_dict *dict, const char *key, const void *value, int flags);
+static int onion_dict_hash_remove(onion_dict *dict, const char *key);
+static void onion_dict_preorder_move(onion_dict *dict, onion_dict_node *node);
+static void onion_dict_hash_free(onion_dict_hash *hash, int keep);
+static void onion_dict_hash_preorder(const onion_dict *dict, void *func, void *data, int with_dict);
+
 /**
  * @memberof onion_dict_t
  * Initializes the basic tree with all the structure in place, but empty.
@@ -76,7 +134,20 @@ onion_dict *onion_dict_new(){
 void onion_dict_set_flags(onion_dict *dict, int flags){
   if (flags&OD_ICASE){
     dict->cmp=strcasecmp;
+    if (dict->hash) // Hashes change
+      onion_dict_hash_resize(dict, 1);
   }
+  if ((flags&OD_HASH) && !dict->hash){
+    dict->hash=calloc(1, sizeof(onion_dict_hash));
+    onion_dict_hash_resize(dict, 0);
+    if (dict->root){ // Move all the tree data to the hash.
+      onion_dict_node *root=dict->root;
+      dict->root=NULL;
+      onion_dict_preorder_move(dict, root);
+    }
+  }
+  if (dict->hash && (flags&OD_SORTED))
+    dict->hash->sorted=1;
 }
 
 
@@ -122,6 +193,8 @@ void onion_dict_hard_dup_helper(onion_dict *dict, const char *key, const void *v
  */
 onion_dict *onion_dict_hard_dup(onion_dict *dict){
 	onion_dict *d=onion_dict_new();
+	if (dict->hash)
+		onion_dict_set_flags(d, (dict->cmp==strcasecmp ? OD_ICASE : 0) | OD_HASH | (dict->hash->sorted ? OD_SORTED : 0));
 	onion_dict_preorder(dict, onion_dict_hard_dup_helper, d);
 	return d;
 }
@@ -159,9 +232,28 @@ void onion_dict_free(onion_dict *dict){
 #endif
 		if (dict->root)
 			onion_dict_node_free(dict->root);
+		if (dict->hash)
+			onion_dict_hash_free(dict->hash, 0);
 		free(dict);
 	}
 }
+
+/**
+ * @short Removes all the values of the dict, but keeps the dict itself.
+ * @memberof onion_dict_t
+ *
+ * It is cheaper than a free and new when the same dict is going to be filled again, as with
+ * the request headers on keep alive connections. Other references to the dict see it empty too.
+ */
+void onion_dict_clear(onion_dict *dict){
+	onion_dict_lock_write(dict);
+	if (dict->root)
+		onion_dict_node_free(dict->root);
+	dict->root=NULL;
+	if (dict->hash)
+		onion_dict_hash_free(dict->hash, 1);
+	onion_dict_unlock(dict);
+}
 	
 /**
  * @short Searchs for a given key, and returns that node and its parent (if parent!=NULL) 
@@ -300,7 +392,10 @@ static onion_dict_node  *onion_dict_node_add(onion_dict *d, onion_dict_node *nod
  */
 void onion_dict_add(onion_dict *dict, const char *key, const void *value, int flags){
 	onion_dict *value_dict;
-	dict->root=onion_dict_node_add(dict, dict->root, onion_dict_node_new(key, value, flags));
+	if (dict->hash)
+		onion_dict_hash_add(dict, key, value, flags);
+	else
+		dict->root=onion_dict_node_add(dict, dict->root, onion_dict_node_new(key, value, flags));
 	if ((flags&OD_DICT) == OD_DICT || (flags&OD_DICT_ARRAY)==OD_DICT_ARRAY) {
 		value_dict = (onion_dict *)value;
 		value_dict->add_to_dict_flags = flags;
@@ -381,19 +476,296 @@ static onion_dict_node *onion_dict_node_remove(const onion_dict *d, onion_dict_n
  * Returns if it removed any node.
  */ 
 int onion_dict_remove(onion_dict *dict, const char *key){
+	if (dict->hash)
+		return onion_dict_hash_remove(dict, key);
 	dict->root=onion_dict_node_remove(dict, dict->root, key);
 	return 1;
 }
 
+/// Hash of the key, FNV-1a. Case insensitive dicts hash the lower case key.
+static unsigned int onion_dict_hash_key(const onion_dict *dict, const char *key){
+	unsigned int h=2166136261u;
+	if (dict->cmp==strcasecmp){
+		for (;*key;key++){
+			h^=(unsigned char)tolower(*key);
+			h*=16777619u;
+		}
+	}
+	else{
+		for (;*key;key++){
+			h^=(unsigned char)*key;
+			h*=16777619u;
+		}
+	}
+	return h;
+}
+
+/**
+ * @short Returns the index slot of the key, or if not there, an empty one where it can be added.
+ * 
+ * There is always some empty slot, as at most half of the index is used.
+ */
+static int *onion_dict_hash_find_slot(const onion_dict *dict, const char *key, unsigned int h){
+	onion_dict_hash *hash=dict->hash;
+	int mask=hash->index_size-1;
+	int i=h&mask;
+	int *removed=NULL;
+	for(;;){
+		int e=hash->index[i];
+		if (e==HASH_EMPTY)
+			return removed ? removed : &hash->index[i];
+		if (e==HASH_REMOVED){
+			if (!removed)
+				removed=&hash->index[i];
+		}
+		else if (hash->entries[e].hash==h && dict->cmp(hash->entries[e].data.key, key)==0)
+			return &hash->index[i];
+		i=(i+1)&mask;
+	}
+}
+
+/// Copies the string to the arena.
+static char *onion_dict_arena_strdup(onion_dict_hash *hash, const char *str){
+	size_t l=strlen(str)+1;
+	onion_dict_arena *arena=hash->arena;
+	if (!arena || arena->pos+l>arena->size){
+		size_t size=arena ? arena->size*2 : ONION_DICT_ARENA_BLOCK;
+		if (size>ONION_DICT_ARENA_MAX_BLOCK)
+			size=ONION_DICT_ARENA_MAX_BLOCK;
+		if (size<l)
+			size=l;
+		arena=malloc(sizeof(onion_dict_arena)+size);
+		arena->next=hash->arena;
+		arena->size=size;
+		arena->pos=0;
+		hash->arena=arena;
+	}
+	char *ret=&arena->data[arena->pos];
+	memcpy(ret, str, l);
+	arena->pos+=l;
+	return ret;
+}
+
+/// Sets the data on the entry. Dupped strings go to the arena, so they are not freed one by one.
+static void onion_dict_hash_set_data(onion_dict_hash *hash, onion_dict_node_data *data, const char *key, const void *value, int flags){
+	if ((flags&OD_DUP_KEY)==OD_DUP_KEY){
+		data->key=onion_dict_arena_strdup(hash, key);
+		flags&=~OD_FREE_KEY;
+	}
+	else
+		data->key=key;
+	if ((flags&OD_DUP_VALUE)==OD_DUP_VALUE){
+		if (flags&OD_DICT)
+			data->value=onion_dict_hard_dup((onion_dict*)value);
+		else{
+			data->value=onion_dict_arena_strdup(hash, value);
+			flags&=~OD_FREE_VALUE;
+		}
+	}
+	else
+		data->value=value;
+	data->flags=flags;
+}
+
+/// Adds an entry at the end, and links it from the slot, or from the previous entry with the same key.
+static void onion_dict_hash_link(onion_dict_hash *hash, int *slot, unsigned int h){
+	int n=hash->nentries++;
+	onion_dict_entry *e=&hash->entries[n];
+	e->hash=h;
+	e->next=-1;
+	e->last=n;
+	if (*slot>=0){
+		onion_dict_entry *first=&hash->entries[*slot];
+		hash->entries[first->last].next=n;
+		first->last=n;
+	}
+	else
+		*slot=n;
+	hash->count++;
+}
+
+/**
+ * @short Rebuilds the hash with room for as many entries again, removing the removed ones.
+ * 
+ * If rehash, the hashes are calculated again, as when the compare function changes.
+ */
+static void onion_dict_hash_resize(onion_dict *dict, int rehash){
+	onion_dict_hash *hash=dict->hash;
+	onion_dict_entry *old=hash->entries;
+	int nold=hash->nentries;
+	int size=ONION_DICT_HASH_MIN_SIZE;
+	int i;
+	while (size<hash->count*4)
+		size*=2;
+
+	if (hash->index)
+		free(hash->index);
+	hash->index=malloc(sizeof(int)*size);
+	memset(hash->index, 0xFF, sizeof(int)*size); // All HASH_EMPTY
+	hash->index_size=size;
+	hash->entries=malloc(sizeof(onion_dict_entry)*(size/2));
+	hash->nentries=0;
+	hash->count=0;
+
+	for (i=0;i<nold;i++){
+		if (!old[i].data.key)
+			continue;
+		unsigned int h=rehash ? onion_dict_hash_key(dict, old[i].data.key) : old[i].hash;
+		int *slot=onion_dict_hash_find_slot(dict, old[i].data.key, h);
+		memcpy(&hash->entries[hash->nentries].data, &old[i].data, sizeof(onion_dict_node_data));
+		onion_dict_hash_link(hash, slot, h);
+	}
+	if (old)
+		free(old);
+}
+
+/// Adds the data to the hash dict. As on the tree, repeated keys are allowed unless OD_REPLACE.
+static void onion_dict_hash_add(onion_dict *dict, const char *key, const void *value, int flags){
+	onion_dict_hash *hash=dict->hash;
+	if (hash->nentries==hash->index_size/2)
+		onion_dict_hash_resize(dict, 0);
+
+	unsigned int h=onion_dict_hash_key(dict, key);
+	int *slot=onion_dict_hash_find_slot(dict, key, h);
+	if (*slot>=0 && (flags&OD_REPLACE)){
+		onion_dict_node_data *data=&hash->entries[*slot].data;
+		onion_dict_node_data_free(data);
+		onion_dict_hash_set_data(hash, data, key, value, flags);
+		return;
+	}
+	onion_dict_hash_set_data(hash, &hash->entries[hash->nentries].data, key, value, flags);
+	onion_dict_hash_link(hash, slot, h);
+}
+
+/// Removes the first entry with that key. Returns if removed any.
+static int onion_dict_hash_remove(onion_dict *dict, const char *key){
+	onion_dict_hash *hash=dict->hash;
+	int *slot=onion_dict_hash_find_slot(dict, key, onion_dict_hash_key(dict, key));
+	if (*slot<0)
+		return 0;
+	onion_dict_entry *e=&hash->entries[*slot];
+	if (e->next>=0){
+		hash->entries[e->next].last=e->last;
+		*slot=e->next;
+	}
+	else
+		*slot=HASH_REMOVED;
+	onion_dict_node_data_free(&e->data);
+	e->data.key=NULL;
+	hash->count--;
+	return 1;
+}
+
+/**
+ * @short Frees all the data of the hash, and the arena in one go.
+ * 
+ * If keep, the hash is kept, empty, to be reused.
+ */
+static void onion_dict_hash_free(onion_dict_hash *hash, int keep){
+	int i;
+	for (i=0;i<hash->nentries;i++)
+		if (hash->entries[i].data.key)
+			onion_dict_node_data_free(&hash->entries[i].data);
+	while (hash->arena){
+		onion_dict_arena *next=hash->arena->next;
+		free(hash->arena);
+		hash->arena=next;
+	}
+	if (keep){
+		memset(hash->index, 0xFF, sizeof(int)*hash->index_size);
+		hash->nentries=hash->count=0;
+		return;
+	}
+	free(hash->index);
+	free(hash->entries);
+	free(hash);
+}
+
+/// Moves all the nodes of the tree to the hash, and frees the nodes.
+static void onion_dict_preorder_move(onion_dict *dict, onion_dict_node *node){
+	if (node->left)
+		onion_dict_preorder_move(dict, node->left);
+	// The data is already dupped, just take it.
+	onion_dict_hash_add(dict, node->data.key, node->data.value, node->data.flags&~(OD_DUP_ALL^OD_FREE_ALL)&~OD_REPLACE);
+	if (node->right)
+		onion_dict_preorder_move(dict, node->right);
+	free(node);
+}
+
+/// Keys compare for sorted preorder. Same keys keep the insertion order.
+static int onion_dict_entry_cmp(const void *a, const void *b){
+	const onion_dict_entry *ea=*(const onion_dict_entry**)a;
+	const onion_dict_entry *eb=*(const onion_dict_entry**)b;
+	int r=strcmp(ea->data.key, eb->data.key);
+	if (r==0)
+		return (ea>eb) - (ea<eb);
+	return r;
+}
+
+/// Keys compare for sorted preorder on case insensitive dicts.
+static int onion_dict_entry_casecmp(const void *a, const void *b){
+	const onion_dict_entry *ea=*(const onion_dict_entry**)a;
+	const onion_dict_entry *eb=*(const onion_dict_entry**)b;
+	int r=strcasecmp(ea->data.key, eb->data.key);
+	if (r==0)
+		return (ea>eb) - (ea<eb);
+	return r;
+}
+
+/// Calls the preorder function, with or without the dict as first argument.
+static void onion_dict_hash_visit(const onion_dict *dict, const onion_dict_node_data *d, void *func, void *data, int with_dict){
+	if (with_dict){
+		void (*f)(const onion_dict *dict, void *data, const char *key, const void *value, int flags)=func;
+		f(dict, data, d->key, d->value, d->flags);
+	}
+	else{
+		void (*f)(void *data, const char *key, const void *value, int flags)=func;
+		f(data, d->key, d->value, d->flags);
+	}
+}
+
+/// Preorder on hash dicts, in insertion order or sorted by key.
+static void onion_dict_hash_preorder(const onion_dict *dict, void *func, void *data, int with_dict){
+	onion_dict_hash *hash=dict->hash;
+	int i;
+	if (!hash->sorted){
+		for (i=0;i<hash->nentries;i++)
+			if (hash->entries[i].data.key)
+				onion_dict_hash_visit(dict, &hash->entries[i].data, func, data, with_dict);
+		return;
+	}
+	
+	const onion_dict_entry **sorted=malloc(sizeof(onion_dict_entry*)*(hash->count+1));
+	int n=0;
+	for (i=0;i<hash->nentries;i++)
+		if (hash->entries[i].data.key)
+			sorted[n++]=&hash->entries[i];
+	qsort(sorted, n, sizeof(onion_dict_entry*), dict->cmp==strcasecmp ? onion_dict_entry_casecmp : onion_dict_entry_cmp);
+	for (i=0;i<n;i++)
+		onion_dict_hash_visit(dict, &sorted[i]->data, func, data, with_dict);
+	free(sorted);
+}
+
+/// Returns the data of the first element with that key, or NULL.
+static const onion_dict_node_data *onion_dict_find_data(const onion_dict *dict, const char *key){
+	if (dict->hash){
+		int *slot=onion_dict_hash_find_slot(dict, key, onion_dict_hash_key(dict, key));
+		if (*slot<0)
+			return NULL;
+		return &dict->hash->entries[*slot].data;
+	}
+	const onion_dict_node *r=onion_dict_find_node(dict, dict->root, key, NULL);
+	return r ? &r->data : NULL;
+}
+
 /**
  * @short Gets a value. For dicts returns NULL; use onion_dict_get_dict.
  * @memberof onion_dict_t
  */
 const char *onion_dict_get(const onion_dict *dict, const char *key){
-	const onion_dict_node *r;
-	r=onion_dict_find_node(dict, dict->root, key, NULL);
-	if (r && !(r->data.flags&OD_DICT))
-		return r->data.value;
+	const onion_dict_node_data *r=onion_dict_find_data(dict, key);
+	if (r && !(r->flags&OD_DICT))
+		return r->value;
 	return NULL;
 }
 
@@ -402,11 +774,10 @@ const char *onion_dict_get(const onion_dict *dict, const char *key){
  * @memberof onion_dict_t
  */
 onion_dict *onion_dict_get_dict(const onion_dict *dict, const char *key){
-	const onion_dict_node *r;
-	r=onion_dict_find_node(dict, dict->root, key, NULL);
+	const onion_dict_node_data *r=onion_dict_find_data(dict, key);
 	if (r){
-		if (r->data.flags&OD_DICT)
-			return (onion_dict*)r->data.value;
+		if (r->flags&OD_DICT)
+			return (onion_dict*)r->value;
 	}
 	return NULL;
 }
@@ -436,6 +807,12 @@ static void onion_dict_node_print_dot(const onion_dict_node *node){
 void onion_dict_print_dot(const onion_dict *dict){
 	if (dict->root)
 		onion_dict_node_print_dot(dict->root);
+	if (dict->hash){ // No graph, just the keys.
+		int i;
+		for (i=0;i<dict->hash->nentries;i++)
+			if (dict->hash->entries[i].data.key)
+				fprintf(stderr,"\"%s\";\n",dict->hash->entries[i].data.key);
+	}
 }
 
 static void onion_dict_node_preorder(const onion_dict_node *node, void *func, void *data){
@@ -466,8 +843,14 @@ static void onion_dict_node_preorder_2(const onion_dict *dict, const onion_dict_
 *  @memberof onion_dict_t
   * 
  * The function is of prototype void func(void *data, const char *key, const void *value, int flags);
+ * 
+ * On OD_HASH dicts the order is the insertion order, unless OD_SORTED is also set.
  */
 void onion_dict_preorder(const onion_dict *dict, void *func, void *data){
+	if (dict && dict->hash){
+		onion_dict_hash_preorder(dict, func, data, 0);
+		return;
+	}
 	if (!dict || !dict->root)
 		return;
 	onion_dict_node_preorder(dict->root, func, data);
@@ -487,6 +870,8 @@ static int onion_dict_node_count(const onion_dict_node *node){
  * @memberof onion_dict_t
  */
 int onion_dict_count(const onion_dict *dict){
+	if (dict && dict->hash)
+		return dict->hash->count;
 	if (dict && dict->root)
 		return onion_dict_node_count(dict->root);
 	return 0;
@@ -522,43 +907,82 @@ void onion_dict_unlock(onion_dict *dict){
 #endif
 }
 
+/**
+ * @short Writes the C quoted string into the block, as onion_c_quote does, but without intermediate copies.
+ *
+ * Plain runs of chars are added at once, and only the chars that need escaping are written one by one.
+ */
+static void onion_dict_json_quote(onion_block *block, const char *str){
+	const unsigned char *p=(const unsigned char *)str;
+	const unsigned char *run=p;
+	char esc[4];
+	int l;
+
+	onion_block_add_char(block, '"');
+	for (;*p;p++){
+		if (*p=='\n' || *p=='\r'){
+			esc[0]='\\'; esc[1]='n'; l=2;
+		}
+		else if (*p=='"' || *p=='\\'){
+			esc[0]='\\'; esc[1]=*p; l=2;
+		}
+		else if (*p=='\t'){
+			esc[0]='\\'; esc[1]='t'; l=2;
+		}
+		else if (*p>127){
+			esc[0]='\\';
+			esc[1]='0'+((*p>>6)&0x03);
+			esc[2]='0'+((*p>>3)&0x07);
+			esc[3]='0'+(*p&0x07);
+			l=4;
+		}
+		else
+			continue;
+		if (p!=run)
+			onion_block_add_data(block, (const char*)run, p-run);
+		onion_block_add_data(block, esc, l);
+		run=p+1;
+	}
+	if (p!=run)
+		onion_block_add_data(block, (const char*)run, p-run);
+	onion_block_add_char(block, '"');
+}
+
+static void onion_dict_json_write(const onion_dict *dict, onion_block *block);
+
 /**
  * @short Helps to prepare each pair.
  */
 static void onion_dict_json_preorder(const onion_dict *dict, onion_block *block, const char *key, const void *value, int flags){
-	if (!onion_block_size(block)) // Error somewhere.
-		return;
-	char *s;
-	s=onion_c_quote_new(key);
-	if (s==NULL){
-		onion_block_clear(block);
-		return;
-	}
-        if (!((dict->add_to_dict_flags&OD_DICT_ARRAY) == OD_DICT_ARRAY)) {
-		onion_block_add_str(block, s);
+	if (!((dict->add_to_dict_flags&OD_DICT_ARRAY) == OD_DICT_ARRAY)) {
+		onion_dict_json_quote(block, key);
 		onion_block_add_char(block, ':');
 	}
-	free(s);
-	if (flags&OD_DICT || flags&OD_DICT_ARRAY){
-		onion_block *tmp;
-		tmp=onion_dict_to_json((onion_dict*)value);
-		if (!tmp){
-			onion_block_clear(block);
-			return;
-		}
-		onion_block_add_block(block, tmp);
-		onion_block_free(tmp);
+	if (flags&OD_DICT || flags&OD_DICT_ARRAY)
+		onion_dict_json_write((const onion_dict*)value, block);
+	else
+		onion_dict_json_quote(block, value);
+	onion_block_add_data(block, ", ",2);
+}
+
+/**
+ * @short Writes the dict as json at the end of the block.
+ *
+ * Nested dicts are written in the same pass into the same block, so each byte is written only once.
+ */
+static void onion_dict_json_write(const onion_dict *dict, onion_block *block){
+	char array=((dict->add_to_dict_flags & OD_DICT_ARRAY) == OD_DICT_ARRAY);
+
+	onion_block_add_char(block, array ? '[' : '{');
+	if (dict->hash && dict->hash->count){
+		onion_dict_hash_preorder(dict, (void*)onion_dict_json_preorder, block, 1);
+		onion_block_rewind(block, 2); // To remove a final ", "
 	}
-	else{
-		s=onion_c_quote_new(value);
-		if (s==NULL){
-			onion_block_clear(block);
-			return;
-		}
-		onion_block_add_str(block, s);
-		free(s);
+	else if (dict->root){
+		onion_dict_node_preorder_2(dict, dict->root, (void*)onion_dict_json_preorder, block);
+		onion_block_rewind(block, 2); // To remove a final ", "
 	}
-	onion_block_add_data(block, ", ",2);
+	onion_block_add_char(block, array ? ']' : '}');
 }
 
 /**
@@ -570,28 +994,11 @@ static void onion_dict_json_preorder(const onion_dict *dict, onion_block *block,
  * @returns an onion_block with the json data, or NULL on error
  */
 block *onion_dict_to_json(onion_dict *dict){
+	if (!dict)
+		return NULL;
 	onion_block *block=onion_block_new();
 
-	if ((dict->add_to_dict_flags & OD_DICT_ARRAY) == OD_DICT_ARRAY)
-		onion_block_add_char(block, '[');
-	else
-		onion_block_add_char(block, '{');
-	if (dict && dict->root)
-		onion_dict_node_preorder_2(dict, dict->root, (void*)onion_dict_json_preorder, block);
-
-
-	int s=onion_block_size(block);
-	if (s==0){ // Error.
-		onion_block_clear(block);
-		return NULL;
-	}
-	if (s!=1) // To remove a final ", "
-		onion_block_rewind(block, 2);
-	
-	if ((dict->add_to_dict_flags&OD_DICT_ARRAY) == OD_DICT_ARRAY)
-		onion_block_add_char(block, ']');
-	else
-		onion_block_add_char(block, '}');
+	onion_dict_json_write(dict, block);
 
 	return block;
 }
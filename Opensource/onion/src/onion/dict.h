@@ -48,6 +48,8 @@ enum onion_dict_flags_e{
   
   // Flags for onion_dict_set_flags
   OD_ICASE=0x01,     /// Do case insensitive cmps.
+  OD_HASH=0x02,      /// Use a hash table, with the dupped keys and values at an arena. Better for big dicts. Preorder is in insertion order.
+  OD_SORTED=0x04,    /// On OD_HASH dicts, preorder is sorted by key, as on normal dicts.
 };
 
 /// Initializes a dict.
@@ -64,6 +66,9 @@ int onion_dict_remove(onion_dict *dict, const char *key);
 /// Removes the full dict struct form mem.
 void onion_dict_free(onion_dict *dict);
 
+/// Removes all the values, but keeps the dict to be reused.
+void onion_dict_clear(onion_dict *dict);
+
 /// Creates a soft duplicate of the dict.
 onion_dict *onion_dict_dup(onion_dict *dict);
 
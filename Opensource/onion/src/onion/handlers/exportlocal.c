@@ -27,12 +27,22 @@
 #include <dirent.h>
 #include <sys/stat.h>
 #include <pwd.h>
+#include <time.h>
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#else
+# define pthread_mutex_init(...)
+# define pthread_mutex_destroy(...)
+# define pthread_mutex_lock(...)
+# define pthread_mutex_unlock(...)
+#endif
 
 #include <onion/shortcuts.h>
 #include <onion/handler.h>
 #include <onion/response.h>
 #include <onion/codecs.h>
 #include <onion/log.h>
+#include <onion/dict.h>
 
 #include "exportlocal.h"
 
@@ -42,13 +52,55 @@ struct onion_handler_export_local_data_t{
 	void (*renderer_footer)(onion_response *res, const char *dirname);
 	char *localpath;
 	int is_file:1;
+	onion_dict *resolved; ///< Recently checked paths of regular files -> real path
+	time_t resolved_time;
+#ifdef HAVE_PTHREADS
+	pthread_mutex_t mutex;
+#endif
 };
 
+/// Max paths kept at the resolved cache. They are forgotten every second anyway.
+#define ONION_EXPORT_LOCAL_MAX_RESOLVED 1024
+
 typedef struct onion_handler_export_local_data_t onion_handler_export_local_data;
 
 int onion_handler_export_local_directory(onion_handler_export_local_data *data, const char *realp, const char *showpath, onion_request *req, onion_response *res);
 int onion_handler_export_local_file(const char *realp, struct stat *reals, onion_request *request, onion_response *response);
 
+/**
+ * @short Looks for the real path of a file already checked this second.
+ *
+ * This way the hot files skip the stat and realpath calls, and go directly to the file cache.
+ */
+static int onion_handler_export_local_resolved(onion_handler_export_local_data *d, const char *path, char *realp){
+	int ok=0;
+	time_t now=time(NULL);
+	pthread_mutex_lock(&d->mutex);
+	if (d->resolved_time!=now){
+		onion_dict_clear(d->resolved);
+		d->resolved_time=now;
+	}
+	else{
+		const char *r=onion_dict_get(d->resolved, path);
+		if (r){
+			strncpy(realp, r, PATH_MAX-1);
+			realp[PATH_MAX-1]='\0';
+			ok=1;
+		}
+	}
+	pthread_mutex_unlock(&d->mutex);
+	return ok;
+}
+
+/// Remembers the real path of a checked file.
+static void onion_handler_export_local_resolved_add(onion_handler_export_local_data *d, const char *path, const char *realp){
+	pthread_mutex_lock(&d->mutex);
+	if (onion_dict_count(d->resolved)>=ONION_EXPORT_LOCAL_MAX_RESOLVED)
+		onion_dict_clear(d->resolved);
+	onion_dict_add(d->resolved, path, realp, OD_DUP_ALL|OD_REPLACE);
+	pthread_mutex_unlock(&d->mutex);
+}
+
 int onion_handler_export_local_handler(onion_handler_export_local_data *d, onion_request *request, onion_response *response){
 	char tmp[PATH_MAX];
 	char realp[PATH_MAX];
@@ -60,6 +112,12 @@ int onion_handler_export_local_handler(onion_handler_export_local_data *d, onion
 
 	ONION_DEBUG0("Get %s (base %s)",tmp, d->localpath);
 
+	if (onion_handler_export_local_resolved(d, tmp, realp)){
+		int r=onion_shortcut_response_file(realp, request, response);
+		if (r!=OCS_NOT_PROCESSED)
+			return r;
+	}
+
 	// First check if it exists and so on. If it does not exist, no trying to escape message
 	struct stat reals;
 	int ok=stat(tmp,&reals);
@@ -81,6 +139,7 @@ int onion_handler_export_local_handler(onion_handler_export_local_data *d, onion
 	}
 	else if (S_ISREG(reals.st_mode)){
 		//ONION_DEBUG("FILE");
+		onion_handler_export_local_resolved_add(d, tmp, realp);
 		return onion_shortcut_response_file(realp, request, response);
 	}
 	ONION_DEBUG0("Dont know how to handle");
@@ -202,6 +261,8 @@ int onion_handler_export_local_directory(onion_handler_export_local_data *data,
 void onion_handler_export_local_delete(void *data){
 	onion_handler_export_local_data *d=data;
 	free(d->localpath);
+	onion_dict_free(d->resolved);
+	pthread_mutex_destroy(&d->mutex);
 	free(d);
 }
 
@@ -244,6 +305,9 @@ onion_handler *onion_handler_export_local_new(const char *localpath){
 	
 	
 	priv_data->is_file=S_ISREG(st.st_mode);
+	priv_data->resolved=onion_dict_new();
+	priv_data->resolved_time=0;
+	pthread_mutex_init(&priv_data->mutex, NULL);
 	
 	onion_handler *ret=onion_handler_new((onion_handler_handler)onion_handler_export_local_handler,
 																			 priv_data,(onion_handler_private_data_free) onion_handler_export_local_delete);
@@ -20,6 +20,7 @@
 #include <onion/dict.h>
 #include <onion/types.h>
 #include <onion/types_internal.h>
+#include <onion/sessions.h>
 
 static void header_write(onion_response *res, const char *key, const char *value, int flags){
   onion_response_printf(res,"<li><b>%s</b> = %s</li>",key,value);
@@ -53,7 +54,7 @@ static onion_connection_status onion_internal_handler(void *_, onion_request *re
   
   // Sessions
   onion_response_write0(res,"<h1>Sessions and data</h1><ul>");
-  onion_dict_preorder( req->server->sessions->sessions, session_write, res);
+  onion_sessions_preorder(req->server->sessions, session_write, res);
   onion_response_write0(res, "</ul>");
   
   onion_response_write0(res, "</body></html>");
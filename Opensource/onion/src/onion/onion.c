@@ -152,6 +152,7 @@
 #include <stdio.h>
 #include <sys/types.h> 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <netinet/in.h>
 #include <errno.h>
 #include <string.h>
@@ -341,6 +342,14 @@ int onion_write_to_socket(int *fd, const char *data, unsigned int len){
 	return write((long int)fd, data, len);
 }
 
+/**
+ * @short Basic direct to socket gather write method.
+ * @memberof onion_t
+ */
+int onion_writev_to_socket(int *fd, const struct iovec *iov, int iovcnt){
+	return writev((long int)fd, iov, iovcnt);
+}
+
 /**
  * @short Basic direct from socket read method.
  * @memberof onion_t
@@ -534,11 +543,15 @@ int onion_listen(onion *o){
 
 	if (o->flags&O_POLL){
 #ifdef HAVE_PTHREADS
-		o->poller=onion_poller_new(o->max_threads+1);
-#else
-		o->poller=onion_poller_new(8);
+		if (o->flags&O_THREADED)
+			o->poller=onion_poller_new_with_threads(o->max_threads+1, o->max_threads);
+		else
 #endif
-		onion_poller_add(o->poller, onion_poller_slot_new(o->listenfd, (void*)onion_accept_request, o));
+			o->poller=onion_poller_new(8);
+		// Accepts on the first polling thread, and the connections go round robin to the others.
+		onion_poller_slot *listen_slot=onion_poller_slot_new(o->listenfd, (void*)onion_accept_request, o);
+		onion_poller_slot_set_thread(listen_slot, 0);
+		onion_poller_add(o->poller, listen_slot);
 		// O_POLL && O_THREADED == O_POOL. Create several threads to poll.
 #ifdef HAVE_PTHREADS
 		if (o->flags&O_THREADED){
@@ -711,6 +724,17 @@ void onion_set_max_threads(onion *onion, int max_threads){
 #endif
 }
 
+/**
+ * @short Sets the size of the output buffer of each response. Default is 1500 bytes.
+ * @memberof onion_t
+ * 
+ * Data is sent to the client when this buffer is full, or at the end of the response, so bigger buffers mean
+ * less system calls on big responses, as big json data, at the cost of more memory per response.
+ */
+void onion_set_response_buffer_size(onion *onion, size_t size){
+	onion_server_set_response_buffer_size(onion->server, size);
+}
+
 static onion_request *onion_connection_start(onion *o, int clientfd, struct sockaddr_storage *cli_addr, socklen_t cli_len);
 static onion_connection_status onion_connection_read(onion_request *req);
 static void onion_connection_shutdown(onion_request *req);
@@ -769,6 +793,7 @@ static onion_request *onion_connection_start(onion *o, int clientfd, struct sock
 #ifdef HAVE_GNUTLS
 	if (o->flags&O_SSL_ENABLED){
 		onion_server_set_write(o->server, (onion_write)gnutls_record_send); // Im lucky, has the same signature.
+		onion_server_set_writev(o->server, NULL);
 		onion_server_set_read(o->server, (onion_read)gnutls_record_recv); // Im lucky, has the same signature.
 		onion_server_set_close(o->server, (onion_close)onion_ssl_close);
 		req=onion_request_new_from_socket(o->server, session, cli_addr, cli_len);
@@ -777,6 +802,7 @@ static onion_request *onion_connection_start(onion *o, int clientfd, struct sock
 #endif
 	{
 		onion_server_set_write(o->server, (onion_write)onion_write_to_socket);
+		onion_server_set_writev(o->server, (onion_writev)onion_writev_to_socket);
 		onion_server_set_read(o->server, (onion_read)onion_read_from_socket);
 		onion_server_set_close(o->server, (onion_close)onion_close_socket);
 		req=onion_request_new_from_socket(o->server, (void*)(long int)clientfd, cli_addr, cli_len);
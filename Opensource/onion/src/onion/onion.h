@@ -67,6 +67,9 @@ void onion_set_timeout(onion *onion, int timeout);
 /// Sets the maximum number of threads to use for requests. default 16.
 void onion_set_max_threads(onion *onion, int max_threads);
 
+/// Sets the size of the output buffer of each response. Default 1500 bytes.
+void onion_set_response_buffer_size(onion *onion, size_t size);
+
 /// Sets this user as soon as listen starts.
 void onion_set_user(onion *server, const char *username);
 
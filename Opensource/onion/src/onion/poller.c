@@ -22,6 +22,7 @@
 #include <string.h>
 #include <stdio.h>
 #include <limits.h>
+#include <stdint.h>
 #include <time.h>
 #include <unistd.h>
 #ifdef __DEBUG__
@@ -51,20 +52,51 @@
 # define pthread_mutex_lock(...)
 # define pthread_mutex_trylock(...) (0)
 # define pthread_mutex_unlock(...)
+# define pthread_mutex_destroy(...)
 #endif
 
 
-struct onion_poller_t{
-	int fd;
-	int eventfd; ///< fd to signal internal changes on poller.
-	int n;
-  char stop;
+/// Seconds covered by a timer wheel. Must be a power of two.
+#define ONION_POLLER_WHEEL 64
+
+/**
+ * @short Per thread part of the poller
+ * @private
+ *
+ * Each polling thread owns one shard, with its own epoll fd, its own slots and its own
+ * timer wheel, so that the polling and timeout handling need no lock. Other threads
+ * only hand slots to add, and fds to remove, through the inbox.
+ */
+typedef struct onion_poller_shard_t{
+	onion_poller *poller;
+	int fd; ///< epoll fd
+	int eventfd; ///< fd to signal there is something in the inbox, or to stop.
+	int active; ///< A thread is polling on this shard.
+
 #ifdef HAVE_PTHREADS
-	pthread_mutex_t mutex;
-	int npollers;
+	pthread_mutex_t mutex; ///< Protects the inbox
 #endif
+	onion_poller_slot *inbox; ///< Slots to add, from other threads
+	int *inbox_remove; ///< fds to remove, from other threads
+	int inbox_nremove;
+	int inbox_remove_size;
+
+	onion_poller_slot *head; ///< All slots of this shard
+	onion_poller_slot *dead; ///< Removed slots, freed once the current events are processed
 
-	onion_poller_slot *head;
+	onion_poller_slot *wheel[ONION_POLLER_WHEEL]; ///< Slots with a timeout, by timeout_limit
+	int wheel_count;
+	time_t wheel_time; ///< Last second the wheel was expired
+}onion_poller_shard;
+
+struct onion_poller_t{
+	int n; ///< Number of slots on all shards
+	char stop;
+	int npollers;
+	int nshards;
+	unsigned int next_shard; ///< Round robin for new slots
+
+	onion_poller_shard *shard;
 };
 
 /// Each element of the poll
@@ -79,10 +111,20 @@ struct onion_poller_slot_t{
 
 	time_t timeout;
 	time_t timeout_limit; ///< Limit in seconds for use with time function.
-	
+
+	int thread; ///< Shard it must go to, or -1 for any.
+	char removed;
+
 	onion_poller_slot *next;
+	onion_poller_slot *prev;
+	onion_poller_slot **wheel; ///< Bucket it is at, or NULL.
+	onion_poller_slot *wheel_next;
+	onion_poller_slot *wheel_prev;
 };
 
+/// Shard of the poller this thread is polling, if any.
+static __thread onion_poller_shard *onion_poller_current=NULL;
+
 /**
  * @short Creates a new slot for the poller, for input data to be ready.
  * @memberof onion_poller_slot_t
@@ -101,6 +143,7 @@ onion_poller_slot *onion_poller_slot_new(int fd, int (*f)(void*), void *data){
 	el->data=data;
 	el->timeout=-1;
 	el->timeout_limit=INT_MAX;
+	el->thread=-1;
 	
 	return el;
 }
@@ -144,8 +187,18 @@ void onion_poller_slot_set_timeout(onion_poller_slot *el, int timeout){
 	ONION_DEBUG0("Set timeout to %d, %d s", el->timeout_limit, el->timeout);
 }
 
-static int onion_poller_empty_helper(void *_){
-  return 0;
+/**
+ * @short Sets the polling thread that will watch this slot
+ * @memberof onion_poller_slot_t
+ *
+ * By default slots are spread round robin over the polling threads, but the first one, which is left
+ * for the slot set here, normally the listen fd.
+ *
+ * @param el Slot to modify
+ * @param n Index of the polling thread, from 0 to the number of threads given at onion_poller_new_with_threads.
+ */
+void onion_poller_slot_set_thread(onion_poller_slot *el, int n){
+	el->thread=n;
 }
 
 #ifndef EFD_CLOEXEC
@@ -161,62 +214,265 @@ static int onion_poller_empty_helper(void *_){
  * Just now it only have EPOLLIN | EPOLLHUP slots, so wait for write ready not available.
  */
 onion_poller *onion_poller_new(int n){
+	return onion_poller_new_with_threads(n, 1);
+}
+
+/**
+ * @short Returns a poller object to be polled from several threads
+ * @memberof onion_poller_t
+ *
+ * Each of the nthreads threads that call onion_poller_poll gets its own epoll fd and its own timer wheel, and
+ * slots are distributed between them as they are added.
+ */
+onion_poller *onion_poller_new_with_threads(int n, int nthreads){
 	onion_poller *p=malloc(sizeof(onion_poller));
-	p->fd=epoll_create(n);
-	if (p->fd < 0){
-		ONION_ERROR("Error creating the poller. %s", strerror(errno));
-		free(p);
-		return NULL;
-	}
-	p->eventfd=eventfd(0,EFD_CLOEXEC);
+	memset(p,0,sizeof(onion_poller));
+	if (nthreads<1)
+		nthreads=1;
+	p->nshards=nthreads;
+	p->shard=malloc(sizeof(onion_poller_shard)*nthreads);
+	memset(p->shard,0,sizeof(onion_poller_shard)*nthreads);
+
+	int i;
+	for (i=0;i<nthreads;i++){
+		onion_poller_shard *s=&p->shard[i];
+		s->poller=p;
+		s->fd=epoll_create(n);
+		if (s->fd < 0){
+			ONION_ERROR("Error creating the poller. %s", strerror(errno));
+			while (i--){
+				close(p->shard[i].fd);
+				close(p->shard[i].eventfd);
+			}
+			free(p->shard);
+			free(p);
+			return NULL;
+		}
+		s->eventfd=eventfd(0,EFD_CLOEXEC);
 #if EFD_CLOEXEC == 0
-  fcntl(p->eventfd,F_SETFD,FD_CLOEXEC);
-#endif
-	p->head=NULL;
-	p->n=0;
-  p->stop=0;
-
-#ifdef HAVE_PTHREADS
-  ONION_DEBUG("Init thread stuff for poll");
-  p->npollers=0;
-  pthread_mutexattr_t attr;
-  pthread_mutexattr_init(&attr);
-  pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
-  pthread_mutex_init(&p->mutex, &attr);
-  pthread_mutexattr_destroy(&attr);
+		fcntl(s->eventfd,F_SETFD,FD_CLOEXEC);
 #endif
+		pthread_mutex_init(&s->mutex, NULL);
+		s->wheel_time=time(NULL);
+
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events=EPOLLIN;
+		ev.data.ptr=NULL; // The eventfd
+		if (epoll_ctl(s->fd, EPOLL_CTL_ADD, s->eventfd, &ev) < 0)
+			ONION_ERROR("Error add eventfd to listen to. %s", strerror(errno));
+	}
+	ONION_DEBUG0("Poller with %d threads", nthreads);
 
-  onion_poller_slot *ev=onion_poller_slot_new(p->eventfd,onion_poller_empty_helper,NULL);
-  onion_poller_add(p,ev);
-  
 	return p;
 }
 
+static void onion_poller_slot_list_free(onion_poller_slot *next){
+	while (next){
+		onion_poller_slot *tnext=next->next;
+		onion_poller_slot_free(next);
+		next=tnext;
+	}
+}
+
 /// @memberof onion_poller_t
 void onion_poller_free(onion_poller *p){
 	ONION_DEBUG("Free onion poller");
-	p->stop=1;
-	close(p->fd); 
+	onion_poller_stop(p);
 	// Wait until all pollers exit.
 	
-	if (pthread_mutex_trylock(&p->mutex)>0){
+	if (p->npollers>0){
 		ONION_WARNING("When cleaning the poller object, some poller is still active; not freeing memory");
+		return;
 	}
-	else{
-		onion_poller_slot *next=p->head;
-		while (next){
-			onion_poller_slot *tnext=next->next;
-			if (next->shutdown)
-				next->shutdown(next->shutdown_data);
-			free(next);
-			next=tnext;
-		}
-		pthread_mutex_unlock(&p->mutex);
-		free(p);
+
+	int i;
+	for (i=0;i<p->nshards;i++){
+		onion_poller_shard *s=&p->shard[i];
+		close(s->fd);
+		close(s->eventfd);
+		onion_poller_slot_list_free(s->head);
+		onion_poller_slot_list_free(s->dead);
+		onion_poller_slot_list_free(s->inbox);
+		free(s->inbox_remove);
+		pthread_mutex_destroy(&s->mutex);
 	}
+	free(p->shard);
+	free(p);
 	ONION_DEBUG0("Done");
 }
 
+/// Wakes the thread polling the shard.
+static void onion_poller_shard_wake(onion_poller_shard *s){
+	uint64_t one=1;
+	if (write(s->eventfd,&one,sizeof(one)) < 0)
+		ONION_ERROR("Error waking poller: %s", strerror(errno));
+}
+
+/// Removes the slot from the timer wheel, if there.
+static void onion_poller_wheel_remove(onion_poller_shard *s, onion_poller_slot *el){
+	if (!el->wheel)
+		return;
+	if (el->wheel_prev)
+		el->wheel_prev->wheel_next=el->wheel_next;
+	else
+		*el->wheel=el->wheel_next;
+	if (el->wheel_next)
+		el->wheel_next->wheel_prev=el->wheel_prev;
+	el->wheel=NULL;
+	el->wheel_next=el->wheel_prev=NULL;
+	s->wheel_count--;
+}
+
+/// Puts the slot at the timer wheel at its timeout_limit, if any.
+static void onion_poller_wheel_add(onion_poller_shard *s, onion_poller_slot *el){
+	onion_poller_wheel_remove(s, el);
+	if (el->timeout_limit==INT_MAX)
+		return;
+	el->wheel=&s->wheel[el->timeout_limit&(ONION_POLLER_WHEEL-1)];
+	el->wheel_next=*el->wheel;
+	if (el->wheel_next)
+		el->wheel_next->wheel_prev=el;
+	*el->wheel=el;
+	s->wheel_count++;
+}
+
+/// Starts polling the slot. Only from the thread of the shard, or if none.
+static void onion_poller_shard_attach(onion_poller_shard *s, onion_poller_slot *el){
+	el->prev=NULL;
+	el->next=s->head;
+	if (s->head)
+		s->head->prev=el;
+	s->head=el;
+	onion_poller_wheel_add(s, el);
+
+	struct epoll_event ev;
+	memset(&ev, 0, sizeof(ev));
+	ev.events=EPOLLIN | EPOLLHUP;
+	ev.data.ptr=el;
+	if (epoll_ctl(s->fd, EPOLL_CTL_ADD, el->fd, &ev) < 0){
+		ONION_ERROR("Error add descriptor to listen to. %s", strerror(errno));
+	}
+}
+
+/**
+ * @short Stops polling the slot. Only from the thread of the shard, or if none.
+ *
+ * The slot is freed at onion_poller_shard_bury, as there may be events for it still to be processed.
+ */
+static void onion_poller_shard_detach(onion_poller_shard *s, onion_poller_slot *el){
+	if (epoll_ctl(s->fd, EPOLL_CTL_DEL, el->fd, NULL) < 0){
+		ONION_DEBUG0("Error remove descriptor to listen to. %s", strerror(errno));
+	}
+	onion_poller_wheel_remove(s, el);
+	if (el->prev)
+		el->prev->next=el->next;
+	else
+		s->head=el->next;
+	if (el->next)
+		el->next->prev=el->prev;
+
+	el->removed=1;
+	el->prev=NULL;
+	el->next=s->dead;
+	s->dead=el;
+
+	if (__sync_sub_and_fetch(&s->poller->n, 1)==0){ // Only the eventfds are left.
+		ONION_DEBUG0("Removed last, stopping poll");
+		onion_poller_stop(s->poller);
+	}
+}
+
+/// Frees the removed slots.
+static void onion_poller_shard_bury(onion_poller_shard *s){
+	onion_poller_slot *dead=s->dead;
+	s->dead=NULL;
+	onion_poller_slot_list_free(dead);
+}
+
+/// Removes the slot for that fd, if it is at this shard.
+static int onion_poller_shard_remove_fd(onion_poller_shard *s, int fd){
+	onion_poller_slot *el;
+	for (el=s->head;el;el=el->next){
+		if (el->fd==fd){
+			onion_poller_shard_detach(s, el);
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/// Processes the slots other threads added or removed.
+static void onion_poller_shard_inbox(onion_poller_shard *s){
+	pthread_mutex_lock(&s->mutex);
+	onion_poller_slot *inbox=s->inbox;
+	s->inbox=NULL;
+	int i;
+	for (i=0;i<s->inbox_nremove;i++)
+		onion_poller_shard_remove_fd(s, s->inbox_remove[i]);
+	s->inbox_nremove=0;
+	pthread_mutex_unlock(&s->mutex);
+
+	while (inbox){
+		onion_poller_slot *next=inbox->next;
+		onion_poller_shard_attach(s, inbox);
+		inbox=next;
+	}
+}
+
+/**
+ * @short Removes the slots that timed out up to ctime
+ *
+ * Only the buckets of the seconds since last call are checked, and at those only the
+ * slots whose time is gone are removed, so its proportional to the expired slots.
+ */
+static void onion_poller_shard_expire(onion_poller_shard *s, time_t ctime){
+	time_t t=s->wheel_time;
+	if (ctime-t >= ONION_POLLER_WHEEL)
+		t=ctime-ONION_POLLER_WHEEL+1;
+	if (s->wheel_count){
+		for (;t<=ctime;t++){
+			onion_poller_slot *el=s->wheel[t&(ONION_POLLER_WHEEL-1)];
+			while (el){
+				onion_poller_slot *next=el->wheel_next;
+				if (el->timeout_limit <= ctime){
+					ONION_DEBUG0("Timeout on %d, was %d (ctime %d)", el->fd, el->timeout_limit, ctime);
+					onion_poller_shard_detach(s, el);
+				}
+				el=next;
+			}
+		}
+	}
+	s->wheel_time=ctime;
+}
+
+/**
+ * @short Gets the next timeout, in ms
+ *
+ * The wheel works in seconds, so this is the time until the next second with a bucket that has slots.
+ * Buckets may hold slots of a later turn of the wheel; then it just wakes up earlier than needed.
+ */
+static int onion_poller_shard_next_timeout(onion_poller_shard *s, time_t ctime){
+	if (!s->wheel_count)
+		return -1;
+	int i;
+	for (i=1;i<ONION_POLLER_WHEEL;i++){
+		if (s->wheel[(ctime+i)&(ONION_POLLER_WHEEL-1)])
+			return i*1000;
+	}
+	return ONION_POLLER_WHEEL*1000;
+}
+
+/// Gets a shard for the calling thread
+static onion_poller_shard *onion_poller_shard_take(onion_poller *p){
+	int i;
+	for (i=0;i<p->nshards;i++){
+		if (__sync_bool_compare_and_swap(&p->shard[i].active, 0, 1))
+			return &p->shard[i];
+	}
+	return NULL;
+}
+
 /**
  * @short Adds a file descriptor to poll.
  * @memberof onion_poller_t
@@ -224,100 +480,67 @@ void onion_poller_free(onion_poller *p){
  * When new data is available (read/write/event) the given function
  * is called with that data.
  * 
- * Once the slot is added is not safe anymore to set data on it, unless its detached from the epoll. (see EPOLLONESHOT)
+ * The slot goes to the polling thread set with onion_poller_slot_set_thread, or else to the next one round robin.
+ * If it is not the calling thread, it is handed through that thread's inbox.
+ * 
+ * Once the slot is added is not safe anymore to set data on it.
  */
 int onion_poller_add(onion_poller *poller, onion_poller_slot *el){
-	ONION_DEBUG0("Adding fd %d for polling (%d)", el->fd, poller->n);
-
-	pthread_mutex_lock(&poller->mutex);
-	// I like head to be always the same, so I do some tricks to keep it. This is beacuse at head normally I have the listen fd, which is very accessed
-	if (!poller->head)
-		poller->head=el;
-	else{
-		el->next=poller->head->next;
-		poller->head->next=el;
-		poller->n++;
-	}
-	pthread_mutex_unlock(&poller->mutex);
-	
-	struct epoll_event ev;
-	memset(&ev, 0, sizeof(ev));
-	ev.events=EPOLLIN | EPOLLHUP | EPOLLONESHOT;
-	ev.data.ptr=el;
-	if (epoll_ctl(poller->fd, EPOLL_CTL_ADD, el->fd, &ev) < 0){
-		ONION_ERROR("Error add descriptor to listen to. %s", strerror(errno));
+	onion_poller_shard *s;
+	if (el->thread>=0)
+		s=&poller->shard[el->thread % poller->nshards];
+	else if (poller->nshards>1)
+		s=&poller->shard[1 + __sync_fetch_and_add(&poller->next_shard, 1) % (poller->nshards-1)];
+	else
+		s=&poller->shard[0];
+
+	ONION_DEBUG0("Adding fd %d for polling (%d) at poller thread %d", el->fd, poller->n, (int)(s-poller->shard));
+	__sync_add_and_fetch(&poller->n, 1);
+
+	if (s==onion_poller_current){
+		onion_poller_shard_attach(s, el);
 		return 1;
 	}
+
+	pthread_mutex_lock(&s->mutex);
+	el->next=s->inbox;
+	s->inbox=el;
+	pthread_mutex_unlock(&s->mutex);
+	onion_poller_shard_wake(s);
+
 	return 1;
 }
 
 /**
- * @short Removes a file descriptor, and all related callbacks from the listening queue
+ * @short Removes a fd, and all related callbacks from the listening queue
  * @memberof onion_poller_t
+ *
+ * From other threads than the one polling the fd, it is removed once that thread wakes up.
  */
 int onion_poller_remove(onion_poller *poller, int fd){
-	if (epoll_ctl(poller->fd, EPOLL_CTL_DEL, fd, NULL) < 0){
-		ONION_ERROR("Error remove descriptor to listen to. %s", strerror(errno));
-	}
-	
-	pthread_mutex_lock(&poller->mutex);
+	onion_poller_shard *cur=onion_poller_current;
 	ONION_DEBUG0("Trying to remove fd %d (%d)", fd, poller->n);
-	onion_poller_slot *el=poller->head;
-	if (el && el->fd==fd){
-		ONION_DEBUG0("Removed from head %p", el);
-		
-		poller->head=el->next;
-		pthread_mutex_unlock(&poller->mutex);
-    
-		onion_poller_slot_free(el);
+
+	if (cur && cur->poller==poller && onion_poller_shard_remove_fd(cur, fd))
 		return 0;
-	}
-	while (el->next){
-		if (el->next->fd==fd){
-			ONION_DEBUG0("Removed from tail %p",el);
-			onion_poller_slot *t=el->next;
-			el->next=t->next;
-      
-      if (poller->head->next==NULL){ // This means only eventfd is here.
-        ONION_DEBUG0("Removed last, stopping poll");
-        onion_poller_stop(poller);
-      }
-      
-			pthread_mutex_unlock(&poller->mutex);
-			
-			onion_poller_slot_free(t);
-			return 0;
+
+	int i;
+	for (i=0;i<poller->nshards;i++){
+		onion_poller_shard *s=&poller->shard[i];
+		if (s==cur)
+			continue;
+		pthread_mutex_lock(&s->mutex);
+		if (s->inbox_nremove==s->inbox_remove_size){
+			s->inbox_remove_size=s->inbox_remove_size ? s->inbox_remove_size*2 : 4;
+			s->inbox_remove=realloc(s->inbox_remove, sizeof(int)*s->inbox_remove_size);
 		}
-		el=el->next;
+		s->inbox_remove[s->inbox_nremove++]=fd;
+		pthread_mutex_unlock(&s->mutex);
+		onion_poller_shard_wake(s);
 	}
-	pthread_mutex_unlock(&poller->mutex);
-	ONION_WARNING("Trying to remove unknown fd from poller %d", fd);
 	return 0;
 }
 
-/**
- * @short Gets the next timeout
- * 
- * On edge cases could get a wrong timeout, but always old or new, so its ok.
- * 
- * List must be locked by caller.
- */
-static int onion_poller_get_next_timeout(onion_poller *p){
-	onion_poller_slot *next;
-	int timeout=INT_MAX; // Ok, minimum wakeup , once per hour.
-	next=p->head;
-	while(next){
-		//ONION_DEBUG("Check %d %d %d", timeout, next->timeout, next->delta_timeout);
-		if (next->timeout_limit<timeout)
-			timeout=next->timeout_limit;
-		
-		next=next->next;
-	}
-	
-	//ONION_DEBUG("Next wakeup in %d ms, at least", timeout);
-	return timeout;
-}
-
 // Max of events per loop. If not al consumed for next, so no prob.  right number uses less memory, and makes less calls.
 #define MAX_EVENTS 10
 
@@ -327,119 +550,85 @@ static int onion_poller_get_next_timeout(onion_poller *p){
  *
  * It loops over polling. To exit polling call onion_poller_stop().
  * 
+ * Each calling thread polls its own part of the poller, up to the number of threads
+ * the poller was created for.
+ * 
  * If no fd to poll, returns.
  */
 void onion_poller_poll(onion_poller *p){
 	struct epoll_event event[MAX_EVENTS];
 	ONION_DEBUG0("Start polling");
 	p->stop=0;
-#ifdef HAVE_PTHREADS
-	pthread_mutex_lock(&p->mutex);
-	p->npollers++;
-	ONION_DEBUG0("Npollers %d. %d listenings %p", p->npollers, p->n, p->head);
-	pthread_mutex_unlock(&p->mutex);
-#endif
-	pthread_mutex_lock(&p->mutex);
-	int maxtime;
-	pthread_mutex_unlock(&p->mutex);
+	onion_poller_shard *s=onion_poller_shard_take(p);
+	if (!s){
+		ONION_ERROR("More threads polling than the poller was created for (%d)", p->nshards);
+		return;
+	}
+	__sync_add_and_fetch(&p->npollers, 1);
+	onion_poller_current=s;
+	ONION_DEBUG0("Npollers %d. %d listenings", p->npollers, p->n);
+
+	onion_poller_shard_inbox(s);
 	time_t ctime;
 	int timeout;
-	while (!p->stop && p->head){
+	while (!p->stop && p->n>0){
 		ctime=time(NULL);
-		pthread_mutex_lock(&p->mutex);
-		maxtime=onion_poller_get_next_timeout(p);
-		pthread_mutex_unlock(&p->mutex);
-		
-		timeout=maxtime-ctime;
-		if (timeout>3600)
-			timeout=3600000;
-		else
-			timeout*=1000;
+		timeout=onion_poller_shard_next_timeout(s, ctime);
 		ONION_DEBUG0("Wait for %d ms", timeout);
-		int nfds = epoll_wait(p->fd, event, MAX_EVENTS, timeout);
-		int ctime_end=time(NULL);
-		ONION_DEBUG0("Current time is %d, limit is %d, timeout is %d. Waited for %d seconds", ctime, maxtime, timeout, ctime_end-ctime);
-    ctime=ctime_end;
-
-		pthread_mutex_lock(&p->mutex);
-		{ // Somebody timedout?
-			onion_poller_slot *next=p->head;
-			while (next){
-				onion_poller_slot *cur=next;
-				next=next->next;
-				if (cur->timeout_limit <= ctime){
-					ONION_DEBUG0("Timeout on %d, was %d (ctime %d)", cur->fd, cur->timeout_limit, ctime);
-          int i;
-          for (i=0;i<nfds;i++){
-            onion_poller_slot *el=(onion_poller_slot*)event[i].data.ptr;
-            if (cur==el){ // If removed just one with event, make it ignore the event later.
-              ONION_DEBUG0("Ignoring event as it timeouted: %d", cur->fd);
-              event[i].data.ptr=NULL;
-            }
-          }
-          onion_poller_remove(p, cur->fd);
-				}
-			}
-		}
-		pthread_mutex_unlock(&p->mutex);
-		
-		if (nfds<0){ // This is normally closed p->fd
-			//ONION_DEBUG("Some error happened"); // Also spurious wakeups... gdb is to blame sometimes or any other.
-			if(p->fd<0 || !p->head){
-				ONION_DEBUG("Finishing the epoll as finished: %s", strerror(errno));
-#ifdef HAVE_PTHREADS
-				pthread_mutex_lock(&p->mutex);
-				p->npollers--;
-				pthread_mutex_unlock(&p->mutex);
-#endif
-				return;
+		int nfds = epoll_wait(s->fd, event, MAX_EVENTS, timeout);
+
+		if (nfds<0){ // Spurious wakeups... gdb is to blame sometimes or any other.
+			if (errno!=EINTR){
+				ONION_ERROR("Error polling: %s", strerror(errno));
+				break;
 			}
+			nfds=0;
 		}
 		int i;
 		for (i=0;i<nfds;i++){
 			onion_poller_slot *el=(onion_poller_slot*)event[i].data.ptr;
-      if (!el)
-        continue;
+			if (!el){ // The eventfd
+				uint64_t val;
+				if (read(s->eventfd, &val, sizeof(val)) < 0)
+					ONION_DEBUG0("Error reading eventfd: %s", strerror(errno));
+				continue;
+			}
+			if (el->removed)
+				continue;
 			// Call the callback
-			//ONION_DEBUG("Calling callback for fd %d (%X %X)", el->fd, event[i].events);
 			int n;
 			if (event[i].events&EPOLLRDHUP){
 				n=-1;
 			}
-			else{ // I also take care of the timeout, no timeout when on the handler, it should handle it itself.
-				el->timeout_limit=INT_MAX;
-
+			else{
 #ifdef __DEBUG__
-        char **bs=backtrace_symbols((void * const *)&el->f, 1);
-        ONION_DEBUG0("Calling handler: %s (%d)",bs[0], el->fd);
-        free(bs);
+				char **bs=backtrace_symbols((void * const *)&el->f, 1);
+				ONION_DEBUG0("Calling handler: %s (%d)",bs[0], el->fd);
+				free(bs);
 #endif
 				n=el->f(el->data);
-				
-				ctime=time(NULL);
-				if (el->timeout>0)
-					el->timeout_limit=ctime+el->timeout;
 			}
 			if (n<0){
-				onion_poller_remove(p, el->fd);
+				if (!el->removed)
+					onion_poller_shard_detach(s, el);
 			}
-			else{
-				ONION_DEBUG0("Re setting poller %d", el->fd);
-				event[i].events=EPOLLIN | EPOLLHUP | EPOLLONESHOT;
-				int e=epoll_ctl(p->fd, EPOLL_CTL_MOD, el->fd, &event[i]);
-				if (e<0){
-					ONION_ERROR("Error resetting poller, %s", strerror(errno));
-				}
+			else if (!el->removed){ // I also take care of the timeout, it counts from the end of the handler.
+				if (el->timeout>0)
+					el->timeout_limit=time(NULL)+el->timeout;
+				else
+					el->timeout_limit=INT_MAX;
+				onion_poller_wheel_add(s, el);
 			}
 		}
+		onion_poller_shard_inbox(s);
+		onion_poller_shard_expire(s, time(NULL));
+		onion_poller_shard_bury(s);
 	}
 	ONION_DEBUG0("Finished polling fds");
-#ifdef HAVE_PTHREADS
-	pthread_mutex_lock(&p->mutex);
-	p->npollers--;
+	onion_poller_current=NULL;
+	s->active=0;
+	__sync_sub_and_fetch(&p->npollers, 1);
 	ONION_DEBUG0("Npollers %d", p->npollers);
-	pthread_mutex_unlock(&p->mutex);
-#endif
 }
 
 /**
@@ -447,12 +636,9 @@ void onion_poller_poll(onion_poller *p){
  * @memberof onion_poller_t
  */
 void onion_poller_stop(onion_poller *p){
-  int ret;
-  ONION_DEBUG0("Stopping poller");
-  p->stop=1;
-  char data[8]={0,0,0,0, 0,0,0,1};
-  ret = write(p->eventfd,data,8);
-  if (ret < 0)
-    perror("write");
+	ONION_DEBUG0("Stopping poller");
+	p->stop=1;
+	int i;
+	for (i=0;i<p->nshards;i++)
+		onion_poller_shard_wake(&p->shard[i]);
 }
-
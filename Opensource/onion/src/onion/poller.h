@@ -33,9 +33,13 @@ void onion_poller_slot_free(onion_poller_slot *el);
 void onion_poller_slot_set_shutdown(onion_poller_slot *el, void (*shutdown)(void*), void *data);
 /// Sets the timeout for this slot. Current implementation takes ms, but then it rounds to seconds.
 void onion_poller_slot_set_timeout(onion_poller_slot *el, int timeout);
+/// Sets the polling thread that will watch this slot.
+void onion_poller_slot_set_thread(onion_poller_slot *el, int n);
 
 /// Create a new poller
 onion_poller *onion_poller_new(int aprox_n);
+/// Create a new poller to be polled from nthreads threads, each with its own fds and timeouts.
+onion_poller *onion_poller_new_with_threads(int aprox_n, int nthreads);
 /// Frees the poller. It first stops it.
 void onion_poller_free(onion_poller *);
 
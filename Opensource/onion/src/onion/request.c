@@ -35,6 +35,8 @@
 #include "block.h"
 
 void onion_request_parser_data_free(void *token); // At request_parser.c
+void onion_request_parser_data_clean(void *token); // At request_parser.c
+void onion_response_spare_free(onion_response *res); // At response.c
 
 /**
  * @memberof onion_request_t
@@ -107,6 +109,33 @@ static void unlink_files(void *p, const char *key, const char *value, int flags)
 	unlink(value);
 }
 
+/**
+ * @short Returns an empty dict for the GET, POST or FILES of the request
+ * @memberof onion_request_t
+ *
+ * On keep alive connections the dicts of the previous requests are cleared and kept, so
+ * that each request does not need to allocate them again.
+ */
+onion_dict *onion_request_dict_new(onion_request *req){
+	if (req->nspare_dicts>0)
+		return req->spare_dicts[--req->nspare_dicts];
+	return onion_dict_new();
+}
+
+/**
+ * @short Keeps the dict for a later request on this connection, if nobody else uses it, or frees it.
+ * @memberof onion_request_t
+ */
+static void onion_request_dict_release(onion_request *req, onion_dict *dict){
+	if (dict->refcount==1 && req->nspare_dicts<ONION_REQUEST_SPARE_DICTS){
+		onion_dict_clear(dict);
+		dict->cmp=strcmp;
+		req->spare_dicts[req->nspare_dicts++]=dict;
+	}
+	else
+		onion_dict_free(dict);
+}
+
 /**
  * @short Deletes a request and all its data
  * @memberof onion_request_t
@@ -114,6 +143,8 @@ static void unlink_files(void *p, const char *key, const char *value, int flags)
 void onion_request_free(onion_request *req){
   ONION_DEBUG0("Free request %p", req);
 	onion_dict_free(req->headers);
+	if (req->headers_data)
+		free(req->headers_data);
 	
 	if (req->parser_data){
 		onion_request_parser_data_free(req->parser_data);
@@ -130,8 +161,10 @@ void onion_request_free(onion_request *req){
 		onion_dict_preorder(req->FILES, unlink_files, NULL);
 		onion_dict_free(req->FILES);
 	}
-	if (req->parser_data)
-		free(req->parser_data);
+	while (req->nspare_dicts>0)
+		onion_dict_free(req->spare_dicts[--req->nspare_dicts]);
+	if (req->spare_response)
+		onion_response_spare_free(req->spare_response);
 	if (req->client_info)
 		free(req->client_info);
 	if (req->session){
@@ -151,33 +184,39 @@ void onion_request_free(onion_request *req){
 /**
  * @short Cleans a request object to reuse it.
  * @memberof onion_request_t
+ *
+ * The headers dict, header block and parser token are kept, as are the GET, POST and FILES
+ * dicts as spares, so next request on the connection allocates as little as possible.
  */
 void onion_request_clean(onion_request* req){
   ONION_DEBUG0("Clean request %p", req);
-  onion_dict_free(req->headers);
-  req->headers=onion_dict_new();
-  onion_dict_set_flags(req->headers, OD_ICASE);
-  if (req->parser_data){
-    onion_request_parser_data_free(req->parser_data);
-    req->parser_data=NULL;
+  if (req->headers->refcount==1)
+    onion_dict_clear(req->headers);
+  else{
+    onion_dict_free(req->headers);
+    req->headers=onion_dict_new();
+    onion_dict_set_flags(req->headers, OD_ICASE);
   }
+  if (req->parser_data)
+    onion_request_parser_data_clean(req->parser_data);
   req->parser=NULL;
   req->flags&=OR_NO_KEEP_ALIVE; // I keep keep alive.
+  req->nparams=0;
   if (req->fullpath){
     free(req->fullpath);
     req->path=req->fullpath=NULL;
   }
   if (req->GET){
-    onion_dict_free(req->GET);
+    onion_request_dict_release(req, req->GET);
     req->GET=NULL;
   }
   if (req->POST){
-    onion_dict_free(req->POST);
+    onion_request_dict_release(req, req->POST);
     req->POST=NULL;
   }
   if (req->FILES){
     onion_dict_preorder(req->FILES, unlink_files, NULL);
-    onion_dict_free(req->FILES);
+    onion_request_dict_release(req, req->FILES);
     req->FILES=NULL;
   }
   if (req->session_id){
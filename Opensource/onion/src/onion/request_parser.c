@@ -92,6 +92,9 @@ static onion_connection_status prepare_POST(onion_request *req);
 static onion_connection_status prepare_CONTENT_LENGTH(onion_request *req);
 static onion_connection_status prepare_PUT(onion_request *req);
 
+onion_dict *onion_request_dict_new(onion_request *req); // At request.c
+void onion_response_flush_pipeline(onion_request *req); // At response.c
+
 /// Reads a string until a non-string char. Returns an onion_token
 int token_read_STRING(onion_token *token, onion_buffer *data){
 	if (data->pos>=data->size)
@@ -587,7 +590,7 @@ static onion_connection_status parse_POST_multipart_headers_key(onion_request *r
 	
 	if (res==NEW_LINE){
 		if (!req->POST)
-			req->POST=onion_dict_new();
+			req->POST=onion_request_dict_new(req);
 		ONION_DEBUG("New line");
 		onion_multipart_buffer *multipart=(onion_multipart_buffer*)token->extra;
 		multipart->pos=0;
@@ -598,7 +601,7 @@ static onion_connection_status parse_POST_multipart_headers_key(onion_request *r
 			if (multipart->fd<0)
 				ONION_ERROR("Could not create temporal file at %s.", filename);
 			if (!req->FILES)
-				req->FILES=onion_dict_new();
+				req->FILES=onion_request_dict_new(req);
 			onion_dict_add(req->POST,multipart->name,multipart->filename, 0);
 			onion_dict_add(req->FILES,multipart->name, filename, OD_DUP_VALUE);
 			ONION_DEBUG0("Created temporal file %s",filename);
@@ -662,7 +665,7 @@ static onion_connection_status parse_POST_urlencode(onion_request *req, onion_bu
 	if (res<=1000)
 		return res;
 	
-	req->POST=onion_dict_new();
+	req->POST=onion_request_dict_new(req);
 	onion_request_parse_query_to_dict(req->POST, token->extra);
 
 	return onion_request_process(req);
@@ -723,32 +726,37 @@ static onion_connection_status parse_headers_VALUE(onion_request *req, onion_buf
 	return parse_headers_VALUE_multiline_if_space(req, data);
 }
 
+/**
+ * @short All headers are read, prepares to read the body, if any.
+ */
+static onion_connection_status parse_headers_end(onion_request *req){
+#if 0
+	if ((req->flags&OR_METHODS)==OR_POST)
+		return prepare_POST(req);
+#endif
+	if ((req->flags&OR_METHODS)==OR_PUT)
+		return prepare_PUT(req);
+	if (onion_request_get_header(req, "Content-Length")){ // Soem length, not POST, get data.
+		int n=atoi(onion_request_get_header(req, "Content-Length"));
+		if (n>0)
+			return prepare_CONTENT_LENGTH(req);
+	}
+
+	return onion_request_process(req);
+}
 
 static onion_connection_status parse_headers_KEY(onion_request *req, onion_buffer *data){
 	onion_token *token=req->parser_data;
-	
+
 	int res=token_read_KEY(token, data);
 
 	if (res<=1000)
 		return res;
 
   ONION_DEBUG0("Got %d at KEY",res);
-  
-	if ( res == NEW_LINE ){
-#if 0
-		if ((req->flags&OR_METHODS)==OR_POST)
-			return prepare_POST(req);
-#endif
-		if ((req->flags&OR_METHODS)==OR_PUT)
-			return prepare_PUT(req);
-		if (onion_request_get_header(req, "Content-Length")){ // Soem length, not POST, get data.
-			int n=atoi(onion_request_get_header(req, "Content-Length"));
-			if (n>0)
-				return prepare_CONTENT_LENGTH(req);
-		}
-		
-		return onion_request_process(req);
-	}
+
+	if ( res == NEW_LINE )
+		return parse_headers_end(req);
 	
 	token->extra=strdup(token->str);
 	
@@ -779,7 +787,7 @@ static onion_connection_status parse_headers_VERSION(onion_request *req, onion_b
 		req->flags|=OR_HTTP11;
 
 	if (!req->GET)
-		req->GET=onion_dict_new();
+		req->GET=onion_request_dict_new(req);
 
 	if (res==STRING){
 		req->parser=parse_headers_KEY_skip_NL;
@@ -833,10 +841,152 @@ static onion_connection_status parse_headers_GET(onion_request *req, onion_buffe
 		}
 	}
 	req->parser=parse_headers_URL;
-	
+
 	return parse_headers_URL(req, data);
 }
 
+/// Checks that the token has no spaces, so that the slow path would read it the same way.
+static int token_is_word(const char *p, const char *end){
+	if (p==end)
+		return 0;
+	for (;p<end;p++)
+		if (isspace((unsigned char)*p))
+			return 0;
+	return 1;
+}
+
+/// Checks that the header line has a plain token key (RFC 7230 tchar) before a ':', as the slow path would store it.
+static int header_key_is_token(const char *p, const char *end){
+	const char *colon=memchr(p, ':', end-p);
+	if (!colon || colon==p)
+		return 0;
+	for (;p<colon;p++){
+		unsigned char c=*p;
+		if (!isalnum(c) && (c=='\0' || !strchr("!#$%&'*+-.^_`|~", c)))
+			return 0;
+	}
+	return 1;
+}
+
+/**
+ * @short Parses the full header block at once, when it all came in this data.
+ *
+ * Lines are found with memchr, that on any decent libc is vectorized, instead of reading
+ * char by char into the token. The header block is copied once to req->headers_data and the
+ * headers dict keys and values point into it, so no per header allocations are done.
+ *
+ * If the headers are not complete or have anything unusual (folded lines, HTTP/0.9 request line,
+ * stray \r, keys that are not plain tokens...) falls back to the char by char parser, so both always
+ * give the same headers.
+ */
+static onion_connection_status parse_headers_fast(onion_request *req, onion_buffer *data){
+	const char *start=&data->data[data->pos];
+	const char *end=&data->data[data->size];
+	const char *line=start;
+	const char *nl;
+
+	// Look for the empty line at the end of the headers.
+	for(;;){
+		nl=memchr(line, '\n', end-line);
+		if (!nl)
+			goto slow;
+		if (nl==line || (nl==line+1 && *line=='\r')){
+			if (line==start)
+				goto slow;
+			break;
+		}
+		if (nl+1==end || nl[1]==' ' || nl[1]=='\t') // Maybe a multiline header
+			goto slow;
+		const char *cr=memchr(line, '\r', nl-line);
+		if (cr && cr!=nl-1) // Stray \r, the slow path drops them from keys
+			goto slow;
+		if ((size_t)(nl-line) >= sizeof(((onion_token*)0)->str)) // The slow path truncates or errors
+			goto slow;
+		if (line!=start && !header_key_is_token(line, nl)) // Spaces, control or 8 bit chars at the key
+			goto slow;
+		line=nl+1;
+	}
+	size_t length=nl+1-start;
+
+	// Request line, must be method, url and version.
+	nl=memchr(start, '\n', length);
+	const char *le=(nl>start && nl[-1]=='\r') ? nl-1 : nl;
+	const char *method_end=memchr(start, ' ', le-start);
+	if (!method_end)
+		goto slow;
+	const char *url=method_end+1;
+	const char *url_end=memchr(url, ' ', le-url);
+	if (!url_end)
+		goto slow;
+	const char *version=url_end+1;
+	if (!token_is_word(start, method_end) || !token_is_word(url, url_end) || !token_is_word(version, le))
+		goto slow;
+
+	if (req->headers_data_size<length+1){ // Kept from previous requests on this connection if big enough
+		if (req->headers_data)
+			free(req->headers_data);
+		req->headers_data=malloc(length+1);
+		req->headers_data_size=length+1;
+	}
+	char *block=req->headers_data;
+	memcpy(block, start, length);
+	block[length]='\0';
+	data->pos+=length;
+
+	block[method_end-start]='\0';
+	block[url_end-start]='\0';
+	block[le-start]='\0';
+
+	int i;
+	for (i=0;i<16;i++){
+		if (!onion_request_methods[i]){
+			ONION_ERROR("Unknown method '%s' (%d known methods)",block, i);
+			return OCS_NOT_IMPLEMENTED;
+		}
+		if (strcmp(onion_request_methods[i], block)==0){
+			ONION_DEBUG0("Method is %s", block);
+			req->flags=(req->flags&~0x0F)+i;
+			break;
+		}
+	}
+
+	req->fullpath=strdup(&block[url-start]);
+	onion_request_parse_query(req);
+	ONION_DEBUG0("URL path is %s", req->fullpath);
+
+	if (strcmp(&block[version-start],"HTTP/1.1")==0)
+		req->flags|=OR_HTTP11;
+	if (!req->GET)
+		req->GET=onion_request_dict_new(req);
+
+	// Headers, up to the empty line.
+	char *p=&block[nl+1-start];
+	char *block_end=&block[length];
+	for(;;){
+		char *lnl=memchr(p, '\n', block_end-p);
+		*lnl='\0';
+		if (lnl>p && lnl[-1]=='\r')
+			lnl[-1]='\0';
+		if (*p=='\0')
+			break;
+
+		char *colon=memchr(p, ':', lnl-p); // Always there, checked at header_key_is_token
+		*colon='\0';
+		char *value=colon+1;
+		while (isspace((unsigned char)*value)) value++;
+
+		ONION_DEBUG0("Adding header %s : %s",p,value);
+		onion_dict_add(req->headers, p, value, 0);
+		p=lnl+1;
+	}
+
+	return parse_headers_end(req);
+
+slow:
+	req->parser=parse_headers_GET;
+	return parse_headers_GET(req, data);
+}
+
 
 
 /**
@@ -846,36 +996,45 @@ static onion_connection_status parse_headers_GET(onion_request *req, onion_buffe
  *
  * Depending on the state input is redirected to a diferent parser, one for headers, POST url encoded data... 
  * 
+ * If the data has several pipelined requests, they are all processed in order, reusing the request
+ * object. The responses of all but the last are kept at the response buffer, so they are sent together
+ * with the next ones.
+ * 
  * @return Returns the number of bytes writen, or <=0 if connection should close, according to onion_connection_status
  * @see onion_connection_status
  */
 onion_connection_status onion_request_write(onion_request *req, const char *data, size_t size){
-	onion_token *token;
-	if (!req->parser_data){
-		token=req->parser_data=malloc(sizeof(onion_token));
-		memset(token,0,sizeof(onion_token));
-		req->parser=parse_headers_GET;
-		req->parser_data=token;
-	}
-	else
-		token=req->parser_data;
-	
+	onion_buffer odata={ data, size, 0};
+	onion_connection_status r=OCS_NEED_MORE_DATA;
 	onion_connection_status (*parse)(onion_request *req, onion_buffer *data);
-	parse=req->parser;
-	
-	if (parse){
-		onion_buffer odata={ data, size, 0};
-		while (odata.size>odata.pos){
-			int r=parse(req, &odata);
-			if (r!=OCS_NEED_MORE_DATA){
-				return r;
+
+	req->input=&odata;
+	while (odata.size>odata.pos){
+		if (!req->parser){ // New request. The token is kept from previous ones.
+			if (!req->parser_data){
+				onion_token *token=req->parser_data=malloc(sizeof(onion_token));
+				memset(token,0,sizeof(onion_token));
 			}
-			parse=req->parser;
+			req->parser=parse_headers_fast;
 		}
-		return OCS_NEED_MORE_DATA;
+		parse=req->parser;
+		r=parse(req, &odata);
+		if (r==OCS_KEEP_ALIVE && !req->parser) // Done, and request cleaned. Maybe next request is already here.
+			continue;
+		if (r!=OCS_NEED_MORE_DATA)
+			break;
 	}
-	
-	return OCS_INTERNAL_ERROR;
+	req->input=NULL;
+	onion_response_flush_pipeline(req);
+
+	return r;
+}
+
+/**
+ * @short Returns if there is more data already read after current request, so more pipelined requests.
+ */
+int onion_request_has_pipelined(onion_request *req){
+	return req->input && req->input->pos<req->input->size;
 }
 
 /**
@@ -900,7 +1059,7 @@ static int onion_request_parse_query(onion_request *req){
 	onion_unquote_inplace(req->fullpath);
 	if (have_query){ // There are querys.
 		p++;
-		req->GET=onion_dict_new();
+		req->GET=onion_request_dict_new(req);
 		onion_request_parse_query_to_dict(req->GET, p);
 	}
 	return 1;
@@ -1081,7 +1240,7 @@ static onion_connection_status prepare_PUT(onion_request *req){
 	ONION_DEBUG0("Creating PUT file %s (%d bytes long)", filename, token->extra_size);
 	
 	if (!req->FILES){
-		req->FILES=onion_dict_new();
+		req->FILES=onion_request_dict_new(req);
 	}
 	{
 	const char *filename=onion_block_data(req->data);
@@ -1106,6 +1265,19 @@ static onion_connection_status prepare_PUT(onion_request *req){
 	return OCS_NEED_MORE_DATA;
 }
 
+/**
+ * @short Resets the parser data for the next request on the same connection, keeping the token memory.
+ */
+void onion_request_parser_data_clean(void *t){
+	onion_token *token=t;
+	if (token->extra){
+		free(token->extra);
+		token->extra=NULL;
+	}
+	token->extra_size=0;
+	token->pos=0;
+}
+
 /**
  * @short Frees the parser data.
  */
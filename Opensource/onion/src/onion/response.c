@@ -21,6 +21,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <sys/uio.h>
 
 #include "dict.h"
 #include "request.h"
@@ -30,7 +31,10 @@
 #include "log.h"
 
 const char *onion_response_code_description(int code);
-static int onion_response_write_buffer(onion_response *res);
+static int onion_response_write_buffer(onion_response *res, int last);
+int onion_request_has_pipelined(onion_request *req); // At request_parser.c
+void onion_response_spare_free(onion_response *res);
+void onion_response_flush_pipeline(onion_request *req);
 
 /**
  * @short Generates a new response object
@@ -54,16 +58,35 @@ static int onion_response_write_buffer(onion_response *res);
  * @returns An onion_response object for that request.
  */
 onion_response *onion_response_new(onion_request *req){
-	onion_response *res=malloc(sizeof(onion_response));
+	size_t buffer_size=req ? req->server->response_buffer_size : ONION_RESPONSE_BUFFER_SIZE;
+	onion_response *res;
+	
+	if (req && req->spare_response && req->spare_response->buffer_size==buffer_size){
+		// Reuse the one of the previous request on this connection. The buffer may have pipelined output.
+		res=req->spare_response;
+		req->spare_response=NULL;
+	}
+	else{
+		if (req && req->spare_response){
+			onion_response_flush_pipeline(req);
+			onion_response_spare_free(req->spare_response);
+			req->spare_response=NULL;
+		}
+		res=malloc(sizeof(onion_response)+buffer_size);
+		res->headers=onion_dict_new();
+		res->buffer=(char*)(res+1);
+		res->buffer_size=buffer_size;
+		res->buffer_pos=0;
+	}
 	
 	res->request=req;
-	res->headers=onion_dict_new();
 	res->code=200; // The most normal code, so no need to overwrite it in other codes.
 	res->flags=0;
 	res->sent_bytes_total=res->length=res->sent_bytes=0;
-	res->buffer_pos=0;
+	res->header_pos=0;
 	if (req){
 		res->write=req->server->write;
+		res->writev=req->server->writev;
 		res->socket=req->socket;
 	}
 	
@@ -82,45 +105,72 @@ onion_response *onion_response_new(onion_request *req){
  * 
  * This function returns the close status: OR_KEEP_ALIVE or OR_CLOSE_CONNECTION as needed.
  * 
+ * On keep alive the response is kept at the request to be reused by the next one. If the next
+ * request is already pipelined, the output is left at the buffer to be sent together with the
+ * next response.
+ * 
  * @returns Whether the connection should be closed or not, or an error status to be handled by server.
  * @see onion_connection_status
  */
 onion_connection_status onion_response_free(onion_response *res){
-	// write pending data.
-	onion_response_write_buffer(res);
-	
-	if (res->flags&OR_CHUNKED){ // Set the chunked data end.
-		void *fd=res->socket;
-		onion_write write=res->write;
-		write(fd, "0\r\n\r\n",5);
-	}
-	
 	int r=OCS_CLOSE_CONNECTION;
+	onion_request *req=res->request;
 	
 	// it is a rare ocassion that there is no request, but although unlikely, it may happend
-	if (res->request){
+	if (req){
 		// keep alive only on HTTP/1.1.
 		//ONION_DEBUG("keep alive [req wants] %d && ([skip] %d || [lenght ok] %d || [chunked] %d)", 
 		//						onion_request_keep_alive(res->request),
 		//						res->flags&OR_SKIP_CONTENT,res->length==res->sent_bytes, res->flags&OR_CHUNKED);
-		if ( onion_request_keep_alive(res->request) && 
+		if ( onion_request_keep_alive(req) && 
 				 ( res->flags&OR_SKIP_CONTENT || res->length==res->sent_bytes || res->flags&OR_CHUNKED ) 
 			 )
 			r=OCS_KEEP_ALIVE;
 		
 		// FIXME! This is no proper logging at all. Maybe use a handler.
-		ONION_INFO("[%s] \"%s %s\" %d %d (%s)", onion_request_get_client_description(res->request),
-							 onion_request_methods[res->request->flags&OR_METHODS],
-						res->request->fullpath, res->code, res->sent_bytes,
+		ONION_INFO("[%s] \"%s %s\" %d %d (%s)", onion_request_get_client_description(req),
+							 onion_request_methods[req->flags&OR_METHODS],
+						req->fullpath, res->code, res->sent_bytes,
 						(r==OCS_KEEP_ALIVE) ? "Keep-Alive" : "Close connection");
 	}
 	
-	onion_dict_free(res->headers);
-	free(res);
+	int keep=(r==OCS_KEEP_ALIVE && !req->spare_response && res->headers->refcount==1);
+	
+	// write pending data, and the chunked data end if needed.
+	if (!keep || (res->flags&(OR_CHUNKED|OR_SKIP_CONTENT)) || !onion_request_has_pipelined(req))
+		onion_response_write_buffer(res, 1);
+	
+	if (keep){
+		onion_dict_clear(res->headers);
+		req->spare_response=res;
+	}
+	else
+		onion_response_spare_free(res);
 	
 	return r;
 }
 
+/**
+ * @short Frees a response kept for reuse, without writing anything.
+ * @memberof onion_response_t
+ */
+void onion_response_spare_free(onion_response *res){
+	onion_dict_free(res->headers);
+	free(res);
+}
+
+/**
+ * @short Sends the output of pipelined responses that is still at the buffer of the spare response.
+ * @memberof onion_response_t
+ * 
+ * Called when there is no more read data to process at the connection.
+ */
+void onion_response_flush_pipeline(onion_request *req){
+	onion_response *res=req->spare_response;
+	if (res && res->buffer_pos)
+		onion_response_write_buffer(res, 1);
+}
+
 /**
  * @short Adds a header to the response object
  * @memberof onion_response_t
@@ -214,12 +264,12 @@ int onion_response_write_headers(onion_response *res){
 	res->sent_bytes=0; // the header size is not counted here.
 	
 	if ((res->request->flags&OR_METHODS)==OR_HEAD){
-		onion_response_write_buffer(res);
+		onion_response_write_buffer(res, 0);
 		res->flags|=OR_SKIP_CONTENT;
 		return OR_SKIP_CONTENT;
 	}
-	if (chunked){
-		onion_response_write_buffer(res);
+	if (chunked){ // Headers are kept at the buffer, and sent with the first chunk.
+		res->header_pos=res->buffer_pos;
 		res->flags|=OR_CHUNKED;
 	}
 	
@@ -251,7 +301,7 @@ ssize_t onion_response_write(onion_response *res, const char *data, size_t lengt
 		return OCS_CLOSE_CONNECTION;
 	}
 	if (length==0){
-		onion_response_write_buffer(res);
+		onion_response_write_buffer(res, 0);
 		return 0;
 	}
 	res->sent_bytes+=length;
@@ -259,12 +309,12 @@ ssize_t onion_response_write(onion_response *res, const char *data, size_t lengt
 
 	int l=length;
 	int w=0;
-	while (res->buffer_pos+l>sizeof(res->buffer)){
-		int wb=sizeof(res->buffer)-res->buffer_pos;
+	while (res->buffer_pos+l>res->buffer_size){
+		int wb=res->buffer_size-res->buffer_pos;
 		memcpy(&res->buffer[res->buffer_pos], data, wb);
 		
-		res->buffer_pos=sizeof(res->buffer);
-		if (onion_response_write_buffer(res)<0)
+		res->buffer_pos=res->buffer_size;
+		if (onion_response_write_buffer(res, 0)<0)
 			return w;
 		
 		l-=wb;
@@ -279,39 +329,83 @@ ssize_t onion_response_write(onion_response *res, const char *data, size_t lengt
 	return w;
 }
 
-/// Writes all buffered output waiting for sending.
-static int onion_response_write_buffer(onion_response *res){
-	if (res->flags&OR_SKIP_CONTENT || res->buffer_pos==0)
-		return 0;
-	void *fd=res->request->socket;
-	onion_write write=res->write;
+/**
+ * @short Writes all the iovecs, with a single writev if possible, or a write for each.
+ *
+ * The iovecs are modified as written.
+ */
+static int onion_response_writev(onion_response *res, struct iovec *iov, int iovcnt){
+	void *fd=res->socket;
 	ssize_t w;
-	off_t pos=0;
-	//ONION_DEBUG0("Write %d bytes",res->buffer_pos);
-	if (res->flags&OR_CHUNKED){
-		char tmp[16];
-		snprintf(tmp,sizeof(tmp),"%X\r\n",(unsigned int)res->buffer_pos);
-		if (write(fd, tmp, strlen(tmp))<=0){
-			ONION_WARNING("Error writing chunk encoding length. Aborting write.");
-			return OCS_CLOSE_CONNECTION;
-		}
-	}
-	while ( (w=write(fd, &res->buffer[pos], res->buffer_pos)) != res->buffer_pos){
-		if (w<=0 || res->buffer_pos<0){
-			ONION_ERROR("Error writing %d bytes. Maybe closed connection. Code %d. ",res->buffer_pos, w);
+
+	while (iovcnt>0){
+		if (res->writev)
+			w=res->writev(fd, iov, iovcnt);
+		else
+			w=res->write(fd, iov->iov_base, iov->iov_len);
+		if (w<=0){
+			ONION_ERROR("Error writing %d bytes. Maybe closed connection. Code %d. ",(int)iov->iov_len, (int)w);
 			perror("");
-			res->buffer_pos=0;
 			return OCS_CLOSE_CONNECTION;
 		}
-		pos+=w;
-		ONION_DEBUG0("Write %d-%d bytes",res->buffer_pos,w);
-		res->buffer_pos-=w;
+		while (iovcnt>0 && w>=iov->iov_len){
+			w-=iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt>0){
+			ONION_DEBUG0("Write %d-%d bytes",(int)iov->iov_len,(int)w);
+			iov->iov_base=(char*)iov->iov_base+w;
+			iov->iov_len-=w;
+		}
 	}
+	return 0;
+}
+
+/**
+ * @short Writes all buffered output waiting for sending.
+ *
+ * On chunked responses the pending headers, chunk length, data and chunk end, and on the last one the
+ * chunked data end, are all sent at once.
+ */
+static int onion_response_write_buffer(onion_response *res, int last){
+	if (res->flags&OR_SKIP_CONTENT)
+		return 0;
+	struct iovec iov[4];
+	int n=0;
+	char tmp[16];
+
 	if (res->flags&OR_CHUNKED){
-		write(fd,"\r\n",2);
+		off_t length=res->buffer_pos-res->header_pos;
+		if (res->header_pos){
+			iov[n].iov_base=res->buffer;
+			iov[n++].iov_len=res->header_pos;
+		}
+		if (length>0){
+			snprintf(tmp,sizeof(tmp),"%X\r\n",(unsigned int)length);
+			iov[n].iov_base=tmp;
+			iov[n++].iov_len=strlen(tmp);
+			iov[n].iov_base=&res->buffer[res->header_pos];
+			// The chunk end goes with the data end on the last one.
+			iov[n++].iov_len=length;
+			iov[n].iov_base=last ? "\r\n0\r\n\r\n" : "\r\n";
+			iov[n++].iov_len=last ? 7 : 2;
+		}
+		else if (last){
+			iov[n].iov_base="0\r\n\r\n";
+			iov[n++].iov_len=5;
+		}
 	}
-	res->buffer_pos=0;
-	return 0;
+	else if (res->buffer_pos){
+		iov[n].iov_base=res->buffer;
+		iov[n++].iov_len=res->buffer_pos;
+	}
+	//ONION_DEBUG0("Write %d bytes",res->buffer_pos);
+
+	res->buffer_pos=res->header_pos=0;
+	if (n==0)
+		return 0;
+	return onion_response_writev(res, iov, n);
 }
 
 /// Writes a 0-ended string to the response.
@@ -26,6 +26,7 @@
 #include "log.h"
 #include "sessions.h"
 #include "mime.h"
+#include "shortcuts.h"
 
 /// Default error handler.
 static int onion_default_error(void *handler, onion_request *req, onion_response *res);
@@ -42,14 +43,17 @@ static int onion_default_error(void *handler, onion_request *req, onion_response
  *  * internal_error_handler
  *  * max_post_size -- 1MB
  *  * max_file_size -- 1GB
+ *  * response_buffer_size -- ONION_RESPONSE_BUFFER_SIZE
  */
 onion_server *onion_server_new(void){
 	onion_server *ret=malloc(sizeof(onion_server));
 	ret->root_handler=NULL;
 	ret->write=NULL;
+	ret->writev=NULL;
 	ret->internal_error_handler=onion_handler_new((onion_handler_handler)onion_default_error, NULL, NULL);
 	ret->max_post_size=1024*1024; // 1MB
 	ret->max_file_size=1024*1024*1024; // 1GB
+	ret->response_buffer_size=ONION_RESPONSE_BUFFER_SIZE;
 	ret->sessions=onion_sessions_new();
 	return ret;
 }
@@ -64,6 +68,7 @@ void onion_server_free(onion_server *server){
 	if (server->internal_error_handler)
 		onion_handler_free(server->internal_error_handler);
 	onion_mime_set(NULL);
+	onion_shortcut_file_cache_clear();
 	onion_sessions_free(server->sessions);
 	free(server);
 }
@@ -78,6 +83,17 @@ void onion_server_set_write(onion_server *server, onion_write write){
 	server->write=write;
 }
 
+/**
+ * @short Sets the gather writer function.
+ * @memberof onion_server_t
+ * 
+ * It has the signature int (*onion_writev)(void *handler, const struct iovec *iov, int iovcnt). It is optional, if
+ * not set (NULL) each buffer is written with the write function.
+ */
+void onion_server_set_writev(onion_server *server, onion_writev writev){
+	server->writev=writev;
+}
+
 /**
  * @short Sets the writer function. 
  * @memberof onion_server_t
@@ -148,6 +164,29 @@ void onion_server_set_max_file_size(onion_server *server, size_t max_file_size){
 	server->max_file_size=max_file_size;
 }
 
+/**
+ * @short Sets the size of the output buffer of each response
+ * @memberof onion_server_t
+ * 
+ * Data written to a response is sent when the buffer is full, or at the end of the response. Bigger buffers
+ * mean less system calls and chunks on big responses, at the expense of memory for each response.
+ */
+void onion_server_set_response_buffer_size(onion_server *server, size_t size){
+	if (size<64)
+		size=64;
+	server->response_buffer_size=size;
+}
+
+/**
+ * @short Returns the sessions storage of this server.
+ * @memberof onion_server_t
+ * 
+ * It can be used to change the sessions timeout and max number. @see onion_sessions_set_timeout
+ */
+onion_sessions *onion_server_get_sessions(onion_server *server){
+	return server->sessions;
+}
+
 /**
  * @short  Performs the processing of the request.
  * @memberof onion_server_t
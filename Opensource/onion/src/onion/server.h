@@ -34,6 +34,8 @@ onion_server *onion_server_new();
 void onion_server_free(onion_server *server);
 /// Sets the write function
 void onion_server_set_write(onion_server *server, onion_write write);
+/// Sets the gather write function
+void onion_server_set_writev(onion_server *server, onion_writev writev);
 /// Sets the close function
 void onion_server_set_close(onion_server *server, onion_close close);
 
@@ -55,6 +57,12 @@ void onion_server_set_max_post_size(onion_server *server, size_t max_post_size);
 /// Sets the maximum file size
 void onion_server_set_max_file_size(onion_server *server, size_t max_file_size);
 
+/// Sets the size of the output buffer of each response
+void onion_server_set_response_buffer_size(onion_server *server, size_t size);
+
+/// Returns the sessions storage, for example to set the sessions timeout.
+onion_sessions *onion_server_get_sessions(onion_server *server);
+
 /// Writes some data to a specific request.
 onion_connection_status onion_server_write_to_request(onion_server *server, onion_request *request, const char *data, size_t len);
 
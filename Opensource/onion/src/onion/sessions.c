@@ -18,66 +18,254 @@
 
 #include <malloc.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #include "sessions.h"
 #include "types_internal.h"
 #include "dict.h"
 #include "log.h"
 
+#ifdef HAVE_PTHREADS
+# define ONION_THREAD_LOCAL __thread
+#else  // if no pthreads, ignore locks.
+# define ONION_THREAD_LOCAL
+# define pthread_mutex_init(...)
+# define pthread_mutex_destroy(...)
+# define pthread_mutex_lock(...)
+# define pthread_mutex_unlock(...)
+#endif
+
+/// Initial buckets at each shard. Always a power of 2.
+#define ONION_SESSIONS_MIN_BUCKETS 16
+
+typedef struct onion_session_t onion_session;
+
+/// Random data of this thread, read from the system in blocks, so not each id needs a syscall.
+static ONION_THREAD_LOCAL unsigned char onion_sessions_random[256];
+static ONION_THREAD_LOCAL unsigned int onion_sessions_random_pos=sizeof(onion_sessions_random);
+
+/// Reads more random data from /dev/urandom. If not possible falls back to rand_r, which is not safe.
+static void onion_sessions_random_fill(){
+	ssize_t r=-1;
+	int fd=open("/dev/urandom", O_RDONLY);
+	if (fd>=0){
+		r=read(fd, onion_sessions_random, sizeof(onion_sessions_random));
+		close(fd);
+	}
+	if (r!=sizeof(onion_sessions_random)){
+		static ONION_THREAD_LOCAL unsigned int seed=0;
+		int i;
+		ONION_ERROR("Could not read /dev/urandom. Session ids are NOT SAFE.");
+		if (!seed)
+			seed=time(NULL)^(unsigned long)&seed;
+		for (i=0;i<sizeof(onion_sessions_random);i++)
+			onion_sessions_random[i]=rand_r(&seed);
+	}
+	onion_sessions_random_pos=0;
+}
+
 /**
  * @short Generates a unique id.
  * @memberof onion_sessions_t
  * 
  * This unique id is also dificult to guess, so that blind guessing will not work.
  * 
- * Just now random 32 bytes string with alphanum chars. Not really safe as using simple C rand.
+ * Its a random 32 bytes string with alphanum chars, from the system cryptographic random generator. 
+ * Each thread keeps its own block of random data, so no locks are needed.
  * 
  * The memory is malloc'ed and will be freed somewhere.
  */
 char *onion_sessions_generate_id(){
 	char allowed_chars[]="abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+	const int nchars=sizeof(allowed_chars)-1;
 	
-	char *ret=malloc(33);
-	int i;
-	for (i=0;i<32;i++){
-		int c=rand()%(sizeof(allowed_chars)-1);
-		ret[i]=allowed_chars[c];
+	char *ret=malloc(ONION_SESSION_ID_LENGTH+1);
+	int i=0;
+	while (i<ONION_SESSION_ID_LENGTH){
+		if (onion_sessions_random_pos>=sizeof(onion_sessions_random))
+			onion_sessions_random_fill();
+		unsigned char c=onion_sessions_random[onion_sessions_random_pos++];
+		if (c>=(256/nchars)*nchars) // So that all chars have the same probability
+			continue;
+		ret[i++]=allowed_chars[c%nchars];
 	}
 	ret[i]='\0';
 	return ret;
 }
 
+/// Hash of the session id, FNV-1a. Low bits select the shard, the others the bucket.
+static unsigned int onion_sessions_hash(const char *id){
+	unsigned int h=2166136261u;
+	for (;*id;id++){
+		h^=(unsigned char)*id;
+		h*=16777619u;
+	}
+	return h;
+}
+
+static struct onion_sessions_shard_t *onion_sessions_shard(onion_sessions *sessions, unsigned int hash){
+	return &sessions->shards[hash&(ONION_SESSIONS_SHARDS-1)];
+}
+
+static onion_session **onion_sessions_bucket(struct onion_sessions_shard_t *shard, unsigned int hash){
+	return &shard->buckets[(hash/ONION_SESSIONS_SHARDS)&(shard->nbuckets-1)];
+}
+
+/// Looks for the session at the shard. Must have the lock.
+static onion_session *onion_sessions_find(struct onion_sessions_shard_t *shard, const char *id, unsigned int hash){
+	onion_session *s=*onion_sessions_bucket(shard, hash);
+	for (;s;s=s->next)
+		if (s->hash==hash && strcmp(s->id, id)==0)
+			return s;
+	return NULL;
+}
+
+/// Removes the session from the recently used list
+static void onion_sessions_lru_unlink(struct onion_sessions_shard_t *shard, onion_session *s){
+	if (s->newer)
+		s->newer->older=s->older;
+	else
+		shard->newest=s->older;
+	if (s->older)
+		s->older->newer=s->newer;
+	else
+		shard->oldest=s->newer;
+}
+
+/// Adds the session as the most recently used.
+static void onion_sessions_lru_push(struct onion_sessions_shard_t *shard, onion_session *s){
+	s->newer=NULL;
+	s->older=shard->newest;
+	if (shard->newest)
+		shard->newest->newer=s;
+	shard->newest=s;
+	if (!shard->oldest)
+		shard->oldest=s;
+}
+
+/// Marks the session as just used.
+static void onion_sessions_touch(struct onion_sessions_shard_t *shard, onion_session *s, time_t now){
+	s->last_used=now;
+	if (shard->newest==s)
+		return;
+	onion_sessions_lru_unlink(shard, s);
+	onion_sessions_lru_push(shard, s);
+}
+
+/// Removes the session from the shard, and frees it. Must have the lock.
+static void onion_sessions_drop(struct onion_sessions_shard_t *shard, onion_session *s){
+	onion_session **p=onion_sessions_bucket(shard, s->hash);
+	while (*p!=s)
+		p=&(*p)->next;
+	*p=s->next;
+	onion_sessions_lru_unlink(shard, s);
+	shard->count--;
+	onion_dict_free(s->data);
+	free(s);
+}
+
+/**
+ * @short Removes the expired sessions, and the least recently used ones if over the max.
+ * 
+ * As the oldest is always at the end of the list, it is done as the shard is used, and only 
+ * looks at the sessions really to be removed.
+ */
+static void onion_sessions_expire(onion_sessions *sessions, struct onion_sessions_shard_t *shard, time_t now){
+	int max=(sessions->max_sessions+ONION_SESSIONS_SHARDS-1)/ONION_SESSIONS_SHARDS;
+	while (shard->oldest){
+		if (sessions->timeout && now-shard->oldest->last_used>sessions->timeout){
+			ONION_DEBUG("Session '%s' expired", shard->oldest->id);
+		}
+		else if (!(max && shard->count>max))
+			break;
+		onion_sessions_drop(shard, shard->oldest);
+	}
+}
+
+/// Doubles the buckets of the shard. Must have the lock.
+static void onion_sessions_grow(struct onion_sessions_shard_t *shard){
+	onion_session **old=shard->buckets;
+	int nold=shard->nbuckets;
+	int i;
+	shard->nbuckets*=2;
+	shard->buckets=calloc(shard->nbuckets, sizeof(onion_session*));
+	for (i=0;i<nold;i++){
+		onion_session *s=old[i];
+		while (s){
+			onion_session *next=s->next;
+			onion_session **b=onion_sessions_bucket(shard, s->hash);
+			s->next=*b;
+			*b=s;
+			s=next;
+		}
+	}
+	free(old);
+}
+
 /**
  * @short Creates a sessions data object, which keeps all sessions in memory.
  * @memberof onion_sessions_t
  * 
+ * Sessions are split in ONION_SESSIONS_SHARDS shards, each with its own lock, so that
+ * threads using different sessions do not wait for each other.
+ * 
+ * By default sessions expire after ONION_SESSIONS_TIMEOUT seconds without use, and at most
+ * ONION_SESSIONS_MAX are kept. @see onion_sessions_set_timeout @see onion_sessions_set_max_sessions
+ * 
  * TODO: Make it also to allow persistent storage: for example if sqlite is available.
  */
 onion_sessions *onion_sessions_new(){
-	// Just in case nobody elses do it... If somebody else do it, then no problem.
-	srand(time(NULL));
-	
 	onion_sessions *ret=malloc(sizeof(onion_sessions));
-	ret->sessions=onion_dict_new();
+	int i;
+	for (i=0;i<ONION_SESSIONS_SHARDS;i++){
+		struct onion_sessions_shard_t *shard=&ret->shards[i];
+		pthread_mutex_init(&shard->mutex, NULL);
+		shard->nbuckets=ONION_SESSIONS_MIN_BUCKETS;
+		shard->buckets=calloc(shard->nbuckets, sizeof(onion_session*));
+		shard->count=0;
+		shard->newest=shard->oldest=NULL;
+	}
+	ret->timeout=ONION_SESSIONS_TIMEOUT;
+	ret->max_sessions=ONION_SESSIONS_MAX;
 	return ret;
 }
 
-/// Helper to remove all dicts inside session. Called with onion_dict_preorder
-static void onion_sessions_free_helper(void *data, const char *key, onion_dict *value, int flags){
-	onion_dict_free(value);
-}
-
 /**
  * @short Frees the memory used by sessions
  * @memberof onion_sessions_t
  */
 void onion_sessions_free(onion_sessions* sessions){
-	onion_dict_preorder(sessions->sessions, (void*)onion_sessions_free_helper, NULL);
-	onion_dict_free(sessions->sessions);
+	int i;
+	for (i=0;i<ONION_SESSIONS_SHARDS;i++){
+		struct onion_sessions_shard_t *shard=&sessions->shards[i];
+		while (shard->oldest)
+			onion_sessions_drop(shard, shard->oldest);
+		free(shard->buckets);
+		pthread_mutex_destroy(&shard->mutex);
+	}
 	free(sessions);
 }
 
+/**
+ * @short Sets the seconds without use after which a session is removed. 0 means never.
+ * @memberof onion_sessions_t
+ */
+void onion_sessions_set_timeout(onion_sessions *sessions, int seconds){
+	sessions->timeout=seconds;
+}
+
+/**
+ * @short Sets the max number of sessions. When there are more, the least recently used are removed. 0 means no limit.
+ * @memberof onion_sessions_t
+ * 
+ * The limit is kept at each shard, so it is only approximate.
+ */
+void onion_sessions_set_max_sessions(onion_sessions *sessions, int max){
+	sessions->max_sessions=max;
+}
 
 /**
  * @short Creates a new session and returns the sessionId.
@@ -86,9 +274,37 @@ void onion_sessions_free(onion_sessions* sessions){
  * @returns the name. Must be freed by user.
  */
 char *onion_sessions_create(onion_sessions *sessions){
-	char *sessionId=onion_sessions_generate_id();
-	onion_dict *data=onion_dict_new();
-	onion_dict_add(sessions->sessions, sessionId, data, OD_DUP_KEY|OD_DICT);
+	onion_session *s=malloc(sizeof(onion_session));
+	char *sessionId;
+	unsigned int hash;
+	struct onion_sessions_shard_t *shard;
+	time_t now=time(NULL);
+	
+	for(;;){
+		sessionId=onion_sessions_generate_id();
+		hash=onion_sessions_hash(sessionId);
+		shard=onion_sessions_shard(sessions, hash);
+		pthread_mutex_lock(&shard->mutex);
+		if (!onion_sessions_find(shard, sessionId, hash))
+			break;
+		pthread_mutex_unlock(&shard->mutex); // Really unlikely.
+		free(sessionId);
+	}
+	
+	strcpy(s->id, sessionId);
+	s->hash=hash;
+	s->data=onion_dict_new();
+	s->last_used=now;
+	if (shard->count>=shard->nbuckets)
+		onion_sessions_grow(shard);
+	onion_session **b=onion_sessions_bucket(shard, hash);
+	s->next=*b;
+	*b=s;
+	shard->count++;
+	onion_sessions_lru_push(shard, s);
+	onion_sessions_expire(sessions, shard, now);
+	pthread_mutex_unlock(&shard->mutex);
+	
 	ONION_DEBUG("Created the session '%s'",sessionId);
 	return sessionId;
 }
@@ -108,16 +324,29 @@ char *onion_sessions_create(onion_sessions *sessions){
  * onion_sessions_create has to be used. It used to reuse the sessionId if it doe snot exist, but that 
  * looks like an insecure pattern.
  * 
+ * Expired sessions do not exist anymore.
+ * 
  * @returns The session for that id, or NULL if none.
  */
 onion_dict *onion_sessions_get(onion_sessions *sessions, const char *sessionId){
 	ONION_DEBUG0("Accessing session '%s'",sessionId);
-	onion_dict *sess=onion_dict_get_dict(sessions->sessions, sessionId);
-	if (!sess){
-		ONION_DEBUG0("Unknown session '%s'.", sessionId);
-		return NULL;
+	unsigned int hash=onion_sessions_hash(sessionId);
+	struct onion_sessions_shard_t *shard=onion_sessions_shard(sessions, hash);
+	onion_dict *sess=NULL;
+	time_t now=time(NULL);
+	
+	pthread_mutex_lock(&shard->mutex);
+	onion_sessions_expire(sessions, shard, now);
+	onion_session *s=onion_sessions_find(shard, sessionId, hash);
+	if (s){
+		onion_sessions_touch(shard, s, now);
+		sess=onion_dict_dup(s->data);
 	}
-	return onion_dict_dup(sess);
+	pthread_mutex_unlock(&shard->mutex);
+	
+	if (!sess)
+		ONION_DEBUG0("Unknown session '%s'.", sessionId);
+	return sess;
 }
 
 /**
@@ -125,9 +354,46 @@ onion_dict *onion_sessions_get(onion_sessions *sessions, const char *sessionId){
  * @memberof onion_sessions_t
  */
 void onion_sessions_remove(onion_sessions *sessions, const char *sessionId){
-	onion_dict *data=onion_dict_get_dict(sessions->sessions, sessionId);
-	if (data){
-		onion_dict_free(data);
-		onion_dict_remove(sessions->sessions, sessionId);
+	unsigned int hash=onion_sessions_hash(sessionId);
+	struct onion_sessions_shard_t *shard=onion_sessions_shard(sessions, hash);
+	
+	pthread_mutex_lock(&shard->mutex);
+	onion_session *s=onion_sessions_find(shard, sessionId, hash);
+	if (s)
+		onion_sessions_drop(shard, s);
+	pthread_mutex_unlock(&shard->mutex);
+}
+
+/**
+ * @short Returns the number of sessions stored, including the expired ones not removed yet.
+ * @memberof onion_sessions_t
+ */
+int onion_sessions_count(onion_sessions *sessions){
+	int i, count=0;
+	for (i=0;i<ONION_SESSIONS_SHARDS;i++){
+		pthread_mutex_lock(&sessions->shards[i].mutex);
+		count+=sessions->shards[i].count;
+		pthread_mutex_unlock(&sessions->shards[i].mutex);
+	}
+	return count;
+}
+
+/**
+ * @short Calls the function for each session, as onion_dict_preorder with the session id as key and data dict as value.
+ * @memberof onion_sessions_t
+ * 
+ * The function is of prototype void func(void *data, const char *id, onion_dict *session, int flags). Each shard
+ * is locked while visited, so the function must not use the sessions.
+ */
+void onion_sessions_preorder(onion_sessions *sessions, void *func, void *data){
+	void (*f)(void *data, const char *id, onion_dict *session, int flags)=func;
+	int i;
+	for (i=0;i<ONION_SESSIONS_SHARDS;i++){
+		struct onion_sessions_shard_t *shard=&sessions->shards[i];
+		pthread_mutex_lock(&shard->mutex);
+		onion_session *s;
+		for (s=shard->newest;s;s=s->older)
+			f(data, s->id, s->data, OD_DICT);
+		pthread_mutex_unlock(&shard->mutex);
 	}
 }
@@ -40,6 +40,18 @@ onion_dict *onion_sessions_get(onion_sessions *sessions, const char *sessionId);
 /// Removes a session from the storage.
 void onion_sessions_remove(onion_sessions *sessions, const char *sessionId);
 
+/// Sets the seconds without use after which a session expires. 0 never.
+void onion_sessions_set_timeout(onion_sessions *sessions, int seconds);
+
+/// Sets the max number of sessions to keep. 0 no limit.
+void onion_sessions_set_max_sessions(onion_sessions *sessions, int max);
+
+/// Returns the number of sessions
+int onion_sessions_count(onion_sessions *sessions);
+
+/// Calls the function for each session. void func(void *data, const char *id, onion_dict *session, int flags).
+void onion_sessions_preorder(onion_sessions *sessions, void *func, void *data);
+
 #ifdef __cplusplus
 }
 #endif
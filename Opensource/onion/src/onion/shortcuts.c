@@ -29,6 +29,9 @@
 #ifdef USE_SENDFILE
 #include <sys/sendfile.h>
 #endif
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 #include "onion.h"
 #include "log.h"
@@ -109,21 +112,115 @@ onion_connection_status onion_shortcut_internal_redirect(const char *newurl, oni
   return onion_handler_handle(req->server->root_handler, req, res);
 }
 
+/// Files up to this size are kept in memory; bigger ones keep the open fd, and go by sendfile when possible.
+#define ONION_FILE_CACHE_MAX_FILE (256*1024)
+/// Max memory used by the cached file contents.
+#define ONION_FILE_CACHE_MAX_TOTAL (32*1024*1024)
+/// Max files at the cache, also max open fds.
+#define ONION_FILE_CACHE_MAX_ENTRIES 256
+/// Seconds a cached entry is trusted before checking again the file.
+#define ONION_FILE_CACHE_CHECK 1
+
 /**
- * @short This shortcut returns the given file contents. 
- * 
- * It sets all the compilant headers (TODO), cache and so on.
- * 
- * This is the recomended way to send static files; it even can use sendfile Linux call 
- * if suitable (TODO).
- * 
- * It does no security checks, so caller must be security aware.
+ * @short A cached file, with all the data needed for the headers already calculated.
+ *
+ * It is removed from the cache when the file changes or it is the least recently used, but
+ * kept alive until the last user releases it.
  */
-onion_connection_status onion_shortcut_response_file(const char *filename, onion_request *request, onion_response *res){
+typedef struct onion_file_cache_entry_t{
+	char *filename;
+	char *data; ///< File contents, for small files. NULL for big ones.
+	int fd; ///< Open fd for big files, -1 for small ones.
+	size_t size;
+	time_t mtime;
+	ino_t ino;
+	time_t checked;
+	int refcount;
+	char etag[32];
+	char *mime;
+	struct onion_file_cache_entry_t *newer, *older;
+}onion_file_cache_entry;
+
+static struct{
+	onion_dict *files; ///< filename -> entry
+	onion_file_cache_entry *newest, *oldest;
+	int count;
+	size_t total;
+	size_t max_file;
+	size_t max_total;
+}onion_file_cache={ NULL, NULL, NULL, 0, 0, ONION_FILE_CACHE_MAX_FILE, ONION_FILE_CACHE_MAX_TOTAL };
+
+#ifdef HAVE_PTHREADS
+static pthread_mutex_t onion_file_cache_mutex=PTHREAD_MUTEX_INITIALIZER;
+#else
+# define pthread_mutex_lock(...)
+# define pthread_mutex_unlock(...)
+#endif
+
+/// Frees the entry when nobody uses it anymore. Must be called with the mutex locked.
+static void onion_file_cache_release_locked(onion_file_cache_entry *e){
+	if (--e->refcount>0)
+		return;
+	if (e->fd>=0)
+		close(e->fd);
+	free(e->data);
+	free(e->mime);
+	free(e->filename);
+	free(e);
+}
+
+/// Releases the entry returned by onion_file_cache_get.
+static void onion_file_cache_release(onion_file_cache_entry *e){
+	pthread_mutex_lock(&onion_file_cache_mutex);
+	onion_file_cache_release_locked(e);
+	pthread_mutex_unlock(&onion_file_cache_mutex);
+}
+
+/// Removes the entry from the cache. Must be called with the mutex locked.
+static void onion_file_cache_drop(onion_file_cache_entry *e){
+	onion_dict_remove(onion_file_cache.files, e->filename);
+	if (e->newer)
+		e->newer->older=e->older;
+	else
+		onion_file_cache.newest=e->older;
+	if (e->older)
+		e->older->newer=e->newer;
+	else
+		onion_file_cache.oldest=e->newer;
+	onion_file_cache.count--;
+	if (e->data)
+		onion_file_cache.total-=e->size;
+	onion_file_cache_release_locked(e);
+}
+
+/// Sets the entry as the newest one. Must be called with the mutex locked, and the entry out of the list.
+static void onion_file_cache_push(onion_file_cache_entry *e){
+	e->newer=NULL;
+	e->older=onion_file_cache.newest;
+	if (e->older)
+		e->older->newer=e;
+	else
+		onion_file_cache.oldest=e;
+	onion_file_cache.newest=e;
+}
+
+/// Moves the entry to the front of the list. Must be called with the mutex locked.
+static void onion_file_cache_touch(onion_file_cache_entry *e){
+	if (e==onion_file_cache.newest)
+		return;
+	e->newer->older=e->older;
+	if (e->older)
+		e->older->newer=e->newer;
+	else
+		onion_file_cache.oldest=e->newer;
+	onion_file_cache_push(e);
+}
+
+/// Opens the file and prepares a new entry. Small files are read into memory and closed.
+static onion_file_cache_entry *onion_file_cache_load(const char *filename, size_t max_file){
 	int fd=open(filename,O_RDONLY|O_CLOEXEC);
-	
 	if (fd<0)
-		return OCS_NOT_PROCESSED;
+		return NULL;
 
 	if(O_CLOEXEC == 0) { // Good compiler know how to cut this out
 		int flags=fcntl(fd, F_GETFD);
@@ -135,35 +232,224 @@ onion_connection_status onion_shortcut_response_file(const char *filename, onion
 			ONION_ERROR("Setting O_CLOEXEC to file descriptor");
 		}
 	}
-	
+
+	// Data of the opened file, as it may have changed since the stat.
 	struct stat st;
-	if (stat(filename, &st)!=0){
-		ONION_WARNING("File does not exist: %s",filename);
+	if (fstat(fd, &st)!=0 || !S_ISREG(st.st_mode)){
 		close(fd);
-		return OCS_NOT_PROCESSED;
+		return NULL;
 	}
-	
-	if (S_ISDIR(st.st_mode)){
+
+	onion_file_cache_entry *e=calloc(1, sizeof(onion_file_cache_entry));
+	e->fd=fd;
+	e->size=st.st_size;
+	e->mtime=st.st_mtime;
+	e->ino=st.st_ino;
+	e->refcount=1;
+	e->filename=strdup(filename);
+	e->mime=strdup(onion_mime_get(filename));
+	onion_shortcut_etag(&st, e->etag);
+
+	if (e->size<=max_file){
+		e->data=malloc(e->size ? e->size : 1);
+		size_t r=0;
+		while (r<e->size){
+			ssize_t l=pread(fd, e->data+r, e->size-r, r);
+			if (l<=0){
+				ONION_ERROR("Could not read %s (%s)", filename, l<0 ? strerror(errno) : "file shrunk");
+				e->refcount=0;
+				onion_file_cache_release_locked(e);
+				return NULL;
+			}
+			r+=l;
+		}
 		close(fd);
-		return OCS_NOT_PROCESSED;
+		e->fd=-1;
 	}
+	return e;
+}
+
+/**
+ * @short Returns the cache entry for that file, loading it if needed.
+ *
+ * The file is only stat'ed again when the entry is older than ONION_FILE_CACHE_CHECK seconds,
+ * and if the file changed, it is loaded again.
+ *
+ * The returned entry must be released with onion_file_cache_release. Returns NULL if the file is not a
+ * regular file, or can not be opened.
+ */
+static onion_file_cache_entry *onion_file_cache_get(const char *filename){
+	time_t now=time(NULL);
+	onion_file_cache_entry *e=NULL;
+
+	pthread_mutex_lock(&onion_file_cache_mutex);
+	if (onion_file_cache.files)
+		e=(onion_file_cache_entry*)onion_dict_get(onion_file_cache.files, filename);
+	if (e && now-e->checked<ONION_FILE_CACHE_CHECK){
+		onion_file_cache_touch(e);
+		e->refcount++;
+		pthread_mutex_unlock(&onion_file_cache_mutex);
+		return e;
+	}
+	size_t max_file=onion_file_cache.max_file;
+	pthread_mutex_unlock(&onion_file_cache_mutex);
+
+	struct stat st;
+	if (stat(filename, &st)!=0 || !S_ISREG(st.st_mode)){
+		e=NULL;
+	}
+	else{
+		// Look again, as the mutex was released.
+		pthread_mutex_lock(&onion_file_cache_mutex);
+		if (onion_file_cache.files)
+			e=(onion_file_cache_entry*)onion_dict_get(onion_file_cache.files, filename);
+		if (e && e->mtime==st.st_mtime && e->size==st.st_size && e->ino==st.st_ino){
+			e->checked=now;
+			onion_file_cache_touch(e);
+			e->refcount++;
+			pthread_mutex_unlock(&onion_file_cache_mutex);
+			return e;
+		}
+		pthread_mutex_unlock(&onion_file_cache_mutex);
+
+		e=onion_file_cache_load(filename, max_file);
+	}
+
+	pthread_mutex_lock(&onion_file_cache_mutex);
+	onion_file_cache_entry *old=NULL;
+	if (onion_file_cache.files)
+		old=(onion_file_cache_entry*)onion_dict_get(onion_file_cache.files, filename);
+	if (old)
+		onion_file_cache_drop(old);
+	if (e){
+		if (!onion_file_cache.files)
+			onion_file_cache.files=onion_dict_new();
+		e->checked=now;
+		e->refcount++; // One for the cache, one for the caller.
+		onion_dict_add(onion_file_cache.files, e->filename, e, 0);
+		onion_file_cache_push(e);
+		onion_file_cache.count++;
+		if (e->data)
+			onion_file_cache.total+=e->size;
+		while (onion_file_cache.oldest!=e &&
+					(onion_file_cache.count>ONION_FILE_CACHE_MAX_ENTRIES || onion_file_cache.total>onion_file_cache.max_total))
+			onion_file_cache_drop(onion_file_cache.oldest);
+		// Too big even alone, so not cached, just used this time.
+		if (onion_file_cache.total>onion_file_cache.max_total)
+			onion_file_cache_drop(e);
+	}
+	pthread_mutex_unlock(&onion_file_cache_mutex);
+
+	return e;
+}
+
+/**
+ * @short Removes all the files from the cache used by onion_shortcut_response_file.
+ *
+ * Files in use are freed after the current response.
+ */
+void onion_shortcut_file_cache_clear(){
+	pthread_mutex_lock(&onion_file_cache_mutex);
+	while (onion_file_cache.oldest)
+		onion_file_cache_drop(onion_file_cache.oldest);
+	if (onion_file_cache.files){
+		onion_dict_free(onion_file_cache.files);
+		onion_file_cache.files=NULL;
+	}
+	pthread_mutex_unlock(&onion_file_cache_mutex);
+}
+
+/**
+ * @short Sets the limits of the cache used by onion_shortcut_response_file.
+ *
+ * Files up to max_file bytes are kept in memory, up to max_total bytes. Bigger files keep just
+ * the open fd, and are sent with sendfile if possible. With max_file 0 no file is kept in memory.
+ *
+ * The defaults are 256KB and 32MB.
+ */
+void onion_shortcut_file_cache_set_limits(size_t max_file, size_t max_total){
+	pthread_mutex_lock(&onion_file_cache_mutex);
+	onion_file_cache.max_file=max_file;
+	onion_file_cache.max_total=max_total;
+	pthread_mutex_unlock(&onion_file_cache_mutex);
+	onion_shortcut_file_cache_clear();
+}
+
+/// Sends the range of a big file, with sendfile if writing directly to the socket.
+static int onion_file_cache_send_fd(onion_file_cache_entry *e, off_t offset, size_t length, onion_request *request, onion_response *res){
+#ifdef USE_SENDFILE
+	if (request->server->write==(void*)onion_write_to_socket){ // Lets have a house party! I can use sendfile!
+		if (onion_response_write(res,NULL,0)<0)
+			return OCS_CLOSE_CONNECTION;
+		ONION_DEBUG("Using sendfile");
+		res->sent_bytes+=length;
+		res->sent_bytes_total+=length;
+		while (length>0){
+			// With the offset, the fd position is not used, so it can be shared by several threads.
+			ssize_t r=sendfile((long int)request->socket, e->fd, &offset, length);
+			if (r<0 && errno==EINTR)
+				continue;
+			if (r<=0){
+				ONION_ERROR("Could not send all file (%s)", r<0 ? strerror(errno) : "file shrunk");
+				return OCS_INTERNAL_ERROR;
+			}
+			length-=r;
+		}
+		return OCS_PROCESSED;
+	}
+#endif
+	// Ok, no I cant, do it as always.
+	char tmp[16*1024];
+	while (length>0){
+		ssize_t r=pread(e->fd, tmp, length<sizeof(tmp) ? length : sizeof(tmp), offset);
+		if (r<=0){
+			ONION_ERROR("Could not read all file (%s)", r<0 ? strerror(errno) : "file shrunk");
+			return OCS_INTERNAL_ERROR;
+		}
+		ssize_t w=onion_response_write(res, tmp, r);
+		if (w!=r){
+			ONION_ERROR("Wrote less than read: write %d, read %d. Quite probably closed connection.",(int)w,(int)r);
+			return OCS_CLOSE_CONNECTION;
+		}
+		offset+=r;
+		length-=r;
+	}
+	return OCS_PROCESSED;
+}
+
+/**
+ * @short This shortcut returns the given file contents. 
+ * 
+ * It sets all the compilant headers (TODO), cache and so on.
+ * 
+ * This is the recomended way to send static files. Files are kept at a cache, with the
+ * etag and mime type already calculated, and small files are kept in memory. Big files use
+ * the sendfile Linux call if suitable.
+ * 
+ * It does no security checks, so caller must be security aware.
+ */
+onion_connection_status onion_shortcut_response_file(const char *filename, onion_request *request, onion_response *res){
+	onion_file_cache_entry *e=onion_file_cache_get(filename);
+	if (!e)
+		return OCS_NOT_PROCESSED;
 	
-	size_t length=st.st_size;
+	size_t length=e->size;
+	off_t offset=0;
 	
 	char etag[64];
-	onion_shortcut_etag(&st, etag);
+	strcpy(etag, e->etag);
 		
 	const char *range=onion_request_get_header(request, "Range");
 	if (range){
-		strncat(etag,range,sizeof(etag)-1);
+		strncat(etag,range,sizeof(etag)-strlen(etag)-1);
 	}
 	onion_response_set_header(res, "Etag", etag);
 	
 	if (range && strncmp(range,"bytes=",6)==0){
-		onion_response_set_code(res, HTTP_PARTIAL_CONTENT);
 		//ONION_DEBUG("Need just a range: %s",range);
 		char tmp[1024];
-		strncpy(tmp, range+6, 1024);
+		strncpy(tmp, range+6, sizeof(tmp)-1);
+		tmp[sizeof(tmp)-1]='\0';
 		char *start=tmp;
 		char *end=tmp;
 		while (*end!='-' && *end) end++;
@@ -176,19 +462,24 @@ onion_connection_status onion_shortcut_response_file(const char *filename, onion
 			if (*end)
 				ends=atol(end);
 			else
-				ends=length;
+				ends=e->size-1;
+			if (ends>=e->size)
+				ends=e->size-1;
 			starts=atol(start);
-			length=ends-starts+1;
-			lseek(fd, starts, SEEK_SET);
-			snprintf(tmp,sizeof(tmp),"bytes %d-%d/%d",(unsigned int)starts, (unsigned int)ends, (unsigned int)st.st_size);
-			//onion_response_set_header(res, "Accept-Ranges","bytes");
-			onion_response_set_header(res, "Content-Range",tmp);
+			if (starts<=ends && e->size){ // Else not satisfiable, just send it all.
+				onion_response_set_code(res, HTTP_PARTIAL_CONTENT);
+				length=ends-starts+1;
+				offset=starts;
+				snprintf(tmp,sizeof(tmp),"bytes %d-%d/%d",(unsigned int)starts, (unsigned int)ends, (unsigned int)e->size);
+				//onion_response_set_header(res, "Accept-Ranges","bytes");
+				onion_response_set_header(res, "Content-Range",tmp);
+			}
 		}
 	}
 	
 	onion_response_set_length(res, length);
-	onion_response_set_header(res, "Content-Type", onion_mime_get(filename) );
-	ONION_DEBUG("Mime type is %s",onion_mime_get(filename));
+	onion_response_set_header(res, "Content-Type", e->mime);
+	ONION_DEBUG("Mime type is %s",e->mime);
 
   ONION_DEBUG0("Etag %s", etag);
   const char *prev_etag=onion_request_get_header(request, "If-None-Match");
@@ -197,7 +488,7 @@ onion_connection_status onion_shortcut_response_file(const char *filename, onion
     onion_response_set_length(res, 0);
     onion_response_set_code(res, HTTP_NOT_MODIFIED);
     onion_response_write_headers(res);
-    close(fd);
+    onion_file_cache_release(e);
     return OCS_PROCESSED;
   }
 
@@ -205,52 +496,20 @@ onion_connection_status onion_shortcut_response_file(const char *filename, onion
 		length=0;
 	}
 	
+	int ret=OCS_PROCESSED;
 	if (length){
-#ifdef USE_SENDFILE
-		if (request->server->write==(void*)onion_write_to_socket){ // Lets have a house party! I can use sendfile!
-			onion_response_write(res,NULL,0);
-			ONION_DEBUG("Using sendfile");
-			int r=sendfile((long int)request->socket, fd, NULL, length);
-			ONION_DEBUG("Wrote %d, should be %d (%s)", r, length, r==length ? "ok" : "nok");
-			if (r!=length || r<0){
-				ONION_ERROR("Could not send all file (%s)", strerror(errno));
-				close(fd);
-				return OCS_INTERNAL_ERROR;
+		if (e->data){ // In memory, goes with the headers in one write if fits.
+			ssize_t w=onion_response_write(res, e->data+offset, length);
+			if (w!=length){
+				ONION_ERROR("Wrote less than expected: write %d, should be %d. Quite probably closed connection.",(int)w,(int)length);
+				ret=OCS_CLOSE_CONNECTION;
 			}
-			res->sent_bytes+=length;
-			res->sent_bytes_total+=length;
 		}
 		else
-#endif
-		{ // Ok, no I cant, do it as always.
-			int r=0,w;
-			size_t tr=0;
-			char tmp[4046];
-			if (length>sizeof(tmp)){
-				size_t max=length-sizeof(tmp);
-				while( tr<max ){
-					r=read(fd,tmp,sizeof(tmp));
-					tr+=r;
-					if (r<0)
-						break;
-					w=onion_response_write(res, tmp, r);
-					if (w!=r){
-						ONION_ERROR("Wrote less than read: write %d, read %d. Quite probably closed connection.",w,r);
-						break;
-					}
-				}
-			}
-			if (sizeof(tmp) >= (length-tr)){
-				r=read(fd, tmp, length-tr);
-				w=onion_response_write(res, tmp, r);
-				if (w!=r){
-					ONION_ERROR("Wrote less than read: write %d, read %d. Quite probably closed connection.",w,r);
-				}
-			}
-		}
+			ret=onion_file_cache_send_fd(e, offset, length, request, res);
 	}
-	close(fd);
-	return OCS_PROCESSED;
+	onion_file_cache_release(e);
+	return ret;
 }
 
 /**
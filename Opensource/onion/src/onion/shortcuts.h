@@ -43,6 +43,10 @@ onion_connection_status onion_shortcut_internal_redirect(const char *newurl, oni
 
 /// Shortcut for response a static file on disk
 onion_connection_status onion_shortcut_response_file(const char *filename, onion_request *req, onion_response *res);
+/// Sets the size limits of the file cache used by onion_shortcut_response_file.
+void onion_shortcut_file_cache_set_limits(size_t max_file, size_t max_total);
+/// Removes all the files from the file cache.
+void onion_shortcut_file_cache_clear();
 
 /// Shortcut for response json data. Dict is freed before return.
 onion_connection_status onion_shortcut_response_json(onion_dict *d, onion_request *req, onion_response *res);
@@ -126,6 +126,15 @@ typedef struct onion_poller_slot_t onion_poller_slot;
  */
 typedef int (*onion_write)(void *handler, const char *data, unsigned int length);
 
+struct iovec;
+/**
+ * @short Prototype for the gather writing on the socket function.
+ *
+ * Optional. If set, the response sends the chunk headers, data and trailers with a single
+ * call, as writev does with the handler as the fd.
+ */
+typedef int (*onion_writev)(void *handler, const struct iovec *iov, int iovcnt);
+
 /**
  * @short Prototype for the reading on the socket function.
  *
@@ -39,12 +39,21 @@ extern "C"{
 
 #define ONION_REQUEST_BUFFER_SIZE 256
 #define ONION_RESPONSE_BUFFER_SIZE 1500
+#define ONION_URL_MAX_PARAMS 8
+#define ONION_REQUEST_SPARE_DICTS 3
+#define ONION_SESSIONS_SHARDS 16
+#define ONION_SESSIONS_TIMEOUT 3600
+#define ONION_SESSIONS_MAX 65536
+#define ONION_SESSION_ID_LENGTH 32
 
 
 struct onion_dict_node_t;
+struct onion_dict_hash_t;
+struct onion_buffer_s;
 
 struct onion_dict_t{
 	struct onion_dict_node_t *root;
+	struct onion_dict_hash_t *hash; /// If set, data is at this hash table instead of at the tree. @see OD_HASH
 #ifdef HAVE_PTHREADS
 	pthread_rwlock_t lock;
 	pthread_mutex_t refmutex;
@@ -79,18 +88,38 @@ struct onion_t{
 
 struct onion_server_t{
 	onion_write write;					 	/// Function to call to write. The request has the io handler to write to.
+	onion_writev writev;					/// Function to call to write several buffers at once, if any. If NULL uses write for each buffer.
 	onion_read read;					 		/// Function to call to read. The request has the io handler to write to.
 	onion_close close;					 		/// Function to call to close the socket.
 	onion_handler *root_handler;	/// Root processing handler for this server.
 	onion_handler *internal_error_handler;	/// Root processing handler for this server.
 	size_t max_post_size;					/// Maximum size of post data. This is the sum of posts, @see onion_request_write_post
 	size_t max_file_size;					/// Maximum size of files. @see onion_request_write_post
+	size_t response_buffer_size;	/// Size of the output buffer of each response. @see onion_server_set_response_buffer_size
 	onion_sessions *sessions;			/// Storage for sessions.
 };
 
+/**
+ * @short Parameter of an url template, as {name:type}, matched by onion_url.
+ *
+ * The value is a slice of the request path, not 0 ended.
+ */
+struct onion_url_param_t{
+	const char *name;     /// Name at the template
+	const char *value;    /// Start of the value at the path
+	int length;           /// Length of the value
+	int type;             /// Type of the parameter, that checked the value
+	union{
+		long integer;       /// Value of int parameters
+		unsigned char ipv4[4]; /// Value of ipv4 parameters, in network order
+	};
+};
+
 struct onion_request_t{
 	onion_server *server; /// Server original data, like write function
 	onion_dict *headers;  /// Headers prepared for this response.
+	char *headers_data;   /// Copy of the header block when parsed at once. Header keys and values point into it. @see request_parser.c
+	size_t headers_data_size; /// Allocated size of headers_data, that is kept for the next request on the connection.
 	void *socket;         /// Write function handler
 	int flags;            /// Flags for this response. Ored onion_request_flags_e
 
@@ -111,6 +140,14 @@ struct onion_request_t{
 	
 	struct sockaddr_storage client_addr; /// Info as stored by TCP/IP, so that handlers can get as much data as needed from peer
 	socklen_t client_len;	               /// Size of the sockaddr_storage as needed.
+
+	struct onion_url_param_t params[ONION_URL_MAX_PARAMS]; /// Parameters of the url templates matched so far. @see onion_url_add
+	int nparams;                         /// Number of used params
+
+	onion_dict *spare_dicts[ONION_REQUEST_SPARE_DICTS]; /// Empty dicts of previous requests on this connection, reused for GET, POST and FILES.
+	int nspare_dicts;                    /// Number of spare dicts
+	onion_response *spare_response;      /// Response of the previous request, reused for the next one. Its buffer may keep pipelined output not sent yet.
+	struct onion_buffer_s *input;        /// Data being written to the request, to know if more pipelined requests follow. @see onion_request_write
 };
 
 struct onion_response_t{
@@ -121,9 +158,12 @@ struct onion_response_t{
 	unsigned int length;			/// Length, if known of the response, to create the Content-Lenght header. 
 	unsigned int sent_bytes; 	/// Sent bytes at content.
 	unsigned int sent_bytes_total; /// Total sent bytes, including headers.
-	char buffer[ONION_RESPONSE_BUFFER_SIZE]; /// buffer of output data. This way its do not send small chunks all the time, but blocks, so better network use. Also helps to keep alive connections with less than block size bytes.
-	off_t buffer_pos;						/// Position in the internal buffer. When sizeof(buffer) its flushed to the onion_server IO.
+	char *buffer;							/// buffer of output data. This way its do not send small chunks all the time, but blocks, so better network use. Also helps to keep alive connections with less than block size bytes.
+	off_t buffer_size;				/// Size of the buffer, allocated just after the response.
+	off_t buffer_pos;						/// Position in the internal buffer. When buffer_size its flushed to the onion_server IO.
+	off_t header_pos;					/// On chunked responses, the headers at the start of the buffer, not sent yet, so they go on the same write as the first chunk.
 	onion_write write;    /// Write function
+	onion_writev writev;  /// Gather write function, if any
 	void *socket;         /// Write function handler
 };
 
@@ -140,8 +180,33 @@ struct onion_handler_t{
 // struct onion_url_t;
 
 
+/// Session as stored at the shards
+struct onion_session_t{
+	char id[ONION_SESSION_ID_LENGTH+1];
+	unsigned int hash;
+	onion_dict *data;
+	time_t last_used;
+	struct onion_session_t *next;   /// Next at the same bucket
+	struct onion_session_t *newer;  /// Recently used list
+	struct onion_session_t *older;
+};
+
+/// Part of the sessions storage, with its own lock. Sessions go to a shard by the hash of their id.
+struct onion_sessions_shard_t{
+#ifdef HAVE_PTHREADS
+	pthread_mutex_t mutex;
+#endif
+	struct onion_session_t **buckets; /// Hash table of the sessions, chained.
+	int nbuckets;                     /// Always a power of 2.
+	int count;                        /// Sessions at this shard
+	struct onion_session_t *newest;   /// Recently used list, from most to least recent.
+	struct onion_session_t *oldest;
+};
+
 struct onion_sessions_t{
-	onion_dict *sessions; 		/// Where all sessions are stored. Each element is another onion_dict.
+	struct onion_sessions_shard_t shards[ONION_SESSIONS_SHARDS]; /// Where all sessions are stored. Each session data is an onion_dict.
+	int timeout;          /// Seconds without use after which a session expires. 0 never expires.
+	int max_sessions;     /// Max number of sessions, oldest are removed when more are created. 0 no max.
 };
 
 typedef struct onion_block_t{
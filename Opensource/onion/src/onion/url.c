@@ -22,6 +22,8 @@
 #include <unistd.h>
 #include <regex.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <arpa/inet.h>
 
 #include "log.h"
 #include "handler.h"
@@ -33,19 +35,48 @@
 
 enum onion_url_data_flags_e{
 	OUD_REGEXP=1,
-	OUD_STRCMP=2,
+	OUD_TREE=2,
 };
 
 typedef enum onion_url_data_flags_e onion_url_data_flags;
 
+/**
+ * @short Types of the nodes of the url tree
+ * @private
+ */
+enum onion_url_node_type_e{
+	OUN_STATIC=0,
+	OUN_STR=1,
+	OUN_INT=2,
+	OUN_IPV4=3,
+};
+
+/**
+ * @short Node of the url prefix tree.
+ * @private
+ * 
+ * Static nodes match some text, that is split among nodes as needed to keep common prefixes in just one
+ * node, and parameter nodes match a full path segment, up to the next / or the end.
+ */
+typedef struct onion_url_node_t{
+	int type;
+	char *text;											/// Static text, or the parameter name
+	int length;											/// Length of static text
+	onion_handler *inside;					/// Handler if an url ends at this node
+	struct onion_url_node_t *child;	/// First child. Static children are before parameters.
+	struct onion_url_node_t *next;	/// Next sibling
+}onion_url_node;
+
 /**
  * @short Internal onion_url data for each known url
  * @private
+ * 
+ * Consecutive non regexp urls share the same tree, so the order between trees and regexps is kept.
  */
 struct onion_url_data_t{
 	union{
 		regex_t regexp;
-		char *str;
+		onion_url_node *tree;
 	};
 #ifdef __DEBUG__
 	char *orig;
@@ -57,6 +88,67 @@ struct onion_url_data_t{
 
 //typedef struct onion_url_data_t onion_url_data; // already at types-internal.h
 
+/// Checks the value of a parameter node, and sets its typed value.
+static int onion_url_param_check(int type, const char *value, int length, struct onion_url_param_t *param){
+	char tmp[24];
+	char *end;
+	if (length<=0)
+		return 0;
+	if (type==OUN_STR)
+		return 1;
+	if (length>=sizeof(tmp))
+		return 0;
+	memcpy(tmp, value, length);
+	tmp[length]='\0';
+	if (type==OUN_INT){
+		if (!isdigit(tmp[0]) && !(tmp[0]=='-' && isdigit(tmp[1])))
+			return 0;
+		param->integer=strtol(tmp, &end, 10);
+		return *end=='\0';
+	}
+	return inet_pton(AF_INET, tmp, param->ipv4)==1;
+}
+
+/**
+ * @short Looks for the handler of the path at the tree.
+ * 
+ * Static children are tried first, and then parameters, going back if the rest of the path does not match.
+ */
+static onion_handler *onion_url_node_match(onion_url_node *node, onion_request *req, const char *path){
+	onion_url_node *child;
+
+	if (node->inside && *path=='\0')
+		return node->inside;
+
+	for (child=node->child;child;child=child->next){
+		if (child->type==OUN_STATIC){
+			if (*path==child->text[0] && strncmp(path, child->text, child->length)==0){
+				onion_handler *ret=onion_url_node_match(child, req, path+child->length);
+				if (ret)
+					return ret;
+			}
+			continue;
+		}
+		if (req->nparams>=ONION_URL_MAX_PARAMS)
+			break;
+		const char *end=strchr(path, '/');
+		int length=end ? end-path : strlen(path);
+		struct onion_url_param_t *param=&req->params[req->nparams];
+		if (!onion_url_param_check(child->type, path, length, param))
+			continue;
+		param->name=child->text;
+		param->value=path;
+		param->length=length;
+		param->type=child->type;
+		req->nparams++;
+		onion_handler *ret=onion_url_node_match(child, req, path+length);
+		if (ret)
+			return ret;
+		req->nparams--;
+	}
+	return NULL;
+}
+
 /**
  * @short Performs the real request: checks if its for me, and then calls the inside level.
  */
@@ -68,13 +160,16 @@ int onion_url_handler(onion_url_data **dd, onion_request *request, onion_respons
 	const char *path=onion_request_get_path(request);
 	while (next){
 		ONION_DEBUG0("Check %s against %s", onion_request_get_path(request), next->orig);
-		if (next->flags&OUD_STRCMP){
-			if (strcmp(path, next->str)==0){
-				ONION_DEBUG0("Ok, simple match.");
+		if (next->flags&OUD_TREE){
+			int nparams=request->nparams;
+			onion_handler *inside=onion_url_node_match(next->tree, request, path);
+			if (inside){
+				ONION_DEBUG0("Ok, tree match.");
 
-				onion_request_advance_path(request, strlen(next->str));
-				return onion_handler_handle(next->inside, request, response);
+				onion_request_advance_path(request, strlen(path));
+				return onion_handler_handle(inside, request, response);
 			}
+			request->nparams=nparams;
 		}
 		else if (regexec(&next->regexp, onion_request_get_path(request), 16, match, 0)==0){
 			//ONION_DEBUG("Ok,match");
@@ -82,8 +177,9 @@ int onion_url_handler(onion_url_data **dd, onion_request *request, onion_respons
 			for (i=1;i<16;i++){
 				regmatch_t *rm=&match[i];
 				if (rm->rm_so!=-1){
-					char *tmp=malloc(rm->rm_eo-rm->rm_so);
+					char *tmp=malloc(rm->rm_eo-rm->rm_so+1);
 					memcpy(tmp, &path[rm->rm_so], rm->rm_eo-rm->rm_so);
+					tmp[rm->rm_eo-rm->rm_so]='\0';
 					char tmpn[4];
 					snprintf(tmpn,sizeof(tmpn),"%d",i);
 					onion_dict_add(reqheader, tmpn, tmp, OD_DUP_KEY|OD_FREE_VALUE);
@@ -104,16 +200,30 @@ int onion_url_handler(onion_url_data **dd, onion_request *request, onion_respons
 	return 0;
 }
 
+/// Frees a node of the tree and all its children
+static void onion_url_node_free(onion_url_node *node){
+	while (node){
+		onion_url_node *t=node;
+		onion_url_node_free(t->child);
+		if (t->inside)
+			onion_handler_free(t->inside);
+		free(t->text);
+		node=t->next;
+		free(t);
+	}
+}
+
 /// Removes internal data for this handler.
 void onion_url_free_data(onion_url_data **d){
 	onion_url_data *next=*d;
 	while (next){
 		onion_url_data *t=next;
-		onion_handler_free(t->inside);
-		if (t->flags&OUD_REGEXP)
+		if (t->flags&OUD_REGEXP){
+			onion_handler_free(t->inside);
 			regfree(&t->regexp);
+		}
 		else
-			free(t->str);
+			onion_url_node_free(t->tree);
 		next=t->next;
 #ifdef __DEBUG__
 		free(t->orig);
@@ -123,6 +233,160 @@ void onion_url_free_data(onion_url_data **d){
 	free(d);
 }
 
+/// Creates a new tree node, with a copy of the given text
+static onion_url_node *onion_url_node_new(int type, const char *text, int length){
+	onion_url_node *node=calloc(1, sizeof(onion_url_node));
+	node->type=type;
+	node->text=strndup(text, length);
+	node->length=length;
+	return node;
+}
+
+/// Adds a static text under the node, splitting nodes as needed. Returns the node where the text ends.
+static onion_url_node *onion_url_node_add_static(onion_url_node *node, const char *text, int length){
+	while (length>0){
+		onion_url_node **w=&node->child;
+		while (*w && (*w)->type==OUN_STATIC && (*w)->text[0]!=text[0])
+			w=&(*w)->next;
+		onion_url_node *child=*w;
+		if (!child || child->type!=OUN_STATIC){ // New static node, before the parameters
+			onion_url_node *n=onion_url_node_new(OUN_STATIC, text, length);
+			n->next=child;
+			*w=n;
+			return n;
+		}
+		int common=0;
+		while (common<child->length && common<length && child->text[common]==text[common])
+			common++;
+		if (common<child->length){ // Split the child at the common prefix
+			onion_url_node *rest=onion_url_node_new(OUN_STATIC, child->text+common, child->length-common);
+			rest->child=child->child;
+			rest->inside=child->inside;
+			child->child=rest;
+			child->inside=NULL;
+			child->text[common]='\0';
+			child->length=common;
+		}
+		node=child;
+		text+=common;
+		length-=common;
+	}
+	return node;
+}
+
+/// Adds a parameter node, or reuses an equal one.
+static onion_url_node *onion_url_node_add_param(onion_url_node *node, int type, const char *name, int length){
+	onion_url_node **w=&node->child;
+	while (*w){
+		if ((*w)->type==type && strncmp((*w)->text, name, length)==0 && (*w)->text[length]=='\0')
+			return *w;
+		w=&(*w)->next;
+	}
+	*w=onion_url_node_new(type, name, length);
+	return *w;
+}
+
+/**
+ * @short Adds an url template to the tree.
+ * 
+ * @returns 0 if ok, 1 on syntax errors.
+ */
+static int onion_url_tree_add(onion_url_node *tree, const char *url, onion_handler *inside){
+	onion_url_node *node=tree;
+	const char *p=url;
+	int nparams=0;
+	while (*p){
+		const char *start=strchr(p, '{');
+		if (!start){
+			node=onion_url_node_add_static(node, p, strlen(p));
+			break;
+		}
+		if (start!=p)
+			node=onion_url_node_add_static(node, p, start-p);
+		const char *end=strchr(start, '}');
+		if (!end || (end[1]!='\0' && end[1]!='/') || (start!=url && start[-1]!='/') || ++nparams>ONION_URL_MAX_PARAMS){
+			ONION_ERROR("Error analyzing url template '%s'. Parameters are full path elements as {name:type}.", url);
+			return 1;
+		}
+		const char *name=start+1;
+		const char *colon=memchr(name, ':', end-name);
+		int type=OUN_STR;
+		if (colon){
+			int tl=end-colon-1;
+			if (tl==3 && strncmp(colon+1, "int", 3)==0)
+				type=OUN_INT;
+			else if (tl==4 && strncmp(colon+1, "ipv4", 4)==0)
+				type=OUN_IPV4;
+			else if (!(tl==3 && strncmp(colon+1, "str", 3)==0)){
+				ONION_ERROR("Unknown parameter type at url template '%s'. Known are str, int and ipv4.", url);
+				return 1;
+			}
+		}
+		else
+			colon=end;
+		node=onion_url_node_add_param(node, type, name, colon-name);
+		p=end+1;
+	}
+	if (node->inside){
+		ONION_ERROR("Url '%s' already has a handler.", url);
+		return 1;
+	}
+	node->inside=inside;
+	return 0;
+}
+
+/**
+ * @short Gets a parameter of the matched url templates, by name
+ * @memberof onion_request_t
+ * 
+ * @returns A pointer to the value at the path, not 0 ended, and its length at length. NULL if not found.
+ */
+const char *onion_request_get_param(onion_request *req, const char *name, int *length){
+	int i;
+	for (i=req->nparams-1;i>=0;i--){
+		if (strcmp(req->params[i].name, name)==0){
+			if (length)
+				*length=req->params[i].length;
+			return req->params[i].value;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @short Gets an int parameter of the matched url templates, as {name:int}
+ * @memberof onion_request_t
+ * 
+ * @returns 0 if found, -1 if not found or not an int parameter.
+ */
+int onion_request_get_param_int(onion_request *req, const char *name, long *value){
+	int i;
+	for (i=req->nparams-1;i>=0;i--){
+		if (req->params[i].type==OUN_INT && strcmp(req->params[i].name, name)==0){
+			*value=req->params[i].integer;
+			return 0;
+		}
+	}
+	return -1;
+}
+
+/**
+ * @short Gets an IPv4 address parameter of the matched url templates, as {name:ipv4}
+ * @memberof onion_request_t
+ * 
+ * @returns 0 if found, -1 if not found or not an ipv4 parameter.
+ */
+int onion_request_get_param_ipv4(onion_request *req, const char *name, struct in_addr *addr){
+	int i;
+	for (i=req->nparams-1;i>=0;i--){
+		if (req->params[i].type==OUN_IPV4 && strcmp(req->params[i].name, name)==0){
+			memcpy(addr, req->params[i].ipv4, 4);
+			return 0;
+		}
+	}
+	return -1;
+}
+
 /**
  * @short Creates the URL handler to map regex urls to handlers
  * @memberof onion_url_t
@@ -162,6 +426,20 @@ void onion_url_free_data(onion_url_data **d){
  *  onion_request_get_query(req, "1") == ".html"
  * @endcode
  * 
+ * Simple strings can also have typed parameters as full path elements, as {name:type}. The types are str (the
+ * default if no type), int and ipv4. The values are checked when matching, so for example an url template
+ * only matches if an ipv4 parameter is a valid address. The handler gets them already parsed, with no
+ * allocation, with onion_request_get_param, onion_request_get_param_int and onion_request_get_param_ipv4:
+ *
+ * @code
+ *  onion_url_add(url, "route/{prefix:ipv4}/{len:int}", route);
+ *  ...
+ *  onion_request_get_param_int(req, "len", &len);
+ * @endcode
+ *
+ * Strings are compiled into a prefix tree, so they are found with a single walk of the path, whatever the
+ * number of urls. Consecutive strings share the same tree, so the order with the regexps is kept.
+ *
  * Be careful as . means every character, and dots in URLs must be with a backslash \ (double because of
  * C escaping), if using regexps.
  * 
@@ -191,20 +469,31 @@ void onion_url_free(onion_url* url){
  * @short Adds a new handler with the given regexp.
  * @memberof onion_url_t
  * 
- * Adds the given handler.
+ * Adds the given handler. The url takes ownership of it, and frees it on error too.
  * 
  * @returns 0 if everything ok. Else there is a regexp error.
  */
 int onion_url_add_handler(onion_url *url, const char *regexp, onion_handler *next){
 	onion_url_data **w=((onion_url_data**)onion_handler_get_private_data((onion_handler*)url));
+	onion_url_data *last=NULL;
 	while (*w){
+		last=*w;
 		w=&(*w)->next;
 	}
+	
+	if (regexp[0]!='^' && last && last->flags&OUD_TREE){ // Goes to the current tree
+		if (onion_url_tree_add(last->tree, regexp, next)){
+			onion_handler_free(next);
+			return 1;
+		}
+		return 0;
+	}
+	
 	//ONION_DEBUG("Adding handler at %p",w);
 	*w=malloc(sizeof(onion_url_data));
 	onion_url_data *data=*w;
 	
-	data->flags=(regexp[0]=='^') ? OUD_REGEXP : OUD_STRCMP;
+	data->flags=(regexp[0]=='^') ? OUD_REGEXP : OUD_TREE;
 	
 	if (data->flags&OUD_REGEXP){
 		int err=regcomp(&data->regexp, regexp, REG_EXTENDED); // empty regexp, always true. should be fast enough. 
@@ -214,14 +503,23 @@ int onion_url_add_handler(onion_url *url, const char *regexp, onion_handler *nex
 			ONION_ERROR("Error analyzing regular expression '%s': %s.\n", regexp, buffer);
 			free(data);
 			*w=NULL;
+			onion_handler_free(next);
 			return 1;
 		}
+		data->inside=next;
 	}
 	else{
-		data->str=strdup(regexp);
+		data->tree=onion_url_node_new(OUN_STATIC, "", 0);
+		data->inside=NULL;
+		if (onion_url_tree_add(data->tree, regexp, next)){
+			onion_url_node_free(data->tree);
+			free(data);
+			*w=NULL;
+			onion_handler_free(next);
+			return 1;
+		}
 	}
 	data->next=NULL;
-	data->inside=next;
 #ifdef __DEBUG__
 	data->orig=strdup(regexp);
 #endif	
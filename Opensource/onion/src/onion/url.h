@@ -44,6 +44,14 @@ int onion_url_add_static(onion_url *url, const char *regexp, const char *text, i
 /// Returns the related handler for this url
 onion_handler *onion_url_to_handler(onion_url *url);
 
+struct in_addr;
+/// Gets a parameter of the matched url templates. Not 0 ended.
+const char *onion_request_get_param(onion_request *req, const char *name, int *length);
+/// Gets an int parameter of the matched url templates
+int onion_request_get_param_int(onion_request *req, const char *name, long *value);
+/// Gets an ipv4 parameter of the matched url templates
+int onion_request_get_param_ipv4(onion_request *req, const char *name, struct in_addr *addr);
+
 #ifdef __cplusplus
 }
 #endif
@@ -24,6 +24,7 @@
 
 #include "../ctest.h"
 #include <unistd.h>
+#include <time.h>
 #include <onion/block.h>
 
 #ifdef HAVE_PTHREADS
@@ -664,6 +665,136 @@ void t14_dict_case_insensitive(){
   END_LOCAL();
 }
 
+void append_key(char *str, const char *key, const char *value, int flags){
+	strcat(str, key);
+	strcat(str, ",");
+}
+
+void t15_hash(){
+	INIT_LOCAL();
+	char tmp[256];
+	char key[16], val[16];
+	int i;
+	
+	onion_dict *d=onion_dict_new();
+	onion_dict_set_flags(d, OD_HASH);
+	
+	// Grows several times, and removes half.
+	for (i=0;i<10000;i++){
+		sprintf(key,"key %d",i);
+		sprintf(val,"val %d",i);
+		onion_dict_add(d, key, val, OD_DUP_ALL);
+	}
+	FAIL_IF_NOT_EQUAL_INT(onion_dict_count(d), 10000);
+	for (i=0;i<10000;i+=2){
+		sprintf(key,"key %d",i);
+		FAIL_IF_NOT(onion_dict_remove(d, key));
+	}
+	FAIL_IF(onion_dict_remove(d, "key 0"));
+	FAIL_IF_NOT_EQUAL_INT(onion_dict_count(d), 5000);
+	for (i=0;i<10000;i++){
+		sprintf(key,"key %d",i);
+		sprintf(val,"val %d",i);
+		if (i&1){
+			FAIL_IF_NOT_EQUAL_STR(onion_dict_get(d, key), val);
+		}
+		else{
+			FAIL_IF_NOT_EQUAL(onion_dict_get(d, key), NULL);
+		}
+	}
+	onion_dict_clear(d);
+	FAIL_IF_NOT_EQUAL_INT(onion_dict_count(d), 0);
+	
+	// Insertion order, repeated keys and replace.
+	onion_dict_add(d, "c", "1", 0);
+	onion_dict_add(d, "a", "2", 0);
+	onion_dict_add(d, "c", "3", 0);
+	onion_dict_add(d, "b", strdup("4"), OD_FREE_VALUE);
+	onion_dict_add(d, "a", "5", OD_DUP_VALUE|OD_REPLACE);
+	tmp[0]=0;
+	onion_dict_preorder(d, append_key, tmp);
+	FAIL_IF_NOT_EQUAL_STR(tmp, "c,a,c,b,");
+	FAIL_IF_NOT_EQUAL_STR(onion_dict_get(d, "a"), "5");
+	FAIL_IF_NOT_EQUAL_STR(onion_dict_get(d, "c"), "1");
+	FAIL_IF_NOT(onion_dict_remove(d, "c"));
+	FAIL_IF_NOT_EQUAL_STR(onion_dict_get(d, "c"), "3");
+	onion_dict_add(d, "c", "6", 0);
+	
+	onion_dict_set_flags(d, OD_SORTED);
+	tmp[0]=0;
+	onion_dict_preorder(d, append_key, tmp);
+	FAIL_IF_NOT_EQUAL_STR(tmp, "a,b,c,c,");
+	onion_block *b=onion_dict_to_json(d);
+	FAIL_IF_NOT_EQUAL_STR(onion_block_data(b), "{\"a\":\"5\", \"b\":\"4\", \"c\":\"3\", \"c\":\"6\"}");
+	onion_block_free(b);
+	
+	onion_dict *dup=onion_dict_hard_dup(d);
+	FAIL_IF_NOT_EQUAL_INT(onion_dict_count(dup), 4);
+	tmp[0]=0;
+	onion_dict_preorder(dup, append_key, tmp);
+	FAIL_IF_NOT_EQUAL_STR(tmp, "a,b,c,c,");
+	onion_dict_free(dup);
+	onion_dict_free(d);
+	
+	// From a tree, case insensitive.
+	d=onion_dict_new();
+	onion_dict_add(d, "Content-Type", "text/html", OD_DUP_ALL);
+	onion_dict_add(d, "Host", "localhost", 0);
+	onion_dict_set_flags(d, OD_ICASE|OD_HASH);
+	FAIL_IF_NOT_EQUAL_STR(onion_dict_get(d, "content-type"), "text/html");
+	FAIL_IF_NOT_EQUAL_STR(onion_dict_get(d, "HOST"), "localhost");
+	FAIL_IF_NOT_EQUAL_INT(onion_dict_count(d), 2);
+	onion_dict_free(d);
+	
+	END_LOCAL();
+}
+
+static double now(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+/// Adds, gets and frees n elements on the dict, and returns the time it took.
+static double t16_fill(onion_dict *d, char **keys, int n){
+	int i;
+	double start=now();
+	for (i=0;i<n;i++)
+		onion_dict_add(d, keys[i], keys[i], OD_DUP_ALL);
+	for (i=0;i<n;i++){
+		if (!onion_dict_get(d, keys[i]))
+			return -1;
+	}
+	onion_dict_free(d);
+	return now()-start;
+}
+
+void t16_hash_benchmark(){
+	INIT_LOCAL();
+	int n=500000;
+	int i;
+	char **keys=malloc(sizeof(char*)*n);
+	for (i=0;i<n;i++){
+		keys[i]=malloc(32);
+		sprintf(keys[i],"10.%d.%d.0/24#%d",(i>>8)&0xFF,i&0xFF,i);
+	}
+	
+	double tree=t16_fill(onion_dict_new(), keys, n);
+	onion_dict *d=onion_dict_new();
+	onion_dict_set_flags(d, OD_HASH);
+	double hash=t16_fill(d, keys, n);
+	
+	FAIL_IF(tree<0);
+	FAIL_IF(hash<0);
+	ONION_INFO("%d adds and gets: tree %.3f s, hash %.3f s", n, tree, hash);
+	
+	for (i=0;i<n;i++)
+		free(keys[i]);
+	free(keys);
+	
+	END_LOCAL();
+}
+
 int main(int argc, char **argv){
   START();
 	t01_create_add_free();
@@ -683,6 +814,8 @@ int main(int argc, char **argv){
 	t12_dict_in_dict();
 	t13_dict_rget();
   t14_dict_case_insensitive();
+	t15_hash();
+	t16_hash_benchmark();
 	
 	END();
 }
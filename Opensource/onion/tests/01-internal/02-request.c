@@ -405,6 +405,62 @@ exit:
 	END_LOCAL();
 }
 
+static void t09_headers_to_str(char *str, const char *key, const char *value, int flags){
+	strcat(str, key);
+	strcat(str, "=");
+	strcat(str, value);
+	strcat(str, ";");
+}
+
+/// Parses the query at once and char by char, that always goes by the slow path, and both must give the same headers.
+static int t09_check_same_headers(const char *query, const char *host, const char *other){
+	char fast_headers[1024]="", slow_headers[1024]="";
+	onion_request *fast=onion_request_new(server, 0, NULL);
+	onion_request *slow=onion_request_new(server, 0, NULL);
+	int ok_fast, ok_slow=OCS_NEED_MORE_DATA;
+	int i, l=strlen(query);
+	
+	ok_fast=onion_request_write(fast, query, l);
+	for (i=0;i<l;i++)
+		ok_slow=onion_request_write(slow, &query[i], 1);
+	FAIL_IF_NOT_EQUAL_INT(ok_fast, ok_slow);
+	FAIL_IF_NOT_EQUAL_INT(fast->flags, slow->flags);
+	FAIL_IF_NOT_EQUAL_STR(fast->fullpath, slow->fullpath);
+	FAIL_IF_NOT_EQUAL_STR(onion_request_get_header(fast, "Host"), host);
+	FAIL_IF_NOT_EQUAL_STR(onion_request_get_header(fast, "Other-Header"), other);
+	
+	onion_dict_preorder(fast->headers, t09_headers_to_str, fast_headers);
+	onion_dict_preorder(slow->headers, t09_headers_to_str, slow_headers);
+	FAIL_IF_NOT_EQUAL_STR(fast_headers, slow_headers);
+	
+	int used_fast_path=(fast->headers_data!=NULL);
+	FAIL_IF_NOT_EQUAL(slow->headers_data, NULL);
+	
+	onion_request_free(fast);
+	onion_request_free(slow);
+	return used_fast_path;
+}
+
+void t09_fast_path_headers(){
+	INIT_LOCAL();
+	
+	FAIL_IF_NOT(t09_check_same_headers("GET /a/b?c=d HTTP/1.0\r\nHost: 127.0.0.1\r\nOther-Header: My header is long\r\n\r\n",
+	                                   "127.0.0.1", "My header is long"));
+	FAIL_IF_NOT(t09_check_same_headers("GET /a/b?c=d HTTP/1.0\nHost: 127.0.0.1\nOther-Header:   My header \xc3\xb1\r\n\n",
+	                                   "127.0.0.1", "My header \xc3\xb1"));
+	// Same as t04, the \r after the Host line is not part of the next key.
+	FAIL_IF(t09_check_same_headers("GET / HTTP/1.0\nHost: 127.0.0.1\n\rOther-Header: My header is long\r\n\r\n",
+	                               "127.0.0.1", "My header is long"));
+	FAIL_IF(t09_check_same_headers("GET / HTTP/1.0\nHost: 127.0.0.1\nOther\r-Header: My header is long\r\n\r\n",
+	                               "127.0.0.1", "My header is long"));
+	FAIL_IF(t09_check_same_headers("GET / HTTP/1.0\r\n Host: 127.0.0.1\r\nOther-Header: My header is long\r\n\r\n",
+	                               NULL, "My header is long"));
+	FAIL_IF(t09_check_same_headers("GET / HTTP/1.0\r\nHost: 127.0.0.1\r\nOther-Header\xc3\xb1: My header is long\r\n\r\n",
+	                               "127.0.0.1", NULL));
+	
+	END_LOCAL();
+}
+
 int main(int argc, char **argv){
   START();
   
@@ -413,6 +469,7 @@ int main(int argc, char **argv){
 	t02_create_add_free_overflow();
 	t03_create_add_free_full_flow();
 	t04_create_add_free_GET();
+	t09_fast_path_headers(); // Before t05, so it runs even if the POST ones crash
 	t05_create_add_free_POST();
 	t06_create_add_free_POST_toobig();
 	t07_multiline_headers();
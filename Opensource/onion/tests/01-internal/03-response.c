@@ -18,6 +18,7 @@
 
 #include <malloc.h>
 #include <string.h>
+#include <sys/uio.h>
 
 #include <onion/dict.h>
 #include <onion/server.h>
@@ -130,10 +131,66 @@ void t03_full_cycle_http11(){
 	END_LOCAL();
 }
 
+int writev_calls;
+
+/// Appends all the buffers, and counts the calls.
+int writev_append(void *handler, const struct iovec *iov, int iovcnt){
+	int i, l=0;
+	writev_calls++;
+	for (i=0;i<iovcnt;i++)
+		l+=write_append(handler, iov[i].iov_base, iov[i].iov_len);
+	return l;
+}
+
+void t04_chunked_writev(){
+	INIT_LOCAL();
+	
+	onion_server *server=onion_server_new();
+	onion_server_set_write(server, write_append);
+	onion_server_set_writev(server, writev_append);
+	onion_request *request;
+	char buffer[4096];
+	memset(buffer,0,sizeof(buffer));
+	
+	request=onion_request_new(server, buffer, NULL);
+	FILL(request,"GET / HTTP/1.1\n");
+	
+	writev_calls=0;
+	onion_response *response=onion_response_new(request);
+	onion_response_write0(response,"123456789012345678901234567890");
+	onion_response_free(response);
+	
+	// Headers, the only chunk and the chunked end go at once.
+	FAIL_IF_NOT_EQUAL_INT(writev_calls, 1);
+	FAIL_IF_NOT_STRSTR(buffer, "HTTP/1.1 200 OK\r\n");
+	FAIL_IF_NOT_STRSTR(buffer, "Transfer-Encoding: chunked\r\n");
+	FAIL_IF_NOT_STRSTR(buffer, "\r\n\r\n1E\r\n123456789012345678901234567890\r\n0\r\n\r\n");
+	
+	// Small buffer, several chunks.
+	memset(buffer,0,sizeof(buffer));
+	onion_server_set_response_buffer_size(server, 64);
+	writev_calls=0;
+	response=onion_response_new(request);
+	int i;
+	for (i=0;i<10;i++)
+		onion_response_write0(response,"123456789012345678901234567890");
+	onion_response_free(response);
+	
+	FAIL_IF(writev_calls<5);
+	FAIL_IF_NOT_STRSTR(buffer, "\r\n40\r\n");
+	FAIL_IF_NOT_STRSTR(buffer, "\r\n0\r\n\r\n");
+	
+	onion_request_free(request);
+	onion_server_free(server);
+	
+	END_LOCAL();
+}
+
 int main(int argc, char **argv){
 	t01_create_add_free();
 	t02_full_cycle_http10();
 	t03_full_cycle_http11();
+	t04_chunked_writev();
 	
 	END();
 }
@@ -38,6 +38,24 @@ ssize_t mstrncat(char *a, const char *b, size_t l){
 	return strlen(a);
 }
 
+int nwrites=0;
+
+ssize_t mstrncat_count(char *a, const char *b, size_t l){
+	nwrites++;
+	strncat(a,b,l);
+	return l;
+}
+
+/// Writes the path and the x query parameter, if any.
+int write_path(void *p, onion_request *req, onion_response *res){
+	char tmp[64];
+	const char *x=onion_request_get_query(req, "x");
+	snprintf(tmp, sizeof(tmp), "<%s%s>", onion_request_get_path(req), x ? x : "");
+	onion_response_set_length(res, strlen(tmp));
+	onion_response_write0(res, tmp);
+	return OCS_PROCESSED;
+}
+
 
 void t00_server_empty(){
 	INIT_LOCAL();
@@ -315,6 +333,40 @@ void t08_server_with_error_404(){
 	END_LOCAL();
 }
 
+void t09_server_pipelined(){
+	INIT_LOCAL();
+	char buffer[4096];
+	memset(buffer,0,sizeof(buffer));
+	
+	onion_server *server=onion_server_new();
+	onion_server_set_write(server, (onion_write)mstrncat_count);
+	onion_server_set_root_handler(server, onion_handler_new(write_path, NULL, NULL));
+	
+	onion_request *req=onion_request_new(server, buffer, NULL);
+#define S "GET /a HTTP/1.1\r\nHost: x\r\n\r\nGET /b?x=1 HTTP/1.1\r\n\r\nGET /c HTTP/1.1\r\n\r\nGET /d HTTP/1.1\r\nHo"
+	nwrites=0;
+	FAIL_IF_NOT_EQUAL_INT(onion_request_write(req, S, sizeof(S)-1), OCS_NEED_MORE_DATA);
+#undef S
+	// Three responses, in order, at just one write.
+	FAIL_IF_NOT_EQUAL_INT(nwrites, 1);
+	FAIL_IF_NOT_STRSTR(buffer, "\r\n\r\n<a>HTTP/1.1 200 OK\r\n");
+	FAIL_IF_NOT_STRSTR(buffer, "\r\n\r\n<b1>HTTP/1.1 200 OK\r\n");
+	FAIL_IF_NOT_STRSTR(buffer, "\r\n\r\n<c>");
+	FAIL_IF_STRSTR(buffer, "<d>");
+	
+	// The rest of the last one.
+	memset(buffer,0,sizeof(buffer));
+	FAIL_IF_NOT_EQUAL_INT(onion_request_write(req, "st: x\r\n\r\n", 9), OCS_KEEP_ALIVE);
+	FAIL_IF_NOT_EQUAL_INT(nwrites, 2);
+	FAIL_IF_NOT_STRSTR(buffer, "\r\n\r\n<d>");
+	FAIL_IF_STRSTR(buffer, "<c>");
+	
+	onion_request_free(req);
+	onion_server_free(server);
+	
+	END_LOCAL();
+}
+
 int main(int argc, char **argv){
 	t00_server_empty();
 	t01_server_min();
@@ -325,6 +377,7 @@ int main(int argc, char **argv){
 	t06_server_with_error_500();
 	t07_server_with_error_501();
 	t08_server_with_error_404();
+	t09_server_pipelined();
   
 	END();
 }
@@ -24,6 +24,10 @@
 #include "../ctest.h"
 #include <onion/types_internal.h>
 #include <onion/server.h>
+#include <unistd.h>
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
 
 void t01_test_session(){
 	INIT_LOCAL();
@@ -206,7 +210,7 @@ void t03_bug_empty_session_is_new_session(){
   strcpy(sessionid, lastsessionid);
   req->fullpath=NULL;
   onion_request_free(req);
-  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(o->server->sessions->sessions), 1);
+  FAIL_IF_NOT_EQUAL_INT(onion_sessions_count(o->server->sessions), 1);
   
   req=onion_request_new(o->server, NULL, NULL);
   req->fullpath="/";
@@ -217,7 +221,7 @@ void t03_bug_empty_session_is_new_session(){
   FAIL_IF_NOT(has_set_cookie);
   req->fullpath=NULL;
   onion_request_free(req);
-  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(o->server->sessions->sessions), 2);
+  FAIL_IF_NOT_EQUAL_INT(onion_sessions_count(o->server->sessions), 2);
   
   req=onion_request_new(o->server, NULL, NULL);
   req->fullpath="/";
@@ -230,7 +234,7 @@ void t03_bug_empty_session_is_new_session(){
   strcpy(sessionid, lastsessionid);
   req->fullpath=NULL;
   onion_request_free(req);
-  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(o->server->sessions->sessions), 2);
+  FAIL_IF_NOT_EQUAL_INT(onion_sessions_count(o->server->sessions), 2);
   
   req=onion_request_new(o->server, NULL, NULL);
   req->fullpath="/";
@@ -242,7 +246,7 @@ void t03_bug_empty_session_is_new_session(){
   FAIL_IF_NOT(has_set_cookie);
   req->fullpath=NULL;
   onion_request_free(req);
-  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(o->server->sessions->sessions), 3);
+  FAIL_IF_NOT_EQUAL_INT(onion_sessions_count(o->server->sessions), 3);
 
   // Ask for new, without session data, but I will not set data on session, so session is not created.
   set_data_on_session=0;
@@ -252,9 +256,9 @@ void t03_bug_empty_session_is_new_session(){
   FAIL_IF_EQUAL_STR(lastsessionid,"");
   strcpy(sessionid, lastsessionid);
   req->fullpath=NULL;
-  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(o->server->sessions->sessions), 4); // For a moment it exists, until onion realizes is not necesary.
+  FAIL_IF_NOT_EQUAL_INT(onion_sessions_count(o->server->sessions), 4); // For a moment it exists, until onion realizes is not necesary.
   onion_request_free(req);
-  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(o->server->sessions->sessions), 3);
+  FAIL_IF_NOT_EQUAL_INT(onion_sessions_count(o->server->sessions), 3);
 
   
   onion_free(o);
@@ -281,7 +285,7 @@ void t04_lot_of_sessionid(){
   req=onion_request_new(o->server, NULL, NULL);
   req->fullpath="/";
   onion_request_process(req);
-  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(o->server->sessions->sessions), 1);
+  FAIL_IF_NOT_EQUAL_INT(onion_sessions_count(o->server->sessions), 1);
   FAIL_IF_EQUAL_STR(lastsessionid,"");
   strcpy(sessionid, lastsessionid);
   req->fullpath=NULL;
@@ -303,7 +307,7 @@ void t04_lot_of_sessionid(){
   //onion_dict_add(req->headers, "Cookie", tmp2, 0);
   
   onion_request_process(req);
-  FAIL_IF_NOT_EQUAL_INT(onion_dict_count(o->server->sessions->sessions), 1);
+  FAIL_IF_NOT_EQUAL_INT(onion_sessions_count(o->server->sessions), 1);
   FAIL_IF_EQUAL_STR(lastsessionid,"");
   FAIL_IF_NOT_EQUAL_STR(lastsessionid, sessionid);
   FAIL_IF_NOT(has_set_cookie);
@@ -314,6 +318,107 @@ void t04_lot_of_sessionid(){
   END_LOCAL();
 }
 
+/// Makes the session look last used some seconds before, instead of sleeping.
+void t05_backdate(onion_sessions *sessions, const char *id, int seconds){
+  int i;
+  for (i=0;i<ONION_SESSIONS_SHARDS;i++){
+    struct onion_session_t *s;
+    for (s=sessions->shards[i].newest;s;s=s->older)
+      if (strcmp(s->id, id)==0)
+        s->last_used-=seconds;
+  }
+}
+
+void t05_expire(){
+  INIT_LOCAL();
+  
+  onion_sessions *sessions=onion_sessions_new();
+  onion_sessions_set_timeout(sessions, 60);
+  
+  char *old=onion_sessions_create(sessions);
+  char *used=onion_sessions_create(sessions);
+  FAIL_IF_NOT_EQUAL_INT(onion_sessions_count(sessions), 2);
+  t05_backdate(sessions, old, 100);
+  t05_backdate(sessions, used, 30);
+  // Not used for 100 seconds, expired; the other used 30 seconds ago.
+  FAIL_IF_NOT_EQUAL(onion_sessions_get(sessions, old), NULL);
+  onion_dict *d=onion_sessions_get(sessions, used);
+  FAIL_IF_EQUAL(d, NULL);
+  // Still usable by whoever has it, although expired.
+  onion_dict_add(d, "still", "here", 0);
+  t05_backdate(sessions, used, 100);
+  FAIL_IF_NOT_EQUAL(onion_sessions_get(sessions, used), NULL);
+  FAIL_IF_NOT_EQUAL_STR(onion_dict_get(d, "still"), "here");
+  onion_dict_free(d);
+  free(old);
+  free(used);
+  
+  // At most the max, removing the least recently used.
+  onion_sessions_set_timeout(sessions, 0);
+  onion_sessions_set_max_sessions(sessions, 160);
+  char *first=onion_sessions_create(sessions);
+  int i;
+  for (i=0;i<10000;i++){
+    free(onion_sessions_create(sessions));
+    d=onion_sessions_get(sessions, first);
+    FAIL_IF_EQUAL(d, NULL);
+    onion_dict_free(d);
+  }
+  FAIL_IF(onion_sessions_count(sessions)>160);
+  free(first);
+  
+  onion_sessions_free(sessions);
+  
+  END_LOCAL();
+}
+
+#ifdef HAVE_PTHREADS
+#define T06_THREADS 8
+#define T06_SESSIONS 2000
+
+void *t06_thread(onion_sessions *sessions){
+  int i;
+  char *ids[T06_SESSIONS];
+  for (i=0;i<T06_SESSIONS;i++){
+    ids[i]=onion_sessions_create(sessions);
+    onion_dict *d=onion_sessions_get(sessions, ids[i]);
+    onion_dict_add(d, "id", ids[i], OD_DUP_VALUE);
+    onion_dict_free(d);
+  }
+  long ok=0;
+  for (i=0;i<T06_SESSIONS;i++){
+    onion_dict *d=onion_sessions_get(sessions, ids[i]);
+    if (d && strcmp(onion_dict_get(d, "id"), ids[i])==0)
+      ok++;
+    if (d)
+      onion_dict_free(d);
+    if (i&1)
+      onion_sessions_remove(sessions, ids[i]);
+    free(ids[i]);
+  }
+  return (void*)ok;
+}
+
+void t06_threads(){
+  INIT_LOCAL();
+  
+  onion_sessions *sessions=onion_sessions_new();
+  pthread_t thread[T06_THREADS];
+  int i;
+  for (i=0;i<T06_THREADS;i++)
+    pthread_create(&thread[i], NULL, (void*)t06_thread, sessions);
+  for (i=0;i<T06_THREADS;i++){
+    void *ok;
+    pthread_join(thread[i], &ok);
+    FAIL_IF_NOT_EQUAL_INT((int)(long)ok, T06_SESSIONS);
+  }
+  FAIL_IF_NOT_EQUAL_INT(onion_sessions_count(sessions), T06_THREADS*T06_SESSIONS/2);
+  onion_sessions_free(sessions);
+  
+  END_LOCAL();
+}
+#endif
+
 int main(int argc, char **argv){
   START();
   
@@ -321,6 +426,10 @@ int main(int argc, char **argv){
   t02_cookies();
   t03_bug_empty_session_is_new_session();
   t04_lot_of_sessionid();
+  t05_expire();
+#ifdef HAVE_PTHREADS
+  t06_threads();
+#endif
 	
 	END();
 }
@@ -0,0 +1,158 @@
+/*
+	Onion HTTP server library
+	Copyright (C) 2010 David Moreno Montero
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as
+	published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	*/
+
+#include <onion/poller.h>
+#include <onion/log.h>
+#include <sys/socket.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+
+#include "../ctest.h"
+
+#define NPAIRS 20
+#define NTHREADS 3
+
+int shutdowns;
+int reads;
+pthread_t readers[NPAIRS];
+pthread_mutex_t mutex=PTHREAD_MUTEX_INITIALIZER;
+
+void count_shutdown(void *fd){
+	pthread_mutex_lock(&mutex);
+	shutdowns++;
+	pthread_mutex_unlock(&mutex);
+	close((int)(long)fd);
+}
+
+/// Reads the byte and asks to be removed.
+int read_and_remove(void *fd){
+	char c;
+	if (read((int)(long)fd, &c, 1)!=1)
+		return -1;
+	pthread_mutex_lock(&mutex);
+	readers[reads++]=pthread_self();
+	pthread_mutex_unlock(&mutex);
+	return -1;
+}
+
+int keep(void *fd){
+	char c;
+	if (read((int)(long)fd, &c, 1)!=1)
+		return -1;
+	return 0;
+}
+
+void *poll_thread(void *p){
+	onion_poller_poll((onion_poller*)p);
+	return NULL;
+}
+
+void t01_timeout(){
+	INIT_TEST();
+
+	int idle[2], busy[2];
+	FAIL_IF_NOT_EQUAL_INT(socketpair(AF_UNIX, SOCK_STREAM, 0, idle), 0);
+	FAIL_IF_NOT_EQUAL_INT(socketpair(AF_UNIX, SOCK_STREAM, 0, busy), 0);
+
+	shutdowns=0;
+	onion_poller *p=onion_poller_new(8);
+
+	// Idle connection, times out after a second.
+	onion_poller_slot *slot=onion_poller_slot_new(idle[0], keep, (void*)(long)idle[0]);
+	onion_poller_slot_set_shutdown(slot, count_shutdown, (void*)(long)idle[0]);
+	onion_poller_slot_set_timeout(slot, 1000);
+	onion_poller_add(p, slot);
+
+	// Gets data and asks to be removed.
+	slot=onion_poller_slot_new(busy[0], read_and_remove, (void*)(long)busy[0]);
+	onion_poller_slot_set_shutdown(slot, count_shutdown, (void*)(long)busy[0]);
+	onion_poller_add(p, slot);
+	FAIL_IF_NOT_EQUAL_INT(write(busy[1], "x", 1), 1);
+
+	reads=0;
+	time_t start=time(NULL);
+	onion_poller_poll(p); // Returns when there is nothing left to poll.
+	int elapsed=time(NULL)-start;
+
+	FAIL_IF_NOT_EQUAL_INT(reads, 1);
+	FAIL_IF_NOT_EQUAL_INT(shutdowns, 2);
+	FAIL_IF(elapsed<1);
+	FAIL_IF(elapsed>3);
+
+	onion_poller_free(p);
+	close(idle[1]);
+	close(busy[1]);
+
+	END_TEST();
+}
+
+void t02_threads(){
+	INIT_TEST();
+
+	int pairs[NPAIRS][2];
+	int i, j;
+
+	shutdowns=0;
+	reads=0;
+	onion_poller *p=onion_poller_new_with_threads(8, NTHREADS);
+
+	for (i=0;i<NPAIRS;i++){
+		FAIL_IF_NOT_EQUAL_INT(socketpair(AF_UNIX, SOCK_STREAM, 0, pairs[i]), 0);
+		onion_poller_slot *slot=onion_poller_slot_new(pairs[i][0], read_and_remove, (void*)(long)pairs[i][0]);
+		onion_poller_slot_set_shutdown(slot, count_shutdown, (void*)(long)pairs[i][0]);
+		onion_poller_slot_set_timeout(slot, 10000);
+		onion_poller_add(p, slot);
+		FAIL_IF_NOT_EQUAL_INT(write(pairs[i][1], "x", 1), 1);
+	}
+
+	pthread_t thread[NTHREADS];
+	for (i=0;i<NTHREADS;i++)
+		pthread_create(&thread[i], NULL, poll_thread, p);
+	for (i=0;i<NTHREADS;i++)
+		pthread_join(thread[i], NULL);
+
+	FAIL_IF_NOT_EQUAL_INT(reads, NPAIRS);
+	FAIL_IF_NOT_EQUAL_INT(shutdowns, NPAIRS);
+
+	// Slots go round robin to all threads but the first, left for the listen fd.
+	int nthreads=0;
+	for (i=0;i<reads;i++){
+		for (j=0;j<i;j++)
+			if (pthread_equal(readers[i], readers[j]))
+				break;
+		if (j==i)
+			nthreads++;
+	}
+	FAIL_IF_NOT_EQUAL_INT(nthreads, NTHREADS-1);
+
+	onion_poller_free(p);
+	for (i=0;i<NPAIRS;i++)
+		close(pairs[i][1]);
+
+	END_TEST();
+}
+
+int main(int argc, char **argv){
+	START();
+
+	t01_timeout();
+	t02_threads();
+
+	END();
+}
@@ -0,0 +1,97 @@
+/*
+	Onion HTTP server library
+	Copyright (C) 2010 David Moreno Montero
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as
+	published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	*/
+
+#include <onion/dict.h>
+#include <onion/block.h>
+#include <onion/log.h>
+#include <string.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "../ctest.h"
+
+#define BENCH_ENTRIES 1000000
+
+static double now(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec+ts.tv_nsec/1e9;
+}
+
+void t01_nested(){
+	INIT_LOCAL();
+
+	onion_dict *d=onion_dict_new();
+	onion_dict *sub=onion_dict_new();
+	onion_dict *empty=onion_dict_new();
+
+	onion_dict_add(sub, "nexthop", "10.0.0.1", 0);
+	onion_dict_add(sub, "path", "65001 \"65002\"\t\\", 0);
+	onion_dict_add(d, "empty", empty, OD_DICT|OD_FREE_VALUE);
+	onion_dict_add(d, "route", sub, OD_DICT|OD_FREE_VALUE);
+	onion_dict_add(d, "a\nb", "\xe1", 0);
+
+	onion_block *b=onion_dict_to_json(d);
+	FAIL_IF_NOT_EQUAL_STR(onion_block_data(b),
+		"{\"a\\nb\":\"\\341\", \"empty\":{}, \"route\":{\"nexthop\":\"10.0.0.1\", \"path\":\"65001 \\\"65002\\\"\\t\\\\\"}}");
+	onion_block_free(b);
+
+	onion_dict_free(d);
+
+	END_LOCAL();
+}
+
+void t02_benchmark(){
+	INIT_LOCAL();
+
+	onion_dict *d=onion_dict_new();
+	char key[32], value[32];
+	int i;
+
+	for (i=0;i<BENCH_ENTRIES;i++){
+		snprintf(key, sizeof(key), "10.%d.%d.0/24", (i>>8)&0xFF, i&0xFF);
+		snprintf(key+strlen(key), sizeof(key)-strlen(key), "#%d", i);
+		snprintf(value, sizeof(value), "192.168.%d.%d", (i>>8)&0xFF, i&0xFF);
+		onion_dict_add(d, key, value, OD_DUP_ALL);
+	}
+	FAIL_IF_NOT_EQUAL_INT(onion_dict_count(d), BENCH_ENTRIES);
+
+	double start=now();
+	onion_block *b=onion_dict_to_json(d);
+	double elapsed=now()-start;
+
+	FAIL_IF_EQUAL(b, NULL);
+	ONION_INFO("%d entries to json in %.3f s, %ld bytes", BENCH_ENTRIES, elapsed, (long)onion_block_size(b));
+	const char *data=onion_block_data(b);
+	FAIL_IF_NOT_EQUAL_INT(data[0], '{');
+	FAIL_IF_NOT_EQUAL_INT(data[onion_block_size(b)-1], '}');
+
+	onion_block_free(b);
+	onion_dict_free(d);
+
+	END_LOCAL();
+}
+
+int main(int argc, char **argv){
+	START();
+
+	t01_nested();
+	t02_benchmark();
+
+	END();
+}
@@ -0,0 +1,115 @@
+/*
+	Onion HTTP server library
+	Copyright (C) 2010 David Moreno Montero
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as
+	published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	*/
+
+#include <string.h>
+#include <arpa/inet.h>
+
+#include <onion/server.h>
+#include <onion/request.h>
+#include <onion/response.h>
+#include <onion/handler.h>
+#include <onion/url.h>
+#include <onion/block.h>
+#include <onion/log.h>
+
+#include "../ctest.h"
+
+#define FILL(a,b) onion_request_write(a,b,strlen(b))
+
+/// Writes the known parameters, as name=value.
+int write_params(void *p, onion_request *req, onion_response *res){
+	struct in_addr addr;
+	long len;
+	const char *s;
+	int l;
+
+	onion_response_write0(res, (const char*)p);
+	if (onion_request_get_param_ipv4(req, "rid", &addr)==0)
+		onion_response_printf(res, " rid=%s", inet_ntoa(addr));
+	if (onion_request_get_param_ipv4(req, "prefix", &addr)==0)
+		onion_response_printf(res, " prefix=%s", inet_ntoa(addr));
+	if (onion_request_get_param_int(req, "len", &len)==0)
+		onion_response_printf(res, " len=%ld", len);
+	if ((s=onion_request_get_param(req, "name", &l)))
+		onion_response_printf(res, " name=%.*s", l, s);
+	return OCS_PROCESSED;
+}
+
+const char *get(onion_server *server, onion_block *block, const char *path){
+	char tmp[256];
+	onion_block_clear(block);
+	onion_request *request=onion_request_new(server, block, NULL);
+	snprintf(tmp, sizeof(tmp), "GET %s HTTP/1.1\n", path);
+	FILL(request, tmp);
+	onion_server_handle_request(server, request);
+	onion_request_free(request);
+	return onion_block_data(block);
+}
+
+void t01_templates(){
+	INIT_LOCAL();
+
+	onion_block *block=onion_block_new();
+	onion_server *server=onion_server_new();
+	onion_server_set_write(server, (onion_write)onion_block_add_data);
+
+	onion_url *url=onion_url_new();
+	FAIL_IF(onion_url_add_with_data(url, "wm/bgp/performance", write_params, "performance", NULL));
+	FAIL_IF(onion_url_add_with_data(url, "wm/bgp/{rid:ipv4}", write_params, "bgp", NULL));
+	FAIL_IF(onion_url_add_with_data(url, "wm/bgp/{rid:ipv4}/{prefix:ipv4}/{len:int}", write_params, "route", NULL));
+	FAIL_IF(onion_url_add_with_data(url, "wm/bgp/{rid:ipv4}/", write_params, "bgp/", NULL));
+	FAIL_IF(onion_url_add_with_data(url, "wm/bgp/{name}", write_params, "name", NULL));
+	FAIL_IF(onion_url_add_with_data(url, "wm/bgpd", write_params, "bgpd", NULL));
+
+	// Errors
+	FAIL_IF_NOT(onion_url_add_with_data(url, "wm/bgp/{rid:ipv4}", write_params, "again", NULL));
+	FAIL_IF_NOT(onion_url_add_with_data(url, "wm/x{rid:ipv4}", write_params, "x", NULL));
+	FAIL_IF_NOT(onion_url_add_with_data(url, "wm/{rid:ipv6}", write_params, "x", NULL));
+
+	FAIL_IF(onion_url_add_static(url, "^wm/", "Regexp", 200));
+	FAIL_IF(onion_url_add_with_data(url, "wm/after", write_params, "after", NULL));
+	FAIL_IF(onion_url_add_static(url, "^.*", "Not found", 404));
+
+	onion_server_set_root_handler(server, onion_url_to_handler(url));
+
+	FAIL_IF_NOT_STRSTR(get(server, block, "/wm/bgp/performance"), "\r\nperformance\r\n");
+	FAIL_IF_NOT_STRSTR(get(server, block, "/wm/bgpd"), "\r\nbgpd\r\n");
+	FAIL_IF_NOT_STRSTR(get(server, block, "/wm/bgp/10.0.0.1"), "\r\nbgp rid=10.0.0.1\r\n");
+	FAIL_IF_NOT_STRSTR(get(server, block, "/wm/bgp/10.0.0.1/"), "\r\nbgp/ rid=10.0.0.1\r\n");
+	FAIL_IF_NOT_STRSTR(get(server, block, "/wm/bgp/10.0.0.1/192.168.0.0/16"),
+										 "\r\nroute rid=10.0.0.1 prefix=192.168.0.0 len=16\r\n");
+	// Bad typed values fall to other urls
+	FAIL_IF_NOT_STRSTR(get(server, block, "/wm/bgp/10.0.0.256"), "\r\nname name=10.0.0.256\r\n");
+	FAIL_IF_NOT_STRSTR(get(server, block, "/wm/bgp/10.0.0.1/192.168.0.0/x"), "\r\n\r\nRegexp");
+	// The regexp is before
+	FAIL_IF_NOT_STRSTR(get(server, block, "/wm/after"), "\r\n\r\nRegexp");
+	FAIL_IF_NOT_STRSTR(get(server, block, "/other"), "\r\n\r\nNot found");
+
+	onion_server_free(server);
+	onion_block_free(block);
+
+	END_LOCAL();
+}
+
+int main(int argc, char **argv){
+	START();
+
+	t01_templates();
+
+	END();
+}
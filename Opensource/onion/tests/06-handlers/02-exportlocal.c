@@ -20,9 +20,12 @@
 #include <onion/server.h>
 #include <onion/handlers/exportlocal.h>
 #include <onion/log.h>
+#include <onion/shortcuts.h>
 
 #include <string.h>
+#include <stdio.h>
 #include <unistd.h>
+#include <sys/stat.h>
 
 #include "../ctest.h"
 #include "buffer.h"
@@ -90,6 +93,83 @@ void t02_exportfile(){
 	END_TEST();
 }
 
+int REQUEST(onion_request *req, const char *request){
+	onion_request_clean(req);
+	buffer_clear(server_buffer);
+	return onion_request_write(req, request, strlen(request));
+}
+
+void write_file(const char *filename, const char *data){
+	FILE *f=fopen(filename, "w");
+	fputs(data, f);
+	fclose(f);
+}
+
+void t03_file_cache(){
+	INIT_TEST();
+	
+	int code;
+	char etag[64];
+	
+	mkdir("02-exportlocal-cache", 0700);
+	write_file("02-exportlocal-cache/index.html", "<h1>Hello</h1>");
+	onion_handler *handler=onion_handler_export_local_new("02-exportlocal-cache");
+	onion_server_set_root_handler(server, handler);
+	onion_request *req=onion_request_new(server, server_buffer, "TEST");
+
+	code=GET(req, "/index.html");
+	FAIL_IF_NOT_EQUAL_INT(code, OCS_KEEP_ALIVE);
+	FAIL_IF_NOT_STRSTR(server_buffer->data, "Content-Length: 14\r\n");
+	FAIL_IF_NOT_STRSTR(server_buffer->data, "\r\n\r\n<h1>Hello</h1>");
+	const char *e=strstr(server_buffer->data, "Etag: ");
+	FAIL_IF_EQUAL(e, NULL);
+	if (e)
+		sscanf(e, "Etag: %63[^\r]", etag);
+
+	// Now from the cache
+	code=GET(req, "/index.html");
+	FAIL_IF_NOT_STRSTR(server_buffer->data, "\r\n\r\n<h1>Hello</h1>");
+	
+	char tmp[256];
+	snprintf(tmp, sizeof(tmp), "GET /index.html HTTP/1.1\nIf-None-Match: %s\n\n", etag);
+	code=REQUEST(req, tmp);
+	FAIL_IF_NOT_STRSTR(server_buffer->data, "HTTP/1.1 304");
+	FAIL_IF_STRSTR(server_buffer->data, "Hello");
+
+	code=REQUEST(req, "GET /index.html HTTP/1.1\nRange: bytes=4-8\n\n");
+	FAIL_IF_NOT_STRSTR(server_buffer->data, "HTTP/1.1 206");
+	FAIL_IF_NOT_STRSTR(server_buffer->data, "Content-Range: bytes 4-8/14\r\n");
+	FAIL_IF_NOT_STRSTR(server_buffer->data, "\r\n\r\nHello");
+	FAIL_IF_STRSTR(server_buffer->data, "</h1>");
+	
+	// Changes are seen after a second
+	write_file("02-exportlocal-cache/index.html", "<h1>Bye</h1>");
+	sleep(2);
+	code=GET(req, "/index.html");
+	FAIL_IF_NOT_STRSTR(server_buffer->data, "\r\n\r\n<h1>Bye</h1>");
+	
+	// Big files are not kept in memory.
+	onion_shortcut_file_cache_set_limits(4, 1024);
+	code=GET(req, "/index.html");
+	FAIL_IF_NOT_STRSTR(server_buffer->data, "\r\n\r\n<h1>Bye</h1>");
+	code=REQUEST(req, "GET /index.html HTTP/1.1\nRange: bytes=4-\n\n");
+	FAIL_IF_NOT_STRSTR(server_buffer->data, "Content-Range: bytes 4-11/12\r\n");
+	FAIL_IF_NOT_STRSTR(server_buffer->data, "\r\n\r\nBye</h1>");
+	onion_shortcut_file_cache_set_limits(256*1024, 32*1024*1024);
+	
+	unlink("02-exportlocal-cache/index.html");
+	sleep(2);
+	code=GET(req, "/index.html");
+	FAIL_IF_STRSTR(server_buffer->data, "Bye");
+	rmdir("02-exportlocal-cache");
+
+	onion_request_free(req);
+	onion_handler_free(handler);
+	onion_server_set_root_handler(server, NULL);
+	
+	END_TEST();
+}
+
 void init(){
 	server=onion_server_new();
 	server_buffer=buffer_new(4096*1024);
@@ -110,6 +190,7 @@ int main(int argc, char **argv){
 
 	t01_exportdir();
 	t02_exportfile();
+	t03_file_cache();
 	
 	end();
 	END();
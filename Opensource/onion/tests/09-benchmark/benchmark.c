@@ -0,0 +1,581 @@
+/*
+	Onion HTTP server library
+	Copyright (C) 2010 David Moreno Montero
+
+	This program is free software: you can redistribute it and/or modify
+	it under the terms of the GNU Affero General Public License as
+	published by the Free Software Foundation, either version 3 of the
+	License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+	GNU Affero General Public License for more details.
+
+	You should have received a copy of the GNU Affero General Public License
+	along with this program.  If not, see <http://www.gnu.org/licenses/>.
+	*/
+
+#define _GNU_SOURCE
+
+#include <unistd.h>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <time.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <onion/onion.h>
+#include <onion/server.h>
+#include <onion/request.h>
+#include <onion/response.h>
+#include <onion/handler.h>
+#include <onion/url.h>
+#include <onion/dict.h>
+#include <onion/block.h>
+#include <onion/shortcuts.h>
+#include <onion/log.h>
+
+/**
+ * @{ @name Allocation count.
+ *
+ * On glibc the allocation functions are replaced by counting ones, that call the real ones. It also
+ * counts the allocations done inside glibc, as strdup.
+ */
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static long allocs=0;
+
+void *malloc(size_t size){
+	__sync_fetch_and_add(&allocs, 1);
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size){
+	__sync_fetch_and_add(&allocs, 1);
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size){
+	__sync_fetch_and_add(&allocs, 1);
+	return __libc_realloc(ptr, size);
+}
+
+/// Returns the allocations up to now, or -1 if not known.
+static long allocs_count(){
+	return __sync_fetch_and_add(&allocs, 0);
+}
+#else
+static long allocs_count(){
+	return -1;
+}
+#endif
+/// @}
+
+/// Output file, CSV
+FILE *csv;
+/// If set, keeps the onion info messages, as the access log.
+int verbose=0;
+
+void onion_log_stderr(onion_log_level level, const char *filename, int lineno, const char *fmt, ...);
+
+/// Logs only the warnings and errors of onion, as writing the access log would be most of the time.
+static void bench_log(onion_log_level level, const char *filename, int lineno, const char *fmt, ...){
+	if (level<O_WARNING && !verbose && !strstr(filename, "benchmark.c"))
+		return;
+	char tmp[1024];
+	va_list ap;
+	va_start(ap, fmt);
+	vsnprintf(tmp, sizeof(tmp), fmt, ap);
+	va_end(ap);
+	onion_log_stderr(level, filename, lineno, "%s", tmp);
+}
+
+/// Nanoseconds from a monotonic clock
+static double now(){
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1e9+ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b){
+	double da=*(const double*)a, db=*(const double*)b;
+	return (da>db) - (da<db);
+}
+
+/**
+ * @short Writes a result line, with the latency percentiles of the given latencies, in ns.
+ *
+ * The latencies are sorted in place.
+ */
+static void write_result(const char *kind, const char *name, const char *mode, int connections,
+												 double *latencies, long n, double elapsed, long allocs){
+	qsort(latencies, n, sizeof(double), cmp_double);
+	double p50=n ? latencies[(long)(0.50*(n-1))] : 0;
+	double p99=n ? latencies[(long)(0.99*(n-1))] : 0;
+	double p999=n ? latencies[(long)(0.999*(n-1))] : 0;
+	double rps=elapsed>0 ? n/(elapsed/1e9) : 0;
+	double apr=(allocs>=0 && n) ? (double)allocs/n : -1;
+
+	ONION_INFO("%s %s %s: %ld requests, %.0f req/s, p50 %.2f us, p99 %.2f us, p999 %.2f us, %.2f allocs/req",
+						 kind, name, mode, n, rps, p50/1e3, p99/1e3, p999/1e3, apr);
+	fprintf(csv, "%s,%s,%s,%d,%ld,%.6f,%.1f,%.3f,%.3f,%.3f,%.3f\n",
+					kind, name, mode, connections, n, elapsed/1e9, rps, p50/1e3, p99/1e3, p999/1e3, apr);
+	fflush(csv);
+}
+
+/**
+ * @{ @name Handlers, as the REST front end of bgpd.
+ */
+
+/// Just the request parsing; the response is empty.
+onion_connection_status empty_handler(void *p, onion_request *req, onion_response *res){
+	onion_response_set_length(res, 0);
+	return OCS_PROCESSED;
+}
+
+/// Some data as json, as the bgp neighbors
+onion_connection_status json_handler(void *p, onion_request *req, onion_response *res){
+	struct in_addr rid;
+	if (onion_request_get_param_ipv4(req, "rid", &rid)!=0)
+		return OCS_NOT_PROCESSED;
+	onion_dict *d=onion_dict_new();
+	onion_dict_add(d, "router-id", inet_ntoa(rid), OD_DUP_VALUE);
+	onion_dict_add(d, "as", "65001", 0);
+	int i;
+	char key[32], value[32];
+	for (i=0;i<8;i++){
+		onion_dict *neighbor=onion_dict_new();
+		snprintf(value, sizeof(value), "10.0.%d.1", i);
+		onion_dict_add(neighbor, "address", value, OD_DUP_VALUE);
+		onion_dict_add(neighbor, "state", "Established", 0);
+		onion_dict_add(neighbor, "prefixes", "1024", 0);
+		snprintf(key, sizeof(key), "%d", i);
+		onion_dict_add(d, key, neighbor, OD_DUP_KEY|OD_DICT|OD_FREE_VALUE);
+	}
+	return onion_shortcut_response_json(d, req, res);
+}
+
+/// A 4KB body written in pieces.
+onion_connection_status response_handler(void *p, onion_request *req, onion_response *res){
+	int i;
+	onion_response_set_length(res, 64*64);
+	for (i=0;i<64;i++)
+		onion_response_printf(res, "%-62d\r\n", i);
+	return OCS_PROCESSED;
+}
+
+/// Creates the urls used by all the benchmarks.
+static void add_urls(onion_url *url){
+	char tmp[64];
+	int i;
+	for (i=0;i<16;i++){ // Some noise on the router.
+		snprintf(tmp, sizeof(tmp), "wm/core/module%d", i);
+		onion_url_add_static(url, tmp, "{}", 200);
+	}
+	onion_url_add(url, "empty", empty_handler);
+	onion_url_add(url, "response", response_handler);
+	onion_url_add(url, "wm/bgp/{rid:ipv4}", json_handler);
+	onion_url_add(url, "wm/bgp/{rid:ipv4}/{prefix:ipv4}/{len:int}", empty_handler);
+}
+/// @}
+
+/**
+ * @{ @name Microbenchmarks, in process, with no sockets.
+ */
+
+static int null_write(void *p, const char *data, unsigned int length){
+	return length;
+}
+
+/// Request with the usual headers of a browser.
+#define REQUEST_HEADERS \
+	"Host: localhost:8080\r\n" \
+	"User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:10.0) Gecko/20100101 Firefox/10.0\r\n" \
+	"Accept: application/json,text/html;q=0.9,*/*;q=0.8\r\n" \
+	"Accept-Language: en-us,en;q=0.5\r\n" \
+	"Accept-Encoding: gzip, deflate\r\n" \
+	"Connection: keep-alive\r\n" \
+	"Cache-Control: max-age=0\r\n\r\n"
+
+/// Runs iterations requests through a server with a null writer, reusing the request as keep alive does.
+static void micro_request(const char *name, const char *request, int iterations){
+	onion_server *server=onion_server_new();
+	onion_url *url=onion_url_new();
+	add_urls(url);
+	onion_server_set_root_handler(server, onion_url_to_handler(url));
+	onion_server_set_write(server, null_write);
+
+	double *latencies=malloc(sizeof(double)*iterations);
+	size_t length=strlen(request);
+	onion_request *req=onion_request_new(server, NULL, "bench");
+	onion_request_write(req, request, length); // Warm up
+	int i;
+	long allocs=allocs_count();
+	double start=now();
+	for (i=0;i<iterations;i++){
+		double t=now();
+		int r=onion_request_write(req, request, length);
+		latencies[i]=now()-t;
+		if (r==OCS_CLOSE_CONNECTION || r==OCS_INTERNAL_ERROR){
+			onion_request_free(req);
+			req=onion_request_new(server, NULL, "bench");
+		}
+	}
+	double elapsed=now()-start;
+	allocs=allocs<0 ? -1 : allocs_count()-allocs;
+	write_result("micro", name, "", 0, latencies, iterations, elapsed, allocs);
+
+	free(latencies);
+	onion_request_free(req);
+	onion_server_free(server);
+}
+
+/// Fills and frees a dict with 32 entries, with some lookups
+static void micro_dict(int iterations){
+	double *latencies=malloc(sizeof(double)*iterations);
+	char keys[32][16];
+	int i, j;
+	for (j=0;j<32;j++)
+		snprintf(keys[j], sizeof(keys[j]), "10.0.%d.0/24", j);
+
+	long allocs=allocs_count();
+	double start=now();
+	for (i=0;i<iterations;i++){
+		double t=now();
+		onion_dict *d=onion_dict_new();
+		for (j=0;j<32;j++)
+			onion_dict_add(d, keys[j], "192.168.0.1", 0);
+		for (j=0;j<32;j++)
+			onion_dict_get(d, keys[(j*7)&31]);
+		onion_dict_free(d);
+		latencies[i]=now()-t;
+	}
+	double elapsed=now()-start;
+	allocs=allocs<0 ? -1 : allocs_count()-allocs;
+	write_result("micro", "dict", "", 0, latencies, iterations, elapsed, allocs);
+	free(latencies);
+}
+
+/// Converts to json a dict with 32 routes, as the bgp rib.
+static void micro_json(int iterations){
+	double *latencies=malloc(sizeof(double)*iterations);
+	char key[32], value[32];
+	int i;
+	onion_dict *d=onion_dict_new();
+	for (i=0;i<32;i++){
+		onion_dict *route=onion_dict_new();
+		snprintf(value, sizeof(value), "10.0.%d.1", i);
+		onion_dict_add(route, "nexthop", value, OD_DUP_VALUE);
+		onion_dict_add(route, "path", "65001 65002 65003", 0);
+		snprintf(key, sizeof(key), "10.%d.0.0/16", i);
+		onion_dict_add(d, key, route, OD_DUP_KEY|OD_DICT|OD_FREE_VALUE);
+	}
+
+	long allocs=allocs_count();
+	double start=now();
+	for (i=0;i<iterations;i++){
+		double t=now();
+		onion_block *b=onion_dict_to_json(d);
+		onion_block_free(b);
+		latencies[i]=now()-t;
+	}
+	double elapsed=now()-start;
+	allocs=allocs<0 ? -1 : allocs_count()-allocs;
+	write_result("micro", "json", "", 0, latencies, iterations, elapsed, allocs);
+
+	onion_dict_free(d);
+	free(latencies);
+}
+
+/// Runs all the microbenchmarks
+static void micro(int iterations){
+	micro_request("parser", "GET /empty?a=1&b=2 HTTP/1.1\r\n" REQUEST_HEADERS, iterations);
+	micro_request("router", "GET /wm/bgp/10.0.0.1/192.168.0.0/16 HTTP/1.1\r\n" REQUEST_HEADERS, iterations);
+	micro_dict(iterations);
+	micro_json(iterations);
+	micro_request("response", "GET /response HTTP/1.1\r\n" REQUEST_HEADERS, iterations);
+	micro_request("rest", "GET /wm/bgp/10.0.0.1 HTTP/1.1\r\n" REQUEST_HEADERS, iterations);
+}
+/// @}
+
+/**
+ * @{ @name Load generator
+ *
+ * Each connection is a thread that sends a request and waits for the full response, on keep alive
+ * connections. If the server closes the connection, it connects again.
+ */
+
+typedef struct{
+	const char *port;
+	const char *request;
+	int requests;
+	double *latencies;
+	long done;
+	long errors;
+}load_connection;
+
+/// Connects to localhost, retrying for a while as the server may be starting.
+static int load_connect(const char *port){
+	struct sockaddr_in addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family=AF_INET;
+	addr.sin_port=htons(atoi(port));
+	addr.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+	int i;
+	for (i=0;i<200;i++){
+		int fd=socket(AF_INET, SOCK_STREAM, 0);
+		if (fd<0)
+			return -1;
+		if (connect(fd, (struct sockaddr*)&addr, sizeof(addr))==0){
+			int one=1;
+			setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+			return fd;
+		}
+		close(fd);
+		usleep(10000);
+	}
+	return -1;
+}
+
+/**
+ * @short Reads a full response.
+ *
+ * @returns 1 if the connection is still usable, 0 if closed by the server, -1 on error, and -2 if
+ *   closed before any data, as when the server does not keep alive.
+ */
+static int load_read_response(int fd, char *buffer, size_t size){
+	size_t pos=0;
+	char *body=NULL;
+	long length=-1;
+	int keep_alive=1;
+	for(;;){
+		if (pos>=size-1)
+			return -1;
+		ssize_t r=read(fd, buffer+pos, size-1-pos);
+		if (r<0 && errno==EINTR)
+			continue;
+		if (r<=0){ // Without length, until close.
+			if (pos==0)
+				return -2;
+			return (body && length<0) ? 0 : -1;
+		}
+		pos+=r;
+		buffer[pos]='\0';
+		if (!body){
+			body=strstr(buffer, "\r\n\r\n");
+			if (!body)
+				continue;
+			body+=4;
+			const char *l=strcasestr(buffer, "\r\nContent-Length:");
+			if (l && l<body)
+				length=atol(l+17);
+			l=strcasestr(buffer, "\r\nConnection: close");
+			if (l && l<body)
+				keep_alive=0;
+		}
+		if (length>=0 && buffer+pos>=body+length){
+			if (strncmp(buffer, "HTTP/1.1 200", 12)!=0)
+				return -1;
+			return keep_alive;
+		}
+	}
+}
+
+static void *load_thread(void *p){
+	load_connection *c=p;
+	char buffer[64*1024];
+	size_t length=strlen(c->request);
+	int fd=-1;
+	int reused=0;
+	while (c->done<c->requests){
+		if (fd<0){
+			fd=load_connect(c->port);
+			reused=0;
+		}
+		if (fd<0){
+			c->errors++;
+			break;
+		}
+		double t=now();
+		int r=-1;
+		if (write(fd, c->request, length)==length)
+			r=load_read_response(fd, buffer, sizeof(buffer));
+		if (r==-2 && reused){ // Closed by the server after the last response. Not an error.
+			close(fd);
+			fd=-1;
+			continue;
+		}
+		reused=1;
+		if (r<0){
+			c->errors++;
+			close(fd);
+			fd=-1;
+			if (c->errors>100)
+				break;
+			continue;
+		}
+		c->latencies[c->done++]=now()-t;
+		if (r==0){
+			close(fd);
+			fd=-1;
+		}
+	}
+	if (fd>=0)
+		close(fd);
+	return NULL;
+}
+
+static void *listen_thread(void *o){
+	onion_listen((onion*)o);
+	return NULL;
+}
+
+/// Runs a server on the given mode, and loads it with the given connections.
+static void load(const char *name, int flags, const char *port, const char *path, int connections, int requests){
+	onion *o=onion_new(flags);
+	onion_set_hostname(o, "127.0.0.1");
+	onion_set_port(o, port);
+	add_urls(onion_root_url(o));
+
+	pthread_t listen;
+	pthread_create(&listen, NULL, listen_thread, o);
+
+	char request[1024];
+	snprintf(request, sizeof(request), "GET %s HTTP/1.1\r\n" REQUEST_HEADERS, path);
+	load_connection *c=calloc(connections, sizeof(load_connection));
+	pthread_t *threads=malloc(sizeof(pthread_t)*connections);
+	double *latencies=malloc(sizeof(double)*connections*requests);
+	int i;
+	for (i=0;i<connections;i++){
+		c[i].port=port;
+		c[i].request=request;
+		c[i].requests=requests;
+		c[i].latencies=latencies+i*requests;
+	}
+	// Wait for the server to be ready; it is the first connection.
+	int fd=load_connect(port);
+	if (fd>=0)
+		close(fd);
+
+	long allocs=allocs_count();
+	double start=now();
+	for (i=0;i<connections;i++)
+		pthread_create(&threads[i], NULL, load_thread, &c[i]);
+	for (i=0;i<connections;i++)
+		pthread_join(threads[i], NULL);
+	double elapsed=now()-start;
+	allocs=allocs<0 ? -1 : allocs_count()-allocs;
+
+	// Compact all the latencies
+	long n=0, errors=0;
+	for (i=0;i<connections;i++){
+		memmove(latencies+n, c[i].latencies, sizeof(double)*c[i].done);
+		n+=c[i].done;
+		errors+=c[i].errors;
+	}
+	if (errors)
+		ONION_WARNING("%ld errors on %s", errors, name);
+	write_result("load", path, name, connections, latencies, n, elapsed, allocs);
+
+	onion_listen_stop(o);
+	pthread_join(listen, NULL);
+	usleep(100000); // Let the detached request threads finish.
+	onion_free(o);
+
+	free(latencies);
+	free(threads);
+	free(c);
+}
+/// @}
+
+static void usage(const char *name){
+	fprintf(stderr,
+		"%s [options]\n"
+		"Benchmarks the onion request path, and loads an in process server in each listen mode.\n"
+		"\n"
+		"  -o <file>     Write the CSV results to file. Default stdout.\n"
+		"  -p <port>     Port to listen to at 127.0.0.1. Default 8089.\n"
+		"  -c <n>        Concurrent connections. Default 8; O_ONE_LOOP always uses 1.\n"
+		"  -n <n>        Requests per connection. Default 10000.\n"
+		"  -i <n>        Iterations of each microbenchmark. Default 100000.\n"
+		"  -u <path>     Path to load. Default /wm/bgp/10.0.0.1.\n"
+		"  --no-load     Only microbenchmarks.\n"
+		"  --no-micro    Only load tests.\n"
+		"  -v            Show the onion info messages, as the access log.\n", name);
+}
+
+int main(int argc, char **argv){
+	const char *port="8089";
+	const char *path="/wm/bgp/10.0.0.1";
+	const char *output=NULL;
+	int connections=8;
+	int requests=10000;
+	int iterations=100000;
+	int do_load=1, do_micro=1;
+
+	int i;
+	for (i=1;i<argc;i++){
+		if (strcmp(argv[i],"-o")==0 && i+1<argc)
+			output=argv[++i];
+		else if (strcmp(argv[i],"-p")==0 && i+1<argc)
+			port=argv[++i];
+		else if (strcmp(argv[i],"-c")==0 && i+1<argc)
+			connections=atoi(argv[++i]);
+		else if (strcmp(argv[i],"-n")==0 && i+1<argc)
+			requests=atoi(argv[++i]);
+		else if (strcmp(argv[i],"-i")==0 && i+1<argc)
+			iterations=atoi(argv[++i]);
+		else if (strcmp(argv[i],"-u")==0 && i+1<argc)
+			path=argv[++i];
+		else if (strcmp(argv[i],"--no-load")==0)
+			do_load=0;
+		else if (strcmp(argv[i],"--no-micro")==0)
+			do_micro=0;
+		else if (strcmp(argv[i],"-v")==0)
+			verbose=1;
+		else{
+			usage(argv[0]);
+			return 1;
+		}
+	}
+	if (connections<1 || requests<1 || iterations<1){
+		usage(argv[0]);
+		return 1;
+	}
+
+	onion_log=bench_log;
+	signal(SIGPIPE, SIG_IGN);
+
+	csv=output ? fopen(output, "w") : stdout;
+	if (!csv){
+		ONION_ERROR("Could not open %s for writing", output);
+		return 1;
+	}
+	fprintf(csv, "kind,name,mode,connections,requests,seconds,req_per_s,p50_us,p99_us,p999_us,allocs_per_req\n");
+
+	if (do_micro)
+		micro(iterations);
+	if (do_load){
+		load("O_ONE_LOOP", O_ONE_LOOP, port, path, 1, requests);
+		load("O_THREADED", O_THREADED, port, path, connections, requests);
+		load("O_POLL", O_POLL, port, path, connections, requests);
+		load("O_POOL", O_POOL, port, path, connections, requests);
+	}
+
+	if (output)
+		fclose(csv);
+	return 0;
+}